@@ -1,20 +1,11 @@
 #include "adapter.h"
 #include "bioformats/fastq/fastq_read.h"
+#include "tools/bam/aux/aux_simd.h"
 
 #define ADAPTER_PREFIX 5
 
 //--------------------------------------------------------------------
 
-typedef struct adapter_match {
-  int match;
-  int adapter_start;
-  int adapter_end;
-  int seq_start;
-  int seq_end;
-  int num_mismatches;
-  int length;
-} adapter_match_t;
-
 adapter_match_t *adapter_match_new() {
   adapter_match_t *p = (adapter_match_t *) calloc(1, sizeof(adapter_match_t));
   return p;
@@ -48,6 +39,7 @@ void match_adapter(char *adapter, int adapter_length,
 		   float ratio_error, adapter_match_t *match) {
 
   int i, j, len, pos, num_mismatches;
+  uint32_t mismatches, sum;
   char *p, *seq = sequence;
   char prefix[ADAPTER_PREFIX + 1];
   memcpy(prefix, adapter, ADAPTER_PREFIX);
@@ -59,16 +51,22 @@ void match_adapter(char *adapter, int adapter_length,
   
   while ((p = strstr(seq, prefix)) != NULL) {
     pos = p - sequence;
-    len = 0;
+    len = adapter_length - ADAPTER_PREFIX;
+    if (sequence_length - (pos + ADAPTER_PREFIX) < len) {
+      len = sequence_length - (pos + ADAPTER_PREFIX);
+    }
+    if (len < 0) {
+      len = 0;
+    }
     num_mismatches = 0;
-    for (i = pos + ADAPTER_PREFIX, j = ADAPTER_PREFIX; 
-	 i < sequence_length && j < adapter_length; 
-	 i++, j++) {
-      if (sequence[i] != adapter[j]) {
-	num_mismatches++;
-      }
-      len++;
+    if (len > 0) {
+      // vectorised comparison (see tools/bam/aux/aux_simd.h)
+      simd_kernels.nucleotide_miss_qual_sum(&sequence[pos + ADAPTER_PREFIX], &adapter[ADAPTER_PREFIX],
+					    NULL, len, NULL, &mismatches, &sum);
+      num_mismatches = mismatches;
     }
+    i = pos + ADAPTER_PREFIX + len;
+    j = ADAPTER_PREFIX + len;
     match->length = ADAPTER_PREFIX + len;
     match->num_mismatches = num_mismatches;
     if (num_mismatches <= round(ratio_error * len)) {
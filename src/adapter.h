@@ -1,4 +1,4 @@
-#ifdef _ADAPTER_H
+#ifndef _ADAPTER_H
 #define _ADAPTER_H
 
 #include <string.h>
@@ -8,6 +8,27 @@
 
 //--------------------------------------------------------------------
 
+typedef struct adapter_match {
+  int match;
+  int adapter_start;
+  int adapter_end;
+  int seq_start;
+  int seq_end;
+  int num_mismatches;
+  int length;
+} adapter_match_t;
+
+adapter_match_t *adapter_match_new();
+void adapter_match_free(adapter_match_t *p);
+void adapter_match_init(adapter_match_t *p);
+void adapter_match_display(char *msg, adapter_match_t *p);
+
+//--------------------------------------------------------------------
+
+void match_adapter(char *adapter, int adapter_length, 
+		   char *sequence, int sequence_length,
+		   float ratio_error, adapter_match_t *match);
+
 void cut_adapter(char *adapter, int adapter_length, fastq_read_t *read);
 
 //--------------------------------------------------------------------
@@ -0,0 +1,399 @@
+#include "affinity.h"
+
+// memory policy constants from <numaif.h>, we do not link against libnuma
+#ifndef MPOL_BIND
+#define MPOL_BIND        2
+#define MPOL_INTERLEAVE  3
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE     (1 << 1)
+#endif
+
+#define MAX_PLACEMENT_SAMPLES 4096
+
+//--------------------------------------------------------------------
+
+static numa_topology_t *topology = NULL;
+static int numa_policy = NUMA_NONE;
+static int num_slots = 0;
+static int next_slot = 0;
+
+static __thread int thread_slot = -1;
+static __thread int thread_node = 0;
+
+//--------------------------------------------------------------------
+// numa_topology_t
+//--------------------------------------------------------------------
+
+static int parse_cpu_list(char *list, int *cpus, int max_cpus) {
+  int num_cpus = 0, first, last;
+  char *token = strtok(list, ",\n");
+  while (token) {
+    if (sscanf(token, "%i-%i", &first, &last) == 2) {
+      for (int cpu = first; cpu <= last && num_cpus < max_cpus; cpu++) {
+	cpus[num_cpus++] = cpu;
+      }
+    } else if (sscanf(token, "%i", &first) == 1 && num_cpus < max_cpus) {
+      cpus[num_cpus++] = first;
+    }
+    token = strtok(NULL, ",\n");
+  }
+  return num_cpus;
+}
+
+//--------------------------------------------------------------------
+
+numa_topology_t *numa_topology_new() {
+  char filename[1024], line[4096];
+  FILE *f;
+
+  numa_topology_t *p = (numa_topology_t *) calloc(1, sizeof(numa_topology_t));
+
+  p->num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+  if (p->num_cpus <= 0) p->num_cpus = 1;
+  if (p->num_cpus > CPU_SETSIZE) p->num_cpus = CPU_SETSIZE;
+
+  p->cpu_node = (int *) calloc(p->num_cpus, sizeof(int));
+  p->node_ids = (int *) calloc(AFFINITY_MAX_NODES, sizeof(int));
+  p->node_num_cpus = (int *) calloc(AFFINITY_MAX_NODES, sizeof(int));
+  p->node_cpus = (int **) calloc(AFFINITY_MAX_NODES, sizeof(int *));
+  p->node_mem_total = (size_t *) calloc(AFFINITY_MAX_NODES, sizeof(size_t));
+
+  // cpus the process is allowed to run on (cpusets, cgroups, taskset...)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+    for (int cpu = 0; cpu < p->num_cpus; cpu++) {
+      CPU_SET(cpu, &allowed);
+    }
+  }
+
+  // node ids may be sparse, take them from the online list, or look for
+  // every nodeN directory
+  int node_ids[AFFINITY_MAX_NODES], num_node_ids = 0;
+  if ((f = fopen("/sys/devices/system/node/online", "r")) != NULL) {
+    if (fgets(line, sizeof(line), f)) {
+      num_node_ids = parse_cpu_list(line, node_ids, AFFINITY_MAX_NODES);
+    }
+    fclose(f);
+  }
+  if (num_node_ids == 0) {
+    for (int node = 0; node < AFFINITY_MAX_NODES; node++) {
+      sprintf(filename, "/sys/devices/system/node/node%i", node);
+      if (access(filename, F_OK) == 0) {
+	node_ids[num_node_ids++] = node;
+      }
+    }
+  }
+
+  int *cpus = (int *) calloc(p->num_cpus, sizeof(int));
+  for (int k = 0; k < num_node_ids; k++) {
+    int id = node_ids[k];
+    if (id < 0 || id >= AFFINITY_MAX_NODES) {
+      continue;
+    }
+
+    int num_cpus = 0;
+    sprintf(filename, "/sys/devices/system/node/node%i/cpulist", id);
+    if ((f = fopen(filename, "r")) != NULL) {
+      if (fgets(line, sizeof(line), f)) {
+	num_cpus = parse_cpu_list(line, cpus, p->num_cpus);
+      }
+      fclose(f);
+    }
+
+    // nodes without allowed cpus (e.g., memory-only nodes) get no threads
+    int node = p->num_nodes;
+    p->node_cpus[node] = (int *) calloc(p->num_cpus, sizeof(int));
+    for (int i = 0; i < num_cpus; i++) {
+      if (cpus[i] < p->num_cpus && CPU_ISSET(cpus[i], &allowed)) {
+	p->node_cpus[node][p->node_num_cpus[node]++] = cpus[i];
+	p->cpu_node[cpus[i]] = node;
+      }
+    }
+    if (p->node_num_cpus[node] == 0) {
+      free(p->node_cpus[node]);
+      p->node_cpus[node] = NULL;
+      continue;
+    }
+    p->node_ids[node] = id;
+
+    sprintf(filename, "/sys/devices/system/node/node%i/meminfo", id);
+    if ((f = fopen(filename, "r")) != NULL) {
+      size_t kbytes;
+      while (fgets(line, sizeof(line), f)) {
+	if (sscanf(line, "Node %*i MemTotal: %lu kB", &kbytes) == 1) {
+	  p->node_mem_total[node] = kbytes * 1024;
+	  break;
+	}
+      }
+      fclose(f);
+    }
+    p->num_nodes++;
+  }
+  free(cpus);
+
+  // no NUMA support in the kernel, all the allowed cpus in a single node
+  if (p->num_nodes == 0) {
+    p->num_nodes = 1;
+    p->node_ids[0] = 0;
+    p->node_cpus[0] = (int *) calloc(p->num_cpus, sizeof(int));
+    for (int cpu = 0; cpu < p->num_cpus; cpu++) {
+      if (CPU_ISSET(cpu, &allowed)) {
+	p->node_cpus[0][p->node_num_cpus[0]++] = cpu;
+      }
+    }
+    if (p->node_num_cpus[0] == 0) {
+      p->node_num_cpus[0] = 1;
+    }
+  }
+
+  return p;
+}
+
+//--------------------------------------------------------------------
+
+void numa_topology_free(numa_topology_t *p) {
+  if (p) {
+    if (p->cpu_node) free(p->cpu_node);
+    if (p->node_ids) free(p->node_ids);
+    if (p->node_num_cpus) free(p->node_num_cpus);
+    if (p->node_cpus) {
+      for (int i = 0; i < AFFINITY_MAX_NODES; i++) {
+	if (p->node_cpus[i]) free(p->node_cpus[i]);
+      }
+      free(p->node_cpus);
+    }
+    if (p->node_mem_total) free(p->node_mem_total);
+    free(p);
+  }
+}
+
+//--------------------------------------------------------------------
+// affinity layer
+//--------------------------------------------------------------------
+
+int parse_numa_policy(char *str) {
+  if (!str || !strcmp(str, "none")) {
+    return NUMA_NONE;
+  } else if (!strcmp(str, "interleave")) {
+    return NUMA_INTERLEAVE;
+  } else if (!strcmp(str, "replicate")) {
+    return NUMA_REPLICATE;
+  }
+  printf("Invalid NUMA policy '%s'. Valid values are: none, interleave, replicate\n", str);
+  exit(-1);
+}
+
+//--------------------------------------------------------------------
+
+void affinity_init(int policy, int num_threads) {
+  if (topology) {
+    numa_topology_free(topology);
+  }
+  topology = numa_topology_new();
+  numa_policy = policy;
+  num_slots = num_threads;
+  next_slot = 0;
+
+  // replicas make no sense with a single node
+  if (numa_policy == NUMA_REPLICATE && topology->num_nodes == 1) {
+    numa_policy = NUMA_INTERLEAVE;
+  }
+}
+
+//--------------------------------------------------------------------
+
+void affinity_free() {
+  numa_topology_free(topology);
+  topology = NULL;
+  numa_policy = NUMA_NONE;
+}
+
+//--------------------------------------------------------------------
+
+int affinity_get_policy() {
+  return numa_policy;
+}
+
+//--------------------------------------------------------------------
+
+int affinity_get_num_nodes() {
+  return (topology ? topology->num_nodes : 1);
+}
+
+//--------------------------------------------------------------------
+
+int affinity_node_id(int node) {
+  return (topology ? topology->node_ids[node] : node);
+}
+
+//--------------------------------------------------------------------
+
+int affinity_slot_cpu(int slot) {
+  if (!topology) {
+    return slot % sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  int node = slot % topology->num_nodes;
+  int index = (slot / topology->num_nodes) % topology->node_num_cpus[node];
+  return topology->node_cpus[node][index];
+}
+
+//--------------------------------------------------------------------
+
+void affinity_pin_thread() {
+  if (thread_slot >= 0 || numa_policy == NUMA_NONE || !topology) {
+    return;
+  }
+
+  thread_slot = __sync_fetch_and_add(&next_slot, 1);
+
+  int cpu = affinity_slot_cpu(thread_slot);
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set)) {
+    // not allowed (e.g., cpuset restrictions), the thread keeps floating
+    return;
+  }
+
+  thread_node = topology->cpu_node[cpu];
+}
+
+//--------------------------------------------------------------------
+
+int affinity_thread_node() {
+  return thread_node;
+}
+
+//--------------------------------------------------------------------
+// memory placement
+//--------------------------------------------------------------------
+
+static inline int page_range(void *ptr, size_t size, char **start, size_t *len) {
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t addr = ((size_t) ptr + page_size - 1) & ~(page_size - 1);
+  size_t end = ((size_t) ptr + size) & ~(page_size - 1);
+  if (end <= addr) {
+    return 0;
+  }
+  *start = (char *) addr;
+  *len = end - addr;
+  return 1;
+}
+
+//--------------------------------------------------------------------
+
+void affinity_interleave(void *ptr, size_t size) {
+  char *start;
+  size_t len;
+
+  if (numa_policy == NUMA_NONE || !topology || topology->num_nodes == 1 ||
+      !page_range(ptr, size, &start, &len)) {
+    return;
+  }
+
+  unsigned long mask = 0;
+  for (int node = 0; node < topology->num_nodes; node++) {
+    mask |= (1UL << topology->node_ids[node]);
+  }
+  syscall(SYS_mbind, start, len, MPOL_INTERLEAVE, &mask, AFFINITY_MAX_NODES + 1, MPOL_MF_MOVE);
+}
+
+//--------------------------------------------------------------------
+
+void affinity_bind(void *ptr, size_t size, int node) {
+  char *start;
+  size_t len;
+
+  if (!topology || topology->num_nodes == 1 ||
+      !page_range(ptr, size, &start, &len)) {
+    return;
+  }
+
+  unsigned long mask = (1UL << topology->node_ids[node]);
+  syscall(SYS_mbind, start, len, MPOL_BIND, &mask, AFFINITY_MAX_NODES + 1, MPOL_MF_MOVE);
+}
+
+//--------------------------------------------------------------------
+
+void *affinity_alloc_on_node(size_t size, int node) {
+  void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    printf("Error: could not allocate %lu bytes on NUMA node %i\n", size, node);
+    exit(-1);
+  }
+  affinity_bind(p, size, node);
+  return p;
+}
+
+//--------------------------------------------------------------------
+
+void affinity_free_on_node(void *ptr, size_t size) {
+  if (ptr) munmap(ptr, size);
+}
+
+//--------------------------------------------------------------------
+
+void affinity_placement(void *ptr, size_t size, size_t *node_bytes) {
+  char *start;
+  size_t len;
+
+  if (!ptr || !page_range(ptr, size, &start, &len)) {
+    return;
+  }
+
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t num_pages = len / page_size;
+  size_t num_samples = (num_pages < MAX_PLACEMENT_SAMPLES ? num_pages : MAX_PLACEMENT_SAMPLES);
+  size_t step = num_pages / num_samples;
+
+  void *pages[num_samples];
+  int status[num_samples];
+  for (size_t i = 0; i < num_samples; i++) {
+    pages[i] = start + i * step * page_size;
+    status[i] = -1;
+  }
+
+  if (syscall(SYS_move_pages, 0, num_samples, pages, NULL, status, 0)) {
+    return;
+  }
+
+  // kernel node ids to node indexes, pages on nodes without threads are
+  // not counted
+  for (size_t i = 0; i < num_samples; i++) {
+    for (int node = 0; topology && node < topology->num_nodes; node++) {
+      if (topology->node_ids[node] == status[i]) {
+	node_bytes[node] += size / num_samples;
+	break;
+      }
+    }
+  }
+}
+
+//--------------------------------------------------------------------
+
+void affinity_display() {
+  if (!topology) return;
+
+  // threads are pinned lazily, so display the planned distribution
+  int node_threads[AFFINITY_MAX_NODES];
+  memset(node_threads, 0, sizeof(node_threads));
+  for (int slot = 0; slot < num_slots; slot++) {
+    node_threads[topology->cpu_node[affinity_slot_cpu(slot)]]++;
+  }
+
+  printf("NUMA placement (policy: %s)\n", NUMA_POLICY_STR(numa_policy));
+  for (int node = 0; node < topology->num_nodes; node++) {
+    printf("\tNode %i: %i cpus, %0.2f GB", topology->node_ids[node], topology->node_num_cpus[node],
+	   topology->node_mem_total[node] / 1073741824.0f);
+    if (numa_policy != NUMA_NONE) {
+      printf(", %i threads", node_threads[node]);
+    }
+    printf("\n");
+  }
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
@@ -0,0 +1,94 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+
+//--------------------------------------------------------------------
+// NUMA policies (--numa option)
+//--------------------------------------------------------------------
+
+#define NUMA_NONE        0
+#define NUMA_INTERLEAVE  1
+#define NUMA_REPLICATE   2
+
+#define NUMA_POLICY_STR(p) (p == NUMA_INTERLEAVE ? "interleave" : (p == NUMA_REPLICATE ? "replicate" : "none"))
+
+#define AFFINITY_MAX_NODES  64
+
+//--------------------------------------------------------------------
+// numa_topology_t: nodes and cpus as seen in /sys/devices/system/node,
+// only the nodes with cpus the process is allowed to run on, indexed
+// from 0 (node_ids keeps the kernel ids, which may be sparse)
+//--------------------------------------------------------------------
+
+typedef struct numa_topology {
+  int num_nodes;
+  int num_cpus;
+  int *cpu_node;           // node for each cpu id
+  int *node_ids;           // kernel node id per node
+  int *node_num_cpus;      // number of allowed cpus per node
+  int **node_cpus;         // cpu ids per node
+  size_t *node_mem_total;  // in bytes
+} numa_topology_t;
+
+numa_topology_t *numa_topology_new();
+void numa_topology_free(numa_topology_t *p);
+
+//--------------------------------------------------------------------
+// affinity layer, the global state is set once from the options
+//--------------------------------------------------------------------
+
+int parse_numa_policy(char *str);
+
+void affinity_init(int policy, int num_threads);
+void affinity_free();
+
+int affinity_get_policy();
+int affinity_get_num_nodes();
+
+// pins the calling thread to the next slot (round-robin over the nodes),
+// it does nothing when already pinned or the policy is NUMA_NONE
+void affinity_pin_thread();
+
+// cpu for the thread slot 'slot' (round-robin over the nodes)
+int affinity_slot_cpu(int slot);
+
+// kernel id of the node 'node'
+int affinity_node_id(int node);
+
+// node of the calling thread, 0 if unknown
+int affinity_thread_node();
+
+//--------------------------------------------------------------------
+// memory placement
+//--------------------------------------------------------------------
+
+// sets interleave policy for the pages of [ptr, ptr + size), it must
+// be called before the first touch
+void affinity_interleave(void *ptr, size_t size);
+
+// sets bind policy on node 'node' for the pages of [ptr, ptr + size)
+void affinity_bind(void *ptr, size_t size, int node);
+
+// allocates 'size' bytes on node 'node' (use affinity_free_on_node)
+void *affinity_alloc_on_node(size_t size, int node);
+void affinity_free_on_node(void *ptr, size_t size);
+
+// counts how many bytes of [ptr, ptr + size) are placed on each node
+// by sampling pages, node_bytes must have AFFINITY_MAX_NODES items
+void affinity_placement(void *ptr, size_t size, size_t *node_bytes);
+
+// displays the topology and thread placement
+void affinity_display();
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+#endif // AFFINITY_H
@@ -38,6 +38,7 @@ void batch_writer_input_init(char* match_filename,
 
   // internal
   input_p->bam_file = NULL;
+  input_p->recal_table = NULL;
   input_p->total_batches = 0;
   input_p->total_reads = 0;
   input_p->total_mappings = 0;
@@ -41,6 +41,9 @@ struct batch_writer_input {
   char* splice_extend_filename;
   genome_t* genome;
   linked_list_t* list_p;
+
+  // base qualities of BAM records recalibrated while they are written, NULL otherwise
+  struct recal_table *recal_table;
 };
 
 //------------------------------------------------------------------------------------
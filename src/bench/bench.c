@@ -0,0 +1,318 @@
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "bench.h"
+
+//--------------------------------------------------------------------
+// fixed-seed generator, the same seed always gives the same input
+//--------------------------------------------------------------------
+
+static uint64_t bench_rand_state = BENCH_SEED;
+
+static inline uint32_t bench_rand() {
+  bench_rand_state = bench_rand_state * 6364136223846793005LLU + 1442695040888963407LLU;
+  return (uint32_t) (bench_rand_state >> 33);
+}
+
+static inline float bench_rand_float() {
+  return (bench_rand() & 0xFFFFFF) / (float) 0x1000000;
+}
+
+static char bench_nts[4] = { 'A', 'C', 'G', 'T' };
+
+static inline char bench_mismatch(char nt) {
+  char c;
+  do {
+    c = bench_nts[bench_rand() & 3];
+  } while (c == nt);
+  return c;
+}
+
+//--------------------------------------------------------------------
+
+static void bench_usage(char *exec_name) {
+  printf("Usage: %s [options]\n\n", exec_name);
+  printf("Micro-benchmarks for the alignment kernels on synthetic data\n\n");
+  printf("  -g <num>   genome length (default %i)\n", BENCH_GENOME_LENGTH);
+  printf("  -c <num>   number of chromosomes (default %i)\n", BENCH_NUM_CHROMS);
+  printf("  -n <num>   number of reads (default %i)\n", BENCH_NUM_READS);
+  printf("  -l <num>   read length (default %i)\n", BENCH_READ_LENGTH);
+  printf("  -i <num>   timed iterations per kernel (default %i)\n", BENCH_ITERATIONS);
+  printf("  -s <num>   random seed (default %i)\n", BENCH_SEED);
+  printf("  -k <name>  run only the kernels whose name contains <name>\n");
+  printf("  -x <isa>   instruction set of the generic variants: scalar, sse2, avx2\n");
+  printf("             or avx512 (default: the best one supported by the CPU)\n");
+  printf("  -d <dir>   directory for the synthetic genome and SA index, an index\n");
+  printf("             already built there is reused (default: temporary directory)\n");
+  printf("  -h         display this help\n");
+  exit(0);
+}
+
+//--------------------------------------------------------------------
+// synthetic genome and SA index
+//--------------------------------------------------------------------
+
+static void bench_write_genome(char *filename, size_t genome_length, int num_chroms) {
+  FILE *f = fopen(filename, "w");
+  if (!f) {
+    printf("Error: could not open %s to write\n", filename);
+    exit(-1);
+  }
+
+  size_t chrom_length = genome_length / num_chroms;
+  for (int c = 0; c < num_chroms; c++) {
+    fprintf(f, ">chr%i\n", c + 1);
+    for (size_t i = 0; i < chrom_length; i++) {
+      fputc(bench_nts[bench_rand() & 3], f);
+      if ((i + 1) % 60 == 0 || i + 1 == chrom_length) fputc('\n', f);
+    }
+  }
+  fclose(f);
+}
+
+//--------------------------------------------------------------------
+
+static sa_index3_t *bench_sa_index(char *dirname, size_t genome_length, int num_chroms) {
+  char filename[strlen(dirname) + 100];
+
+  sprintf(filename, "%s/params.txt", dirname);
+  if (access(filename, F_OK)) {
+    sprintf(filename, "%s/bench.fa", dirname);
+    bench_write_genome(filename, genome_length, num_chroms);
+    sa_index3_build_k18(filename, 18, dirname);
+  }
+
+  return sa_index3_new(dirname);
+}
+
+//--------------------------------------------------------------------
+
+static void bench_remove_dir(char *dirname) {
+  DIR *dir = opendir(dirname);
+  if (!dir) return;
+
+  struct dirent *entry;
+  char filename[strlen(dirname) + 512];
+  while ((entry = readdir(dir)) != NULL) {
+    if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+    sprintf(filename, "%s/%s", dirname, entry->d_name);
+    unlink(filename);
+  }
+  closedir(dir);
+  rmdir(dirname);
+}
+
+//--------------------------------------------------------------------
+// synthetic reads, sampled from the genome with mismatches and, for a
+// fraction of them, an adapter at the 3' end
+//--------------------------------------------------------------------
+
+static bench_data_t *bench_data_new(sa_index3_t *sa_index, int num_reads, int read_length) {
+  sa_genome3_t *genome = sa_index->genome;
+  int adapter_length = strlen(BENCH_ADAPTER);
+
+  bench_data_t *p = (bench_data_t *) calloc(1, sizeof(bench_data_t));
+  p->num_reads = num_reads;
+  p->read_length = read_length;
+  p->sa_index = sa_index;
+  p->reads = (bench_read_t *) calloc(num_reads, sizeof(bench_read_t));
+
+  char quality[read_length + 1];
+  memset(quality, 'I', read_length);
+  quality[read_length] = 0;
+
+  char id[64];
+  for (int i = 0; i < num_reads; i++) {
+    bench_read_t *read = &p->reads[i];
+    do {
+      read->chrom = bench_rand() % genome->num_chroms;
+    } while (genome->chrom_lengths[read->chrom] < read_length + 2 * BENCH_REF_FLANK);
+
+    size_t max_pos = genome->chrom_lengths[read->chrom] - read_length - 2 * BENCH_REF_FLANK;
+    size_t ref_start = bench_rand() % (max_pos + 1);
+    char *S = &genome->S[genome->chrom_offsets[read->chrom] + ref_start];
+
+    read->pos = ref_start + BENCH_REF_FLANK;
+    read->ref_length = read_length + 2 * BENCH_REF_FLANK;
+    read->ref = (char *) malloc(read->ref_length + 1);
+    memcpy(read->ref, S, read->ref_length);
+    read->ref[read->ref_length] = 0;
+
+    read->seq = (char *) malloc(read_length + 1);
+    memcpy(read->seq, S + BENCH_REF_FLANK, read_length);
+    read->seq[read_length] = 0;
+    for (int j = 0; j < read_length; j++) {
+      if (bench_rand_float() < BENCH_MISMATCH_RATE) {
+	read->seq[j] = bench_mismatch(read->seq[j]);
+      }
+    }
+    if (bench_rand_float() < BENCH_ADAPTER_RATE) {
+      int len = (BENCH_ADAPTER_LENGTH < adapter_length ? BENCH_ADAPTER_LENGTH : adapter_length);
+      if (len > read_length) len = read_length;
+      memcpy(&read->seq[read_length - len], BENCH_ADAPTER, len);
+    }
+
+    sprintf(id, "bench_%i", i);
+    read->fq_read = fastq_read_new(id, read->seq, quality);
+  }
+
+  return p;
+}
+
+//--------------------------------------------------------------------
+
+static void bench_data_free(bench_data_t *p) {
+  for (int i = 0; i < p->num_reads; i++) {
+    free(p->reads[i].seq);
+    free(p->reads[i].ref);
+    fastq_read_free(p->reads[i].fq_read);
+  }
+  free(p->reads);
+  free(p);
+}
+
+//--------------------------------------------------------------------
+// runs a kernel variant: one warm-up pass (also gives the checksum)
+// and then the timed iterations
+//--------------------------------------------------------------------
+
+static void bench_run(bench_kernel_t *kernel, bench_data_t *data, int iterations,
+		      bench_result_t *result, double *ns, double *cycles) {
+  bench_result_t timed;
+
+  memset(result, 0, sizeof(bench_result_t));
+  kernel->run(data, result);
+
+  memset(&timed, 0, sizeof(bench_result_t));
+  uint64_t start_ns = metrics_now();
+  uint64_t start_ticks = profile_ticks();
+  for (int i = 0; i < iterations; i++) {
+    kernel->run(data, &timed);
+  }
+  uint64_t ticks = profile_ticks() - start_ticks;
+  uint64_t elapsed = metrics_now() - start_ns;
+
+  *ns = (timed.ops ? (double) elapsed / timed.ops : 0.0);
+  *cycles = (timed.ops ? (double) ticks / timed.ops : 0.0);
+}
+
+//--------------------------------------------------------------------
+
+int main(int argc, char *argv[]) {
+  size_t genome_length = BENCH_GENOME_LENGTH;
+  int num_chroms = BENCH_NUM_CHROMS;
+  int num_reads = BENCH_NUM_READS;
+  int read_length = BENCH_READ_LENGTH;
+  int iterations = BENCH_ITERATIONS;
+  char *filter = NULL, *dirname = NULL, *isa_name = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "g:c:n:l:i:s:k:d:x:h")) != -1) {
+    switch (opt) {
+    case 'g': genome_length = atol(optarg); break;
+    case 'c': num_chroms = atoi(optarg); break;
+    case 'n': num_reads = atoi(optarg); break;
+    case 'l': read_length = atoi(optarg); break;
+    case 'i': iterations = atoi(optarg); break;
+    case 's': bench_rand_state = atol(optarg); break;
+    case 'k': filter = optarg; break;
+    case 'd': dirname = optarg; break;
+    case 'x': isa_name = optarg; break;
+    default: bench_usage(argv[0]);
+    }
+  }
+
+  if (num_chroms <= 0 || num_reads <= 0 || iterations <= 0 ||
+      read_length < 2 * BENCH_ADAPTER_LENGTH ||
+      genome_length / num_chroms < read_length + 2 * BENCH_REF_FLANK) {
+    printf("Error: invalid benchmark parameters (use -h to display the options)\n");
+    exit(-1);
+  }
+
+  // vectorised kernels
+  simd_init();
+  if (isa_name) {
+    int isa = simd_isa_from_name(isa_name);
+    if (isa < 0 || simd_set_isa(isa) != NO_ERROR) {
+      printf("Error: instruction set %s unknown or not supported by this CPU\n", isa_name);
+      exit(-1);
+    }
+  }
+
+  // synthetic genome and index
+  char tmp_dirname[] = "/tmp/hpg-bench.XXXXXX";
+  int remove_dir = 0;
+  if (!dirname) {
+    if (!mkdtemp(tmp_dirname)) {
+      printf("Error: could not create the temporary directory %s\n", tmp_dirname);
+      exit(-1);
+    }
+    dirname = tmp_dirname;
+    remove_dir = 1;
+  } else {
+    mkdir(dirname, 0755);
+  }
+
+  sa_index3_t *sa_index = bench_sa_index(dirname, genome_length, num_chroms);
+  bench_data_t *data = bench_data_new(sa_index, num_reads, read_length);
+
+  printf("\nhpg-bench: genome %lu nt, %i chromosomes, %i reads x %i nt, %i iterations, %s kernels\n\n",
+	 sa_index->genome->length, (int) sa_index->genome->num_chroms,
+	 num_reads, read_length, iterations, simd_isa_name(simd_kernels.isa));
+  printf("%-20s %-10s %10s %12s %12s %10s %18s  %s\n",
+	 "kernel", "variant", "ops", "ns/op", "cycles/op", "bytes/op", "checksum", "check");
+
+  // every variant is checked against the first variant of its kernel
+  int num_mismatches = 0;
+  char *ref_name = NULL;
+  uint64_t ref_checksum = 0;
+
+  bench_result_t result;
+  double ns, cycles;
+  for (int k = 0; k < num_bench_kernels; k++) {
+    bench_kernel_t *kernel = &bench_kernels[k];
+    if (filter && !strstr(kernel->name, filter)) continue;
+
+    if (!kernel->supported()) {
+      printf("%-20s %-10s %10s\n", kernel->name, kernel->variant, "unsupported");
+      continue;
+    }
+
+    bench_run(kernel, data, iterations, &result, &ns, &cycles);
+
+    char *check = "ref";
+    if (ref_name && !strcmp(ref_name, kernel->name)) {
+      if (result.checksum == ref_checksum) {
+	check = "ok";
+      } else {
+	check = "MISMATCH";
+	num_mismatches++;
+      }
+    } else {
+      ref_name = kernel->name;
+      ref_checksum = result.checksum;
+    }
+
+    printf("%-20s %-10s %10lu %12.1f %12.1f %10.1f %#18lx  %s\n",
+	   kernel->name, kernel->variant, result.ops, ns, cycles,
+	   (result.ops ? (double) result.bytes / result.ops : 0.0),
+	   result.checksum, check);
+    fflush(stdout);
+  }
+
+  bench_data_free(data);
+  sa_index3_free(sa_index);
+  if (remove_dir) {
+    bench_remove_dir(dirname);
+  }
+
+  if (num_mismatches) {
+    printf("\n%i kernel variant(s) do not match the reference results\n", num_mismatches);
+    return 1;
+  }
+  return 0;
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
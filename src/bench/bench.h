@@ -0,0 +1,98 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "bioformats/fastq/fastq_read.h"
+
+#include "metrics.h"
+#include "profile.h"
+
+#include "adapter.h"
+#include "sa/sa_index3.h"
+#include "sa/sa_search.h"
+#include "dna/sa_dna_commons.h"
+#include "dna/sa_mapper_stage.h"
+#include "dna/doscadfun.h"
+#include "sw_server.h"
+
+#include "tools/bam/aux/aux_simd.h"
+#include "tools/bam/recalibrate/bam_recal_library.h"
+
+//--------------------------------------------------------------------
+// micro-benchmarks for the alignment kernels (scons bench)
+//
+// the input (genome, SA index and reads) is synthetic and generated
+// from a fixed seed, so two runs with the same parameters process the
+// same data and every kernel variant must produce the same checksum
+//--------------------------------------------------------------------
+
+#define BENCH_GENOME_LENGTH   4000000
+#define BENCH_NUM_CHROMS      4
+#define BENCH_NUM_READS       20000
+#define BENCH_READ_LENGTH     100
+#define BENCH_ITERATIONS      5
+#define BENCH_SEED            1
+
+#define BENCH_MISMATCH_RATE   0.01f
+#define BENCH_ADAPTER_RATE    0.30f
+#define BENCH_ADAPTER_LENGTH  20
+#define BENCH_REF_FLANK       5
+#define BENCH_SW_BATCH        64
+
+#define BENCH_ADAPTER  "AGATCGGAAGAGCACACGTCTGAACTCCAGTCAC"
+
+//--------------------------------------------------------------------
+
+typedef struct bench_read {
+  char *seq;        // read sequence (mismatches and adapter included)
+  char *ref;        // reference region, BENCH_REF_FLANK nt on both sides
+  int ref_length;
+  int chrom;
+  size_t pos;       // read start in the chromosome
+  fastq_read_t *fq_read;
+} bench_read_t;
+
+typedef struct bench_data {
+  int num_reads;
+  int read_length;
+  bench_read_t *reads;
+  sa_index3_t *sa_index;
+} bench_data_t;
+
+typedef struct bench_result {
+  size_t ops;
+  size_t bytes;
+  uint64_t checksum;
+} bench_result_t;
+
+//--------------------------------------------------------------------
+// a kernel variant runs once over the whole input, kernels with the
+// same name are different implementations (CPU dispatch variants) of
+// the same function, the first one registered is the reference
+//--------------------------------------------------------------------
+
+typedef struct bench_kernel {
+  char *name;
+  char *variant;
+  int (*supported)();
+  void (*run)(bench_data_t *data, bench_result_t *result);
+} bench_kernel_t;
+
+extern bench_kernel_t bench_kernels[];
+extern int num_bench_kernels;
+
+//--------------------------------------------------------------------
+
+static inline void bench_checksum(uint64_t value, bench_result_t *result) {
+  // FNV-1a style mix, order dependent
+  result->checksum = (result->checksum ^ value) * 1099511628211LLU;
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+#endif // BENCH_H
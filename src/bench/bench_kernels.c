@@ -0,0 +1,294 @@
+#include "bench.h"
+
+//--------------------------------------------------------------------
+
+static int bench_always() {
+  return 1;
+}
+
+//--------------------------------------------------------------------
+// SA index search
+//--------------------------------------------------------------------
+
+static void bench_search_prefix(bench_data_t *data, bench_result_t *result) {
+  size_t low, high, num;
+  sa_index3_t *sa_index = data->sa_index;
+
+  for (int i = 0; i < data->num_reads; i++) {
+    num = search_prefix(data->reads[i].seq, &low, &high, sa_index, 0);
+    bench_checksum(num ? low : num, result);
+    bench_checksum(num, result);
+    result->bytes += sa_index->k_value;
+  }
+  result->ops += data->num_reads;
+}
+
+//--------------------------------------------------------------------
+
+static void bench_search_suffix(bench_data_t *data, bench_result_t *result) {
+  size_t low, high, suffix_len, num;
+
+  for (int i = 0; i < data->num_reads; i++) {
+    num = search_suffix(data->reads[i].seq, data->read_length, MAX_NUM_SUFFIXES,
+			data->sa_index, &low, &high, &suffix_len);
+    bench_checksum(num, result);
+    bench_checksum(suffix_len, result);
+    result->bytes += data->read_length;
+  }
+  result->ops += data->num_reads;
+}
+
+//--------------------------------------------------------------------
+// alignment
+//--------------------------------------------------------------------
+
+static void bench_doscadfun(bench_data_t *data, bench_result_t *result) {
+  float score;
+  alig_out_t alig_out;
+  cigar_init(&alig_out.cigar);
+
+  for (int i = 0; i < data->num_reads; i++) {
+    bench_read_t *read = &data->reads[i];
+    alig_out_init(&alig_out);
+    score = doscadfun(read->seq, data->read_length,
+		      read->ref + BENCH_REF_FLANK, data->read_length,
+		      0.1f, &alig_out);
+    bench_checksum((uint64_t) (score * 1000), result);
+    bench_checksum(alig_out.mismatch, result);
+    result->bytes += 2 * data->read_length;
+  }
+  result->ops += data->num_reads;
+
+  cigar_clean(&alig_out.cigar);
+}
+
+//--------------------------------------------------------------------
+
+static void bench_smith_waterman(bench_data_t *data, bench_result_t *result) {
+  char *q[BENCH_SW_BATCH], *r[BENCH_SW_BATCH];
+
+  sw_optarg_t sw_optarg;
+  sw_optarg_init(10, 0.5, 5, -4, &sw_optarg);
+
+  for (int i = 0; i < data->num_reads; i += BENCH_SW_BATCH) {
+    int count = 0;
+    for (int j = i; j < data->num_reads && count < BENCH_SW_BATCH; j++, count++) {
+      q[count] = data->reads[j].seq;
+      r[count] = data->reads[j].ref;
+      result->bytes += data->read_length + data->reads[j].ref_length;
+    }
+
+    sw_multi_output_t *sw_output = sw_multi_output_new(count);
+    smith_waterman_mqmr(q, r, count, &sw_optarg, 1, sw_output);
+    for (int j = 0; j < count; j++) {
+      bench_checksum((uint64_t) (sw_output->score_p[j] * 1000), result);
+      bench_checksum(sw_output->query_start_p[j], result);
+      bench_checksum(sw_output->ref_start_p[j], result);
+    }
+    sw_multi_output_free(sw_output);
+
+    result->ops += count;
+  }
+}
+
+//--------------------------------------------------------------------
+// cigar helpers: one cigar per read built base by base ('=' and 'X'
+// runs merged by cigar_append_op), then measured and printed
+//--------------------------------------------------------------------
+
+static void bench_cigar(bench_data_t *data, bench_result_t *result) {
+  cigar_t cigar;
+  char *str;
+
+  for (int i = 0; i < data->num_reads; i++) {
+    bench_read_t *read = &data->reads[i];
+    char *ref = read->ref + BENCH_REF_FLANK;
+
+    cigar_init(&cigar);
+    for (int j = 0; j < data->read_length; j++) {
+      cigar_append_op(1, (read->seq[j] == ref[j] ? '=' : 'X'), &cigar);
+    }
+    str = cigar_to_string(&cigar);
+
+    bench_checksum(cigar.num_ops, result);
+    bench_checksum(cigar_get_length(&cigar), result);
+    bench_checksum(strlen(str), result);
+
+    free(str);
+    cigar_clean(&cigar);
+
+    result->bytes += data->read_length;
+  }
+  result->ops += data->num_reads;
+}
+
+//--------------------------------------------------------------------
+// adapter
+//--------------------------------------------------------------------
+
+static void bench_match_adapter(bench_data_t *data, bench_result_t *result) {
+  adapter_match_t match;
+  int adapter_length = strlen(BENCH_ADAPTER);
+
+  for (int i = 0; i < data->num_reads; i++) {
+    adapter_match_init(&match);
+    match_adapter(BENCH_ADAPTER, adapter_length, data->reads[i].seq, data->read_length,
+		  0.1f, &match);
+    bench_checksum(match.match ? match.seq_start : -1, result);
+    result->bytes += data->read_length;
+  }
+  result->ops += data->num_reads;
+}
+
+//--------------------------------------------------------------------
+// nucleotide comparison (realigner and recalibration scores) and base
+// selection of the recalibration, both through the dispatch layer
+//--------------------------------------------------------------------
+
+static void bench_nucleotide_compare(bench_data_t *data, bench_result_t *result) {
+  uint32_t misses, sum;
+  char comp[data->read_length];
+
+  for (int i = 0; i < data->num_reads; i++) {
+    bench_read_t *read = &data->reads[i];
+    simd_kernels.nucleotide_miss_qual_sum(read->ref + BENCH_REF_FLANK, read->seq, read->fq_read->quality,
+					  data->read_length, comp, &misses, &sum);
+    bench_checksum(misses, result);
+    bench_checksum(sum, result);
+    bench_checksum(comp[data->read_length - 1], result);
+    result->bytes += 3 * data->read_length;
+  }
+  result->ops += data->num_reads;
+}
+
+//--------------------------------------------------------------------
+
+static void bench_recal_select_bases(bench_data_t *data, bench_result_t *result) {
+  uint64_t valid, bad;
+
+  for (int i = 0; i < data->num_reads; i++) {
+    bench_read_t *read = &data->reads[i];
+    for (int j = 0; j < data->read_length; j += 64) {
+      int len = (data->read_length - j < 64 ? data->read_length - j : 64);
+      simd_kernels.recal_select_bases(read->seq + j, read->fq_read->quality + j, NULL, len, &valid, &bad);
+      bench_checksum(valid, result);
+      bench_checksum(bad, result);
+    }
+    result->bytes += 2 * data->read_length;
+  }
+  result->ops += data->num_reads;
+}
+
+//--------------------------------------------------------------------
+// instruction set variants: the kernels above (and the adapter search)
+// run with the dispatch layer forced to an instruction set
+//--------------------------------------------------------------------
+
+static void bench_isa_run(int isa, void (*run)(bench_data_t *, bench_result_t *),
+			  bench_data_t *data, bench_result_t *result) {
+  int prev_isa = simd_kernels.isa;
+  simd_set_isa(isa);
+  run(data, result);
+  simd_set_isa(prev_isa);
+}
+
+static int bench_sse2() {
+  return simd_isa_supported(SIMD_ISA_SSE2);
+}
+
+static int bench_avx2() {
+  return simd_isa_supported(SIMD_ISA_AVX2);
+}
+
+static int bench_avx512() {
+  return simd_isa_supported(SIMD_ISA_AVX512);
+}
+
+#define BENCH_ISA_VARIANT(kernel, isa, suffix)				\
+  static void kernel##_##suffix(bench_data_t *data, bench_result_t *result) { \
+    bench_isa_run(isa, kernel, data, result);				\
+  }
+
+BENCH_ISA_VARIANT(bench_nucleotide_compare, SIMD_ISA_SCALAR, scalar)
+BENCH_ISA_VARIANT(bench_nucleotide_compare, SIMD_ISA_SSE2, sse2)
+BENCH_ISA_VARIANT(bench_nucleotide_compare, SIMD_ISA_AVX2, avx2)
+BENCH_ISA_VARIANT(bench_nucleotide_compare, SIMD_ISA_AVX512, avx512)
+
+BENCH_ISA_VARIANT(bench_recal_select_bases, SIMD_ISA_SCALAR, scalar)
+BENCH_ISA_VARIANT(bench_recal_select_bases, SIMD_ISA_SSE2, sse2)
+BENCH_ISA_VARIANT(bench_recal_select_bases, SIMD_ISA_AVX2, avx2)
+BENCH_ISA_VARIANT(bench_recal_select_bases, SIMD_ISA_AVX512, avx512)
+
+BENCH_ISA_VARIANT(bench_match_adapter, SIMD_ISA_SCALAR, scalar)
+BENCH_ISA_VARIANT(bench_match_adapter, SIMD_ISA_SSE2, sse2)
+BENCH_ISA_VARIANT(bench_match_adapter, SIMD_ISA_AVX2, avx2)
+BENCH_ISA_VARIANT(bench_match_adapter, SIMD_ISA_AVX512, avx512)
+
+//--------------------------------------------------------------------
+// CAL manager: three seeds per read (as if found by the suffix
+// search), the CALs are counted and cleared after every read
+//--------------------------------------------------------------------
+
+static void bench_cal_mng_update(bench_data_t *data, bench_result_t *result) {
+  seed_t *seed;
+  size_t num_cals;
+  int seed_length = data->read_length / 4;
+  cal_mng_t *cal_mng = cal_mng_new(data->sa_index->genome);
+
+  for (int i = 0; i < data->num_reads; i++) {
+    bench_read_t *read = &data->reads[i];
+    for (int j = 0; j < 3; j++) {
+      size_t read_start = j * (data->read_length / 3);
+      seed = seed_new(read_start, read_start + seed_length - 1,
+		      read->pos + read_start, read->pos + read_start + seed_length - 1);
+      seed->chromosome_id = read->chrom;
+      seed->strand = 0;
+      cal_mng_update(seed, read->fq_read, cal_mng);
+    }
+
+    num_cals = 0;
+    for (int c = 0; c < cal_mng->num_chroms; c++) {
+      num_cals += linked_list_size(cal_mng->cals_lists[c]);
+    }
+    bench_checksum(num_cals, result);
+    cal_mng_clear(cal_mng);
+
+    result->bytes += 3 * sizeof(seed_t);
+  }
+  result->ops += data->num_reads;
+
+  cal_mng_free(cal_mng);
+}
+
+//--------------------------------------------------------------------
+// kernel table
+//--------------------------------------------------------------------
+
+bench_kernel_t bench_kernels[] = {
+  { "search_prefix",       "generic", bench_always, bench_search_prefix  },
+  { "search_suffix",       "generic", bench_always, bench_search_suffix  },
+  { "doscadfun",           "generic", bench_always, bench_doscadfun      },
+  { "smith_waterman_mqmr", "generic", bench_always, bench_smith_waterman },
+  { "cigar",               "generic", bench_always, bench_cigar          },
+  { "match_adapter",       "generic", bench_always, bench_match_adapter  },
+  { "match_adapter",       "scalar",  bench_always, bench_match_adapter_scalar },
+  { "match_adapter",       "sse2",    bench_sse2,   bench_match_adapter_sse2   },
+  { "match_adapter",       "avx2",    bench_avx2,   bench_match_adapter_avx2   },
+  { "match_adapter",       "avx512",  bench_avx512, bench_match_adapter_avx512 },
+  { "nucleotide_compare",  "generic", bench_always, bench_nucleotide_compare },
+  { "nucleotide_compare",  "scalar",  bench_always, bench_nucleotide_compare_scalar },
+  { "nucleotide_compare",  "sse2",    bench_sse2,   bench_nucleotide_compare_sse2   },
+  { "nucleotide_compare",  "avx2",    bench_avx2,   bench_nucleotide_compare_avx2   },
+  { "nucleotide_compare",  "avx512",  bench_avx512, bench_nucleotide_compare_avx512 },
+  { "recal_select_bases",  "generic", bench_always, bench_recal_select_bases },
+  { "recal_select_bases",  "scalar",  bench_always, bench_recal_select_bases_scalar },
+  { "recal_select_bases",  "sse2",    bench_sse2,   bench_recal_select_bases_sse2   },
+  { "recal_select_bases",  "avx2",    bench_avx2,   bench_recal_select_bases_avx2   },
+  { "recal_select_bases",  "avx512",  bench_avx512, bench_recal_select_bases_avx512 },
+  { "cal_mng_update",      "generic", bench_always, bench_cal_mng_update }
+};
+
+int num_bench_kernels = sizeof(bench_kernels) / sizeof(bench_kernel_t);
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
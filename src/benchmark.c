@@ -0,0 +1,696 @@
+#include "benchmark.h"
+
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+static char *mode_names[NUM_BENCHMARK_MODES] = { "dna", "dna-paired", "rna" };
+
+//--------------------------------------------------------------------
+// seeded generator, the same seed gives the same genome and reads
+//--------------------------------------------------------------------
+
+static uint64_t rand_state;
+
+static inline uint32_t bench_rand() {
+  rand_state = rand_state * 6364136223846793005LLU + 1442695040888963407LLU;
+  return (uint32_t) (rand_state >> 33);
+}
+
+static inline float bench_rand_float() {
+  return (bench_rand() & 0xFFFFFF) / (float) 0x1000000;
+}
+
+static inline int bench_rand_range(int min, int max) {
+  return min + (bench_rand() % (max - min + 1));
+}
+
+static char nts[4] = { 'A', 'C', 'G', 'T' };
+
+//--------------------------------------------------------------------
+// options
+//--------------------------------------------------------------------
+
+benchmark_options_t *benchmark_options_new() {
+  benchmark_options_t *options = (benchmark_options_t *) calloc(1, sizeof(benchmark_options_t));
+
+  options->max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  options->num_chroms = BENCHMARK_NUM_CHROMS;
+  options->num_reads = BENCHMARK_NUM_READS;
+  options->read_length = BENCHMARK_READ_LENGTH;
+  options->genome_length = BENCHMARK_GENOME_LENGTH;
+  options->modes = strdup("dna,dna-paired,rna");
+  options->outdir = strdup("hpg-aligner-bench");
+
+  return options;
+}
+
+//--------------------------------------------------------------------
+
+void benchmark_options_free(benchmark_options_t *options) {
+  if (options) {
+    if (options->modes) { free(options->modes); }
+    if (options->outdir) { free(options->outdir); }
+    free(options);
+  }
+}
+
+//--------------------------------------------------------------------
+
+static void **argtable_benchmark_options_new() {
+  // NUM_OPTIONS +1 to allocate end structure
+  void **argtable = (void **) malloc((NUM_BENCHMARK_OPTIONS + 1) * sizeof(void *));
+
+  int count = 0;
+  argtable[count++] = arg_file0("o", "outdir", NULL, "Working directory for the genome, index, reads and runs. Default: hpg-aligner-bench");
+  argtable[count++] = arg_int0("t", "cpu-threads", NULL, "Maximum number of CPU threads, runs use 1, 2, 4... up to this value. Default: all the cores");
+  argtable[count++] = arg_int0(NULL, "genome-length", NULL, "Length of the synthetic genome");
+  argtable[count++] = arg_int0(NULL, "num-chroms", NULL, "Number of chromosomes of the synthetic genome");
+  argtable[count++] = arg_int0(NULL, "num-reads", NULL, "Number of simulated reads (pairs in paired mode) per mode");
+  argtable[count++] = arg_int0(NULL, "read-length", NULL, "Length of the simulated reads");
+  argtable[count++] = arg_int0(NULL, "seed", NULL, "Random seed for the genome and the reads. Default: random, the value used is reported");
+  argtable[count++] = arg_str0(NULL, "modes", NULL, "Comma-separated list of modes: dna, dna-paired, rna. Default: all");
+  argtable[count++] = arg_lit0(NULL, "keep-output", "Keep the alignment files of every run");
+  argtable[count++] = arg_lit0("h", "help", "Help option");
+  argtable[count++] = arg_lit0("v", "version", "Display the HPG Aligner version");
+
+  argtable[NUM_BENCHMARK_OPTIONS] = arg_end(count);
+
+  return argtable;
+}
+
+//--------------------------------------------------------------------
+
+static void argtable_benchmark_options_free(void **argtable) {
+  if (argtable != NULL) {
+    arg_freetable(argtable, NUM_BENCHMARK_OPTIONS + 1);	// struct end must also be freed
+    free(argtable);
+  }
+}
+
+//--------------------------------------------------------------------
+
+static void read_CLI_benchmark_options(void **argtable, benchmark_options_t *options) {
+  int count = -1;
+  if (((struct arg_file*)argtable[++count])->count) { free(options->outdir); options->outdir = strdup(*(((struct arg_file*)argtable[count])->filename)); }
+  if (((struct arg_int*)argtable[++count])->count) { options->max_threads = *(((struct arg_int*)argtable[count])->ival); }
+  if (((struct arg_int*)argtable[++count])->count) { options->genome_length = *(((struct arg_int*)argtable[count])->ival); }
+  if (((struct arg_int*)argtable[++count])->count) { options->num_chroms = *(((struct arg_int*)argtable[count])->ival); }
+  if (((struct arg_int*)argtable[++count])->count) { options->num_reads = *(((struct arg_int*)argtable[count])->ival); }
+  if (((struct arg_int*)argtable[++count])->count) { options->read_length = *(((struct arg_int*)argtable[count])->ival); }
+  if (((struct arg_int*)argtable[++count])->count) { options->seed = *(((struct arg_int*)argtable[count])->ival); options->set_seed = 1; }
+  if (((struct arg_str*)argtable[++count])->count) { free(options->modes); options->modes = strdup(*(((struct arg_str*)argtable[count])->sval)); }
+  if (((struct arg_int*)argtable[++count])->count) { options->keep = ((struct arg_int*)argtable[count])->count; }
+  if (((struct arg_int*)argtable[++count])->count) { options->help = ((struct arg_int*)argtable[count])->count; }
+  if (((struct arg_int*)argtable[++count])->count) { options->version = ((struct arg_int*)argtable[count])->count; }
+}
+
+//--------------------------------------------------------------------
+
+static void usage_benchmark(void **argtable) {
+  printf("Usage:\nhpg-aligner bench");
+  arg_print_syntaxv(stdout, argtable, "\n");
+  arg_print_glossary(stdout, argtable, "%-50s\t%s\n");
+}
+
+//--------------------------------------------------------------------
+
+static benchmark_options_t *parse_benchmark_options(int argc, char **argv) {
+  void **argtable = argtable_benchmark_options_new();
+  benchmark_options_t *options = benchmark_options_new();
+
+  int num_errors = arg_parse(argc, argv, argtable);
+  if (num_errors > 0) {
+    fprintf(stdout, "Errors:\n");
+    // struct end is always allocated in the last position
+    arg_print_errors(stdout, argtable[NUM_BENCHMARK_OPTIONS], "hpg-aligner");
+    usage_benchmark(argtable);
+    exit(-1);
+  }
+
+  read_CLI_benchmark_options(argtable, options);
+  if (options->help) {
+    usage_benchmark(argtable);
+    argtable_benchmark_options_free(argtable);
+    benchmark_options_free(options);
+    exit(0);
+  }
+  if (options->version) {
+    display_version();
+    argtable_benchmark_options_free(argtable);
+    benchmark_options_free(options);
+    exit(0);
+  }
+
+  argtable_benchmark_options_free(argtable);
+
+  if (options->max_threads <= 0 || options->num_chroms <= 0 || options->num_reads <= 0 ||
+      options->read_length < 50 ||
+      options->genome_length / options->num_chroms < 10 * (BENCHMARK_INSERT_SIZE + BENCHMARK_MAX_INTRON_LENGTH)) {
+    LOG_FATAL("Invalid benchmark parameters: at least one thread, 50-nt reads and chromosomes long enough for the simulated genes are required.\n");
+  }
+
+  if (!options->set_seed) {
+    options->seed = (uint64_t) time(NULL) ^ getpid();
+  }
+
+  return options;
+}
+
+//--------------------------------------------------------------------
+// synthetic genome
+//--------------------------------------------------------------------
+
+typedef struct bench_genome {
+  int num_chroms;
+  size_t chrom_length;
+  char **chroms;
+} bench_genome_t;
+
+//--------------------------------------------------------------------
+
+static bench_genome_t *bench_genome_new(char *filename, benchmark_options_t *options) {
+  bench_genome_t *p = (bench_genome_t *) calloc(1, sizeof(bench_genome_t));
+  p->num_chroms = options->num_chroms;
+  p->chrom_length = options->genome_length / options->num_chroms;
+  p->chroms = (char **) calloc(p->num_chroms, sizeof(char *));
+
+  FILE *f = fopen(filename, "w");
+  if (!f) {
+    LOG_FATAL_F("Could not open %s to write\n", filename);
+  }
+
+  for (int c = 0; c < p->num_chroms; c++) {
+    char *seq = (char *) malloc(p->chrom_length + 1);
+    for (size_t i = 0; i < p->chrom_length; i++) {
+      seq[i] = nts[bench_rand() & 3];
+    }
+    seq[p->chrom_length] = 0;
+    p->chroms[c] = seq;
+
+    fprintf(f, ">chr%i\n", c + 1);
+    for (size_t i = 0; i < p->chrom_length; i += 60) {
+      fprintf(f, "%.*s\n", (int) (p->chrom_length - i < 60 ? p->chrom_length - i : 60), &seq[i]);
+    }
+  }
+  fclose(f);
+
+  return p;
+}
+
+//--------------------------------------------------------------------
+
+static void bench_genome_free(bench_genome_t *p) {
+  for (int c = 0; c < p->num_chroms; c++) {
+    free(p->chroms[c]);
+  }
+  free(p->chroms);
+  free(p);
+}
+
+//--------------------------------------------------------------------
+// simulated genes (RNA reads are sampled from their transcripts)
+//--------------------------------------------------------------------
+
+typedef struct bench_gene {
+  int chrom;
+  int num_exons;
+  size_t starts[BENCHMARK_MAX_EXONS];
+  size_t ends[BENCHMARK_MAX_EXONS];   // inclusive
+  size_t length;                      // transcript length
+} bench_gene_t;
+
+//--------------------------------------------------------------------
+
+static bench_gene_t *bench_genes_new(bench_genome_t *genome, int read_length, int *num_genes) {
+  int n = 0, max_genes = 1024;
+  bench_gene_t *genes = (bench_gene_t *) malloc(max_genes * sizeof(bench_gene_t));
+
+  for (int c = 0; c < genome->num_chroms; c++) {
+    size_t pos = bench_rand_range(1000, 5000);
+    while (1) {
+      bench_gene_t gene;
+      gene.chrom = c;
+      gene.num_exons = bench_rand_range(BENCHMARK_MIN_EXONS, BENCHMARK_MAX_EXONS);
+      gene.length = 0;
+      for (int e = 0; e < gene.num_exons; e++) {
+	if (e) pos += bench_rand_range(BENCHMARK_MIN_INTRON_LENGTH, BENCHMARK_MAX_INTRON_LENGTH);
+	gene.starts[e] = pos;
+	pos += bench_rand_range(BENCHMARK_MIN_EXON_LENGTH, BENCHMARK_MAX_EXON_LENGTH);
+	gene.ends[e] = pos - 1;
+	gene.length += gene.ends[e] - gene.starts[e] + 1;
+      }
+      if (pos + 1000 >= genome->chrom_length) break;
+
+      if (gene.length >= read_length) {
+	if (n >= max_genes) {
+	  max_genes *= 2;
+	  genes = (bench_gene_t *) realloc(genes, max_genes * sizeof(bench_gene_t));
+	}
+	genes[n++] = gene;
+      }
+      pos += bench_rand_range(2000, 10000);
+    }
+  }
+
+  *num_genes = n;
+  return genes;
+}
+
+//--------------------------------------------------------------------
+// reads: the origin is encoded in the read name as
+//   sim_<n>_<chrom>_<strand>_<start1>_<end1>_<start2>_<end2>
+// with 1-based positions, (start2, end2) = (0, 0) for single reads and
+// strand referring to the first mate
+//--------------------------------------------------------------------
+
+static void bench_revcomp(char *seq, int len) {
+  for (int i = 0, j = len - 1; i <= j; i++, j--) {
+    char a = seq[i], b = seq[j];
+    seq[i] = (b == 'A' ? 'T' : b == 'C' ? 'G' : b == 'G' ? 'C' : 'A');
+    seq[j] = (a == 'A' ? 'T' : a == 'C' ? 'G' : a == 'G' ? 'C' : 'A');
+  }
+}
+
+//--------------------------------------------------------------------
+
+static void bench_mutate(char *seq, int len) {
+  for (int i = 0; i < len; i++) {
+    if (bench_rand_float() < BENCHMARK_MISMATCH_RATE) {
+      char nt;
+      do {
+	nt = nts[bench_rand() & 3];
+      } while (nt == seq[i]);
+      seq[i] = nt;
+    }
+  }
+}
+
+//--------------------------------------------------------------------
+
+static void bench_write_read(FILE *f, char *id, char *seq, char *quality) {
+  fprintf(f, "@%s\n%s\n+\n%s\n", id, seq, quality);
+}
+
+//--------------------------------------------------------------------
+
+static void bench_simulate_dna(char *filename1, char *filename2, bench_genome_t *genome,
+			       benchmark_options_t *options) {
+  int len = options->read_length;
+  char seq1[len + 1], seq2[len + 1], quality[len + 1], id[256];
+  memset(quality, 'I', len);
+  quality[len] = 0;
+
+  FILE *f1 = fopen(filename1, "w");
+  FILE *f2 = (filename2 ? fopen(filename2, "w") : NULL);
+  if (!f1 || (filename2 && !f2)) {
+    LOG_FATAL("Could not create the simulated reads files\n");
+  }
+
+  for (int i = 0; i < options->num_reads; i++) {
+    int c = bench_rand() % genome->num_chroms;
+    int strand = bench_rand() & 1;
+
+    if (!f2) {
+      size_t start = bench_rand() % (genome->chrom_length - len);
+      memcpy(seq1, &genome->chroms[c][start], len);
+      seq1[len] = 0;
+      if (strand) bench_revcomp(seq1, len);
+      bench_mutate(seq1, len);
+
+      sprintf(id, "sim_%i_%i_%i_%lu_%lu_0_0", i, c, strand, start + 1, start + len);
+      bench_write_read(f1, id, seq1, quality);
+    } else {
+      int insert = BENCHMARK_INSERT_SIZE + bench_rand_range(-BENCHMARK_INSERT_SD, BENCHMARK_INSERT_SD);
+      if (insert < len) insert = len;
+      size_t start = bench_rand() % (genome->chrom_length - insert);
+      size_t start1 = start, start2 = start + insert - len;
+      if (strand) {
+	start1 = start + insert - len;
+	start2 = start;
+      }
+
+      // first mate on 'strand', second mate on the opposite one
+      memcpy(seq1, &genome->chroms[c][start1], len);
+      memcpy(seq2, &genome->chroms[c][start2], len);
+      seq1[len] = seq2[len] = 0;
+      if (strand) {
+	bench_revcomp(seq1, len);
+      } else {
+	bench_revcomp(seq2, len);
+      }
+      bench_mutate(seq1, len);
+      bench_mutate(seq2, len);
+
+      sprintf(id, "sim_%i_%i_%i_%lu_%lu_%lu_%lu", i, c, strand,
+	      start1 + 1, start1 + len, start2 + 1, start2 + len);
+      bench_write_read(f1, id, seq1, quality);
+      bench_write_read(f2, id, seq2, quality);
+    }
+  }
+
+  fclose(f1);
+  if (f2) fclose(f2);
+}
+
+//--------------------------------------------------------------------
+
+static void bench_simulate_rna(char *filename, bench_genome_t *genome,
+			       benchmark_options_t *options) {
+  int len = options->read_length, num_genes;
+  char seq[len + 1], quality[len + 1], id[256];
+  memset(quality, 'I', len);
+  quality[len] = 0;
+
+  bench_gene_t *genes = bench_genes_new(genome, len, &num_genes);
+  if (!num_genes) {
+    LOG_FATAL("The synthetic genome is too short to simulate RNA reads\n");
+  }
+
+  FILE *f = fopen(filename, "w");
+  if (!f) {
+    LOG_FATAL_F("Could not open %s to write\n", filename);
+  }
+
+  for (int i = 0; i < options->num_reads; i++) {
+    bench_gene_t *gene = &genes[bench_rand() % num_genes];
+    int strand = bench_rand() & 1;
+    size_t offset = bench_rand() % (gene->length - len + 1);
+    size_t start = 0, end = 0;
+
+    // copy the read from the transcript, exon by exon
+    int copied = 0;
+    for (int e = 0; e < gene->num_exons && copied < len; e++) {
+      size_t exon_length = gene->ends[e] - gene->starts[e] + 1;
+      if (offset >= exon_length) {
+	offset -= exon_length;
+	continue;
+      }
+      size_t from = gene->starts[e] + offset;
+      int n = (exon_length - offset < len - copied ? exon_length - offset : len - copied);
+      memcpy(&seq[copied], &genome->chroms[gene->chrom][from], n);
+      if (!copied) start = from;
+      end = from + n - 1;
+      copied += n;
+      offset = 0;
+    }
+    seq[len] = 0;
+    if (strand) bench_revcomp(seq, len);
+    bench_mutate(seq, len);
+
+    sprintf(id, "sim_%i_%i_%i_%lu_%lu_0_0", i, gene->chrom, strand, start + 1, end + 1);
+    bench_write_read(f, id, seq, quality);
+  }
+
+  fclose(f);
+  free(genes);
+}
+
+//--------------------------------------------------------------------
+// runs hpg-aligner in a child process, output to <dir>/stdout.log
+//--------------------------------------------------------------------
+
+static int bench_exec(char **args, char *log_filename, double *seconds, size_t *max_rss) {
+  fflush(stdout);
+
+  uint64_t start = metrics_now();
+  pid_t pid = fork();
+  if (pid < 0) {
+    LOG_FATAL("Could not start the benchmark run\n");
+  }
+
+  if (pid == 0) {
+    int fd = open(log_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+      dup2(fd, STDOUT_FILENO);
+      dup2(fd, STDERR_FILENO);
+      close(fd);
+    }
+    execv("/proc/self/exe", args);
+    _exit(127);
+  }
+
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0) {
+    LOG_FATAL("Could not wait for the benchmark run\n");
+  }
+
+  *seconds = (metrics_now() - start) / 1000000000.0;
+  *max_rss = (size_t) usage.ru_maxrss * 1024;
+
+  return (WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+}
+
+//--------------------------------------------------------------------
+// accuracy: primary alignments checked against the read name
+//--------------------------------------------------------------------
+
+static void bench_evaluate(char *sam_filename, benchmark_run_t *run) {
+  FILE *f = fopen(sam_filename, "r");
+  if (!f) {
+    return;
+  }
+
+  char line[64 * 1024], *fields[4], *saveptr;
+  int n, chrom, strand, flag;
+  size_t pos, start1, end1, start2, end2;
+
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '@') continue;
+
+    // QNAME, FLAG, RNAME, POS
+    fields[0] = strtok_r(line, "\t", &saveptr);
+    for (int i = 1; i < 4 && fields[i - 1]; i++) {
+      fields[i] = strtok_r(NULL, "\t", &saveptr);
+    }
+    if (!fields[0] || !fields[3]) continue;
+
+    if (sscanf(fields[0], "sim_%d_%d_%d_%lu_%lu_%lu_%lu",
+	       &n, &chrom, &strand, &start1, &end1, &start2, &end2) != 7) {
+      continue;
+    }
+    flag = atoi(fields[1]);
+    pos = strtoul(fields[3], NULL, 10);
+    if (flag & (0x100 | 0x800)) continue;
+
+    run->num_records++;
+    if (flag & 0x4) continue;
+    run->num_mapped++;
+
+    // second mate: opposite strand, second span
+    if (flag & 0x80) {
+      strand = !strand;
+      start1 = start2;
+      end1 = end2;
+    }
+
+    char chrom_name[32];
+    sprintf(chrom_name, "chr%i", chrom + 1);
+    if (strcmp(fields[2], chrom_name) || ((flag & 0x10) != 0) != strand) continue;
+    if (pos + BENCHMARK_POS_TOLERANCE >= start1 && pos <= end1 + BENCHMARK_POS_TOLERANCE) {
+      run->num_correct++;
+    }
+  }
+
+  fclose(f);
+}
+
+//--------------------------------------------------------------------
+
+static void bench_run(char *dirname, char *index_dirname, char **reads_filenames,
+		      benchmark_options_t *options, benchmark_run_t *run) {
+  char run_dirname[strlen(dirname) + 100], log_filename[strlen(dirname) + 200];
+  char sam_filename[strlen(dirname) + 200], threads[32];
+
+  sprintf(run_dirname, "%s/run_%s_%i", dirname, mode_names[run->mode], run->num_threads);
+  sprintf(log_filename, "%s.log", run_dirname);
+  sprintf(sam_filename, "%s/%s.sam", run_dirname, OUTPUT_FILENAME);
+  sprintf(threads, "%i", run->num_threads);
+
+  char *args[16];
+  int n = 0;
+  args[n++] = "hpg-aligner";
+  args[n++] = (run->mode == BENCHMARK_RNA ? "rna" : "dna");
+  args[n++] = "-i";
+  args[n++] = index_dirname;
+  args[n++] = "-f";
+  args[n++] = reads_filenames[0];
+  if (run->mode == BENCHMARK_DNA_PAIRED) {
+    args[n++] = "-j";
+    args[n++] = reads_filenames[1];
+  }
+  args[n++] = "-o";
+  args[n++] = run_dirname;
+  args[n++] = "-t";
+  args[n++] = threads;
+  args[n] = NULL;
+
+  run->status = bench_exec(args, log_filename, &run->seconds, &run->max_rss);
+  run->num_reads = (run->mode == BENCHMARK_DNA_PAIRED ? 2 : 1) * options->num_reads;
+
+  if (!run->status) {
+    bench_evaluate(sam_filename, run);
+    if (!options->keep) unlink(sam_filename);
+  }
+}
+
+//--------------------------------------------------------------------
+// report
+//--------------------------------------------------------------------
+
+static void bench_report(char *filename, benchmark_run_t *runs, int num_runs,
+			 benchmark_options_t *options) {
+  FILE *f = fopen(filename, "w");
+  if (f) {
+    fprintf(f, "{\"seed\": %lu, \"genome_length\": %lu, \"num_chroms\": %i, \"num_reads\": %i, \"read_length\": %i, \"runs\": [",
+	    options->seed, options->genome_length, options->num_chroms,
+	    options->num_reads, options->read_length);
+  }
+
+  printf("\n%-11s %7s %10s %9s %12s %9s %10s %10s %8s %8s %9s\n",
+	 "mode", "threads", "reads", "seconds", "reads/s", "speedup", "efficiency",
+	 "RSS (MB)", "mapped", "correct", "precision");
+
+  double base = 0.0;
+  for (int i = 0; i < num_runs; i++) {
+    benchmark_run_t *run = &runs[i];
+    if (i == 0 || runs[i - 1].mode != run->mode) {
+      base = (run->status ? 0.0 : run->seconds * run->num_threads);
+    }
+
+    if (run->status) {
+      printf("%-11s %7i %10lu   failed (exit status %i)\n",
+	     mode_names[run->mode], run->num_threads, run->num_reads, run->status);
+    } else {
+      double speedup = (base > 0 ? base / run->seconds : 0.0);
+      double efficiency = speedup / run->num_threads;
+      double mapped = (run->num_reads ? 100.0 * run->num_mapped / run->num_reads : 0.0);
+      double correct = (run->num_reads ? 100.0 * run->num_correct / run->num_reads : 0.0);
+      double precision = (run->num_mapped ? 100.0 * run->num_correct / run->num_mapped : 0.0);
+
+      printf("%-11s %7i %10lu %9.2f %12.1f %9.2f %9.1f%% %10.1f %7.2f%% %7.2f%% %8.2f%%\n",
+	     mode_names[run->mode], run->num_threads, run->num_reads, run->seconds,
+	     run->num_reads / run->seconds, speedup, 100.0 * efficiency,
+	     run->max_rss / 1048576.0, mapped, correct, precision);
+    }
+
+    if (f) {
+      fprintf(f, "%s\n  {\"mode\": \"%s\", \"threads\": %i, \"status\": %i, \"reads\": %lu, \"seconds\": %0.3f, "
+	      "\"max_rss_bytes\": %lu, \"records\": %lu, \"mapped\": %lu, \"correct\": %lu}",
+	      (i ? "," : ""), mode_names[run->mode], run->num_threads, run->status,
+	      run->num_reads, run->seconds, run->max_rss,
+	      run->num_records, run->num_mapped, run->num_correct);
+    }
+  }
+
+  if (f) {
+    fprintf(f, "\n]}\n");
+    fclose(f);
+  }
+}
+
+//--------------------------------------------------------------------
+
+void run_benchmark(int argc, char **argv) {
+  benchmark_options_t *options = parse_benchmark_options(argc, argv);
+  rand_state = options->seed;
+
+  // selected modes
+  int modes[NUM_BENCHMARK_MODES] = { 0 };
+  for (int m = 0; m < NUM_BENCHMARK_MODES; m++) {
+    char *p = options->modes;
+    while ((p = strstr(p, mode_names[m])) != NULL) {
+      char next = p[strlen(mode_names[m])];
+      if ((p == options->modes || p[-1] == ',') && (next == 0 || next == ',')) {
+	modes[m] = 1;
+	break;
+      }
+      p++;
+    }
+  }
+
+  char *dirname = options->outdir;
+  if (!exists(dirname)) {
+    create_directory(dirname);
+  }
+
+  char genome_filename[strlen(dirname) + 100], index_dirname[strlen(dirname) + 100];
+  char log_filename[strlen(dirname) + 100], report_filename[strlen(dirname) + 100];
+  sprintf(genome_filename, "%s/genome.fa", dirname);
+  sprintf(index_dirname, "%s/index", dirname);
+  sprintf(log_filename, "%s/build-index.log", dirname);
+  sprintf(report_filename, "%s/bench.json", dirname);
+
+  printf("hpg-aligner bench: seed %lu, genome %lu nt (%i chromosomes), %i reads x %i nt, up to %i threads\n",
+	 options->seed, options->genome_length, options->num_chroms,
+	 options->num_reads, options->read_length, options->max_threads);
+
+  // genome and SA index
+  printf("Generating genome and SA index...\n");
+  bench_genome_t *genome = bench_genome_new(genome_filename, options);
+  if (!exists(index_dirname)) {
+    create_directory(index_dirname);
+  }
+
+  double seconds;
+  size_t max_rss;
+  char *index_args[] = { "hpg-aligner", "build-sa-index", "-g", genome_filename, "-i", index_dirname, NULL };
+  if (bench_exec(index_args, log_filename, &seconds, &max_rss)) {
+    LOG_FATAL_F("SA index building failed, see %s\n", log_filename);
+  }
+  printf("SA index built in %0.2f s (peak RSS %0.1f MB)\n", seconds, max_rss / 1048576.0);
+
+  // simulated reads
+  char reads_filenames[NUM_BENCHMARK_MODES][2][strlen(dirname) + 100];
+  char *reads[NUM_BENCHMARK_MODES][2];
+  for (int m = 0; m < NUM_BENCHMARK_MODES; m++) {
+    sprintf(reads_filenames[m][0], "%s/reads_%s_1.fq", dirname, mode_names[m]);
+    sprintf(reads_filenames[m][1], "%s/reads_%s_2.fq", dirname, mode_names[m]);
+    reads[m][0] = reads_filenames[m][0];
+    reads[m][1] = reads_filenames[m][1];
+  }
+
+  printf("Simulating reads...\n");
+  if (modes[BENCHMARK_DNA_SINGLE]) {
+    bench_simulate_dna(reads[BENCHMARK_DNA_SINGLE][0], NULL, genome, options);
+  }
+  if (modes[BENCHMARK_DNA_PAIRED]) {
+    bench_simulate_dna(reads[BENCHMARK_DNA_PAIRED][0], reads[BENCHMARK_DNA_PAIRED][1], genome, options);
+  }
+  if (modes[BENCHMARK_RNA]) {
+    bench_simulate_rna(reads[BENCHMARK_RNA][0], genome, options);
+  }
+  bench_genome_free(genome);
+
+  // runs at 1, 2, 4... threads, always including the maximum
+  int num_runs = 0;
+  benchmark_run_t runs[NUM_BENCHMARK_MODES * 64];
+  memset(runs, 0, sizeof(runs));
+
+  for (int m = 0; m < NUM_BENCHMARK_MODES; m++) {
+    if (!modes[m]) continue;
+    for (int t = 1; ; t = (2 * t < options->max_threads ? 2 * t : options->max_threads)) {
+      benchmark_run_t *run = &runs[num_runs++];
+      run->mode = m;
+      run->num_threads = t;
+
+      printf("Running %s with %i thread(s)...\n", mode_names[m], t);
+      bench_run(dirname, index_dirname, reads[m], options, run);
+
+      if (t >= options->max_threads) break;
+    }
+  }
+
+  bench_report(report_filename, runs, num_runs, options);
+  printf("\nReport written to %s\n", report_filename);
+
+  benchmark_options_free(options);
+  exit(0);
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
@@ -0,0 +1,99 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "argtable2.h"
+#include "commons/log.h"
+#include "commons/file_utils.h"
+
+#include "options.h"
+#include "metrics.h"
+
+//--------------------------------------------------------------------
+// end-to-end benchmark (hpg-aligner bench)
+//
+// generates a synthetic genome, builds its SA index, simulates DNA
+// (single and paired-end) and spliced RNA reads with known origin and
+// runs the whole aligner at 1, 2, 4... N threads, each run in a child
+// process; the report gives reads/s, scaling efficiency, peak RSS and
+// mapping accuracy against the simulated truth
+//--------------------------------------------------------------------
+
+#define NUM_BENCHMARK_OPTIONS  11
+
+#define BENCHMARK_GENOME_LENGTH  10000000
+#define BENCHMARK_NUM_CHROMS     4
+#define BENCHMARK_NUM_READS      100000
+#define BENCHMARK_READ_LENGTH    100
+
+#define BENCHMARK_MISMATCH_RATE  0.005f
+#define BENCHMARK_INSERT_SIZE    300
+#define BENCHMARK_INSERT_SD      30
+
+// an alignment is correct when it starts inside the simulated read
+// span (soft-clipped ends allowed) of the right chromosome and strand
+#define BENCHMARK_POS_TOLERANCE  20
+
+// simulated genes for the RNA reads
+#define BENCHMARK_MIN_EXONS         2
+#define BENCHMARK_MAX_EXONS         4
+#define BENCHMARK_MIN_EXON_LENGTH   150
+#define BENCHMARK_MAX_EXON_LENGTH   400
+#define BENCHMARK_MIN_INTRON_LENGTH 200
+#define BENCHMARK_MAX_INTRON_LENGTH 3000
+
+#define BENCHMARK_DNA_SINGLE  0
+#define BENCHMARK_DNA_PAIRED  1
+#define BENCHMARK_RNA         2
+
+#define NUM_BENCHMARK_MODES (BENCHMARK_RNA + 1)
+
+//--------------------------------------------------------------------
+
+typedef struct benchmark_options {
+  int help;
+  int version;
+  int keep;
+  int max_threads;
+  int num_chroms;
+  int num_reads;
+  int read_length;
+  size_t genome_length;
+  uint64_t seed;
+  int set_seed;
+  char *modes;
+  char *outdir;
+} benchmark_options_t;
+
+benchmark_options_t *benchmark_options_new();
+void benchmark_options_free(benchmark_options_t *options);
+
+//--------------------------------------------------------------------
+// result of one aligner run
+//--------------------------------------------------------------------
+
+typedef struct benchmark_run {
+  int mode;
+  int num_threads;
+  int status;
+  double seconds;
+  size_t max_rss;          // bytes
+
+  size_t num_reads;        // simulated reads (mates count twice)
+  size_t num_records;      // primary alignments and unmapped records
+  size_t num_mapped;
+  size_t num_correct;
+} benchmark_run_t;
+
+//--------------------------------------------------------------------
+
+void run_benchmark(int argc, char **argv);
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+#endif // BENCHMARK_H
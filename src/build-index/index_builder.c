@@ -11,6 +11,7 @@ index_options_t *index_options_new() {
   options->help = 0;
   options->bs_index = 0;
   options->index_ratio = 0;
+  options->hugepages = 0;
 
   options->ref_genome = NULL;
   options->index_filename = NULL;
@@ -198,6 +199,55 @@ void run_index_builder(int argc, char **argv, char *mode_str) {
 }
 
 
+//------------------------------------------------------------------------------------
+
+void run_index_shm(int argc, char **argv, char *mode_str) {
+  int num_options = NUM_INDEX_SHM_OPTIONS;
+  void **argtable = (void**)malloc((num_options + 1) * sizeof(void*));
+
+  int count = 0;
+  argtable[count++] = arg_file0("i", "index", NULL, "Index directory name");
+  argtable[count++] = arg_lit0(NULL, "hugepages", "Place the index on hugepages (index-load, hugetlbfs mounted on " SA_SHM_HUGEPAGES_DIR ")");
+  argtable[count++] = arg_lit0("h", "help", "Help option");
+  argtable[num_options] = arg_end(count);
+
+  index_options_t *options = index_options_new();
+  int num_errors = arg_parse(argc, argv, argtable);
+  if (num_errors > 0) {
+    fprintf(stdout, "Errors:\n");
+    arg_print_errors(stdout, argtable[num_options], "hpg-aligner");
+  }
+
+  count = -1;
+  if (((struct arg_file*)argtable[++count])->count) { options->index_filename = strdup(*(((struct arg_file*)argtable[count])->filename)); }
+  if (((struct arg_int*)argtable[++count])->count) { options->hugepages = 1; }
+  if (((struct arg_int*)argtable[++count])->count) { options->help = 1; }
+
+  if (num_errors > 0 || options->help || argc < 2) {
+    printf("Usage:\nhpg-aligner %s", mode_str);
+    arg_print_syntaxv(stdout, argtable, "\n");
+    arg_print_glossary(stdout, argtable, "%-50s\t%s\n");
+    argtable_index_options_free(argtable, num_options);
+    index_options_free(options);
+    exit(num_errors > 0 ? -1 : 0);
+  }
+  argtable_index_options_free(argtable, num_options);
+
+  if (!exists(options->index_filename)) {
+    LOG_FATAL("Index directory does not exist.\n");
+  }
+
+  int res;
+  if (!strcmp(mode_str, "index-load")) {
+    res = sa_shm_load(options->index_filename, options->hugepages);
+  } else {
+    res = sa_shm_unload(options->index_filename);
+  }
+
+  index_options_free(options);
+  exit(res ? -1 : 0);
+}
+
 //const uint prefix_value = 18;
 //run_index_builder_sa(options->genome_filename, prefix_value, options->bwt_dirname);
 
@@ -11,18 +11,21 @@
 #include "options.h"
 #include "argtable2.h"
 #include "sa/sa_index3.h"
+#include "sa/sa_shm.h"
 
 #define SA_INDEX  0
 #define BWT_INDEX 1
 
 #define NUM_INDEX_OPTIONS 4
 #define NUM_INDEX_BWT_OPTIONS 1
+#define NUM_INDEX_SHM_OPTIONS 3
 
 typedef struct index_options {
   int version;
   int index_ratio;
   int bs_index;
   int help;
+  int hugepages;
   char *ref_genome;
   char *index_filename;  
 } index_options_t;
@@ -41,6 +44,9 @@ void help_index_builder();
 
 void run_index_builder(int argc, char **argv, char *mode_str);
 
+// index-load / index-unload: SA index in shared memory
+void run_index_shm(int argc, char **argv, char *mode_str);
+
 //void run_index_builder_bs(char *genome_filename, char *bwt_dirname, int bwt_ratio, char *bases);
 
 
@@ -0,0 +1,158 @@
+#include "counters.h"
+
+//--------------------------------------------------------------------
+
+__thread counters_thread_t *counters_local = NULL;
+
+// blocks [0, num_counters_used) belong to live threads, the rest are
+// the spare blocks of exited threads, waiting to be reused
+static int num_counters_used = 0;
+static int num_counters_threads = 0;
+static int max_counters_threads = 0;
+static counters_thread_t **counters_threads = NULL;
+static pthread_mutex_t counters_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// values of the exited threads
+static uint64_t counters_retired[NUM_COUNTER_IDS];
+
+static pthread_key_t counters_key;
+static pthread_once_t counters_key_once = PTHREAD_ONCE_INIT;
+
+static char *counters_names[NUM_COUNTER_IDS] = {
+  "total_reads",
+  "mapped_reads",
+  "unmapped_reads",
+  "total_mappings",
+  "multihit_reads",
+  "uniq_mapping_reads"
+};
+
+//--------------------------------------------------------------------
+
+static void counters_thread_exit(void *data) {
+  counters_thread_t *p = (counters_thread_t *) data;
+
+  pthread_mutex_lock(&counters_mutex);
+  for (int t = 0; t < num_counters_used; t++) {
+    if (counters_threads[t] == p) {
+      // keeps the values, and moves the block to the spare ones
+      for (int i = 0; i < NUM_COUNTER_IDS; i++) {
+	counters_retired[i] += p->values[i];
+      }
+      memset(p, 0, sizeof(counters_thread_t));
+      counters_threads[t] = counters_threads[--num_counters_used];
+      counters_threads[num_counters_used] = p;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&counters_mutex);
+}
+
+//--------------------------------------------------------------------
+
+static void counters_key_create() {
+  pthread_key_create(&counters_key, counters_thread_exit);
+}
+
+//--------------------------------------------------------------------
+
+counters_thread_t *counters_thread_register() {
+  counters_thread_t *p = NULL;
+
+  pthread_once(&counters_key_once, counters_key_create);
+
+  pthread_mutex_lock(&counters_mutex);
+  if (num_counters_used < num_counters_threads) {
+    p = counters_threads[num_counters_used++];
+  }
+  pthread_mutex_unlock(&counters_mutex);
+
+  if (!p) {
+    if (posix_memalign((void **) &p, 64, sizeof(counters_thread_t))) {
+      printf("Error: could not allocate the statistics counters\n");
+      exit(-1);
+    }
+    memset(p, 0, sizeof(counters_thread_t));
+
+    pthread_mutex_lock(&counters_mutex);
+    if (num_counters_threads >= max_counters_threads) {
+      max_counters_threads = (max_counters_threads ? 2 * max_counters_threads : 64);
+      counters_threads = (counters_thread_t **) realloc(counters_threads,
+							max_counters_threads * sizeof(counters_thread_t *));
+    }
+    // the spare blocks go after the used ones
+    counters_threads[num_counters_threads++] = counters_threads[num_counters_used];
+    counters_threads[num_counters_used++] = p;
+    pthread_mutex_unlock(&counters_mutex);
+  }
+
+  // the block goes back to the spare ones when the thread exits
+  pthread_setspecific(counters_key, p);
+
+  return p;
+}
+
+//--------------------------------------------------------------------
+
+void counters_reduce(uint64_t *values) {
+  pthread_mutex_lock(&counters_mutex);
+  memcpy(values, counters_retired, NUM_COUNTER_IDS * sizeof(uint64_t));
+  for (int t = 0; t < num_counters_used; t++) {
+    for (int i = 0; i < NUM_COUNTER_IDS; i++) {
+      values[i] += counters_threads[t]->values[i];
+    }
+  }
+  pthread_mutex_unlock(&counters_mutex);
+}
+
+//--------------------------------------------------------------------
+
+uint64_t counter_get(int id) {
+  pthread_mutex_lock(&counters_mutex);
+  uint64_t value = counters_retired[id];
+  for (int t = 0; t < num_counters_used; t++) {
+    value += counters_threads[t]->values[id];
+  }
+  pthread_mutex_unlock(&counters_mutex);
+
+  return value;
+}
+
+//--------------------------------------------------------------------
+
+char *counter_name(int id) {
+  return counters_names[id];
+}
+
+//--------------------------------------------------------------------
+
+void counters_reset() {
+  pthread_mutex_lock(&counters_mutex);
+  memset(counters_retired, 0, NUM_COUNTER_IDS * sizeof(uint64_t));
+  for (int t = 0; t < num_counters_used; t++) {
+    memset(counters_threads[t]->values, 0, NUM_COUNTER_IDS * sizeof(uint64_t));
+  }
+  pthread_mutex_unlock(&counters_mutex);
+}
+
+//--------------------------------------------------------------------
+
+void counters_free() {
+  pthread_mutex_lock(&counters_mutex);
+  for (int t = 0; t < num_counters_threads; t++) {
+    free(counters_threads[t]);
+  }
+  if (counters_threads) free(counters_threads);
+
+  counters_threads = NULL;
+  num_counters_used = 0;
+  num_counters_threads = 0;
+  max_counters_threads = 0;
+  memset(counters_retired, 0, NUM_COUNTER_IDS * sizeof(uint64_t));
+  pthread_mutex_unlock(&counters_mutex);
+
+  counters_local = NULL;
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
@@ -0,0 +1,62 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+//--------------------------------------------------------------------
+// mapping statistics counters
+//
+// every thread updates its own block (no locks, no atomics), the
+// blocks are summed up by counter_get/counters_reduce at the end of
+// the run or when the metrics thread takes a snapshot; the block of
+// an exited thread is added to the totals and reused by the next one
+//--------------------------------------------------------------------
+
+#define COUNTER_TOTAL_READS                  0
+#define COUNTER_MAPPED_READS                 1
+#define COUNTER_UNMAPPED_READS               2
+#define COUNTER_TOTAL_MAPPINGS               3
+#define COUNTER_MULTIHIT_READS               4
+#define COUNTER_UNIQ_MAPPING_READS           5
+
+#define NUM_COUNTER_IDS (COUNTER_UNIQ_MAPPING_READS + 1)
+
+//--------------------------------------------------------------------
+
+typedef struct counters_thread {
+  uint64_t values[NUM_COUNTER_IDS];
+} __attribute__((aligned(64))) counters_thread_t;
+
+extern __thread counters_thread_t *counters_local;
+
+counters_thread_t *counters_thread_register();
+
+//--------------------------------------------------------------------
+
+static inline void counter_add(int id, uint64_t value) {
+  if (!counters_local) {
+    counters_local = counters_thread_register();
+  }
+  counters_local->values[id] += value;
+}
+
+//--------------------------------------------------------------------
+
+// sum of all the thread blocks
+uint64_t counter_get(int id);
+void counters_reduce(uint64_t *values);
+
+char *counter_name(int id);
+
+// clears the counters, the thread blocks are kept
+void counters_reset();
+void counters_free();
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+#endif // COUNTERS_H
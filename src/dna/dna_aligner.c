@@ -6,13 +6,6 @@ extern int num_dup_reads;
 extern int num_total_dup_reads;
 #endif
 
-extern size_t num_mapped_reads;
-extern size_t num_unmapped_reads;
-extern size_t num_multihit_reads;
-extern size_t num_total_mappings;
-extern size_t num_unmapped_reads_by_invalid_cal;
-extern size_t num_unmapped_reads_by_cigar_length;
-
 //--------------------------------------------------------------------
 // main 
 //--------------------------------------------------------------------
@@ -21,20 +14,16 @@ int counters[NUM_COUNTERS];
 sa_genome3_t *global_genome = NULL;
 
 #include "adapter.h"
-
-void bam_sort_core_ext(int is_by_qname, const char *fn, const char *prefix, size_t max_mem, int is_stdout);
+#include "tools/bam/aux/aux_bam_sort.h"
 
 void dna_aligner(options_t *options) {
   for (int i = 0; i < NUM_COUNTERS; i++) {
     counters[i] = 0;
   }
 
-  #ifdef _TIMING
-  init_func_names();
-  for (int i = 0; i < NUM_TIMING; i++) {
-    func_times[i] = 0;
-  }
-  #endif
+  profile_init(options->profile);
+  trace_init(options->trace);
+  metrics_init(options->metrics_target);
 
   // set input parameters
   char *sa_dirname = options->bwt_dirname;
@@ -60,7 +49,7 @@ void dna_aligner(options_t *options) {
     strcat(out_filename, "_");
   }
   strcat(out_filename, OUTPUT_FILENAME);
-  if (options->bam_format || options->realignment || options->recalibration) {
+  if (options->bam_format || options->realignment || options->recalibration || options->index_output) {
     bam_format = 1;
     strcat(out_filename, ".bam");
   } else {
@@ -70,6 +59,9 @@ void dna_aligner(options_t *options) {
   // display options
   options_display(options);
 
+  // NUMA placement (thread pinning, index memory policy)
+  affinity_init(options->numa_policy, num_threads);
+
   // load SA index
   struct timeval stop, start;
   printf("\n");
@@ -82,6 +74,11 @@ void dna_aligner(options_t *options) {
   printf("End of loading SA tables in %0.2f min. Done!!\n", 
 	 ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f) / 60.0f);  
 
+  if (options->numa_policy != NUMA_NONE) {
+    affinity_display();
+    sa_index3_display_placement(sa_index);
+  }
+
   // preparing input FastQ file
   fastq_batch_reader_input_t reader_input;
   
@@ -97,6 +94,19 @@ void dna_aligner(options_t *options) {
     write_sam_header(options, sa_index->genome, (FILE *) writer_input.bam_file);
   }
 
+  // base quality recalibration while the BAM records are written,
+  // lookup table from a known recalibration data file
+  recal_table_t recal_table;
+  if (bam_format && options->recal_data_filename) {
+    recal_info_t recal_info;
+    recal_init_info(500, &recal_info);
+    recal_load_recal_info(options->recal_data_filename, &recal_info);
+    recal_calc_deltas(&recal_info);
+    recal_table_init(&recal_info, &recal_table);
+    recal_destroy_info(&recal_info);
+    writer_input.recal_table = &recal_table;
+  }
+
   char *fq_list1 = options->in_filename, *fq_list2 = options->in_filename2;
   char token[2] = ",";
   char *ptr;
@@ -176,6 +186,17 @@ void dna_aligner(options_t *options) {
       }
     }    
    
+    // --shard: only the slice of the input file(s) for this shard
+    shard_t *shard = NULL;
+    if (options->shard_count) {
+      if (options->input_format == BAM_FORMAT) {
+	shard = shard_bam_new(file1, options->shard_index, options->shard_count);
+	shard_bam_seek(shard, ((bam_file_t *) reader_input.fq_file1)->bam_fd);
+      } else {
+	shard = shard_fastq_new(file1, file2, options->shard_index, options->shard_count);
+      }
+    }
+
     bam_index_t *idx = 0;
     bam_file_t *fnomapped = NULL;
     stats_t *stats = sa_stats_new(0,0,0);
@@ -187,26 +208,15 @@ void dna_aligner(options_t *options) {
 	bam_fwrite_header(bam_header, fnomapped);//write the header in fnomapped
 	idx = bam_index_load(file1); //idx_filename);//load the index
 	if (idx == 0){
+	  // samtools 0.1.18 only loads BAI indexes
 	  char *idx_filename = malloc(strlen(file1) + 5);
-	  strcpy(idx_filename, file1);
-	  strcat(idx_filename, ".bai");
+	  bam_index_filename(file1, BAM_INDEX_BAI, idx_filename);
 	  printf("Creating BAM index...\n");
-	  //samtools index fastq_filename;
-	  bamFile bf = bam_open(file1, "r");
-	  idx = bam_index_core(bf);
-	  if (!idx) {
+	  if (bam_index_build(file1, NULL, BAM_INDEX_BAI, 0, num_threads) != BAM_INDEX_BAI) {
 	    printf("Could not create the BAM index. Please, check your BAM file: %s\n", file1);
 	    exit(-1);
 	  }
-	  bam_close(bf);
 	  printf("Done. BAM index: %s\n", idx_filename);
-	  FILE *idxf = fopen(idx_filename, "wb");
-	  if (idxf == NULL) {
-	    LOG_FATAL_F("Could not open the BAM index: %s", idx_filename);
-	  }
-	  bam_index_save(idx, idxf);
-	  //bam_index_destroy(idx);
-	  fclose(idxf);
 	  idx = bam_index_load(file1);
 	  if (idx == 0){
 	    printf("Could not load the BAM index: %s", idx_filename);
@@ -222,6 +232,7 @@ void dna_aligner(options_t *options) {
     //
     sa_wf_batch_t *wf_batch = sa_wf_batch_new(options, (void *)sa_index, &writer_input, NULL, NULL);
     sa_wf_input_t *wf_input = sa_wf_input_new(bam_format, &reader_input, wf_batch);
+    wf_input->shard = shard;
     
     
     // create and initialize workflow
@@ -264,25 +275,7 @@ void dna_aligner(options_t *options) {
     workflow_run_with(num_threads, wf_input, wf);
     gettimeofday(&stop, NULL);
 
-    #ifdef _TIMING
-    char func_name[1024];
-    double total_func_times = 0;
-    for (int i = 0; i < NUM_TIMING; i++) {
-      if (i != FUNC_SEARCH_PREFIX && i != FUNC_SEARCH_SA 
-	  && i < FUNC_INIT_CALS_FROM_SUFFIXES || i > FUNC_CAL_MNG_INSERT) {
-	total_func_times += func_times[i];
-      }
-    }
-    printf("Timing in seconds:\n");
-    for (int i = 0; i < NUM_TIMING; i++) {
-      if (i == FUNC_SEARCH_PREFIX || i == FUNC_SEARCH_SA ||
-	  (i >= FUNC_INIT_CALS_FROM_SUFFIXES && i <= FUNC_CAL_MNG_INSERT)) {
-      printf("\t");
-      }
-      printf("\t%0.2f %%\t%0.4f\tof %0.4f\t%s\n", 
-	     100.0 * func_times[i] / total_func_times, func_times[i], total_func_times, func_names[i]);
-    }
-    #endif
+    profile_display();
     
     if ((options->input_format == BAM_FORMAT) || 
 	(options->input_format == SAM_FORMAT)) {
@@ -293,8 +286,10 @@ void dna_aligner(options_t *options) {
       if (options->pair_mode == PAIRED_END_MODE) {
 	// sort the bam
 	char *un = "Unmapped.bam";
-	char *sortname = "SortedUnmap";
-	bam_sort_core_ext(0, un, sortname, 500000000, 0);
+	char *sortname = "SortedUnmap.bam";
+	if (bam_sort_file(un, sortname, BAM_SORT_COORD, (size_t) options->sort_memory * 1000000, num_threads, 0, 0) != 0) {
+	  LOG_FATAL_F("Could not sort the BAM file %s\n", un);
+	}
 	fnomapped = bam_fopen("SortedUnmap.bam");
 
 	// free the previous wf_input
@@ -340,19 +335,27 @@ void dna_aligner(options_t *options) {
       }
     }
     
+    // last metrics snapshot
+    metrics_free();
+
     // display stats
     printf("End of mapping in %0.2f min. Done!!\n",
 	   ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f)/60.0f);
     printf("-----------------------------------------------------------------\n");
     printf("Output file : %s\n", out_filename);
     printf("\n");
+    uint64_t mapping_counters[NUM_COUNTER_IDS];
+    counters_reduce(mapping_counters);
+    size_t num_mapped_reads = mapping_counters[COUNTER_MAPPED_READS];
+    size_t num_unmapped_reads = mapping_counters[COUNTER_UNMAPPED_READS];
+
     printf("Num. reads : %lu\nNum. mapped reads : %lu (%0.2f %%)\nNum. unmapped reads: %lu (%0.2f %%)\n",
 	   num_mapped_reads + num_unmapped_reads,
 	   num_mapped_reads, 100.0f * num_mapped_reads / (num_mapped_reads + num_unmapped_reads),
 	   num_unmapped_reads, 100.0f * num_unmapped_reads / (num_mapped_reads + num_unmapped_reads));
     printf("\n");
-    printf("Num. mappings : %lu\n", num_total_mappings);
-    printf("Num. multihit reads: %lu\n", num_multihit_reads);
+    printf("Num. mappings : %lu\n", mapping_counters[COUNTER_TOTAL_MAPPINGS]);
+    printf("Num. multihit reads: %lu\n", mapping_counters[COUNTER_MULTIHIT_READS]);
     printf("-----------------------------------------------------------------\n");
 
     if ((options->input_format == BAM_FORMAT) || 
@@ -369,6 +372,7 @@ void dna_aligner(options_t *options) {
     workflow_free(wf);
     if (idx) bam_index_destroy(idx);
     if (stats) sa_stats_free(stats);
+    if (shard) shard_free(shard);
 
     //
     // end of workflow management
@@ -379,6 +383,28 @@ void dna_aligner(options_t *options) {
   array_list_free(files_fq1, (void *) free);
   array_list_free(files_fq2, (void *) free);
   if (sa_index) sa_index3_free(sa_index);
+  affinity_free();
+
+  // profiling report
+  if (options->profile) {
+    char profile_filename[strlen(options->output_name) + 100];
+    sprintf(profile_filename, "%s/profile.json", options->output_name);
+    profile_report(profile_filename, num_threads);
+    printf("Profiling report: %s\n", profile_filename);
+    profile_free();
+  }
+
+  metrics_free();
+  counters_free();
+
+  // timeline trace
+  if (options->trace) {
+    char trace_filename[strlen(options->output_name) + 100];
+    sprintf(trace_filename, "%s/trace.json", options->output_name);
+    trace_dump(trace_filename);
+    printf("Timeline trace: %s\n", trace_filename);
+    trace_free();
+  }
   
   //closing files
   if (bam_format) {
@@ -386,6 +412,25 @@ void dna_aligner(options_t *options) {
   } else {
     fclose((FILE *) writer_input.bam_file);
   }
+  if (writer_input.recal_table) {
+    recal_table_destroy(writer_input.recal_table);
+  }
+
+  // sorted and indexed output, the index is built while the sorted
+  // file is written
+  if (bam_format && options->index_output) {
+    printf("-----------------------------------------------------------------\n");
+    printf("Sorting and indexing the output file...\n");
+    char unsorted_filename[strlen(out_filename) + 16];
+    sprintf(unsorted_filename, "%s.unsorted", out_filename);
+    if (rename(out_filename, unsorted_filename) != 0 ||
+	bam_sort_file(unsorted_filename, out_filename, BAM_SORT_COORD, (size_t) options->sort_memory * 1000000,
+		      num_threads, 1, 0) != 0) {
+      LOG_FATAL_F("Could not sort and index the BAM file %s\n", out_filename);
+    }
+    remove(unsorted_filename);
+    printf("Done!\n");
+  }
 
   // post-processing: realignment and recalibration
   if (options->realignment || options->recalibration) {
@@ -416,13 +461,15 @@ void dna_aligner(options_t *options) {
     }
     strcat(sorted_filename, "sorted_");
     strcat(sorted_filename, OUTPUT_FILENAME);
+    strcat(sorted_filename, ".bam");
 
     // run sort
-    bam_sort_core_ext(0, out_filename, sorted_filename, 500000000, 0);
+    if (bam_sort_file(out_filename, sorted_filename, BAM_SORT_COORD, (size_t) options->sort_memory * 1000000, num_threads, 0, 0) != 0) {
+      LOG_FATAL_F("Could not sort the BAM file %s\n", out_filename);
+    }
     printf("Done!\n");
 
     // and then, re-align
-    strcat(sorted_filename, ".bam");
     printf("-----------------------------------------------------------------\n");
     printf("Realigning...\n");
     realig_filename[0] = 0;
@@ -474,7 +521,7 @@ void dna_aligner(options_t *options) {
     strcat(ref_filename, "/dna_compression.bin");
 
     recal_bam_file(RECALIBRATE_COLLECT | RECALIBRATE_RECALIBRATE, aux, ref_filename, 
-		   NULL, NULL, recal_filename, 500, NULL);
+		   NULL, NULL, recal_filename, 500, NULL, NULL);
     printf("Recalibrated file  : %s\n", recal_filename);
   }
 
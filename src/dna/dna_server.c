@@ -0,0 +1,423 @@
+#include "dna_server.h"
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+extern sa_genome3_t *global_genome;
+
+//--------------------------------------------------------------------
+// server state, shared by the accept loop and the job threads
+//--------------------------------------------------------------------
+
+typedef struct server {
+  options_t *options;
+  sa_index3_t *sa_index;
+  int threads_per_job;
+
+  int stop;
+  int running;  // jobs being mapped
+  server_job_t *first;
+  server_job_t *last;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} server_t;
+
+static server_t server;
+
+//--------------------------------------------------------------------
+
+static void server_reply(int fd, char *reply) {
+  size_t len = strlen(reply), written = 0;
+  while (written < len) {
+    // the client may be gone, no SIGPIPE
+    ssize_t n = send(fd, reply + written, len - written, MSG_NOSIGNAL);
+    if (n <= 0) break;
+    written += n;
+  }
+}
+
+//--------------------------------------------------------------------
+
+static void server_job_free(server_job_t *job) {
+  if (job->fq1) free(job->fq1);
+  if (job->fq2) free(job->fq2);
+  if (job->out) free(job->out);
+  free(job);
+}
+
+//--------------------------------------------------------------------
+// maps a job with the preloaded index, same workflow as dna_aligner
+// (FastQ input only)
+//--------------------------------------------------------------------
+
+static void server_job_map(server_job_t *job, char *reply, size_t reply_size) {
+  if (access(job->fq1, R_OK) || (job->fq2 && access(job->fq2, R_OK))) {
+    snprintf(reply, reply_size, "error could not read the input file %s\n",
+	     (access(job->fq1, R_OK) ? job->fq1 : job->fq2));
+    return;
+  }
+
+  FILE *f = fopen(job->out, "w");
+  if (!f) {
+    snprintf(reply, reply_size, "error could not open the output file %s (%s)\n",
+	     job->out, strerror(errno));
+    return;
+  }
+
+  sa_index3_t *sa_index = server.sa_index;
+
+  // every job has its own copy of the options (pair mode, input files)
+  options_t options;
+  memcpy(&options, server.options, sizeof(options_t));
+  options.in_filename = job->fq1;
+  options.in_filename2 = job->fq2;
+  options.pair_mode = (job->fq2 ? PAIRED_END_MODE : SINGLE_END_MODE);
+  options.gzip = job->gzip;
+  options.input_format = FASTQ_FORMAT;
+
+  size_t len = strlen(job->out);
+  int bam_format = (len > 4 && !strcmp(job->out + len - 4, ".bam"));
+
+  struct timeval stop, start;
+  gettimeofday(&start, NULL);
+
+  // output
+  batch_writer_input_t writer_input;
+  batch_writer_input_init(job->out, NULL, NULL, NULL, NULL, &writer_input);
+  if (bam_format) {
+    fclose(f);
+    bam_header_t *bam_header = create_bam_header(&options, sa_index->genome);
+    writer_input.bam_file = bam_fopen_mode(job->out, bam_header, "w");
+    bam_fwrite_header(bam_header, writer_input.bam_file);
+  } else {
+    writer_input.bam_file = (bam_file_t *) f;
+    write_sam_header(&options, sa_index->genome, f);
+  }
+
+  // input
+  fastq_batch_reader_input_t reader_input;
+  fastq_batch_reader_input_init(job->fq1, job->fq2, options.pair_mode,
+				options.batch_size, NULL, options.gzip,
+				&reader_input);
+  if (options.gzip) {
+    reader_input.fq_gzip_file1 = fastq_gzopen(job->fq1);
+    if (job->fq2) reader_input.fq_gzip_file2 = fastq_gzopen(job->fq2);
+  } else {
+    reader_input.fq_file1 = fastq_fopen(job->fq1);
+    if (job->fq2) reader_input.fq_file2 = fastq_fopen(job->fq2);
+  }
+
+  // workflow
+  sa_wf_batch_t *wf_batch = sa_wf_batch_new(&options, (void *) sa_index, &writer_input, NULL, NULL);
+  sa_wf_input_t *wf_input = sa_wf_input_new(bam_format, &reader_input, wf_batch);
+
+  workflow_t *wf = workflow_new();
+  workflow_stage_function_t stage_functions[1];
+  char *stage_labels[1] = {"SA mapper"};
+  stage_functions[0] = (options.pair_mode == SINGLE_END_MODE ? sa_single_mapper : sa_pair_mapper);
+  workflow_set_stages(1, stage_functions, stage_labels, wf);
+  workflow_set_producer(sa_fq_reader, "FastQ reader", wf);
+  if (bam_format) {
+    workflow_set_consumer((workflow_consumer_function_t *)sa_bam_writer, "BAM writer", wf);
+  } else {
+    workflow_set_consumer((workflow_consumer_function_t *)sa_sam_writer, "SAM writer", wf);
+  }
+
+  workflow_run_with(server.threads_per_job, wf_input, wf);
+
+  // close files and free memory
+  if (options.gzip) {
+    fastq_gzclose(reader_input.fq_gzip_file1);
+    if (job->fq2) fastq_gzclose(reader_input.fq_gzip_file2);
+  } else {
+    fastq_fclose(reader_input.fq_file1);
+    if (job->fq2) fastq_fclose(reader_input.fq_file2);
+  }
+  if (bam_format) {
+    bam_fclose(writer_input.bam_file);
+  } else {
+    fclose((FILE *) writer_input.bam_file);
+  }
+
+  sa_wf_input_free(wf_input);
+  sa_wf_batch_free(wf_batch);
+  workflow_free(wf);
+
+  gettimeofday(&stop, NULL);
+  snprintf(reply, reply_size, "ok %lu %lu %0.3f\n",
+	   writer_input.total_reads, writer_input.num_mapped_reads,
+	   (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);
+}
+
+//--------------------------------------------------------------------
+
+static void *server_job_thread(void *arg) {
+  char reply[SERVER_MAX_REQUEST];
+  server_job_t *job;
+
+  while (1) {
+    pthread_mutex_lock(&server.mutex);
+    while (!server.first && !server.stop) {
+      pthread_cond_wait(&server.cond, &server.mutex);
+    }
+    job = server.first;
+    if (job) {
+      server.first = job->next;
+      if (!server.first) server.last = NULL;
+
+      // the counters cover the jobs since the server was idle, they
+      // can not be cleared while other jobs are adding to them
+      if (!server.running++) counters_reset();
+    }
+    pthread_mutex_unlock(&server.mutex);
+
+    // stop only when the queue is empty
+    if (!job) break;
+
+    LOG_DEBUG_F("job: %s %s -> %s\n", job->fq1, (job->fq2 ? job->fq2 : ""), job->out);
+    server_job_map(job, reply, sizeof(reply));
+    server_reply(job->fd, reply);
+    close(job->fd);
+    server_job_free(job);
+
+    pthread_mutex_lock(&server.mutex);
+    server.running--;
+    pthread_mutex_unlock(&server.mutex);
+  }
+
+  return NULL;
+}
+
+//--------------------------------------------------------------------
+// request parsing, returns a job or NULL (reply already sent)
+//--------------------------------------------------------------------
+
+static server_job_t *server_request(int fd, char *request) {
+  char *saveptr, *token = strtok_r(request, " \t\r\n", &saveptr);
+
+  if (!token) {
+    server_reply(fd, "error empty request\n");
+    return NULL;
+  }
+
+  if (!strcmp(token, "ping")) {
+    server_reply(fd, "ok\n");
+    return NULL;
+  }
+
+  if (!strcmp(token, "shutdown")) {
+    pthread_mutex_lock(&server.mutex);
+    server.stop = 1;
+    pthread_cond_broadcast(&server.cond);
+    pthread_mutex_unlock(&server.mutex);
+    server_reply(fd, "ok\n");
+    return NULL;
+  }
+
+  if (strcmp(token, "map")) {
+    server_reply(fd, "error unknown request, valid requests: map, ping, shutdown\n");
+    return NULL;
+  }
+
+  server_job_t *job = (server_job_t *) calloc(1, sizeof(server_job_t));
+  job->fd = fd;
+  while ((token = strtok_r(NULL, " \t\r\n", &saveptr)) != NULL) {
+    if (!strncmp(token, "fq=", 3)) {
+      job->fq1 = strdup(token + 3);
+    } else if (!strncmp(token, "fq2=", 4)) {
+      job->fq2 = strdup(token + 4);
+    } else if (!strncmp(token, "out=", 4)) {
+      job->out = strdup(token + 4);
+    } else if (!strcmp(token, "gzip")) {
+      job->gzip = 1;
+    } else {
+      server_reply(fd, "error unknown map argument, valid arguments: fq=, fq2=, out=, gzip\n");
+      server_job_free(job);
+      return NULL;
+    }
+  }
+
+  if (!job->fq1 || !job->out) {
+    server_reply(fd, "error map needs fq=<file> and out=<file>\n");
+    server_job_free(job);
+    return NULL;
+  }
+
+  return job;
+}
+
+//--------------------------------------------------------------------
+// the request is read by the accept loop, a client sending nothing
+// must not hold the next ones: reads time out after
+// SERVER_REQUEST_TIMEOUT seconds
+//--------------------------------------------------------------------
+
+static int server_read_request(int fd, char *request, size_t size) {
+  struct timeval timeout = { .tv_sec = SERVER_REQUEST_TIMEOUT, .tv_usec = 0 };
+  if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout))) {
+    LOG_WARN_F("Could not set the request timeout (%s)\n", strerror(errno));
+  }
+
+  size_t len = 0;
+  while (len < size - 1) {
+    ssize_t n = read(fd, request + len, size - 1 - len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      server_reply(fd, "error request timeout\n");
+      return 0;
+    }
+    if (n <= 0) break;
+    len += n;
+    if (memchr(request + len - n, '\n', n)) break;
+  }
+  request[len] = 0;
+  return len;
+}
+
+//--------------------------------------------------------------------
+
+static int server_socket_new(char *path) {
+  struct sockaddr_un addr;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    LOG_FATAL_F("Socket path too long: %s\n", path);
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    LOG_FATAL_F("Could not create the socket %s\n", path);
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  unlink(path);
+
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, SERVER_BACKLOG)) {
+    LOG_FATAL_F("Could not listen on the socket %s (%s)\n", path, strerror(errno));
+  }
+
+  return fd;
+}
+
+//--------------------------------------------------------------------
+
+void dna_server(options_t *options) {
+  if (!options->socket_path) {
+    LOG_FATAL("Socket path is missing. Please, insert it with option '--socket PATH'.\n");
+  }
+
+  int num_jobs = (options->serve_jobs > 0 ? options->serve_jobs : 1);
+  int num_threads = options->num_cpu_threads;
+
+  profile_init(options->profile);
+  trace_init(options->trace);
+  metrics_init(options->metrics_target);
+
+  options_display(options);
+  affinity_init(options->numa_policy, num_threads);
+
+  // load SA index, once for all the jobs
+  struct timeval stop, start;
+  printf("\n");
+  printf("-----------------------------------------------------------------\n");
+  printf("Loading SA tables...\n");
+  gettimeofday(&start, NULL);
+  sa_index3_t *sa_index = sa_index3_new(options->bwt_dirname);
+  global_genome = sa_index->genome;
+  gettimeofday(&stop, NULL);
+  printf("End of loading SA tables in %0.2f min. Done!!\n",
+	 ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f) / 60.0f);
+
+  if (options->numa_policy != NUMA_NONE) {
+    affinity_display();
+    sa_index3_display_placement(sa_index);
+  }
+
+  memset(&server, 0, sizeof(server_t));
+  server.options = options;
+  server.sa_index = sa_index;
+  server.threads_per_job = (num_threads / num_jobs > 0 ? num_threads / num_jobs : 1);
+  pthread_mutex_init(&server.mutex, NULL);
+  pthread_cond_init(&server.cond, NULL);
+
+  pthread_t threads[num_jobs];
+  for (int i = 0; i < num_jobs; i++) {
+    if (pthread_create(&threads[i], NULL, server_job_thread, NULL)) {
+      LOG_FATAL("Could not create the server job threads\n");
+    }
+  }
+
+  int socket_fd = server_socket_new(options->socket_path);
+  printf("-----------------------------------------------------------------\n");
+  printf("Listening on %s (%i concurrent job(s), %i thread(s) per job)\n",
+	 options->socket_path, num_jobs, server.threads_per_job);
+  fflush(stdout);
+
+  // accept loop
+  char request[SERVER_MAX_REQUEST];
+  while (!server.stop) {
+    int fd = accept(socket_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      LOG_FATAL_F("Could not accept connections on %s (%s)\n", options->socket_path, strerror(errno));
+    }
+
+    if (!server_read_request(fd, request, sizeof(request))) {
+      close(fd);
+      continue;
+    }
+
+    server_job_t *job = server_request(fd, request);
+    if (!job) {
+      close(fd);
+      continue;
+    }
+
+    pthread_mutex_lock(&server.mutex);
+    if (server.last) {
+      server.last->next = job;
+    } else {
+      server.first = job;
+    }
+    server.last = job;
+    pthread_cond_signal(&server.cond);
+    pthread_mutex_unlock(&server.mutex);
+  }
+
+  printf("Shutting down, waiting for the pending jobs...\n");
+  close(socket_fd);
+  unlink(options->socket_path);
+
+  for (int i = 0; i < num_jobs; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  pthread_mutex_destroy(&server.mutex);
+  pthread_cond_destroy(&server.cond);
+
+  sa_index3_free(sa_index);
+  affinity_free();
+
+  if (options->profile) {
+    char profile_filename[strlen(options->output_name) + 100];
+    sprintf(profile_filename, "%s/profile.json", options->output_name);
+    profile_report(profile_filename, num_threads);
+    printf("Profiling report: %s\n", profile_filename);
+    profile_free();
+  }
+
+  metrics_free();
+  counters_free();
+
+  if (options->trace) {
+    char trace_filename[strlen(options->output_name) + 100];
+    sprintf(trace_filename, "%s/trace.json", options->output_name);
+    trace_dump(trace_filename);
+    printf("Timeline trace: %s\n", trace_filename);
+    trace_free();
+  }
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
@@ -0,0 +1,46 @@
+#ifndef DNA_SERVER_H
+#define DNA_SERVER_H
+
+#include "dna/dna_aligner.h"
+
+//--------------------------------------------------------------------
+// mapping server (serve command)
+//
+// the SA index is loaded once and jobs are received on a Unix socket,
+// one request line per connection:
+//
+//   map fq=<file> [fq2=<file>] out=<file.sam|file.bam> [gzip]
+//   ping
+//   shutdown
+//
+// and one reply line:
+//
+//   ok <num. reads> <num. mapped reads> <seconds>
+//   error <message>
+//
+// up to --serve-jobs jobs are mapped at the same time, splitting the
+// CPU threads between them
+//--------------------------------------------------------------------
+
+#define SERVER_MAX_REQUEST  8192
+#define SERVER_BACKLOG      64
+#define SERVER_REQUEST_TIMEOUT  5   // seconds to receive the request line
+
+//--------------------------------------------------------------------
+
+typedef struct server_job {
+  int fd;
+  char *fq1;
+  char *fq2;
+  char *out;
+  int gzip;
+  struct server_job *next;
+} server_job_t;
+
+//--------------------------------------------------------------------
+
+void dna_server(options_t *options);
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+#endif // DNA_SERVER_H
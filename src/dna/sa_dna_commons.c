@@ -147,36 +147,6 @@ void seed_cal_merge_seeds(seed_cal_t *cal) {
 // utils
 //--------------------------------------------------------------------
 
-#ifdef _TIMING
-void init_func_names() {
-  strcpy(func_names[0], "search_suffix");
-  strcpy(func_names[1], "search_prefix");
-  strcpy(func_names[2], "search_sa");
-  strcpy(func_names[3], "generate_cals_from_exact_read");
-  strcpy(func_names[4], "generate_cals_from_suffixes");
-  strcpy(func_names[5], "init_cals_from_suffixes");
-  strcpy(func_names[6], "set_positions");
-  strcpy(func_names[7], "set_reference_sequence");
-  strcpy(func_names[8], "skip_suffixes");
-  strcpy(func_names[9], "mini_sw_right_side");
-  strcpy(func_names[10], "mini_sw_left_side");
-  strcpy(func_names[11], "seed_new");
-  strcpy(func_names[12], "seed_list_insert");
-  strcpy(func_names[13], "cal_new");
-  strcpy(func_names[14], "cal_mng_insert");
-  strcpy(func_names[15], "cal_mng_to_array_list");
-  strcpy(func_names[16], "filter_by_read_area");
-  strcpy(func_names[17], "filter_by_num_mismatches");
-  strcpy(func_names[18], "sw_pre_processing");
-  strcpy(func_names[19], "sw_execution");
-  strcpy(func_names[20], "sw_post_processing");
-  strcpy(func_names[21], "other functions");
-  strcpy(func_names[22], "create_alignments");
-}
-#endif
-
-//--------------------------------------------------------------------
-
 float get_max_score(array_list_t *cal_list,
 		    float match_score, float mismatch_penalty,
 		    float gap_open_penalty, float gap_extend_penalty) {
@@ -473,18 +443,13 @@ void select_best_cals(fastq_read_t *read, array_list_t **cal_list) {
 void select_best_cals2(fastq_read_t *read, array_list_t **cal_list) {
 
   int max_read_area, min_num_mismatches;
+  uint64_t start;
 
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(start);
   max_read_area = get_max_read_area(*cal_list);
   if (max_read_area > read->length) max_read_area = read->length;
   filter_cals_by_max_read_area(max_read_area, cal_list);
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  mapping_batch->func_times[FUNC_FILTER_BY_READ_AREA] += 
-    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_FILTER_BY_READ_AREA, start);
 
   #ifdef _VERBOSE
   printf("\t***> max_read_area = %i\n", max_read_area);
@@ -495,15 +460,9 @@ void select_best_cals2(fastq_read_t *read, array_list_t **cal_list) {
   printf("\t*** before SW> min_num_mismatches = %i\n", min_num_mismatches);
   #endif
       
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(start);
   filter_cals_by_max_num_mismatches(min_num_mismatches, cal_list);
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  mapping_batch->func_times[FUNC_FILTER_BY_NUM_MISMATCHES] += 
-    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_FILTER_BY_NUM_MISMATCHES, start);
 }
 
 //--------------------------------------------------------------------
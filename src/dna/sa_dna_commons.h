@@ -8,6 +8,10 @@
 #include "buffers.h"
 #include "cal_seeker.h"
 #include "pair_server.h"
+#include "profile.h"
+#include "trace.h"
+#include "metrics.h"
+#include "counters.h"
 
 #include "sa/sa_index3.h"
 
@@ -18,38 +22,6 @@ extern int counters[NUM_COUNTERS];
 
 //--------------------------------------------------------------------
 
-#ifdef _TIMING
-
-#define FUNC_SEARCH_SUFFIX             0
-#define FUNC_SEARCH_PREFIX             1
-#define FUNC_SEARCH_SA                 2
-#define FUNC_CALS_FROM_EXACT_READ      3
-#define FUNC_CALS_FROM_SUFFIXES        4
-#define FUNC_INIT_CALS_FROM_SUFFIXES   5
-#define FUNC_SET_POSITIONS             6
-#define FUNC_SET_REF_SEQUENCE          7
-#define FUNC_SKIP_SUFFIXES             8
-#define FUNC_MINI_SW_RIGHT_SIDE        9
-#define FUNC_MINI_SW_LEFT_SIDE        10
-#define FUNC_SEED_NEW                 11
-#define FUNC_SEED_LIST_INSERT         12
-#define FUNC_CAL_NEW                  13
-#define FUNC_CAL_MNG_INSERT           14
-#define FUNC_CAL_MNG_TO_LIST          15
-#define FUNC_FILTER_BY_READ_AREA      16
-#define FUNC_FILTER_BY_NUM_MISMATCHES 17
-#define FUNC_PRE_SW                   18
-#define FUNC_SW                       19
-#define FUNC_POST_SW                  20
-#define FUNC_OTHER                    21
-#define FUNC_CREATE_ALIGNMENTS        22
-
-
-#define NUM_TIMING (FUNC_CREATE_ALIGNMENTS + 1)
-double func_times[NUM_TIMING];
-char func_names[NUM_TIMING][1024];
-
-#endif
 
 //--------------------------------------------------------------------
 
@@ -72,10 +44,6 @@ typedef struct sa_mapping_batch {
   int pair_min_distance;
   int pair_max_distance;
 
-  #ifdef _TIMING
-  double func_times[NUM_TIMING];
-  #endif
-
   options_t *options;
 
   array_list_t *fq_reads;
@@ -86,6 +54,19 @@ typedef struct sa_mapping_batch {
 
 //--------------------------------------------------------------------
 
+static inline void sa_mapping_batch_touch(sa_mapping_batch_t *p) {
+  if (p->mapping_lists) return;
+
+  p->mapping_lists = (array_list_t **) malloc(p->num_reads * sizeof(array_list_t *));
+  for (size_t i = 0; i < p->num_reads; i++) {
+    p->mapping_lists[i] = array_list_new(10, 1.25f, COLLECTION_MODE_ASYNCHRONIZED);
+  }
+
+  p->status = (char *) calloc(p->num_reads, sizeof(char));
+}
+
+//--------------------------------------------------------------------
+
 static inline sa_mapping_batch_t *sa_mapping_batch_new(array_list_t *fq_reads) {
 
   size_t num_reads = array_list_size(fq_reads);
@@ -103,18 +84,14 @@ static inline sa_mapping_batch_t *sa_mapping_batch_new(array_list_t *fq_reads) {
   p->pair_max_distance = 0;
 
   p->fq_reads = fq_reads;
-  p->mapping_lists = (array_list_t **) malloc(num_reads * sizeof(array_list_t *));
-  for (size_t i = 0; i < num_reads; i++) {
-    p->mapping_lists[i] = array_list_new(10, 1.25f, COLLECTION_MODE_ASYNCHRONIZED);
-  }
-
-  p->status = (char *) calloc(num_reads, sizeof(char));
+  p->mapping_lists = NULL;
+  p->status = NULL;
 
-  #ifdef _TIMING
-  for (int i = 0; i < NUM_TIMING; i++) {
-    p->func_times[i] = 0;
+  // with NUMA placement, the mapper stage allocates (first touch) the
+  // output buffers on the node of the worker thread
+  if (affinity_get_policy() == NUMA_NONE) {
+    sa_mapping_batch_touch(p);
   }
-  #endif
 
   return p;
 }  
@@ -130,6 +107,14 @@ static inline void sa_mapping_batch_free(sa_mapping_batch_t *p) {
   }
 }  
 
+static inline void sa_metrics_add_reads(array_list_t *reads) {
+  size_t num_reads = array_list_size(reads), num_bases = 0;
+  for (size_t i = 0; i < num_reads; i++) {
+    num_bases += ((fastq_read_t *) array_list_get(i, reads))->length;
+  }
+  metrics_add_reads(num_reads, num_bases);
+}
+
 //--------------------------------------------------------------------
 // sa_wf_batch_t
 //--------------------------------------------------------------------
@@ -143,6 +128,8 @@ typedef struct sa_wf_batch {
   void *data_input;
   void *data_output;
   int data_output_size;
+
+  uint64_t created; // for the batch latency metrics
 } sa_wf_batch_t;
 
 //--------------------------------------------------------------------
@@ -161,6 +148,8 @@ static inline sa_wf_batch_t *sa_wf_batch_new(options_t *options,
   p->mapping_batch = mapping_batch;
   p->data_input    = data_input;
 
+  p->created = metrics_now();
+
   return p;
 }
 
@@ -207,6 +196,7 @@ typedef struct sa_wf_input {
   bam_index_t *idx;
   stats_t *stats;
   void *data;
+  shard_t *shard;  // --shard, NULL to read the whole input
 } sa_wf_input_t;
 
 //--------------------------------------------------------------------
@@ -221,6 +211,7 @@ static inline sa_wf_input_t *sa_wf_input_new(int bam_format,
   p->idx = NULL;
   p->stats = NULL;
   p->data = NULL;
+  p->shard = NULL;
   return p;
 }
 
@@ -1,5 +1,7 @@
 #include "sa_io_stages.h"
 
+#include "tools/bam/recalibrate/bam_recal_library.h"
+
 //====================================================================
 // PRODUCER
 //====================================================================
@@ -10,6 +12,11 @@
 
 void *sa_fq_reader(void *input) {
   sa_wf_input_t *wf_input = (sa_wf_input_t *) input;
+
+  uint64_t start;
+  PROFILE_START(start);
+  TRACE_BEGIN("FastQ reader");
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_READER);
   
   sa_wf_batch_t *new_wf_batch = NULL;
   sa_wf_batch_t *curr_wf_batch = wf_input->wf_batch;
@@ -17,7 +24,10 @@ void *sa_fq_reader(void *input) {
   fastq_batch_reader_input_t *fq_reader_input = wf_input->fq_reader_input;
   array_list_t *reads = array_list_new(fq_reader_input->batch_size, 1.25f, COLLECTION_MODE_ASYNCHRONIZED);
 
-  if (fq_reader_input->gzip) {
+  if (wf_input->shard) {
+    // slice of the input files
+    shard_fastq_read(reads, fq_reader_input->batch_size, wf_input->shard);
+  } else if (fq_reader_input->gzip) {
     // Gzip fastq file
     if (fq_reader_input->flags == SINGLE_END_MODE) {
       fastq_gzread_bytes_se(reads, fq_reader_input->batch_size, fq_reader_input->fq_gzip_file1);
@@ -40,6 +50,7 @@ void *sa_fq_reader(void *input) {
     array_list_free(reads, (void *)fastq_read_free);
   } else {
     sa_mapping_batch_t *sa_mapping_batch = sa_mapping_batch_new(reads);
+    sa_metrics_add_reads(reads);
     sa_mapping_batch->bam_format = wf_input->bam_format;
 
     new_wf_batch = sa_wf_batch_new(curr_wf_batch->options,
@@ -49,6 +60,10 @@ void *sa_fq_reader(void *input) {
 				   NULL);
   }
 
+  if (new_wf_batch) metrics_stage_end(METRICS_STAGE_READER, metrics_start);
+  TRACE_END("FastQ reader");
+  PROFILE_STOP(FUNC_READ_BATCH, start);
+
   return new_wf_batch;
 
 }
@@ -59,6 +74,11 @@ void *sa_fq_reader(void *input) {
 
 void *sa_bam_reader_single(void *input) {
   sa_wf_input_t *wf_input = (sa_wf_input_t *) input;
+
+  uint64_t start;
+  PROFILE_START(start);
+  TRACE_BEGIN("BAM reader");
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_READER);
   
   sa_wf_batch_t *new_wf_batch = NULL;
   sa_wf_batch_t *curr_wf_batch = wf_input->wf_batch;
@@ -80,7 +100,8 @@ void *sa_bam_reader_single(void *input) {
   char *header, *sequence, *quality;
 
   bam1 = bam_init1();
-  while ((bam_read1(bam_file->bam_fd, bam1) > 0) && (size < batch_size) ) {
+  while (!shard_bam_done(wf_input->shard, bam_file->bam_fd) &&
+	 (bam_read1(bam_file->bam_fd, bam1) > 0) && (size < batch_size) ) {
     // convert bam1_t to fastq_read_t
     total_reads++;
     if (!(bam1->core.flag & BAM_FSECONDARY)) {
@@ -113,6 +134,7 @@ void *sa_bam_reader_single(void *input) {
     array_list_free(reads, (void *)fastq_read_free);
   } else {
     sa_mapping_batch_t *sa_mapping_batch = sa_mapping_batch_new(reads);
+    sa_metrics_add_reads(reads);
     sa_mapping_batch->bam_format = wf_input->bam_format;
     
     new_wf_batch = sa_wf_batch_new(curr_wf_batch->options,
@@ -124,6 +146,10 @@ void *sa_bam_reader_single(void *input) {
   
   stats->total_reads+=total_reads;
   
+  if (new_wf_batch) metrics_stage_end(METRICS_STAGE_READER, metrics_start);
+  TRACE_END("BAM reader");
+  PROFILE_STOP(FUNC_READ_BATCH, start);
+
   return new_wf_batch;
 }
 
@@ -133,6 +159,11 @@ void *sa_bam_reader_single(void *input) {
 
 void *sa_bam_reader_pairend(void *input) { 
   sa_wf_input_t *wf_input = (sa_wf_input_t *) input;
+
+  uint64_t start;
+  PROFILE_START(start);
+  TRACE_BEGIN("BAM reader");
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_READER);
   
   sa_wf_batch_t *new_wf_batch = NULL;
   sa_wf_batch_t *curr_wf_batch = wf_input->wf_batch;
@@ -159,7 +190,8 @@ void *sa_bam_reader_pairend(void *input) {
   char *header, *sequence, *quality;
   fastq_read_t *read;
     
-  while ((bam_read1(bam_file->bam_fd, bam1) > 0) && (size < batch_size)) {
+  while (!shard_bam_done(wf_input->shard, bam_file->bam_fd) &&
+	 (bam_read1(bam_file->bam_fd, bam1) > 0) && (size < batch_size)) {
 
     if ((bam1->core.flag & BAM_FREAD1) 
 	&& !(bam1->core.flag & BAM_FMUNMAP) 
@@ -258,6 +290,7 @@ void *sa_bam_reader_pairend(void *input) {
     array_list_free(reads, (void *) fastq_read_free);
   } else {
     sa_mapping_batch_t *sa_mapping_batch = sa_mapping_batch_new(reads);
+    sa_metrics_add_reads(reads);
     sa_mapping_batch->bam_format = wf_input->bam_format;
     
     new_wf_batch = sa_wf_batch_new(curr_wf_batch->options,
@@ -269,6 +302,10 @@ void *sa_bam_reader_pairend(void *input) {
   
   stats->total_reads+=total_reads;
   
+  if (new_wf_batch) metrics_stage_end(METRICS_STAGE_READER, metrics_start);
+  TRACE_END("BAM reader");
+  PROFILE_STOP(FUNC_READ_BATCH, start);
+
   return new_wf_batch;
 }
 
@@ -280,6 +317,11 @@ void *sa_bam_reader_unmapped(void *input) {
 
   sa_wf_input_t *wf_input = (sa_wf_input_t *) input;
 
+  uint64_t start;
+  PROFILE_START(start);
+  TRACE_BEGIN("BAM reader");
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_READER);
+
   sa_wf_batch_t *new_wf_batch = NULL;
   sa_wf_batch_t *curr_wf_batch = wf_input->wf_batch;
 
@@ -403,6 +445,7 @@ void *sa_bam_reader_unmapped(void *input) {
     array_list_free(reads, (void *)fastq_read_free);
   } else {
     sa_mapping_batch_t *sa_mapping_batch = sa_mapping_batch_new(reads);
+    sa_metrics_add_reads(reads);
     sa_mapping_batch->bam_format = wf_input->bam_format;
     
     new_wf_batch = sa_wf_batch_new(curr_wf_batch->options,
@@ -412,6 +455,10 @@ void *sa_bam_reader_unmapped(void *input) {
 				   NULL);
   }
 
+  if (new_wf_batch) metrics_stage_end(METRICS_STAGE_READER, metrics_start);
+  TRACE_END("BAM reader");
+  PROFILE_STOP(FUNC_READ_BATCH, start);
+
   return new_wf_batch;
 }
 
@@ -424,13 +471,6 @@ int num_dup_reads = 0;
 int num_total_dup_reads = 0;
 #endif
 
-size_t num_mapped_reads = 0;
-size_t num_unmapped_reads = 0;
-size_t num_total_mappings = 0;
-size_t num_multihit_reads = 0;
-size_t num_unmapped_reads_by_invalid_cal = 0;
-size_t num_unmapped_reads_by_cigar_length = 0;
-
 //--------------------------------------------------------------------
 // SAM writer
 //--------------------------------------------------------------------
@@ -454,11 +494,10 @@ int sa_sam_writer(void *data) {
     return 0;
   }
 
-  #ifdef _TIMING
-  for (int i = 0; i < NUM_TIMING; i++) {
-    func_times[i] += mapping_batch->func_times[i];
-  }
-  #endif
+  uint64_t start;
+  PROFILE_START(start);
+  TRACE_BEGIN("SAM writer");
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_WRITER);
 
   int num_mismatches, num_cigar_ops;
   size_t flag, pnext = 0, tlen = 0;
@@ -474,6 +513,8 @@ int sa_sam_writer(void *data) {
 
   size_t num_reads, num_mappings;
   num_reads = mapping_batch->num_reads;
+  counter_add(COUNTER_TOTAL_READS, num_reads);
+  wf_batch->writer_input->total_reads += num_reads;
 
   if (mapping_batch->options->pair_mode != SINGLE_END_MODE) {
     // PAIR MODE
@@ -489,7 +530,7 @@ int sa_sam_writer(void *data) {
 
       mapping_list = mapping_batch->mapping_lists[i];
       num_mappings = array_list_size(mapping_list);
-      num_total_mappings += num_mappings;
+      counter_add(COUNTER_TOTAL_MAPPINGS, num_mappings);
 
       #ifdef _VERBOSE
       if (num_mappings > 1) {
@@ -499,9 +540,10 @@ int sa_sam_writer(void *data) {
       #endif
       
       if (num_mappings > 0) {
-	num_mapped_reads++;
+	counter_add(COUNTER_MAPPED_READS, 1);
+	wf_batch->writer_input->num_mapped_reads++;
 	if (num_mappings > 1) {
-	  num_multihit_reads++;
+	  counter_add(COUNTER_MULTIHIT_READS, 1);
 	}
 	for (size_t j = 0; j < num_mappings; j++) {
 	  alig = (alignment_t *) array_list_get(j, mapping_list);
@@ -544,7 +586,7 @@ int sa_sam_writer(void *data) {
 	  alignment_free(alig);	 
 	} // end for num_mappings
       } else {
-	num_unmapped_reads++;
+	counter_add(COUNTER_UNMAPPED_READS, 1);
 
 	if (read->adapter) {
 	  len = read->length + abs(read->adapter_length);
@@ -601,7 +643,7 @@ int sa_sam_writer(void *data) {
       read = (fastq_read_t *) array_list_get(i, read_list);
       mapping_list = mapping_batch->mapping_lists[i];
       num_mappings = array_list_size(mapping_list);
-      num_total_mappings += num_mappings;
+      counter_add(COUNTER_TOTAL_MAPPINGS, num_mappings);
 
       #ifdef _VERBOSE
       if (num_mappings > 1) {
@@ -611,9 +653,10 @@ int sa_sam_writer(void *data) {
       #endif
       
       if (num_mappings > 0) {
-	num_mapped_reads++;
+	counter_add(COUNTER_MAPPED_READS, 1);
+	wf_batch->writer_input->num_mapped_reads++;
 	if (num_mappings > 1) {
-	  num_multihit_reads++;
+	  counter_add(COUNTER_MULTIHIT_READS, 1);
 	}
 
 	for (size_t j = 0; j < num_mappings; j++) {
@@ -710,7 +753,7 @@ int sa_sam_writer(void *data) {
 	  }
 	}
       } else {
-	num_unmapped_reads++;
+	counter_add(COUNTER_UNMAPPED_READS, 1);
 
 	if (read->adapter) {
 	  // sequences and cigar
@@ -759,6 +802,11 @@ int sa_sam_writer(void *data) {
     } // end for num_reads
   }
 
+  metrics_stage_end(METRICS_STAGE_WRITER, metrics_start);
+  metrics_batch_latency(wf_batch->created);
+  TRACE_END("SAM writer");
+  PROFILE_STOP(FUNC_WRITE_BATCH, start);
+
   // free memory
   sa_mapping_batch_free(mapping_batch);
 
@@ -806,11 +854,10 @@ int sa_bam_writer(void *data) {
     return 0;
   }
 
-  #ifdef _TIMING
-  for (int i = 0; i < NUM_TIMING; i++) {
-    func_times[i] += mapping_batch->func_times[i];
-  }
-  #endif
+  uint64_t start;
+  PROFILE_START(start);
+  TRACE_BEGIN("BAM writer");
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_WRITER);
 
   int len;
   char *sequence, *quality;
@@ -822,16 +869,19 @@ int sa_bam_writer(void *data) {
   alignment_t *alig;
   array_list_t *mapping_list;
   bam_file_t *out_file = wf_batch->writer_input->bam_file;
+  recal_table_t *recal_table = wf_batch->writer_input->recal_table;
 
 
 
   size_t num_reads, num_mappings;
   num_reads = mapping_batch->num_reads;
+  counter_add(COUNTER_TOTAL_READS, num_reads);
+  wf_batch->writer_input->total_reads += num_reads;
   for (size_t i = 0; i < num_reads; i++) {
     read = (fastq_read_t *) array_list_get(i, read_list);
     mapping_list = mapping_batch->mapping_lists[i];
     num_mappings = array_list_size(mapping_list);
-    num_total_mappings += num_mappings;
+    counter_add(COUNTER_TOTAL_MAPPINGS, num_mappings);
 
     #ifdef _VERBOSE
     if (num_mappings > 1) {
@@ -841,9 +891,10 @@ int sa_bam_writer(void *data) {
     #endif
 
     if (num_mappings > 0) {
-      num_mapped_reads++;
+      counter_add(COUNTER_MAPPED_READS, 1);
+      wf_batch->writer_input->num_mapped_reads++;
       if (num_mappings > 1) {
-	num_multihit_reads++;
+	counter_add(COUNTER_MULTIHIT_READS, 1);
       }
       for (size_t j = 0; j < num_mappings; j++) {
 	alig = (alignment_t *) array_list_get(j, mapping_list);
@@ -856,12 +907,16 @@ int sa_bam_writer(void *data) {
 	}
 
 	bam1 = convert_to_bam(alig, 33);
+	if (recal_table &&
+	    !filter_read(bam1, FILTER_ZERO_QUAL | FILTER_DIFF_MATE_CHROM | FILTER_NO_CIGAR | FILTER_DEF_MASK)) {
+	  recal_recalibrate_alignment_table(bam1, recal_table);
+	}
 	bam_fwrite(bam1, out_file);
 	bam_destroy1(bam1);
 	alignment_free(alig);
       }
     } else {
-      num_unmapped_reads++;
+      counter_add(COUNTER_UNMAPPED_READS, 1);
 
       if (read->adapter) {
 	// sequences and cigar
@@ -914,6 +969,11 @@ int sa_bam_writer(void *data) {
     array_list_free(mapping_list, (void *) NULL);
   }
 
+  metrics_stage_end(METRICS_STAGE_WRITER, metrics_start);
+  metrics_batch_latency(wf_batch->created);
+  TRACE_END("BAM writer");
+  PROFILE_STOP(FUNC_WRITE_BATCH, start);
+
   // free memory
   sa_mapping_batch_free(mapping_batch);
 
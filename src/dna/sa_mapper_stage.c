@@ -23,9 +23,6 @@ void cut_adapter(char *adapter, int adapter_length, fastq_read_t *read);
 int generate_cals_from_suffixes(int strand, fastq_read_t *read,
 				int read_pos, int suffix_len, size_t low, size_t high, 
 				sa_index3_t *sa_index, cal_mng_t *cal_mng
-                                #ifdef _TIMING
-				, sa_mapping_batch_t *mapping_batch
-                                #endif
 				);
 
 
@@ -566,9 +563,6 @@ array_list_t *search_mate_cal_by_prefixes(seed_cal_t *cal, fastq_read_t *read,
 	  generate_cals_from_suffixes(1 - cal->strand, read, read_pos,
 				      sa_index->k_value, i, i,
 				      sa_index, cal_mng
-                                      #ifdef _TIMING
-				      , batch
-                                      #endif
 				      );
 	}
       }
@@ -928,18 +922,11 @@ void generate_cals_from_exact_read(int strand, fastq_read_t *read,
 int generate_cals_from_suffixes(int strand, fastq_read_t *read,
 				int read_pos, int suffix_len, size_t low, size_t high, 
 				sa_index3_t *sa_index, cal_mng_t *cal_mng
-                                #ifdef _TIMING
-				, sa_mapping_batch_t *mapping_batch
-                                #endif
 				) {
 
-  #ifdef _TIMING
-  struct timeval stop, start;
-  #endif
+  uint64_t start;
 
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(start);
 
   size_t r_start_suf, r_end_suf, g_start_suf, g_end_suf;
   size_t r_start, r_end, r_len, g_start, g_end, g_len;
@@ -956,16 +943,10 @@ int generate_cals_from_suffixes(int strand, fastq_read_t *read,
   char *g_seq, *r_seq;
   r_seq = (strand ? read->revcomp : read->sequence);
   
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  mapping_batch->func_times[FUNC_INIT_CALS_FROM_SUFFIXES] += 
-    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_INIT_CALS_FROM_SUFFIXES, start);
 
   for (size_t suff = low; suff <= high; suff++) {
-    #ifdef _TIMING
-    gettimeofday(&start, NULL);
-    #endif
+    PROFILE_START(start);
     chrom = (unsigned int) sa_index->CHROM[suff];
 
     // extend suffix to right side
@@ -975,23 +956,13 @@ int generate_cals_from_suffixes(int strand, fastq_read_t *read,
     g_start_suf = sa_index->SA[suff] - sa_index->genome->chrom_offsets[chrom];
     g_end_suf = g_start_suf + suffix_len - 1;
 
-    #ifdef _TIMING
-    gettimeofday(&stop, NULL);
-    mapping_batch->func_times[FUNC_SET_POSITIONS] += 
-      ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-    #endif
+    PROFILE_STOP(FUNC_SET_POSITIONS, start);
 
     // skip suffixes, 
     // if found cal for this suffix, then next suffix
-    #ifdef _TIMING
-    gettimeofday(&start, NULL);
-    #endif
+    PROFILE_START(start);
     found_cal = cal_mng_find(strand, chrom, g_start_suf, g_end_suf, cal_mng);
-    #ifdef _TIMING
-    gettimeofday(&stop, NULL);
-    mapping_batch->func_times[FUNC_SKIP_SUFFIXES] += 
-      ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-    #endif
+    PROFILE_STOP(FUNC_SKIP_SUFFIXES, start);
     if (found_cal) continue;
 
 
@@ -1013,27 +984,15 @@ int generate_cals_from_suffixes(int strand, fastq_read_t *read,
       g_end = g_start_suf - 1;
       g_start = g_end - g_len;
 
-      #ifdef _TIMING
-      gettimeofday(&start, NULL);
-      #endif
+      PROFILE_START(start);
       g_seq = &sa_index->genome->S[g_start + sa_index->genome->chrom_offsets[chrom] + 1];
-      #ifdef _TIMING
-      gettimeofday(&stop, NULL);
-      mapping_batch->func_times[FUNC_SET_REF_SEQUENCE] += 
-	((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-      #endif
+      PROFILE_STOP(FUNC_SET_REF_SEQUENCE, start);
 
-      #ifdef _TIMING
-      gettimeofday(&start, NULL);
-      #endif
+      PROFILE_START(start);
       score = doscadfun_inv(r_seq, r_len, g_seq, g_len, MISMATCH_PERC,
 			    &alig_out);
 			    
-      #ifdef _TIMING
-      gettimeofday(&stop, NULL);
-      mapping_batch->func_times[FUNC_MINI_SW_LEFT_SIDE] += 
-	((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-      #endif
+      PROFILE_STOP(FUNC_MINI_SW_LEFT_SIDE, start);
       if (score > 0.0f) {
 	// update seed
 	seed->num_mismatches += alig_out.mismatch;
@@ -1046,9 +1005,7 @@ int generate_cals_from_suffixes(int strand, fastq_read_t *read,
 
       // if there's a mini-gap then try to fill the mini-gap
       if (seed->read_start > 0 && seed->read_start < 5) {
-        #ifdef _TIMING
-	gettimeofday(&start, NULL);
-        #endif
+	PROFILE_START(start);
 	g_seq = &sa_index->genome->S[seed->genome_start + sa_index->genome->chrom_offsets[chrom] - seed->read_start];
 	for (size_t k1 = 0, k2 = 0; k1 < seed->read_start; k1++, k2++) {
 	  if (r_seq[k1] != g_seq[k2]) {
@@ -1061,11 +1018,7 @@ int generate_cals_from_suffixes(int strand, fastq_read_t *read,
 	  
 	seed->genome_start -= seed->read_start;
 	seed->read_start = 0;
-        #ifdef _TIMING
-	gettimeofday(&stop, NULL);
-	mapping_batch->func_times[FUNC_SEED_NEW] += 
-	  ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-        #endif
+	PROFILE_STOP(FUNC_SEED_NEW, start);
       }
 
       // update cigar with the sw output
@@ -1087,26 +1040,14 @@ int generate_cals_from_suffixes(int strand, fastq_read_t *read,
       g_start = g_end_suf + 1;
       g_end = g_start + g_len;
 
-      #ifdef _TIMING
-      gettimeofday(&start, NULL);
-      #endif
+      PROFILE_START(start);
       g_seq = &sa_index->genome->S[g_start + sa_index->genome->chrom_offsets[chrom]];
-      #ifdef _TIMING
-      gettimeofday(&stop, NULL);
-      mapping_batch->func_times[FUNC_SET_REF_SEQUENCE] += 
-	((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-      #endif
+      PROFILE_STOP(FUNC_SET_REF_SEQUENCE, start);
 
-      #ifdef _TIMING
-      gettimeofday(&start, NULL);
-      #endif
+      PROFILE_START(start);
       score = doscadfun(&r_seq[r_start], r_len, g_seq, g_len, MISMATCH_PERC,
 			&alig_out);
-      #ifdef _TIMING
-      gettimeofday(&stop, NULL);
-      mapping_batch->func_times[FUNC_MINI_SW_RIGHT_SIDE] += 
-	((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-      #endif
+      PROFILE_STOP(FUNC_MINI_SW_RIGHT_SIDE, start);
       if (score > 0.0f) {
 	// update seed
 	seed->num_mismatches += alig_out.mismatch;
@@ -1125,9 +1066,7 @@ int generate_cals_from_suffixes(int strand, fastq_read_t *read,
       // if there's a mini-gap then try to fill the mini-gap
       diff = read->length - seed->read_end - 1;
       if (diff > 0 && diff < 5) {
-        #ifdef _TIMING
-	gettimeofday(&start, NULL);
-        #endif
+	PROFILE_START(start);
 	g_seq = &sa_index->genome->S[seed->genome_end + sa_index->genome->chrom_offsets[chrom] + 1];
 	for (size_t k1 = seed->read_end + 1, k2 = 0; k1 < read->length; k1++, k2++) {
 	  if (r_seq[k1] != g_seq[k2]) {
@@ -1140,11 +1079,7 @@ int generate_cals_from_suffixes(int strand, fastq_read_t *read,
 	
 	seed->read_end += diff;
 	seed->genome_end += diff;
-        #ifdef _TIMING
-	gettimeofday(&stop, NULL);
-	mapping_batch->func_times[FUNC_SEED_NEW] += 
-	  ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-          #endif
+	PROFILE_STOP(FUNC_SEED_NEW, start);
       }
     }
 
@@ -1152,17 +1087,11 @@ int generate_cals_from_suffixes(int strand, fastq_read_t *read,
     if (seed->read_end - seed->read_start + 1 > 20) {
       seed->strand = strand;
       seed->chromosome_id = chrom;
-      #ifdef _TIMING
-      gettimeofday(&start, NULL);
-      #endif
+      PROFILE_START(start);
 
       cal_mng_update(seed, read, cal_mng);
 
-      #ifdef _TIMING
-      gettimeofday(&stop, NULL);
-      mapping_batch->func_times[FUNC_CAL_MNG_INSERT] += 
-	((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-      #endif
+      PROFILE_STOP(FUNC_CAL_MNG_INSERT, start);
     } else {
       // free seed
       seed_free(seed);
@@ -1183,9 +1112,7 @@ array_list_t *create_cals(int num_seeds, fastq_read_t *read,
 			  sa_mapping_batch_t *mapping_batch, 
 			  sa_index3_t *sa_index, cal_mng_t *cal_mng) {
 
-  #ifdef _TIMING
-  struct timeval stop, start;
-  #endif
+  uint64_t start;
 
 
   size_t suffix_len, num_suffixes;
@@ -1193,9 +1120,7 @@ array_list_t *create_cals(int num_seeds, fastq_read_t *read,
 
   size_t low, high;
 
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(start);
 
   array_list_t *cal_list = array_list_new(1000, 1.25f, COLLECTION_MODE_ASYNCHRONIZED);
   cal_mng->min_read_area = read->length;
@@ -1218,11 +1143,7 @@ array_list_t *create_cals(int num_seeds, fastq_read_t *read,
   display_cmp_sequences(read, sa_index);
   #endif
 
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  mapping_batch->func_times[FUNC_OTHER] += 
-    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_OTHER, start);
 
   // first step, searching mappings in both strands
   // distance between seeds >= prefix value (sa_index->k_value)
@@ -1237,24 +1158,12 @@ array_list_t *create_cals(int num_seeds, fastq_read_t *read,
       printf("\tread pos. = %lu\n", read_pos);
       #endif
 
-      #ifdef _TIMING
-      gettimeofday(&start, NULL);
-      #endif
+      PROFILE_START(start);
       num_suffixes = search_suffix(&r_seq[read_pos], sa_index->k_value, 
 				   MAX_NUM_SUFFIXES, sa_index, 
 				   &low, &high, &suffix_len
-                                   #ifdef _TIMING
-				   , &prefix_time, &suffix_time
-                                   #endif
 				   );
-      #ifdef _TIMING
-      gettimeofday(&stop, NULL);
-      mapping_batch->func_times[FUNC_SEARCH_SUFFIX] += 
-	((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-
-      mapping_batch->func_times[FUNC_SEARCH_PREFIX] += prefix_time;
-      mapping_batch->func_times[FUNC_SEARCH_SA] +=  suffix_time;
-      #endif
+      PROFILE_STOP(FUNC_SEARCH_SUFFIX, start);
       
       #ifdef _VERBOSE	  
       printf("\t\tnum. suffixes = %lu (suffix length = %lu)\n", num_suffixes, suffix_len);
@@ -1267,32 +1176,17 @@ array_list_t *create_cals(int num_seeds, fastq_read_t *read,
 	
 	// exact search
 	if (suffix_len == read->length) {
-          #ifdef _TIMING
-	  gettimeofday(&start, NULL);
-          #endif
+	  PROFILE_START(start);
 	  generate_cals_from_exact_read(strand, read, low, high, 
 					sa_index, cal_mng);
-          #ifdef _TIMING
-	  gettimeofday(&stop, NULL);
-	  mapping_batch->func_times[FUNC_CALS_FROM_EXACT_READ] += 
-	    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-          #endif
+	  PROFILE_STOP(FUNC_CALS_FROM_EXACT_READ, start);
 	  break;
 	} else {
-          #ifdef _TIMING
-	  gettimeofday(&start, NULL);
-          #endif
+	  PROFILE_START(start);
 	  generate_cals_from_suffixes(strand, read,
 				      read_pos, suffix_len, low, high, sa_index, cal_mng
-                                      #ifdef _TIMING
-				      , mapping_batch
-                                      #endif
 				      );
-          #ifdef _TIMING
-	  gettimeofday(&stop, NULL);
-	  mapping_batch->func_times[FUNC_CALS_FROM_SUFFIXES] += 
-	    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-          #endif
+	  PROFILE_STOP(FUNC_CALS_FROM_SUFFIXES, start);
 	}
       }
       read_pos += read_inc;
@@ -1304,24 +1198,12 @@ array_list_t *create_cals(int num_seeds, fastq_read_t *read,
       printf("\tread pos. = %lu\n", read_pos);
       #endif
 
-      #ifdef _TIMING
-      gettimeofday(&start, NULL);
-      #endif
+      PROFILE_START(start);
       num_suffixes = search_suffix(&r_seq[read_pos], sa_index->k_value, 
 				   MAX_NUM_SUFFIXES, sa_index, 
 				   &low, &high, &suffix_len
-                                   #ifdef _TIMING
-				   , &prefix_time, &suffix_time
-                                   #endif
 				   );
-      #ifdef _TIMING
-      gettimeofday(&stop, NULL);
-      mapping_batch->func_times[FUNC_SEARCH_SUFFIX] += 
-	((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-
-      mapping_batch->func_times[FUNC_SEARCH_PREFIX] += prefix_time;
-      mapping_batch->func_times[FUNC_SEARCH_SA] +=  suffix_time;
-      #endif
+      PROFILE_STOP(FUNC_SEARCH_SUFFIX, start);
       
       #ifdef _VERBOSE	  
       printf("\t\tnum. suffixes = %lu (suffix length = %lu)\n", num_suffixes, suffix_len);
@@ -1331,34 +1213,19 @@ array_list_t *create_cals(int num_seeds, fastq_read_t *read,
 	display_suffix_mappings(strand, read_pos, suffix_len, low, high, sa_index);
         #endif 
 	
-        #ifdef _TIMING
-	gettimeofday(&start, NULL);
-        #endif
+	PROFILE_START(start);
 	read_pos += generate_cals_from_suffixes(strand, read,
 						read_pos, suffix_len, low, high, sa_index, cal_mng
-                                                #ifdef _TIMING
-						, mapping_batch
-                                                #endif
 						);
-        #ifdef _TIMING
-	gettimeofday(&stop, NULL);
-	mapping_batch->func_times[FUNC_CALS_FROM_SUFFIXES] += 
-	  ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-        #endif
+	PROFILE_STOP(FUNC_CALS_FROM_SUFFIXES, start);
       }
     }
 
     // update cal list from cal manager
-    #ifdef _TIMING
-    gettimeofday(&start, NULL);
-    #endif
+    PROFILE_START(start);
 
     cal_mng_to_array_list(read->length / 3, cal_list, cal_mng);
-    #ifdef _TIMING
-    gettimeofday(&stop, NULL);
-    mapping_batch->func_times[FUNC_CAL_MNG_TO_LIST] += 
-      ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-    #endif
+    PROFILE_STOP(FUNC_CAL_MNG_TO_LIST, start);
     
     // next, - strand
     r_seq = read->revcomp;
@@ -1680,13 +1547,9 @@ int prepare_sw(fastq_read_t *read,   array_list_t *sw_prepare_list,
   printf("\n\n====>>>> STEP THREE : prepare_sw <<<<====\n");
   #endif
 
-  #ifdef _TIMING
-  struct timeval stop, start;
-  #endif
+  uint64_t profile_start;
 
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(profile_start);
 
   char *seq, *ref;
   seed_t *prev_seed, *seed;
@@ -1927,6 +1790,8 @@ int prepare_sw(fastq_read_t *read,   array_list_t *sw_prepare_list,
     num_total_sw += num_sw;
   }
   
+  PROFILE_STOP(FUNC_PRE_SW, profile_start);
+
   return num_total_sw;
 }
 
@@ -1934,9 +1799,9 @@ int prepare_sw(fastq_read_t *read,   array_list_t *sw_prepare_list,
 
 void execute_sw(array_list_t *sw_prepare_list, sa_mapping_batch_t *mapping_batch) {
 
-  #ifdef _TIMING
-  struct timeval stop, start;
-  #endif
+  uint64_t start;
+
+  PROFILE_START(start);
 
   sw_prepare_t *sw_prepare;
 
@@ -1962,15 +1827,9 @@ void execute_sw(array_list_t *sw_prepare_list, sa_mapping_batch_t *mapping_batch
     #endif
   }
   
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  mapping_batch->func_times[FUNC_PRE_SW] += 
-    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_PRE_SW, start);
 
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(start);
 
   sw_multi_output_t *sw_output = sw_multi_output_new(sw_count);
   smith_waterman_mqmr(q, r, sw_count, &sw_optarg, 1, sw_output);
@@ -1978,15 +1837,9 @@ void execute_sw(array_list_t *sw_prepare_list, sa_mapping_batch_t *mapping_batch
   sw_multi_output_save(sw_count, sw_output, stdout);
   #endif
 
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  mapping_batch->func_times[FUNC_SW] += 
-    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_SW, start);
 
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(start);
 
   // process Smith-Waterman output
   seed_t *seed;
@@ -2120,11 +1973,7 @@ void execute_sw(array_list_t *sw_prepare_list, sa_mapping_batch_t *mapping_batch
   // free memory
   sw_multi_output_free(sw_output);
 
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  mapping_batch->func_times[FUNC_POST_SW] += 
-    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_POST_SW, start);
 }
 
 //--------------------------------------------------------------------
@@ -2132,13 +1981,9 @@ void execute_sw(array_list_t *sw_prepare_list, sa_mapping_batch_t *mapping_batch
 void post_process_sw(int sw_post_read_counter, int *sw_post_read,   
 		     array_list_t **cal_lists, sa_mapping_batch_t *mapping_batch) {
 
-  #ifdef _TIMING
-  struct timeval stop, start;
-  #endif
+  uint64_t start;
 
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(start);
 
   int num_cals, cigar_type;
   array_list_t *cal_list;
@@ -2216,11 +2061,7 @@ void post_process_sw(int sw_post_read_counter, int *sw_post_read,
     }
   }
 
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  mapping_batch->func_times[FUNC_POST_SW] += 
-    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_POST_SW, start);
 }
 
 //--------------------------------------------------------------------
@@ -2229,23 +2070,25 @@ void post_process_sw(int sw_post_read_counter, int *sw_post_read,
 
 int sa_single_mapper(void *data) {
 
-  #ifdef _TIMING
-  struct timeval stop, start;
-  #endif
+  uint64_t start;
 
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(start);
   
   sa_wf_batch_t *wf_batch = (sa_wf_batch_t *) data;
 
   int num_seeds = wf_batch->options->num_seeds;
 
   
+  // NUMA placement: pin the worker and first-touch the batch buffers
+  affinity_pin_thread();
+  TRACE_BEGIN("SA single mapper");
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_MAPPER);
+
   sa_mapping_batch_t *mapping_batch = wf_batch->mapping_batch;
   mapping_batch->options = wf_batch->options;
+  sa_mapping_batch_touch(mapping_batch);
 
-  sa_index3_t *sa_index = (sa_index3_t *) wf_batch->sa_index;
+  sa_index3_t *sa_index = sa_index3_local((sa_index3_t *) wf_batch->sa_index);
   
   int bam_format = mapping_batch->bam_format;
 
@@ -2274,11 +2117,7 @@ int sa_single_mapper(void *data) {
   fastq_read_t *read;
 
   cal_mng = cal_mng_new(sa_index->genome);
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  mapping_batch->func_times[FUNC_OTHER] += 
-    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_OTHER, start);
 
   // for each read, create cals and prepare sw
   for (int i = 0; i < num_reads; i++) {
@@ -2337,33 +2176,21 @@ int sa_single_mapper(void *data) {
     if (array_list_size(cal_list) > 0) {
 
       // filter by score
-      #ifdef _TIMING
-      gettimeofday(&start, NULL);
-      #endif
+      PROFILE_START(start);
       max_score = get_max_score(cal_list, match_score, mismatch_penalty,
 				gap_open_penalty, gap_extend_penalty);
       #ifdef _VERBOSE
       printf("\n******* after SW> max. score = %0.2f (read %s)\n", max_score, read->id);
       #endif
       filter_cals_by_max_score(max_score, &cal_list);
-      #ifdef _TIMING
-      gettimeofday(&stop, NULL);
-      mapping_batch->func_times[FUNC_FILTER_BY_NUM_MISMATCHES] += 
-	((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-      #endif
+      PROFILE_STOP(FUNC_FILTER_BY_NUM_MISMATCHES, start);
     }
     
     // if BAM format, create alignments structures
     if (bam_format) {
-      #ifdef _TIMING
-      gettimeofday(&start, NULL);
-      #endif
+      PROFILE_START(start);
       create_alignments(cal_list, read, bam_format, mapping_batch->mapping_lists[i]);
-      #ifdef _TIMING
-      gettimeofday(&stop, NULL);
-      mapping_batch->func_times[FUNC_CREATE_ALIGNMENTS] += 
-	((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-      #endif
+      PROFILE_STOP(FUNC_CREATE_ALIGNMENTS, start);
       
       // free cal list and clear seed manager for next read
       array_list_free(cal_list, (void *) NULL);
@@ -2376,16 +2203,13 @@ int sa_single_mapper(void *data) {
   } // end of for reads
   
   // free memory
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(start);
   cal_mng_free(cal_mng);
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  mapping_batch->func_times[FUNC_OTHER] += 
-    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_OTHER, start);
   
+  metrics_stage_end(METRICS_STAGE_MAPPER, metrics_start);
+  TRACE_END("SA single mapper");
+
   return -1;
 }
 
@@ -2393,13 +2217,9 @@ int sa_single_mapper(void *data) {
 
 int sa_pair_mapper(void *data) {
 
-  #ifdef _TIMING
-  struct timeval stop, start;
-  #endif
+  uint64_t start;
 
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(start);
   
   sa_wf_batch_t *wf_batch = (sa_wf_batch_t *) data;
 
@@ -2409,8 +2229,14 @@ int sa_pair_mapper(void *data) {
 
   int num_seeds = wf_batch->options->num_seeds;
   
+  // NUMA placement: pin the worker and first-touch the batch buffers
+  affinity_pin_thread();
+  TRACE_BEGIN("SA pair mapper");
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_MAPPER);
+
   sa_mapping_batch_t *mapping_batch = wf_batch->mapping_batch;
   mapping_batch->options = wf_batch->options;
+  sa_mapping_batch_touch(mapping_batch);
   if (pair_min_distance > 0 && pair_max_distance > 0) {
     infer_insert = 0;
     mapping_batch->pair_min_distance = pair_min_distance; 
@@ -2419,7 +2245,7 @@ int sa_pair_mapper(void *data) {
     infer_insert = 1;
   }
 
-  sa_index3_t *sa_index = (sa_index3_t *) wf_batch->sa_index;
+  sa_index3_t *sa_index = sa_index3_local((sa_index3_t *) wf_batch->sa_index);
   
   int bam_format = mapping_batch->bam_format;
 
@@ -2438,11 +2264,7 @@ int sa_pair_mapper(void *data) {
   fastq_read_t *read;
 
   cal_mng = cal_mng_new(sa_index->genome);
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  mapping_batch->func_times[FUNC_OTHER] += 
-    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_OTHER, start);
 
   // for each read, create cals and prepare sw
   for (int i = 0; i < num_reads; i++) {
@@ -2493,6 +2315,7 @@ int sa_pair_mapper(void *data) {
 
 
   // 2) filter cals by pairs
+  PROFILE_START(start);
   if (infer_insert) {
     infer_insert_size(&pair_min_distance, &pair_max_distance, 
 		      num_reads, cal_lists);
@@ -2503,6 +2326,7 @@ int sa_pair_mapper(void *data) {
     			   num_reads, cal_lists);
   
   check_pairs(cal_lists, sa_index, mapping_batch, cal_mng);
+  PROFILE_STOP(FUNC_PAIRING, start);
 
   // 3) prepare Smith-Waterman to fill in the gaps
   for (int i = 0; i < num_reads; i++) {
@@ -2530,33 +2354,26 @@ int sa_pair_mapper(void *data) {
     read = array_list_get(i, mapping_batch->fq_reads);
 
     // create alignments structures
-    #ifdef _TIMING
-    gettimeofday(&start, NULL);
-    #endif
+    PROFILE_START(start);
     create_alignments(cal_list, read, bam_format, mapping_batch->mapping_lists[i]);
-    #ifdef _TIMING
-    gettimeofday(&stop, NULL);
-    mapping_batch->func_times[FUNC_CREATE_ALIGNMENTS] += 
-      ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-    #endif
+    PROFILE_STOP(FUNC_CREATE_ALIGNMENTS, start);
       
     // free cal list and clear seed manager for next read
     array_list_free(cal_list, (void *) NULL);
   } // end of for reads
   
+  PROFILE_START(start);
   complete_pairs(mapping_batch);
+  PROFILE_STOP(FUNC_PAIRING, start);
 
   // free memory
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(start);
   cal_mng_free(cal_mng);
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  mapping_batch->func_times[FUNC_OTHER] += 
-    ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_OTHER, start);
   
+  metrics_stage_end(METRICS_STAGE_MAPPER, metrics_start);
+  TRACE_END("SA pair mapper");
+
   return -1;
 }
 
@@ -468,9 +468,6 @@ void suffix_mng_search_read_cals(fastq_read_t *read, int num_seeds,
       num_suffixes = search_suffix(&r_seq[read_pos], sa_index->k_value, 
 				   max_suffixes, sa_index, 
 				   &low, &high, &suffix_len
-                                   #ifdef _TIMING
-				   , &prefix_time, &suffix_time
-                                   #endif
 				   );
       if (num_suffixes < max_suffixes && suffix_len) {
 	for (size_t suff = low; suff <= high; suff++) {
@@ -492,9 +489,6 @@ void suffix_mng_search_read_cals(fastq_read_t *read, int num_seeds,
       num_suffixes = search_suffix(&r_seq[read_pos], sa_index->k_value, 
 				   max_suffixes, sa_index, 
 				   &low, &high, &suffix_len
-                                   #ifdef _TIMING
-				   , &prefix_time, &suffix_time
-                                   #endif
 				   );
       if (num_suffixes < max_suffixes && suffix_len) {
 	for (size_t suff = low; suff <= high; suff++) {
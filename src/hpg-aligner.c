@@ -1,8 +1,13 @@
 #include "dna/dna_aligner.h"
 #include "rna/rna_aligner.h"
+#include "dna/dna_server.h"
 
 #include "build-index/index_builder.h"
 
+#include "benchmark.h"
+
+#include "tools/bam/aux/aux_simd.h"
+
 
 //--------------------------------------------------------------------
 // constants
@@ -28,9 +33,6 @@ pthread_mutex_t mutex_sp;
 FILE *fd_log;
 size_t junction_id;
 
-size_t total_reads = 0;
-size_t reads_no_map = 0;
-
 size_t total_sw = 0;
 
 unsigned char mute;
@@ -69,9 +71,6 @@ int redirect_stdout = 0;
 int gziped_fileds = 0;
 
 st_bwt_t st_bwt;
-int w1_end;
-int w2_end;
-int w3_end;
 
 size_t total_reads_w2, total_reads_w3;
 size_t reads_w2, reads_w3;
@@ -80,6 +79,10 @@ size_t reads_w2, reads_w3;
 // main parameters support
 //--------------------------------------------------------------------
 
+// the benchmark binary (scons bench) links the globals above with its
+// own main
+#ifndef HPG_ALIGNER_NO_MAIN
+
 int main(int argc, char* argv[]) {
   redirect_stdout = 0;
   gziped_fileds = 0;
@@ -112,8 +115,12 @@ int main(int argc, char* argv[]) {
   log_verbose = 1;
   log_file = NULL;
 
+  // select the vectorised kernels for this CPU
+  // (HPG_SIMD_ISA=scalar|sse2|avx2|avx512 forces one)
+  simd_init();
+
   if (argc <= 1) {
-    LOG_FATAL("Missing command.\nValid commands are:\n\tdna: to map DNA sequences\n\trna: to map RNA sequences\n\tbuild-sa-index: to create the genome SA index (suffix array).\n\tbuild-bwt-index: to create the genome BWT index.\nUse -h or --help to display hpg-aligner options.\nUse -v or --version to display hpg-aligner version.\n");
+    LOG_FATAL("Missing command.\nValid commands are:\n\tdna: to map DNA sequences\n\trna: to map RNA sequences\n\tbuild-sa-index: to create the genome SA index (suffix array).\n\tbuild-bwt-index: to create the genome BWT index.\n\tindex-load: to load the genome SA index in shared memory.\n\tindex-unload: to remove the genome SA index from shared memory.\n\tserve: to map DNA jobs received on a Unix socket, with the index loaded once.\n\tbench: to run the end-to-end benchmark on simulated reads.\nUse -h or --help to display hpg-aligner options.\nUse -v or --version to display hpg-aligner version.\n");
   }
 
   if (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
@@ -127,16 +134,20 @@ int main(int argc, char* argv[]) {
 
   char *command = argv[1];  
 
-  // We need to consume command: {dna | rna | bs | build-index}
+  // We need to consume command: {dna | rna | bs | serve | build-index | index-load | index-unload | bench}
   argc -= 1;
   argv += 1;
   
   if(strcmp(command, "dna") != 0 && 
      strcmp(command, "rna") != 0 &&
+     strcmp(command, "serve") != 0 &&
      strcmp(command, "bs" ) != 0 && 
      strcmp(command, "build-sa-index") != 0 &&
-     strcmp(command, "build-bwt-index") != 0) {
-    LOG_FATAL("Command unknown.\nValid commands are:\n\tdna: to map DNA sequences\n\trna: to map RNA sequences\n\tbs: to map BS sequences\n\tbuild-sa-index: to create the genome sa index.\n\tbuild-bwt-index: to create the genome bwt index.\nUse -h or --help to display hpg-aligner options.\n");
+     strcmp(command, "build-bwt-index") != 0 &&
+     strcmp(command, "index-load") != 0 &&
+     strcmp(command, "index-unload") != 0 &&
+     strcmp(command, "bench") != 0) {
+    LOG_FATAL("Command unknown.\nValid commands are:\n\tdna: to map DNA sequences\n\trna: to map RNA sequences\n\tbs: to map BS sequences\n\tbuild-sa-index: to create the genome sa index.\n\tbuild-bwt-index: to create the genome bwt index.\n\tindex-load: to load the genome SA index in shared memory.\n\tindex-unload: to remove the genome SA index from shared memory.\n\tserve: to map DNA jobs received on a Unix socket, with the index loaded once.\n\tbench: to run the end-to-end benchmark on simulated reads.\nUse -h or --help to display hpg-aligner options.\n");
 
   }
 
@@ -145,6 +156,20 @@ int main(int argc, char* argv[]) {
       run_index_builder(argc, argv, command);
   }
 
+  if (!strcmp(command, "index-load") ||
+      !strcmp(command, "index-unload")) {
+    run_index_shm(argc, argv, command);
+  }
+
+  if (!strcmp(command, "bench")) {
+    run_benchmark(argc, argv);
+  }
+
+  // the server maps DNA jobs, same options as the dna command
+  if (!strcmp(command, "serve")) {
+    argv[0] = "dna";
+  }
+
   // parsing options
   options_t *options = parse_options(argc, argv);
 
@@ -186,6 +211,11 @@ int main(int argc, char* argv[]) {
     // DNA command
     validate_options(options);
     dna_aligner(options);
+  } else if (strcmp(command, "serve") == 0) {
+    // DNA mapping server
+    options->serve = 1;
+    validate_options(options);
+    dna_server(options);
   } else if (strcmp(command, "rna") == 0)  { 
     // RNA command
     validate_options(options);
@@ -196,3 +226,5 @@ int main(int argc, char* argv[]) {
   return 0;
 
 }
+
+#endif // HPG_ALIGNER_NO_MAIN
@@ -0,0 +1,369 @@
+#include "metrics.h"
+#include "counters.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define METRICS_SOCKET_PREFIX   "unix:"
+#define METRICS_SNAPSHOT_SIZE   4096
+#define METRICS_PROGRESS_WIDTH  65
+
+//--------------------------------------------------------------------
+
+metrics_counters_t metrics_counters;
+
+static char *stage_names[NUM_METRICS_STAGES] = { "reader", "mapper", "writer" };
+
+typedef struct metrics_progress {
+  char *phase;
+  volatile size_t *done;
+  volatile size_t *total;
+  int display;
+  uint64_t start;
+} metrics_progress_t;
+
+typedef struct metrics_state {
+  char *filename;
+  char *socket_path;
+  int socket_fd;
+  int wake_fd[2];
+
+  pthread_t thread;
+  int running;
+  pthread_mutex_t mutex;
+
+  uint64_t start;
+  uint64_t last;
+  metrics_counters_t previous;
+
+  metrics_progress_t progress;
+  char snapshot[METRICS_SNAPSHOT_SIZE];
+} metrics_state_t;
+
+static metrics_state_t *state = NULL;
+
+//--------------------------------------------------------------------
+
+static size_t metrics_rss() {
+  size_t size = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f) {
+    if (fscanf(f, "%lu %lu", &size, &resident) != 2) {
+      resident = 0;
+    }
+    fclose(f);
+  }
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+//--------------------------------------------------------------------
+
+static double latency_percentile(uint64_t *hist, uint64_t count, double p) {
+  if (!count) return 0.0;
+
+  uint64_t target = (uint64_t) (p * count), acc = 0;
+  for (int i = 0; i < METRICS_LATENCY_BUCKETS; i++) {
+    acc += hist[i];
+    if (acc > target) {
+      // bucket upper bound, in milliseconds
+      return (1LLU << i) / 1000.0;
+    }
+  }
+  return (1LLU << (METRICS_LATENCY_BUCKETS - 1)) / 1000.0;
+}
+
+//--------------------------------------------------------------------
+
+static void metrics_snapshot(int finished) {
+  metrics_counters_t now;
+  memcpy(&now, (void *) &metrics_counters, sizeof(metrics_counters_t));
+
+  uint64_t t = metrics_now();
+  double interval = (t - state->last) / 1000000000.0;
+  double elapsed = (t - state->start) / 1000000000.0;
+  if (interval <= 0) interval = 1.0;
+
+  metrics_counters_t *prev = &state->previous;
+
+  uint64_t hist[METRICS_LATENCY_BUCKETS], count = 0;
+  for (int i = 0; i < METRICS_LATENCY_BUCKETS; i++) {
+    hist[i] = now.latency[i] - prev->latency[i];
+    count += hist[i];
+  }
+
+  double progress = 0.0;
+  if (state->progress.done && state->progress.total && *state->progress.total > 0) {
+    progress = (double) *state->progress.done / *state->progress.total;
+    if (progress > 1.0) progress = 1.0;
+  }
+
+  char *p = state->snapshot;
+  char *end = state->snapshot + METRICS_SNAPSHOT_SIZE;
+
+  p += snprintf(p, end - p, "{\"elapsed\": %0.3f, \"finished\": %s, \"phase\": \"%s\", \"progress\": %0.4f, ",
+		elapsed, (finished ? "true" : "false"),
+		(state->progress.phase ? state->progress.phase : ""), progress);
+  p += snprintf(p, end - p, "\"reads\": %lu, \"bases\": %lu, \"reads_per_second\": %0.1f, \"bases_per_second\": %0.1f, ",
+		now.reads, now.bases,
+		(now.reads - prev->reads) / interval, (now.bases - prev->bases) / interval);
+  // mapping statistics, reduced from the per-thread counters
+  uint64_t counters[NUM_COUNTER_IDS];
+  counters_reduce(counters);
+  p += snprintf(p, end - p, "\"counters\": {");
+  for (int i = 0; i < NUM_COUNTER_IDS; i++) {
+    p += snprintf(p, end - p, "%s\"%s\": %lu", (i ? ", " : ""), counter_name(i), counters[i]);
+  }
+  p += snprintf(p, end - p, "}, ");
+
+  p += snprintf(p, end - p, "\"rss_bytes\": %lu, \"stages\": [", metrics_rss());
+
+  for (int s = 0; s < NUM_METRICS_STAGES; s++) {
+    metrics_stage_t *curr = &now.stages[s], *last = &prev->stages[s];
+    // batches waiting between the previous stage and this one
+    int64_t queue = (s == 0 ? 0 : (int64_t) now.stages[s - 1].batches_out - (int64_t) curr->batches_in);
+    p += snprintf(p, end - p, "%s{\"name\": \"%s\", \"batches\": %lu, \"batches_per_second\": %0.2f, "
+		  "\"busy_threads\": %0.2f, \"queue_depth\": %li}",
+		  (s ? ", " : ""), stage_names[s], curr->batches_out,
+		  (curr->batches_out - last->batches_out) / interval,
+		  (curr->busy_ns - last->busy_ns) / (interval * 1000000000.0),
+		  (queue > 0 ? queue : 0));
+  }
+
+  snprintf(p, end - p, "], \"batch_latency_ms\": {\"count\": %lu, \"p50\": %0.3f, \"p90\": %0.3f, \"p99\": %0.3f}}\n",
+	   count, latency_percentile(hist, count, 0.50), latency_percentile(hist, count, 0.90),
+	   latency_percentile(hist, count, 0.99));
+
+  memcpy(prev, &now, sizeof(metrics_counters_t));
+  state->last = t;
+}
+
+//--------------------------------------------------------------------
+
+static void metrics_write_file() {
+  char tmp_filename[strlen(state->filename) + 10];
+  sprintf(tmp_filename, "%s.tmp", state->filename);
+
+  FILE *f = fopen(tmp_filename, "w");
+  if (!f) return;
+  fputs(state->snapshot, f);
+  fclose(f);
+
+  // scrapers never see a partial snapshot
+  rename(tmp_filename, state->filename);
+}
+
+//--------------------------------------------------------------------
+
+static void metrics_serve_clients() {
+  int fd;
+  while ((fd = accept(state->socket_fd, NULL, NULL)) >= 0) {
+    size_t len = strlen(state->snapshot), written = 0;
+    while (written < len) {
+      ssize_t n = write(fd, state->snapshot + written, len - written);
+      if (n <= 0) break;
+      written += n;
+    }
+    close(fd);
+  }
+}
+
+//--------------------------------------------------------------------
+
+static void metrics_display_progress(int finished) {
+  metrics_progress_t *p = &state->progress;
+  if (!p->phase || !p->display) return;
+
+  if (finished) {
+    printf("[");
+    for (int x = 0; x < METRICS_PROGRESS_WIDTH; x++) printf("|");
+    printf("]  100%%\n\n\033[F");
+    fflush(stdout);
+    return;
+  }
+
+  size_t done = *p->done, total = *p->total;
+  float progress = (total > 0 ? (done * 100.0f) / total : 0.0f);
+  if (progress > 100.0f) progress = 100.0f;
+
+  int c = (METRICS_PROGRESS_WIDTH * progress) / 100;
+  printf("[");
+  for (int x = 0; x < c; x++) printf("|");
+  for (int x = c; x < METRICS_PROGRESS_WIDTH; x++) printf(" ");
+
+  size_t estimated = 0;
+  if (done > 0 && total > done) {
+    estimated = ((total - done) * ((metrics_now() - p->start) / 1000000000.0)) / done;
+  }
+
+  printf("]  %.1f%% | %02lu:%02lu:%02lu ETA", progress,
+	 estimated / 3600, (estimated / 60) % 60, estimated % 60);
+  printf("\n\033[F\033[J");
+  fflush(stdout);
+}
+
+//--------------------------------------------------------------------
+
+static void *metrics_thread(void *arg) {
+  struct pollfd fds[2];
+  int num_fds = 1;
+
+  fds[0].fd = state->wake_fd[0];
+  fds[0].events = POLLIN;
+  if (state->socket_fd >= 0) {
+    fds[1].fd = state->socket_fd;
+    fds[1].events = POLLIN;
+    num_fds = 2;
+  }
+
+  uint64_t next = metrics_now() + METRICS_INTERVAL * 1000000000LLU;
+
+  while (1) {
+    uint64_t t = metrics_now();
+    int timeout = (next > t ? (next - t) / 1000000 : 0);
+
+    if (poll(fds, num_fds, timeout) > 0) {
+      if (fds[0].revents) break;
+      if (num_fds > 1 && fds[1].revents) {
+	pthread_mutex_lock(&state->mutex);
+	metrics_serve_clients();
+	pthread_mutex_unlock(&state->mutex);
+      }
+      continue;
+    }
+
+    pthread_mutex_lock(&state->mutex);
+    metrics_snapshot(0);
+    if (state->filename) metrics_write_file();
+    metrics_display_progress(0);
+    pthread_mutex_unlock(&state->mutex);
+
+    next += METRICS_INTERVAL * 1000000000LLU;
+  }
+
+  return NULL;
+}
+
+//--------------------------------------------------------------------
+
+static int metrics_socket_new(char *path) {
+  struct sockaddr_un addr;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    printf("Error: metrics socket path too long: %s\n", path);
+    exit(-1);
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    printf("Error: could not create the metrics socket %s\n", path);
+    exit(-1);
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  unlink(path);
+
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, 16)) {
+    printf("Error: could not listen on the metrics socket %s (%s)\n", path, strerror(errno));
+    exit(-1);
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  return fd;
+}
+
+//--------------------------------------------------------------------
+
+void metrics_init(char *target) {
+  if (state) {
+    metrics_free();
+  }
+
+  memset((void *) &metrics_counters, 0, sizeof(metrics_counters_t));
+
+  state = (metrics_state_t *) calloc(1, sizeof(metrics_state_t));
+  state->socket_fd = -1;
+  state->start = state->last = metrics_now();
+  pthread_mutex_init(&state->mutex, NULL);
+
+  if (target) {
+    if (!strncmp(target, METRICS_SOCKET_PREFIX, strlen(METRICS_SOCKET_PREFIX))) {
+      state->socket_path = strdup(target + strlen(METRICS_SOCKET_PREFIX));
+      state->socket_fd = metrics_socket_new(state->socket_path);
+    } else {
+      state->filename = strdup(target);
+    }
+  }
+
+  if (pipe(state->wake_fd)) {
+    printf("Error: could not start the metrics thread\n");
+    exit(-1);
+  }
+
+  metrics_snapshot(0);
+  state->running = !pthread_create(&state->thread, NULL, metrics_thread, NULL);
+}
+
+//--------------------------------------------------------------------
+
+void metrics_free() {
+  if (!state) return;
+
+  if (state->running) {
+    if (write(state->wake_fd[1], "x", 1) == 1) {
+      pthread_join(state->thread, NULL);
+    }
+  }
+
+  // final snapshot
+  metrics_snapshot(1);
+  if (state->filename) metrics_write_file();
+
+  close(state->wake_fd[0]);
+  close(state->wake_fd[1]);
+
+  if (state->socket_fd >= 0) {
+    close(state->socket_fd);
+    unlink(state->socket_path);
+  }
+  if (state->socket_path) free(state->socket_path);
+  if (state->filename) free(state->filename);
+
+  pthread_mutex_destroy(&state->mutex);
+  free(state);
+  state = NULL;
+}
+
+//--------------------------------------------------------------------
+
+void metrics_progress_begin(char *phase, volatile size_t *done, volatile size_t *total, int display) {
+  if (!state) return;
+
+  pthread_mutex_lock(&state->mutex);
+  state->progress.phase = phase;
+  state->progress.done = done;
+  state->progress.total = total;
+  state->progress.display = display;
+  state->progress.start = metrics_now();
+  metrics_display_progress(0);
+  pthread_mutex_unlock(&state->mutex);
+}
+
+//--------------------------------------------------------------------
+
+void metrics_progress_end() {
+  if (!state) return;
+
+  pthread_mutex_lock(&state->mutex);
+  metrics_display_progress(1);
+  state->progress.display = 0;
+  state->progress.done = NULL;
+  state->progress.total = NULL;
+  pthread_mutex_unlock(&state->mutex);
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
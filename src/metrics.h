@@ -0,0 +1,109 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+//--------------------------------------------------------------------
+// live throughput metrics (--metrics option)
+//
+// the pipeline stages update lock-free counters, a background thread
+// takes a snapshot every second and:
+//   - writes it as JSON to a file (replaced atomically), or
+//   - serves it to every client connecting to a Unix socket
+//     (target 'unix:<path>')
+// the same thread draws the progress bar on the terminal
+//--------------------------------------------------------------------
+
+#define METRICS_STAGE_READER  0
+#define METRICS_STAGE_MAPPER  1
+#define METRICS_STAGE_WRITER  2
+
+#define NUM_METRICS_STAGES (METRICS_STAGE_WRITER + 1)
+
+// batch latency histogram, bucket i counts latencies < 2^i microseconds
+#define METRICS_LATENCY_BUCKETS  40
+
+#define METRICS_INTERVAL  1 // seconds
+
+//--------------------------------------------------------------------
+// counters, one cache line per stage to avoid false sharing
+//--------------------------------------------------------------------
+
+typedef struct metrics_stage {
+  volatile uint64_t batches_in;
+  volatile uint64_t batches_out;
+  volatile uint64_t busy_ns;
+} __attribute__((aligned(64))) metrics_stage_t;
+
+typedef struct metrics_counters {
+  metrics_stage_t stages[NUM_METRICS_STAGES];
+  volatile uint64_t reads __attribute__((aligned(64)));
+  volatile uint64_t bases;
+  volatile uint64_t latency[METRICS_LATENCY_BUCKETS] __attribute__((aligned(64)));
+} metrics_counters_t;
+
+extern metrics_counters_t metrics_counters;
+
+//--------------------------------------------------------------------
+
+static inline uint64_t metrics_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000LLU + ts.tv_nsec;
+}
+
+//--------------------------------------------------------------------
+
+static inline uint64_t metrics_stage_begin(int stage) {
+  __sync_fetch_and_add(&metrics_counters.stages[stage].batches_in, 1);
+  return metrics_now();
+}
+
+//--------------------------------------------------------------------
+
+static inline void metrics_stage_end(int stage, uint64_t start) {
+  __sync_fetch_and_add(&metrics_counters.stages[stage].busy_ns, metrics_now() - start);
+  __sync_fetch_and_add(&metrics_counters.stages[stage].batches_out, 1);
+}
+
+//--------------------------------------------------------------------
+
+static inline void metrics_add_reads(uint64_t num_reads, uint64_t num_bases) {
+  __sync_fetch_and_add(&metrics_counters.reads, num_reads);
+  __sync_fetch_and_add(&metrics_counters.bases, num_bases);
+}
+
+//--------------------------------------------------------------------
+// time from the reader creating the batch to the writer flushing it
+
+static inline void metrics_batch_latency(uint64_t created) {
+  uint64_t us = (metrics_now() - created) / 1000;
+  int bucket = 0;
+  while (bucket < METRICS_LATENCY_BUCKETS - 1 && (1LLU << bucket) <= us) {
+    bucket++;
+  }
+  __sync_fetch_and_add(&metrics_counters.latency[bucket], 1);
+}
+
+//--------------------------------------------------------------------
+
+// target: NULL (progress bar only), a filename or 'unix:<path>'
+void metrics_init(char *target);
+void metrics_free();
+
+// progress bar for a workflow phase, done and total are polled by the
+// metrics thread (bytes or reads), display is 0 when stdout is not a
+// terminal
+void metrics_progress_begin(char *phase, volatile size_t *done, volatile size_t *total, int display);
+void metrics_progress_end();
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+#endif // METRICS_H
@@ -22,6 +22,7 @@ options_t *options_new(void) {
 
   options->realignment = 0;
   options->recalibration = 0;
+  options->recal_data_filename = NULL;
   options->adapter = NULL;
   options->input_format = FASTQ_FORMAT;
 
@@ -82,6 +83,17 @@ options_t *options_new(void) {
   options->adapter_length = 0;
   options->set_bam_format = 0;
   options->set_cal = 0;
+  options->numa_policy = NUMA_NONE;
+  options->profile = 0;
+  options->trace = 0;
+  options->metrics_target = NULL;
+  options->socket_path = NULL;
+  options->serve = 0;
+  options->serve_jobs = 1;
+  options->shard_index = 0;
+  options->shard_count = 0;
+  options->sort_memory = DEFAULT_SORT_MEMORY;
+  options->index_output = 0;
 
   //new variables for bisulphite case in index generation
   options->bs_index = 0;
@@ -142,7 +154,7 @@ void validate_options(options_t *options) {
       create_directory(options->output_name);
     }
     
-    if (!options->in_filename) {
+    if (!options->in_filename && !options->serve) {
       printf("Filename input is missing. Please, insert it with option '-f FILENAME'.\n");
       usage_cli(mode);
     }
@@ -152,6 +164,26 @@ void validate_options(options_t *options) {
       printf("Index directory is missing. Please, insert it with option '-i DIRNAME'.\n");
       usage_cli(mode);
     }
+
+    // every output file of a shard is tagged with the shard name
+    if (options->shard_count) {
+      char shard[SHARD_NAME_LENGTH];
+      shard_name(options->shard_index, options->shard_count, shard);
+      char *prefix = (char *) malloc(strlen(shard) + (options->prefix_name ? strlen(options->prefix_name) : 0) + 2);
+      if (options->prefix_name) {
+	sprintf(prefix, "%s_%s", options->prefix_name, shard);
+	free(options->prefix_name);
+      } else {
+	strcpy(prefix, shard);
+      }
+      options->prefix_name = prefix;
+    }
+  }
+
+  // the recalibration table is only applied by the dna aligner BAM writer
+  if (options->recal_data_filename && (mode != DNA_MODE || options->serve)) {
+    printf("Recalibration data file is only supported by the dna command, remove option '--recal-data'.\n");
+    usage_cli(mode);
   }
 
   if (!options->num_seeds) {
@@ -221,7 +253,10 @@ void options_free(options_t *options) {
      if (options->genome_filename) { free(options->genome_filename); }
      if (options->output_name)	{ free(options->output_name); }
      if (options->prefix_name) { free(options->prefix_name); }
+     if (options->metrics_target) { free(options->metrics_target); }
+     if (options->socket_path) { free(options->socket_path); }
      if (options->adapter) { free(options->adapter); }
+     if (options->recal_data_filename) { free(options->recal_data_filename); }
 
      if (options->mode == RNA_MODE) {
        if (options->transcriptome_filename) { free(options->transcriptome_filename); }
@@ -309,12 +344,22 @@ void options_display(options_t *options) {
      printf("\tOutput directory name: %s\n", output_name);
           
      printf("\tOutput file format: %s\n", 
-	    (options->bam_format || options->realignment || options->recalibration) ? "BAM" : "SAM");
+	    (options->bam_format || options->realignment || options->recalibration || options->index_output) ? "BAM" : "SAM");
+     if (options->index_output) {
+       printf("\tOutput sorted by coordinate and indexed\n");
+     }
      printf("\tAdapter: %s\n", (adapter ? adapter : "Not present"));
      printf("\n");
 
      printf("Architecture parameters\n");
      printf("\tNumber of cpu threads: %d\n",  num_cpu_threads);
+     printf("\tNUMA policy: %s\n",  NUMA_POLICY_STR(options->numa_policy));
+     if (options->shard_count) {
+       printf("\tShard: %i/%i\n", options->shard_index + 1, options->shard_count);
+     }
+     if (options->realignment || options->recalibration || options->index_output) {
+       printf("\tSort memory: %d MB\n", options->sort_memory);
+     }
      //printf("CAL seeker errors: %d\n",  cal_seeker_errors);
      printf("\tBatch size: %d bytes\n",  batch_size);
      //     printf("\tWrite size: %d bytes\n",  write_size);
@@ -367,7 +412,7 @@ void options_display(options_t *options) {
        printf("\tMin score        : %d\n", min_score);
      }
 
-     if (options->realignment || options->recalibration) {
+     if (options->realignment || options->recalibration || options->recal_data_filename) {
        printf("Post-processing\n");
        if (options->realignment) {
 	 printf("\tIndel realignment\n");
@@ -375,6 +420,9 @@ void options_display(options_t *options) {
        if (options->recalibration) {
 	 printf("\tRecalibration\n");
        }
+       if (options->recal_data_filename) {
+	 printf("\tRecalibration while writing, data file: %s\n", options->recal_data_filename);
+       }
      }
      printf("+===============================================================+\n");
      
@@ -459,7 +507,10 @@ void options_to_file(options_t *options, FILE *fd) {
   fprintf(fd, "= Output directory name: %s\n", output_name);
 
   fprintf(fd, "= Output file format: %s\n", 
-	 (options->bam_format || options->realignment || options->recalibration) ? "SAM" : "BAM");
+	 (options->bam_format || options->realignment || options->recalibration || options->index_output) ? "SAM" : "BAM");
+  if (options->index_output) {
+    fprintf(fd, "= Output sorted by coordinate and indexed\n");
+  }
   fprintf(fd, "= Adapter: %s\n", (adapter ? adapter : "Not present"));
   fprintf(fd, "\n\n");
 
@@ -467,6 +518,13 @@ void options_to_file(options_t *options, FILE *fd) {
   fprintf(fd, "=  A R C H I T E C T U R E    P A R A M E T E R S\n"); 
   fprintf(fd, "=-----------------------------------------------=\n");
   fprintf(fd, "= Number of cpu threads %d\n",  num_cpu_threads);
+  fprintf(fd, "= NUMA policy: %s\n",  NUMA_POLICY_STR(options->numa_policy));
+  if (options->shard_count) {
+    fprintf(fd, "= Shard: %i/%i\n", options->shard_index + 1, options->shard_count);
+  }
+  if (options->realignment || options->recalibration || options->index_output) {
+    fprintf(fd, "= Sort memory: %d MB\n", options->sort_memory);
+  }
   fprintf(fd, "= Batch size: %d bytes\n",  batch_size);
   fprintf(fd, "\n\n");
 
@@ -592,6 +650,16 @@ void** argtable_options_new(int mode) {
   argtable[count++] = arg_str0("a", "adapter", NULL, "Adapter sequence in the read");
   argtable[count++] = arg_str0(NULL, "input-format", NULL, "Input file format: fastq or bam. Default: fastq");
   argtable[count++] = arg_lit0("v", "version", "Display the HPG Aligner version");
+  argtable[count++] = arg_str0(NULL, "numa", NULL, "NUMA placement: none, interleave (index pages across nodes) or replicate (index copy per node). Threads are pinned unless none. Default: none");
+  argtable[count++] = arg_lit0(NULL, "profile", "Enable the profiling counters, a JSON report is written to the output directory");
+  argtable[count++] = arg_lit0(NULL, "trace", "Record a timeline of the workflow stages per thread, written to the output directory (Chrome trace format)");
+  argtable[count++] = arg_str0(NULL, "metrics", NULL, "Write live throughput metrics (JSON, every second) to a file, or serve them on a Unix socket with unix:<path>");
+  argtable[count++] = arg_str0(NULL, "socket", NULL, "Unix socket path where the serve command accepts mapping jobs");
+  argtable[count++] = arg_int0(NULL, "serve-jobs", NULL, "Number of jobs mapped concurrently by the serve command, they share the CPU threads. Default: 1");
+  argtable[count++] = arg_str0(NULL, "shard", NULL, "Map only the shard i of N (i/N, 1 <= i <= N) of the input files: record-aligned slices of plain FastQ, BGZF FastQ or BAM files. The output files are named after the shard");
+  argtable[count++] = arg_int0(NULL, "sort-memory", NULL, "Memory (MB) to sort the BAM files before re-aligning and of the unmapped pairs of BAM input, they are sorted on the CPU threads. Default: 500");
+  argtable[count++] = arg_lit0(NULL, "index", "Sort the BAM output file by coordinate and create its index (BAI, CSI for references longer than 512 Mbp) while the sorted file is written");
+  argtable[count++] = arg_file0(NULL, "recal-data", NULL, "Recalibration data file (saved by hpg-bam recalibrate) applied to the base qualities of the BAM output while it is written, instead of a recalibration pass over the output (dna command only)");
 
   if (mode == DNA_MODE) {
     argtable[count++] = arg_int0(NULL, "num-seeds", NULL, "Number of seeds");
@@ -708,6 +776,26 @@ options_t *read_CLI_options(void **argtable, options_t *options) {
   }
 
   if (((struct arg_int*)argtable[++count])->count) { options->version = ((struct arg_int*)argtable[count])->count; }
+  if (((struct arg_str*)argtable[++count])->count) { options->numa_policy = parse_numa_policy((char *) *(((struct arg_str*)argtable[count])->sval)); }
+  if (((struct arg_int*)argtable[++count])->count) { options->profile = ((struct arg_int*)argtable[count])->count; }
+  if (((struct arg_int*)argtable[++count])->count) { options->trace = ((struct arg_int*)argtable[count])->count; }
+  if (((struct arg_str*)argtable[++count])->count) { options->metrics_target = strdup(*(((struct arg_str*)argtable[count])->sval)); }
+  if (((struct arg_str*)argtable[++count])->count) { options->socket_path = strdup(*(((struct arg_str*)argtable[count])->sval)); }
+  if (((struct arg_int*)argtable[++count])->count) { options->serve_jobs = *(((struct arg_int*)argtable[count])->ival); }
+  if (((struct arg_str*)argtable[++count])->count) { parse_shard((char *) *(((struct arg_str*)argtable[count])->sval), &options->shard_index, &options->shard_count); }
+  if (((struct arg_int*)argtable[++count])->count) { options->sort_memory = *(((struct arg_int*)argtable[count])->ival); }
+  if (((struct arg_int*)argtable[++count])->count) { options->index_output = ((struct arg_int*)argtable[count])->count; }
+  if (((struct arg_file*)argtable[++count])->count) { options->recal_data_filename = strdup(*(((struct arg_file*)argtable[count])->filename)); }
+
+  // recalibration with a known data file, BAM output
+  if (options->recal_data_filename) {
+    options->bam_format = 1;
+    options->set_bam_format = 1;
+    if (options->recalibration) {
+      LOG_WARN("Recalibration data file given, the recalibration post-processing is not run\n");
+      options->recalibration = 0;
+    }
+  }
 
   if (options->mode == DNA_MODE) {
     if (((struct arg_int*)argtable[++count])->count) { options->num_seeds = *(((struct arg_int*)argtable[count])->ival); }
@@ -843,6 +931,9 @@ void options_set_cmdline(int argc, char **argv,
   cmdline = (char *) calloc(size, sizeof(char));
   sprintf(cmdline, "%s ", HPG_ALIGNER_BIN);
   for (int i = 0; i < argc; i++) {
+    // left out so that the headers of all the shards are the same (merge)
+    if (!strcmp(argv[i], "--shard")) { i++; continue; }
+    if (!strncmp(argv[i], "--shard=", 8)) { continue; }
     sprintf(cmdline, "%s %s", cmdline, argv[i]);
   }
   
@@ -17,6 +17,8 @@
 #include "commons/system_utils.h"
 #include "commons/file_utils.h"
 #include "buffers.h"
+#include "affinity.h"
+#include "shard.h"
 
 //========================================================================
 
@@ -28,6 +30,7 @@
 //============================ DEFAULT VALUES ============================
 #define DEFAULT_GPU_THREADS		32
 #define DEFAULT_CPU_THREADS		1
+#define DEFAULT_SORT_MEMORY		500
 #define DEFAULT_CAL_SEEKER_ERRORS	0
 #define DEFAULT_MIN_SEED_PADDING_LEFT	5
 #define DEFAULT_MIN_SEED_PADDING_RIGHT	5
@@ -58,7 +61,7 @@
 #define DEFAULT_FILTER_SEED_MAPPINGS_BS 500
 //========================================================================
 
-#define NUM_OPTIONS			31
+#define NUM_OPTIONS			41
 #define NUM_RNA_OPTIONS			 5
 #define NUM_DNA_OPTIONS			 1
 
@@ -119,6 +122,15 @@ typedef struct options {
   int set_bam_format;
   int adapter_length;
   int set_cal;
+  int numa_policy;
+  int profile;
+  int trace;
+  int serve;  // serve command, the jobs bring the input files
+  int serve_jobs;
+  int shard_index;  // 0-based
+  int shard_count;  // 0: no sharding
+  int sort_memory;  // MB
+  int index_output;
   double min_score;
   double match;
   double mismatch;
@@ -126,6 +138,8 @@ typedef struct options {
   double gap_extend;  
   char str_mode[32];
   char *prefix_name;
+  char *metrics_target;
+  char *socket_path;
   char *in_filename;
   char *in_filename2;
   char *bwt_dirname;
@@ -136,6 +150,7 @@ typedef struct options {
   char *intron_filename;
   char *adapter;
   char *adapter_revcomp;
+  char *recal_data_filename;
   char *cmdline;
   // new variables for bisulphite case
 } options_t;
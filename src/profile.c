@@ -0,0 +1,229 @@
+#include "profile.h"
+
+//--------------------------------------------------------------------
+
+int profile_enabled = 0;
+__thread profile_thread_t *profile_local = NULL;
+
+static int num_profile_threads = 0;
+static int max_profile_threads = 0;
+static profile_thread_t **profile_threads = NULL;
+static pthread_mutex_t profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t start_ticks;
+static struct timespec start_time;
+
+//--------------------------------------------------------------------
+// counter names, nested counters (parent != -1) are already included
+// in their parent and are not added to the totals
+//--------------------------------------------------------------------
+
+typedef struct profile_func {
+  char *name;
+  int parent;
+  int section;
+} profile_func_t;
+
+static profile_func_t profile_funcs[NUM_TIMING] = {
+  { "search_suffix",                 -1,                      SECTION_SEEDING },
+  { "search_prefix",                 FUNC_SEARCH_SUFFIX,      SECTION_SEEDING },
+  { "search_sa",                     FUNC_SEARCH_SUFFIX,      SECTION_SEEDING },
+  { "generate_cals_from_exact_read", -1,                      SECTION_SEEDING },
+  { "generate_cals_from_suffixes",   -1,                      SECTION_EXTENSION },
+  { "init_cals_from_suffixes",       FUNC_CALS_FROM_SUFFIXES, SECTION_EXTENSION },
+  { "set_positions",                 FUNC_CALS_FROM_SUFFIXES, SECTION_EXTENSION },
+  { "set_reference_sequence",        FUNC_CALS_FROM_SUFFIXES, SECTION_EXTENSION },
+  { "skip_suffixes",                 FUNC_CALS_FROM_SUFFIXES, SECTION_EXTENSION },
+  { "mini_sw_right_side",            FUNC_CALS_FROM_SUFFIXES, SECTION_EXTENSION },
+  { "mini_sw_left_side",             FUNC_CALS_FROM_SUFFIXES, SECTION_EXTENSION },
+  { "seed_new",                      FUNC_CALS_FROM_SUFFIXES, SECTION_EXTENSION },
+  { "seed_list_insert",              FUNC_CALS_FROM_SUFFIXES, SECTION_EXTENSION },
+  { "cal_new",                       FUNC_CALS_FROM_SUFFIXES, SECTION_EXTENSION },
+  { "cal_mng_insert",                FUNC_CALS_FROM_SUFFIXES, SECTION_EXTENSION },
+  { "cal_mng_to_array_list",         -1,                      SECTION_EXTENSION },
+  { "filter_by_read_area",           -1,                      SECTION_EXTENSION },
+  { "filter_by_num_mismatches",      -1,                      SECTION_EXTENSION },
+  { "sw_pre_processing",             -1,                      SECTION_SW },
+  { "sw_execution",                  -1,                      SECTION_SW },
+  { "sw_post_processing",            -1,                      SECTION_SW },
+  { "other functions",               -1,                      SECTION_OTHER },
+  { "create_alignments",             -1,                      SECTION_OTHER },
+  { "pairing",                       -1,                      SECTION_PAIRING },
+  { "read_batch",                    -1,                      SECTION_IO },
+  { "write_batch",                   -1,                      SECTION_IO }
+};
+
+static char *profile_sections[NUM_SECTIONS] = {
+  "seeding", "extension", "sw", "pairing", "io", "other"
+};
+
+//--------------------------------------------------------------------
+
+profile_thread_t *profile_thread_register() {
+  profile_thread_t *p;
+  if (posix_memalign((void **) &p, 64, sizeof(profile_thread_t))) {
+    printf("Error: could not allocate profiling counters\n");
+    exit(-1);
+  }
+  memset(p, 0, sizeof(profile_thread_t));
+
+  pthread_mutex_lock(&profile_mutex);
+  if (num_profile_threads >= max_profile_threads) {
+    max_profile_threads = (max_profile_threads ? 2 * max_profile_threads : 64);
+    profile_threads = (profile_thread_t **) realloc(profile_threads,
+						    max_profile_threads * sizeof(profile_thread_t *));
+  }
+  profile_threads[num_profile_threads++] = p;
+  pthread_mutex_unlock(&profile_mutex);
+
+  return p;
+}
+
+//--------------------------------------------------------------------
+
+void profile_init(int enabled) {
+  profile_enabled = enabled;
+  start_ticks = profile_ticks();
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+}
+
+//--------------------------------------------------------------------
+
+void profile_free() {
+  for (int i = 0; i < num_profile_threads; i++) {
+    free(profile_threads[i]);
+  }
+  if (profile_threads) free(profile_threads);
+
+  profile_threads = NULL;
+  num_profile_threads = 0;
+  max_profile_threads = 0;
+  profile_local = NULL;
+  profile_enabled = 0;
+}
+
+//--------------------------------------------------------------------
+
+static double elapsed_time(double *ticks_per_second) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t ticks = profile_ticks() - start_ticks;
+
+  double seconds = (now.tv_sec - start_time.tv_sec) + (now.tv_nsec - start_time.tv_nsec) / 1000000000.0;
+  *ticks_per_second = (seconds > 0 ? ticks / seconds : 1000000000.0);
+  return seconds;
+}
+
+//--------------------------------------------------------------------
+
+static void profile_sum(uint64_t *ticks, uint64_t *calls) {
+  memset(ticks, 0, NUM_TIMING * sizeof(uint64_t));
+  memset(calls, 0, NUM_TIMING * sizeof(uint64_t));
+  for (int t = 0; t < num_profile_threads; t++) {
+    for (int i = 0; i < NUM_TIMING; i++) {
+      ticks[i] += profile_threads[t]->ticks[i];
+      calls[i] += profile_threads[t]->calls[i];
+    }
+  }
+}
+
+//--------------------------------------------------------------------
+
+void profile_display() {
+  if (!profile_enabled) return;
+
+  double ticks_per_second;
+  uint64_t ticks[NUM_TIMING], calls[NUM_TIMING];
+
+  elapsed_time(&ticks_per_second);
+  profile_sum(ticks, calls);
+
+  double total = 0;
+  for (int i = 0; i < NUM_TIMING; i++) {
+    if (profile_funcs[i].parent == -1) {
+      total += ticks[i] / ticks_per_second;
+    }
+  }
+
+  printf("Timing in seconds (sum over %i threads):\n", num_profile_threads);
+  for (int i = 0; i < NUM_TIMING; i++) {
+    double seconds = ticks[i] / ticks_per_second;
+    if (profile_funcs[i].parent != -1) {
+      printf("\t");
+    }
+    printf("\t%0.2f %%\t%0.4f\tof %0.4f\t%s\n",
+	   (total > 0 ? 100.0 * seconds / total : 0.0), seconds, total, profile_funcs[i].name);
+  }
+}
+
+//--------------------------------------------------------------------
+
+void profile_report(char *filename, int num_threads) {
+  if (!profile_enabled) return;
+
+  FILE *f = fopen(filename, "w");
+  if (!f) {
+    printf("Error: could not open %s to write\n", filename);
+    return;
+  }
+
+  double ticks_per_second;
+  uint64_t ticks[NUM_TIMING], calls[NUM_TIMING];
+
+  double wall_time = elapsed_time(&ticks_per_second);
+  profile_sum(ticks, calls);
+
+  double sections[NUM_SECTIONS];
+  memset(sections, 0, sizeof(sections));
+  for (int i = 0; i < NUM_TIMING; i++) {
+    if (profile_funcs[i].parent == -1) {
+      sections[profile_funcs[i].section] += ticks[i] / ticks_per_second;
+    }
+  }
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"wall_time\": %0.6f,\n", wall_time);
+  fprintf(f, "  \"num_threads\": %i,\n", num_threads);
+  fprintf(f, "  \"profiled_threads\": %i,\n", num_profile_threads);
+  fprintf(f, "  \"ticks_per_second\": %0.0f,\n", ticks_per_second);
+
+  fprintf(f, "  \"sections\": {\n");
+  for (int s = 0; s < NUM_SECTIONS; s++) {
+    fprintf(f, "    \"%s\": %0.6f%s\n", profile_sections[s], sections[s],
+	    (s < NUM_SECTIONS - 1 ? "," : ""));
+  }
+  fprintf(f, "  },\n");
+
+  fprintf(f, "  \"functions\": [\n");
+  for (int i = 0; i < NUM_TIMING; i++) {
+    fprintf(f, "    { \"name\": \"%s\", \"section\": \"%s\", \"parent\": ",
+	    profile_funcs[i].name, profile_sections[profile_funcs[i].section]);
+    if (profile_funcs[i].parent == -1) {
+      fprintf(f, "null");
+    } else {
+      fprintf(f, "\"%s\"", profile_funcs[profile_funcs[i].parent].name);
+    }
+    fprintf(f, ", \"calls\": %lu, \"seconds\": %0.6f }%s\n", calls[i], ticks[i] / ticks_per_second,
+	    (i < NUM_TIMING - 1 ? "," : ""));
+  }
+  fprintf(f, "  ],\n");
+
+  fprintf(f, "  \"threads\": [\n");
+  for (int t = 0; t < num_profile_threads; t++) {
+    double seconds = 0;
+    for (int i = 0; i < NUM_TIMING; i++) {
+      if (profile_funcs[i].parent == -1) {
+	seconds += profile_threads[t]->ticks[i] / ticks_per_second;
+      }
+    }
+    fprintf(f, "    { \"thread\": %i, \"seconds\": %0.6f }%s\n", t, seconds,
+	    (t < num_profile_threads - 1 ? "," : ""));
+  }
+  fprintf(f, "  ]\n");
+  fprintf(f, "}\n");
+
+  fclose(f);
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
@@ -0,0 +1,115 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//--------------------------------------------------------------------
+// profiling counters (--profile option)
+//--------------------------------------------------------------------
+
+#define FUNC_SEARCH_SUFFIX             0
+#define FUNC_SEARCH_PREFIX             1
+#define FUNC_SEARCH_SA                 2
+#define FUNC_CALS_FROM_EXACT_READ      3
+#define FUNC_CALS_FROM_SUFFIXES        4
+#define FUNC_INIT_CALS_FROM_SUFFIXES   5
+#define FUNC_SET_POSITIONS             6
+#define FUNC_SET_REF_SEQUENCE          7
+#define FUNC_SKIP_SUFFIXES             8
+#define FUNC_MINI_SW_RIGHT_SIDE        9
+#define FUNC_MINI_SW_LEFT_SIDE        10
+#define FUNC_SEED_NEW                 11
+#define FUNC_SEED_LIST_INSERT         12
+#define FUNC_CAL_NEW                  13
+#define FUNC_CAL_MNG_INSERT           14
+#define FUNC_CAL_MNG_TO_LIST          15
+#define FUNC_FILTER_BY_READ_AREA      16
+#define FUNC_FILTER_BY_NUM_MISMATCHES 17
+#define FUNC_PRE_SW                   18
+#define FUNC_SW                       19
+#define FUNC_POST_SW                  20
+#define FUNC_OTHER                    21
+#define FUNC_CREATE_ALIGNMENTS        22
+#define FUNC_PAIRING                  23
+#define FUNC_READ_BATCH               24
+#define FUNC_WRITE_BATCH              25
+
+#define NUM_TIMING (FUNC_WRITE_BATCH + 1)
+
+// sections for the JSON report
+#define SECTION_SEEDING    0
+#define SECTION_EXTENSION  1
+#define SECTION_SW         2
+#define SECTION_PAIRING    3
+#define SECTION_IO         4
+#define SECTION_OTHER      5
+
+#define NUM_SECTIONS (SECTION_OTHER + 1)
+
+//--------------------------------------------------------------------
+// per-thread counters, one cache-line aligned block per thread
+//--------------------------------------------------------------------
+
+typedef struct profile_thread {
+  uint64_t ticks[NUM_TIMING];
+  uint64_t calls[NUM_TIMING];
+} __attribute__((aligned(64))) profile_thread_t;
+
+extern int profile_enabled;
+extern __thread profile_thread_t *profile_local;
+
+profile_thread_t *profile_thread_register();
+
+//--------------------------------------------------------------------
+
+static inline uint64_t profile_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000LLU + ts.tv_nsec;
+#endif
+}
+
+//--------------------------------------------------------------------
+
+static inline void profile_add(int id, uint64_t ticks) {
+  if (!profile_local) {
+    profile_local = profile_thread_register();
+  }
+  profile_local->ticks[id] += ticks;
+  profile_local->calls[id]++;
+}
+
+//--------------------------------------------------------------------
+// when profiling is disabled, the cost is a (well-predicted) branch
+//--------------------------------------------------------------------
+
+#define PROFILE_START(t)     ((t) = (profile_enabled ? profile_ticks() : 0))
+#define PROFILE_STOP(id, t)  do { if (profile_enabled) profile_add((id), profile_ticks() - (t)); } while (0)
+
+//--------------------------------------------------------------------
+
+void profile_init(int enabled);
+void profile_free();
+
+// human-readable table on stdout
+void profile_display();
+
+// machine-readable report
+void profile_report(char *filename, int num_threads);
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+#endif // PROFILE_H
@@ -11,13 +11,13 @@ extern size_t fd_read_bytes;
 extern size_t fd_total_bytes;
 extern int redirect_stdout;
 extern int gziped_fileds;
-extern int w1_end, w2_end, w3_end;
 
 extern size_t total_reads_w2, total_reads_w3;
 extern size_t reads_w2, reads_w3;
 
 int max = 65;
 extern size_t total_reads_ph2;
+extern size_t reads_ph2;
 
 void write_sam_header_BWT(options_t *options, genome_t *genome, FILE *f) {
   fprintf(f, "@HD\tVN:1.4\tSO:unsorted\n");
@@ -57,147 +57,6 @@ int w3_function(void *data) {
 
 //--------------------------------------------------------------------------------------
 
-void display_progress() {
-
-  if (redirect_stdout || gziped_fileds) { return; }
-  
-  float progress;
-
-  struct timeval wt_s, wt_e;
-  double w_time = 0.0;
-
-  start_timer(wt_s);
-  while (!w1_end) {
-
-    if (fd_total_bytes <= 0) { 
-      progress = 0; 
-    } else {
-      progress = (fd_read_bytes * (size_t)100) / fd_total_bytes;
-    }
-
-    int c   = (max * progress) / 100;
-
-    printf("[");
-    for (int x = 0; x < c; x++)
-      printf("|");
-    for (int x = c; x < max; x++)
-      printf(" ");
-
-    stop_timer(wt_s, wt_e, w_time);
-    start_timer(wt_s);
-
-    size_t estimated;
-    if (fd_read_bytes <= 0) { 
-      estimated = 0;
-    } else {
-      estimated = ((fd_total_bytes - fd_read_bytes) * (w_time / 1000000) ) / fd_read_bytes;
-    }
-
-    size_t hour, min, sec;
-
-    min = estimated / 60;
-    sec = estimated % 60;
-
-    if (min >= 60) {
-      hour = min / 60;
-      min = min % 60;
-    } else {
-      hour = 0;      
-    }
-
-    printf("]  %.1f%% | %02lu:%02lu:%02lu ETA", progress, hour, min, sec);  
-    printf("\n\033[F\033[J");
-    
-    sleep(1);
-
-  }
-  
-    printf("[");
-  for (int x = 0; x < max; x++)
-    printf("|");        
-  
-  stop_timer(wt_s, wt_e, w_time);
-  printf("]  100%%\n\n\033[F");  
-
-}
-
-void display_progress_2_3(int w_id) {
-
-  if (redirect_stdout || gziped_fileds) { return; }
-  
-  float progress;
-
-  struct timeval wt_s, wt_e;
-  double w_time = 0.0;
-
-  int total_reads;
-  size_t *actual_reads;
-  int *w_end;
-
-  if (w_id == 2) {
-    total_reads = total_reads_w2;    
-    w_end = &w2_end;
-    actual_reads = &reads_w2;
-  } else {
-    total_reads = total_reads_w3;
-    w_end = &w3_end;
-    actual_reads = &reads_w3;
-  }
-
-  start_timer(wt_s);
-  while (!(*w_end)) {
-    if (total_reads <= 0) { 
-      progress = 0; 
-    } else {
-      progress = ((*actual_reads) * (size_t)100) / (total_reads);
-    }
-
-    int c   = (max * progress) / 100;
-
-    printf("[");
-    for (int x = 0; x < c; x++)
-      printf("|");
-    for (int x = c; x < max; x++)
-      printf(" ");
-
-    stop_timer(wt_s, wt_e, w_time);
-    start_timer(wt_s);
-
-    size_t estimated;
-    if ((*actual_reads) <= 0) { 
-      estimated = 0;
-    } else {
-      estimated = ((total_reads - (*actual_reads)) * (w_time / 1000000) ) / (*actual_reads);
-    }
-
-    size_t hour, min, sec;
-
-    min = estimated / 60;
-    sec = estimated % 60;
-
-    if (min >= 60) {
-      hour = min / 60;
-      min = min % 60;
-    } else {
-      hour = 0;      
-    }
-
-    printf("]  %.1f%% | %02lu:%02lu:%02lu ETA", progress, hour, min, sec);  
-    printf("\n\033[F\033[J");
-    
-    sleep(1);
-
-  }
-  
-  printf("[");
-  for (int x = 0; x < max; x++)
-    printf("|");        
-  
-  stop_timer(wt_s, wt_e, w_time);
-  printf("]  100%%\n\n\033[F");  
-
-}
-
 //--------------------------------------------------------------------------------------
 
 void print_load_progress(float progress, int finish) {
@@ -222,71 +81,6 @@ void print_load_progress(float progress, int finish) {
 
 
 
-void display_progressX() {
-  if (redirect_stdout || gziped_fileds) { return; }
-
-  extern size_t fd_read_bytes;
-  extern size_t fd_total_bytes;
-  
-  float progress;
-
-  printf("[");
-  while (!w1_end) {
-    progress = (fd_read_bytes * (size_t)100) / fd_total_bytes;
-
-    int c   = (max * progress) / 100;
-
-    for (int x = 0; x < c; x++)
-      printf("|");
-    for (int x = c; x < max; x++)
-      printf(" ");
-
-    printf("] %.1f%%", progress);  
-    printf("\n\033[F\033[J");
-    
-    sleep(2);
-  }
-  
-  for (int x = 0; x < max; x++)
-    printf("|");        
-  
-  printf("] 100%%\n\n\033[F");  
-
-}
-
-
-void display_progress_2() {
-  if (redirect_stdout || gziped_fileds) { return; }
-
-  extern size_t reads_ph2;  
-  float progress;
-
-  printf("[");
-  while (reads_ph2 < total_reads_ph2) {
-    
-    progress = (reads_ph2 * (size_t)100) / total_reads_ph2;
-
-    int c   = (max * progress) / 100;
-
-    for (int x = 0; x < c; x++)
-      printf("|");
-    for (int x = c; x < max; x++)
-      printf(" ");
-
-    printf("] %.1f%%", progress);  
-    printf("\n\033[F\033[J");
-    
-    sleep(2);
-  }
-  
-  for (int x = 0; x < max; x++)
-    printf("|");        
-  
-  printf("] 100%%\n\n\033[F");  
-
-}
-
-
 void sa_index3_parallel_genome_new(char *sa_index_dirname, int num_threads,
 				   sa_index3_t **sa_index_out, genome_t **genome_out) {  
 
@@ -390,7 +184,7 @@ void sa_index3_parallel_genome_new(char *sa_index_dirname, int num_threads,
 	  exit(-1);
 	}
 	//  printf("genome: filename %s, length = %lu\n", filename_tab, genome_len);
-	S = (char *) malloc(genome_len);
+	S = (char *) sa_index3_table_alloc(genome_len);
   
 	//printf("\nreading S from file %s...\n", filename_tab);
 	gettimeofday(&start, NULL);
@@ -425,7 +219,7 @@ void sa_index3_parallel_genome_new(char *sa_index_dirname, int num_threads,
 	sprintf(filename_tab, "%s/%s.A", sa_index_dirname, prefix);
 	f_tab = fopen(filename_tab, "rb");
 	if (f_tab) {
-	  A = (uint *) malloc(A_items * sizeof(uint));
+	  A = (uint *) sa_index3_table_alloc(A_items * sizeof(uint));
 	
 	  //	printf("\nreading A table (Compression Row Storage) from file %s...\n", filename_tab);
 	  gettimeofday(&start, NULL);
@@ -451,7 +245,7 @@ void sa_index3_parallel_genome_new(char *sa_index_dirname, int num_threads,
 	sprintf(filename_tab, "%s/%s.IA", sa_index_dirname, prefix);
 	f_tab = fopen(filename_tab, "rb");
 	if (f_tab) {
-	  IA = (uint *) malloc(IA_items * sizeof(uint));
+	  IA = (uint *) sa_index3_table_alloc(IA_items * sizeof(uint));
 	
 	  //	printf("\nreading IA table (Compression Row Storage) from file %s...\n", filename_tab);
 	  gettimeofday(&start, NULL);
@@ -488,7 +282,7 @@ void sa_index3_parallel_genome_new(char *sa_index_dirname, int num_threads,
 	  exit(-1);
 	}
 	//      printf("SA: filename %s, num_suffixes = %lu\n", filename_tab, num_suffixes);
-	SA = (uint *) malloc(num_suffixes * sizeof(uint));
+	SA = (uint *) sa_index3_table_alloc(num_suffixes * sizeof(uint));
   
 	//      printf("\nreading SA table from file %s...\n", filename_tab);
 	gettimeofday(&start, NULL);
@@ -517,7 +311,7 @@ void sa_index3_parallel_genome_new(char *sa_index_dirname, int num_threads,
 	  exit(-1);
 	}
 	//      printf("CHROM: filename %s, num_suffixes = %lu\n", filename_tab, num_suffixes);
-	CHROM = (char *) malloc(num_suffixes * sizeof(char));
+	CHROM = (char *) sa_index3_table_alloc(num_suffixes * sizeof(char));
       
 	//      printf("\nreading CHROM table from file %s...\n", filename_tab);
 	gettimeofday(&start, NULL);
@@ -546,7 +340,7 @@ void sa_index3_parallel_genome_new(char *sa_index_dirname, int num_threads,
 	if (f_tab) {
 	  num_items = 1LLU << (2 * k_value);
 	  assert(num_items == pre_length);
-	  PRE = (uint *) malloc(num_items * sizeof(uint));
+	  PRE = (uint *) sa_index3_table_alloc(num_items * sizeof(uint));
 	
 	  //	printf("\nreading PRE table from file %s...\n", filename_tab);
 	  gettimeofday(&start, NULL);
@@ -567,7 +361,7 @@ void sa_index3_parallel_genome_new(char *sa_index_dirname, int num_threads,
 	sprintf(filename_tab, "%s/%s.JA", sa_index_dirname, prefix);
 	f_tab = fopen(filename_tab, "rb");
 	if (f_tab) {
-	  JA = (unsigned char *) malloc(A_items * sizeof(unsigned char));
+	  JA = (unsigned char *) sa_index3_table_alloc(A_items * sizeof(unsigned char));
 	
 	  //	printf("\nreading JA table (Compression Row Storage) from file %s...\n", filename_tab);
 	  gettimeofday(&start, NULL);
@@ -632,6 +426,14 @@ void sa_index3_parallel_genome_new(char *sa_index_dirname, int num_threads,
     p->IA = IA;
     p->JA = JA;
     p->genome = genome;
+    p->num_replicas = 1;
+    p->replicas = NULL;
+    p->shm = NULL;
+    p->shm_size = 0;
+
+    if (affinity_get_policy() == NUMA_REPLICATE) {
+      sa_index3_replicate(p);
+    }
     
     *sa_index_out = p;
     *genome_out = genome_;
@@ -645,6 +447,15 @@ void sa_index3_parallel_genome_new(char *sa_index_dirname, int num_threads,
 
 void rna_aligner(options_t *options) {
 
+  // profiling counters
+  profile_init(options->profile);
+
+  // timeline tracer
+  trace_init(options->trace);
+
+  // live metrics and progress bar
+  metrics_init(options->metrics_target);
+
   //End fill 
   int path_length = strlen(options->output_name);
   int prefix_length = 0;
@@ -860,9 +671,17 @@ void rna_aligner(options_t *options) {
 
     LOG_DEBUG("Load SA State");
 
+    // NUMA placement (thread pinning, index memory policy)
+    affinity_init(options->numa_policy, options->num_cpu_threads);
+
     //sa_index = sa_index3_new(options->bwt_dirname);
     start_timer(time_genome_s);
     sa_index3_parallel_genome_new(options->bwt_dirname, options->num_cpu_threads, &sa_index, &genome);
+
+    if (options->numa_policy != NUMA_NONE) {
+      affinity_display();
+      sa_index3_display_placement(sa_index);
+    }
     
     /*
     sa_index3_display(sa_index);
@@ -1144,6 +963,15 @@ void rna_aligner(options_t *options) {
     }
 
 
+    // --shard: only the slice of the input file(s) for this shard
+    shard_t *shard = NULL;
+    if (options->shard_count) {
+      shard = shard_fastq_new(file1, file2, options->shard_index, options->shard_count);
+      if (shard_total_bytes(shard)) {
+	fd_total_bytes = shard_total_bytes(shard);
+      }
+    }
+
     f_sa = fopen("buffer_sa.tmp", "w+b");
     if (f_sa == NULL) {
       LOG_FATAL("Error opening file 'buffer_sa.tmp' \n");
@@ -1170,6 +998,7 @@ void rna_aligner(options_t *options) {
       //struct timeval start, end;
 
       wf_input_t *wf_input = wf_input_new(&reader_input, batch);
+      wf_input->shard = shard;
       wf_input_file_t *wf_input_file = wf_input_file_new(f_sa, batch);   
       wf_input_file_t *wf_input_file_hc = wf_input_file_new(f_hc, batch);  
 
@@ -1233,55 +1062,27 @@ void rna_aligner(options_t *options) {
 
       start_timer(time_start_alig);
 
+      int display = !(redirect_stdout || gziped_fileds);
+
       printf("\nWORKFLOW 1\n");
-      w1_end = 0;
       fd_read_bytes = 0;
-      #pragma omp parallel sections num_threads(2) 
-      {
-          #pragma omp section
-          {      
-	    workflow_run_with(options->num_cpu_threads, wf_input, wf);
-	    w1_end = 1;
-	  }
-          #pragma omp section
-	  {
-	    display_progress();
-	  }
-      }
+      metrics_progress_begin("workflow 1", &fd_read_bytes, &fd_total_bytes, display);
+      workflow_run_with(options->num_cpu_threads, wf_input, wf);
+      metrics_progress_end();
 
       printf("\nWORKFLOW 2\n");
       rewind(f_sa);
-      w2_end = 0;
       reads_w2 = 0;
-      #pragma omp parallel sections num_threads(2) 
-      {
-          #pragma omp section
-          {      
-	    workflow_run_with(options->num_cpu_threads, wf_input_file, wf_last);
-	    w2_end = 1;
-	  }
-          #pragma omp section
-	  {
-	    display_progress_2_3(2);
-	  }
-      }
+      metrics_progress_begin("workflow 2", &reads_w2, &total_reads_w2, display);
+      workflow_run_with(options->num_cpu_threads, wf_input_file, wf_last);
+      metrics_progress_end();
 
       printf("\nWORKFLOW 3\n");
       rewind(f_hc);
-      w3_end = 0;
       reads_w3 = 0;
-      #pragma omp parallel sections num_threads(2) 
-      {
-          #pragma omp section
-          {      
-	    workflow_run_with(options->num_cpu_threads, wf_input_file_hc, wf_hc);
-	    w3_end = 1;
-	  }
-          #pragma omp section
-	  {
-	    display_progress_2_3(3);
-	  }
-      }
+      metrics_progress_begin("workflow 3", &reads_w3, &total_reads_w3, display);
+      workflow_run_with(options->num_cpu_threads, wf_input_file_hc, wf_hc);
+      metrics_progress_end();
       printf("\n");
       total_reads_w3 = 0;
       total_reads_w2 = 0;
@@ -1323,6 +1124,7 @@ void rna_aligner(options_t *options) {
 
       sa_wf_batch_t *wf_batch = sa_wf_batch_new(NULL, (void *)sa_index, &writer_input, NULL, &sa_rna);
       sa_wf_input_t *wf_input = sa_wf_input_new(options->bam_format, &reader_input, wf_batch);
+      wf_input->shard = shard;
       
       // create and initialize workflow
       workflow_SA_t *wf = workflow_SA_new();      
@@ -1359,44 +1161,22 @@ void rna_aligner(options_t *options) {
       //printf("Run workflow with %i threads\n", options->num_cpu_threads);
       //Extrae_init(); 
 
-      printf("\nMapping Status (First Phase)\n");
-      #pragma omp parallel sections num_threads(2) 
-      {
-          #pragma omp section
-          {      
-	    start_timer(time_s1);
-	    workflow_run_with_SA(options->num_cpu_threads, wf_input, wf);
-	    stop_timer(time_s1, time_e1, time_total_1);
-	    //printf("= = = = T I M I N G    W O R K F L O W    '1' = = = =\n");
-	    //workflow_display_timing(wf);
-	    //printf("= = = = - - - - - - - - - - - - - - - - - - - = = = =\n\n");
-	    w1_end = 1;
-	  }
-          #pragma omp section
-	  {
-	    display_progressX();
-	  }
-      }
+      int display = !(redirect_stdout || gziped_fileds);
 
+      printf("\nMapping Status (First Phase)\n");
+      metrics_progress_begin("first phase", &fd_read_bytes, &fd_total_bytes, display);
+      start_timer(time_s1);
+      workflow_run_with_SA(options->num_cpu_threads, wf_input, wf);
+      stop_timer(time_s1, time_e1, time_total_1);
+      metrics_progress_end();
       
       printf("\nMapping Status (Second Phase)\n");
-      #pragma omp parallel sections num_threads(2) 
-      {
-          #pragma omp section
-          {
-	    start_timer(time_s2);
-	    rewind(f_sa);
-	    workflow_run_with_SA(options->num_cpu_threads, wf_input, wf_last);      
-	    stop_timer(time_s2, time_e2, time_total_2);      
-	    //printf("= = = = T I M I N G    W O R K F L O W    '2' = = = =\n");
-	    //workflow_display_timing(wf_last);
-	    //printf("= = = = - - - - - - - - - - - - - - - - - - - = = = =\n\n");
-	  }
-          #pragma omp section
-	  {
-	    display_progress_2();
-	  }
-      }
+      metrics_progress_begin("second phase", &reads_ph2, &total_reads_ph2, display);
+      start_timer(time_s2);
+      rewind(f_sa);
+      workflow_run_with_SA(options->num_cpu_threads, wf_input, wf_last);      
+      stop_timer(time_s2, time_e2, time_total_2);      
+      metrics_progress_end();
       printf("\n");
       
 
@@ -1415,6 +1195,7 @@ void rna_aligner(options_t *options) {
 
 
 
+      basic_statistics_reduce(basic_st);
       basic_statistics_display(basic_st, 1, 
 			       (time_total_1 + time_total_2) / 1000000, 
 			       time_genome / 1000000, total_reads_ph2);  
@@ -1494,6 +1275,8 @@ void rna_aligner(options_t *options) {
 	fastq_fclose(reader_input.fq_file2);
       }
     }    
+
+    if (shard) shard_free(shard);
   }
 
   array_list_free(files_fq1, NULL);
@@ -1582,6 +1365,7 @@ void rna_aligner(options_t *options) {
   } else {
     // free memory
     if (sa_index)  { sa_index3_free(sa_index);  }
+    affinity_free();
   }
 
   if (options->bam_format) {
@@ -1619,6 +1403,25 @@ void rna_aligner(options_t *options) {
   linked_list_free(buffer, (void *)NULL);
   linked_list_free(buffer_hc, (void *)NULL);
 
+  metrics_free();
+  counters_free();
+
+  if (options->profile) {
+    profile_display();
+
+    char profile_filename[path_length + 100];
+    sprintf(profile_filename, "%s/profile.json", options->output_name);
+    profile_report(profile_filename, options->num_cpu_threads);
+    printf("Profiling report: %s\n", profile_filename);
+    profile_free();
+  }
+
+  if (options->trace) {
+    char trace_filename[path_length + 100];
+    sprintf(trace_filename, "%s/trace.json", options->output_name);
+    trace_dump(trace_filename);
+    trace_free();
+  }
 }
 
 //--------------------------------------------------------------------------------------
@@ -118,6 +118,8 @@ void *sa_alignments_reader_rna(void *input) {
 
   extern size_t reads_ph2;
 
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_READER);
+
   if (pair_mode == SINGLE_END_MODE) {
     while (1) { 
       int type = file_read_type_items(fd);
@@ -191,6 +193,7 @@ void *sa_alignments_reader_rna(void *input) {
 				   curr_wf_batch->writer_input, 
 				   sa_batch,
 				   curr_wf_batch->data_input);
+    metrics_stage_end(METRICS_STAGE_READER, metrics_start);
   } else {
     array_list_free(reads, (void *)fastq_read_free);
     free(mapping_lists);
@@ -214,7 +217,12 @@ void *sa_fq_reader_rna(void *input) {
   
   extern size_t fd_read_bytes;
 
-  if (fq_reader_input->gzip) {
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_READER);
+
+  if (wf_input->shard) {
+    // slice of the input files
+    fd_read_bytes += shard_fastq_read(reads, fq_reader_input->batch_size, wf_input->shard);
+  } else if (fq_reader_input->gzip) {
     // Gzip fastq file
     if (fq_reader_input->flags == SINGLE_END_MODE) {
       fastq_gzread_bytes_se(reads, fq_reader_input->batch_size, fq_reader_input->fq_gzip_file1);
@@ -237,12 +245,14 @@ void *sa_fq_reader_rna(void *input) {
     array_list_free(reads, (void *)fastq_read_free);
   } else {
     sa_batch_t *sa_batch = sa_batch_new(reads);
+    sa_metrics_add_reads(reads);
 
     new_wf_batch = sa_wf_batch_new(NULL,
 				   curr_wf_batch->sa_index,
 				   curr_wf_batch->writer_input, 
 				   sa_batch,
 				   curr_wf_batch->data_input);
+    metrics_stage_end(METRICS_STAGE_READER, metrics_start);
   }
 
   return new_wf_batch;
@@ -269,14 +279,7 @@ int sa_bam_writer_rna(void *data) {
 
   //mapping_batch_t *mapping_batch = (mapping_batch_t *) batch->mapping_batch;
   
-  extern size_t total_reads;
-  extern size_t reads_no_map;
-
-  extern pthread_mutex_t mutex_sp;
-  
-  pthread_mutex_lock(&mutex_sp);
-  total_reads += num_reads;
-  pthread_mutex_unlock(&mutex_sp);
+  counter_add(COUNTER_TOTAL_READS, num_reads);
   
   //
   // DNA/RNA mode
@@ -287,9 +290,7 @@ int sa_bam_writer_rna(void *data) {
     fq_read = (fastq_read_t *) array_list_get(i, read_list);
     // mapped or not mapped ?	 
     if (num_items == 0) {
-      pthread_mutex_lock(&mutex_sp);
-      reads_no_map++;
-      pthread_mutex_unlock(&mutex_sp);      
+      counter_add(COUNTER_UNMAPPED_READS, 1);
       write_unmapped_read(fq_read, bam_file);
       if (mapping_batch->mapping_lists[i]) {
 	array_list_free(mapping_batch->mapping_lists[i], NULL);
@@ -333,18 +334,10 @@ int sa_sam_writer_rna(void *data) {
 
   num_reads = mapping_batch->num_reads;
 
-  //extern size_t total_reads, unmapped_reads, correct_reads;
-  extern size_t total_reads;
-  extern size_t reads_no_map;
-
-  extern pthread_mutex_t mutex_sp;
-
   //struct timeval time_free_s, time_free_e;
   //extern double time_free_alig, time_free_list, time_free_batch;
 
-  pthread_mutex_lock(&mutex_sp);
-  total_reads += num_reads;
-  pthread_mutex_unlock(&mutex_sp);
+  counter_add(COUNTER_TOTAL_READS, num_reads);
 
   if (pair_mode != SINGLE_END_MODE) {
     /*
@@ -462,9 +455,7 @@ int sa_sam_writer_rna(void *data) {
 
 	}
       } else {
-	pthread_mutex_lock(&mutex_sp);
-	reads_no_map++;
-	pthread_mutex_unlock(&mutex_sp);
+	counter_add(COUNTER_UNMAPPED_READS, 1);
       
 	fprintf(out_file, "%s\t4\t*\t0\t0\t*\t*\t0\t0\t%s\t%s\n", 
 		read->id,
@@ -1564,10 +1555,6 @@ void convert_batch_to_str(sa_wf_batch_t *wf_batch) {
 
   sa_genome3_t *genome = wf_batch->sa_index->genome;
   
-  //extern size_t total_reads, unmapped_reads, correct_reads;
-  extern size_t total_reads;
-  extern size_t reads_no_map;
-  extern pthread_mutex_t mutex_sp;
 
 
 
@@ -1584,7 +1571,6 @@ void convert_batch_to_str(sa_wf_batch_t *wf_batch) {
     char *buffer = (char *)malloc(sizeof(char)*buffer_max_size);
     buffer[0] = '\0';
 
-    extern basic_statistics_t *basic_st;
     size_t total_reads = num_reads;
     size_t num_mapped_reads = 0;
     size_t total_mappings = 0;
@@ -1785,7 +1771,10 @@ void convert_batch_to_str(sa_wf_batch_t *wf_batch) {
     // free memory
     sa_batch_free(sa_batch);  
 
-    basic_statistics_add(total_reads, num_mapped_reads, total_mappings, reads_uniq_mappings, basic_st);
+    counter_add(COUNTER_TOTAL_READS, total_reads);
+    counter_add(COUNTER_MAPPED_READS, num_mapped_reads);
+    counter_add(COUNTER_TOTAL_MAPPINGS, total_mappings);
+    counter_add(COUNTER_UNIQ_MAPPING_READS, reads_uniq_mappings);
 
   } else {    
     for (size_t i = 0; i < num_reads; i++) {
@@ -1826,6 +1815,8 @@ int write_to_file(void *data) {
   sa_wf_batch_t *wf_batch = (sa_wf_batch_t *) data;
   if (!wf_batch->data_output_size) { return 0; }
 
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_WRITER);
+
   extern pthread_mutex_t mutex_sp;
 
 
@@ -1860,6 +1851,9 @@ int write_to_file(void *data) {
     free(mapping_lists);
   }
 
+  metrics_stage_end(METRICS_STAGE_WRITER, metrics_start);
+  metrics_batch_latency(wf_batch->created);
+
   if (wf_batch) sa_wf_batch_free(wf_batch);
 
   return 0;
@@ -2784,9 +2778,12 @@ void cal_rna_mng_free(cal_mng_t *p) {
 //--------------------------------------------------------------------
 
 int sa_rna_mapper(void *data) {
+  affinity_pin_thread();
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_MAPPER);
+
   sa_wf_batch_t *wf_batch = (sa_wf_batch_t *) data;
   sa_batch_t *sa_batch = wf_batch->mapping_batch;
-  sa_index3_t *sa_index = (sa_index3_t *) wf_batch->sa_index;
+  sa_index3_t *sa_index = sa_index3_local((sa_index3_t *) wf_batch->sa_index);
   sa_rna_input_t *sa_rna = wf_batch->data_input;
   genome_t *genome = (genome_t *)sa_rna->genome;
   avls_list_t *avls_list = (avls_list_t *)sa_rna->avls_list;
@@ -3505,6 +3502,7 @@ int sa_rna_mapper(void *data) {
   
   
   convert_batch_to_str(wf_batch);
+  metrics_stage_end(METRICS_STAGE_MAPPER, metrics_start);
   
   return -1;
   
@@ -3512,11 +3510,14 @@ int sa_rna_mapper(void *data) {
 
 
 int sa_rna_mapper_last(void *data) {
+  affinity_pin_thread();
+  uint64_t metrics_start = metrics_stage_begin(METRICS_STAGE_MAPPER);
+
   array_list_t *sa_list;
   sa_wf_batch_t *wf_batch = (sa_wf_batch_t *) data;
   sa_batch_t *sa_batch = wf_batch->mapping_batch;
   size_t num_reads = sa_batch->num_reads;
-  sa_index3_t *sa_index = (sa_index3_t *) wf_batch->sa_index;
+  sa_index3_t *sa_index = sa_index3_local((sa_index3_t *) wf_batch->sa_index);
   sa_rna_input_t *sa_rna = wf_batch->data_input;
   genome_t *genome = (genome_t *)sa_rna->genome;
   avls_list_t *avls_list = (avls_list_t *)sa_rna->avls_list;
@@ -4807,6 +4808,7 @@ int sa_rna_mapper_last(void *data) {
   }
 
   convert_batch_to_str(wf_batch);
+  metrics_stage_end(METRICS_STAGE_MAPPER, metrics_start);
   
   return -1;
 
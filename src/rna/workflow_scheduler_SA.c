@@ -1,4 +1,6 @@
 #include "rna/workflow_scheduler_SA.h"
+#include "affinity.h"
+#include "trace.h"
 //#include "extrae_user_events.h" 
 
 //----------------------------------------------------------------------------------------
@@ -263,6 +265,7 @@ void workflow_insert_item_at_SA(int stage_id, void *data, workflow_SA_t *wf) {
 	  wf->num_pending_items++;
 	  item->context = (void *) wf;
      }
+     TRACE_COUNTER("pending items", wf->num_pending_items);
 
      pthread_cond_broadcast(&wf->workers_cond);
 
@@ -424,10 +427,15 @@ void workflow_schedule_SA(workflow_SA_t *wf) {
 
      //Extrae_event(6000019, 5);   
      //printf("Workflow schedule mutex lock\n");
-     while (wf->num_pending_items <= 0 && !wf->completed_producer) {// || 
-       //(wf->num_pending_items <= 0 && wf->running_consumer)) {
-       //printf("Waiting in workflow... %lu\n", pthread_self());
-       pthread_cond_wait(&wf->workers_cond, &wf->main_mutex);
+     if (wf->num_pending_items <= 0 && !wf->completed_producer) {
+       // queue stall, no items to process
+       TRACE_BEGIN("wait");
+       while (wf->num_pending_items <= 0 && !wf->completed_producer) {// || 
+	 //(wf->num_pending_items <= 0 && wf->running_consumer)) {
+	 //printf("Waiting in workflow... %lu\n", pthread_self());
+	 pthread_cond_wait(&wf->workers_cond, &wf->main_mutex);
+       }
+       TRACE_END("wait");
      }
      //printf("Waiting in workflow continue! %lu\n", pthread_self());
      //Extrae_event(6000019, 0);
@@ -454,9 +462,11 @@ void workflow_schedule_SA(workflow_SA_t *wf) {
 
 	  start_timer(start_time);
 
-	  //Extrae_event(6000019, 3); 
+	  char *stage_label = (wf->stage_labels && wf->stage_labels[item->stage_id] ?
+			       wf->stage_labels[item->stage_id] : "stage");
+	  TRACE_BEGIN(stage_label);
 	  int next_stage = stage_function(item->data);
-	  //Extrae_event(6000019, 0);
+	  TRACE_END(stage_label);
 
 	  //Extrae_event(6000019, 7); 
 	  stop_timer(start_time, end_time, total_time);
@@ -482,6 +492,7 @@ void workflow_schedule_SA(workflow_SA_t *wf) {
 	       array_list_insert(item, wf->completed_items);
 
 	       pthread_cond_broadcast(&wf->consumer_cond);
+	       TRACE_COUNTER("pending items", wf->num_pending_items);
 	       pthread_mutex_unlock(&wf->main_mutex);
 	  } else {
 	       // error !!
@@ -576,6 +587,9 @@ void *thread_function_SA(void *wf_context) {
 
   int min_batches = (int)(num_threads * 3);
 
+  // NUMA-aware placement, each thread pins itself to its slot
+  affinity_pin_thread();
+
 
   //int max_write_batches = 1000;
 
@@ -590,9 +604,9 @@ void *thread_function_SA(void *wf_context) {
       //do {
       start_timer(start_time);
 
-      //Extrae_event(6000019, 1);  
+      TRACE_BEGIN(wf->producer_label ? wf->producer_label : "producer");
       data = producer_function(input);
-      //Extrae_event(6000019, 0);
+      TRACE_END(wf->producer_label ? wf->producer_label : "producer");
 
       stop_timer(start_time, end_time, total_time);
       wf->producer_time += (total_time / 1000000.0f);
@@ -616,9 +630,9 @@ void *thread_function_SA(void *wf_context) {
 	total_time = 0;
 	start_timer(start_time);
 
-	//Extrae_event(6000019, 2);   
+	TRACE_BEGIN(wf->consumer_label ? wf->consumer_label : "consumer");
 	consumer_function(data);
-	//Extrae_event(6000019, 0);
+	TRACE_END(wf->consumer_label ? wf->consumer_label : "consumer");
 
 	stop_timer(start_time, end_time, total_time);
 	wf->consumer_time += (total_time / 1000000.0f);
@@ -648,13 +662,6 @@ void workflow_run_with_SA(int num_threads, void *input, workflow_SA_t *wf) {
      pthread_t threads[num_threads];
      pthread_attr_t attr;
      
-     int num_cpus = 64;
-     int cpuArray[num_cpus];
-     
-     for (int i = 0; i < num_cpus; i++) {
-	  cpuArray[i] = i;
-     }
-     
      pthread_attr_init(&attr);
      pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
      
@@ -664,12 +671,9 @@ void workflow_run_with_SA(int num_threads, void *input, workflow_SA_t *wf) {
      struct timeval start_time, stop_time;
      gettimeofday(&start_time, NULL);
 
+     // threads are pinned by themselves (affinity_pin_thread), and float
+     // with the none policy
      for(int i = 0; i < num_threads; i++){
-	  cpu_set_t cpu_set;
-	  CPU_ZERO( &cpu_set);
-	  CPU_SET( cpuArray[i % num_cpus], &cpu_set);
-	  sched_setaffinity(syscall(SYS_gettid), sizeof(cpu_set), &cpu_set);
-
 	  if ((ret = pthread_create(&threads[i], &attr, thread_function_SA, (void *) wf_context))) {
 	       printf("ERROR; return code from pthread_create() is %d\n", ret);
 	       exit(-1);
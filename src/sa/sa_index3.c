@@ -1,4 +1,7 @@
+#include <sys/mman.h>
+
 #include "sa_index3.h"
+#include "sa_shm.h"
 
 #include "options.h"
  
@@ -850,6 +853,15 @@ sa_index3_t *sa_index3_new(char *sa_index_dirname) {
   PREFIX_TABLE_NT_VALUE['G'] = 2;
   PREFIX_TABLE_NT_VALUE['T'] = 3;
 
+  // index previously loaded in shared memory (index-load command)
+  sa_index3_t *shm_index = sa_shm_attach(sa_index_dirname);
+  if (shm_index) {
+    if (affinity_get_policy() == NUMA_REPLICATE) {
+      sa_index3_replicate(shm_index);
+    }
+    return shm_index;
+  }
+
   sprintf(filename_tab, "%s/params.txt", sa_index_dirname);
   //printf("reading %s\n", filename_tab);
 
@@ -923,7 +935,7 @@ sa_index3_t *sa_index3_new(char *sa_index_dirname) {
 	exit(-1);
       }
       //  printf("genome: filename %s, length = %lu\n", filename_tab, genome_len);
-      S = (char *) malloc(genome_len);
+      S = (char *) sa_index3_table_alloc(genome_len);
   
       //printf("\nreading S from file %s...\n", filename_tab);
       gettimeofday(&start, NULL);
@@ -953,7 +965,7 @@ sa_index3_t *sa_index3_new(char *sa_index_dirname) {
       sprintf(filename_tab, "%s/%s.A", sa_index_dirname, prefix);
       f_tab = fopen(filename_tab, "rb");
       if (f_tab) {
-	A = (uint *) malloc(A_items * sizeof(uint));
+	A = (uint *) sa_index3_table_alloc(A_items * sizeof(uint));
 	
 	//	printf("\nreading A table (Compression Row Storage) from file %s...\n", filename_tab);
 	gettimeofday(&start, NULL);
@@ -974,7 +986,7 @@ sa_index3_t *sa_index3_new(char *sa_index_dirname) {
       sprintf(filename_tab, "%s/%s.IA", sa_index_dirname, prefix);
       f_tab = fopen(filename_tab, "rb");
       if (f_tab) {
-	IA = (uint *) malloc(IA_items * sizeof(uint));
+	IA = (uint *) sa_index3_table_alloc(IA_items * sizeof(uint));
 	
 	//	printf("\nreading IA table (Compression Row Storage) from file %s...\n", filename_tab);
 	gettimeofday(&start, NULL);
@@ -1005,7 +1017,7 @@ sa_index3_t *sa_index3_new(char *sa_index_dirname) {
 	exit(-1);
       }
       //      printf("SA: filename %s, num_suffixes = %lu\n", filename_tab, num_suffixes);
-      SA = (uint *) malloc(num_suffixes * sizeof(uint));
+      SA = (uint *) sa_index3_table_alloc(num_suffixes * sizeof(uint));
   
       //      printf("\nreading SA table from file %s...\n", filename_tab);
       gettimeofday(&start, NULL);
@@ -1029,7 +1041,7 @@ sa_index3_t *sa_index3_new(char *sa_index_dirname) {
 	exit(-1);
       }
       //      printf("CHROM: filename %s, num_suffixes = %lu\n", filename_tab, num_suffixes);
-      CHROM = (unsigned char *) malloc(num_suffixes * sizeof(unsigned char));
+      CHROM = (unsigned char *) sa_index3_table_alloc(num_suffixes * sizeof(unsigned char));
       
       //      printf("\nreading CHROM table from file %s...\n", filename_tab);
       gettimeofday(&start, NULL);
@@ -1052,7 +1064,7 @@ sa_index3_t *sa_index3_new(char *sa_index_dirname) {
       if (f_tab) {
 	num_items = 1LLU << (2 * k_value);
 	assert(num_items == pre_length);
-	PRE = (uint *) malloc(num_items * sizeof(uint));
+	PRE = (uint *) sa_index3_table_alloc(num_items * sizeof(uint));
 	
 	//	printf("\nreading PRE table from file %s...\n", filename_tab);
 	gettimeofday(&start, NULL);
@@ -1073,7 +1085,7 @@ sa_index3_t *sa_index3_new(char *sa_index_dirname) {
       sprintf(filename_tab, "%s/%s.JA", sa_index_dirname, prefix);
       f_tab = fopen(filename_tab, "rb");
       if (f_tab) {
-	JA = (unsigned char *) malloc(A_items * sizeof(unsigned char));
+	JA = (unsigned char *) sa_index3_table_alloc(A_items * sizeof(unsigned char));
 	
 	//	printf("\nreading JA table (Compression Row Storage) from file %s...\n", filename_tab);
 	gettimeofday(&start, NULL);
@@ -1107,15 +1119,53 @@ sa_index3_t *sa_index3_new(char *sa_index_dirname) {
   p->IA = IA;
   p->JA = JA;
   p->genome = genome;
+  p->num_replicas = 1;
+  p->replicas = NULL;
+  p->shm = NULL;
+  p->shm_size = 0;
+
+  if (affinity_get_policy() == NUMA_REPLICATE) {
+    sa_index3_replicate(p);
+  }
 
   return p;
 }
 
 
+//--------------------------------------------------------------------------------------
+
+static inline void sa_index3_replica_free(sa_index3_t *p) {
+  affinity_free_on_node(p->SA, p->num_suffixes * sizeof(uint));
+  affinity_free_on_node(p->CHROM, p->num_suffixes * sizeof(unsigned char));
+  affinity_free_on_node(p->PRE, p->prefix_length * sizeof(uint));
+  affinity_free_on_node(p->A, p->A_items * sizeof(uint));
+  affinity_free_on_node(p->IA, p->IA_items * sizeof(uint));
+  affinity_free_on_node(p->JA, p->A_items * sizeof(unsigned char));
+  affinity_free_on_node(p->genome->S, p->genome->length);
+  free(p->genome);
+  free(p);
+}
+
 //--------------------------------------------------------------------------------------
 
 void sa_index3_free(sa_index3_t *p) {
   if (p) {
+
+    if (p->replicas) {
+      for (int i = 1; i < p->num_replicas; i++) {
+	sa_index3_replica_free(p->replicas[i]);
+      }
+      free(p->replicas);
+    }
+
+    if (p->shm) {
+      // the tables and the genome sequence belong to the segment
+      p->genome->S = NULL;
+      sa_genome3_free(p->genome);
+      munmap(p->shm, p->shm_size);
+      free(p);
+      return;
+    }
     
     if (p->SA) free(p->SA);
     if (p->CHROM) free(p->CHROM);
@@ -1129,6 +1179,78 @@ void sa_index3_free(sa_index3_t *p) {
   }
 }
 
+//--------------------------------------------------------------------------------------
+
+static inline void *table_copy_on_node(void *src, size_t size, int node) {
+  if (!src) return NULL;
+  void *dst = affinity_alloc_on_node(size, node);
+  memcpy(dst, src, size);
+  return dst;
+}
+
+//--------------------------------------------------------------------------------------
+// copies the index tables on each NUMA node (the index itself is placed on node 0),
+// the genome metadata (chromosome names, lengths...) is shared
+//--------------------------------------------------------------------------------------
+
+void sa_index3_replicate(sa_index3_t *p) {
+  int num_nodes = affinity_get_num_nodes();
+  if (num_nodes <= 1) return;
+
+  p->num_replicas = num_nodes;
+  p->replicas = (sa_index3_t **) calloc(num_nodes, sizeof(sa_index3_t *));
+  p->replicas[0] = p;
+
+  #pragma omp parallel for num_threads(num_nodes)
+  for (int node = 1; node < num_nodes; node++) {
+    sa_index3_t *r = (sa_index3_t *) malloc(sizeof(sa_index3_t));
+    memcpy(r, p, sizeof(sa_index3_t));
+    r->num_replicas = 0;
+    r->replicas = NULL;
+    r->shm = NULL;
+
+    r->SA = table_copy_on_node(p->SA, p->num_suffixes * sizeof(uint), node);
+    r->CHROM = table_copy_on_node(p->CHROM, p->num_suffixes * sizeof(unsigned char), node);
+    r->PRE = table_copy_on_node(p->PRE, p->prefix_length * sizeof(uint), node);
+    r->A = table_copy_on_node(p->A, p->A_items * sizeof(uint), node);
+    r->IA = table_copy_on_node(p->IA, p->IA_items * sizeof(uint), node);
+    r->JA = table_copy_on_node(p->JA, p->A_items * sizeof(unsigned char), node);
+
+    r->genome = (sa_genome3_t *) malloc(sizeof(sa_genome3_t));
+    memcpy(r->genome, p->genome, sizeof(sa_genome3_t));
+    r->genome->S = table_copy_on_node(p->genome->S, p->genome->length, node);
+
+    p->replicas[node] = r;
+  }
+}
+
+//--------------------------------------------------------------------------------------
+
+void sa_index3_display_placement(sa_index3_t *p) {
+  size_t node_bytes[AFFINITY_MAX_NODES];
+  int num_nodes = affinity_get_num_nodes();
+
+  for (int i = 0; i < p->num_replicas; i++) {
+    sa_index3_t *r = (p->replicas ? p->replicas[i] : p);
+
+    memset(node_bytes, 0, sizeof(node_bytes));
+    affinity_placement(r->SA, r->num_suffixes * sizeof(uint), node_bytes);
+    affinity_placement(r->CHROM, r->num_suffixes * sizeof(unsigned char), node_bytes);
+    affinity_placement(r->PRE, r->prefix_length * sizeof(uint), node_bytes);
+    affinity_placement(r->A, r->A_items * sizeof(uint), node_bytes);
+    affinity_placement(r->IA, r->IA_items * sizeof(uint), node_bytes);
+    affinity_placement(r->JA, r->A_items * sizeof(unsigned char), node_bytes);
+    affinity_placement(r->genome->S, r->genome->length, node_bytes);
+
+    printf("\tSA index%s:", (p->replicas ? " replica" : ""));
+    if (p->replicas) printf(" %i:", i);
+    for (int node = 0; node < num_nodes; node++) {
+      printf(" node %i = %0.2f GB", affinity_node_id(node), node_bytes[node] / 1073741824.0f);
+    }
+    printf("\n");
+  }
+}
+
 //--------------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------------
 
@@ -10,6 +10,7 @@
 #include <assert.h>
 
 #include "sa_tools.h"
+#include "affinity.h"
 
 //--------------------------------------------------------------------------------------
 
@@ -202,8 +203,31 @@ typedef struct sa_index3 {
   uint *IA;
   unsigned char *JA;
   sa_genome3_t *genome;
+
+  // per-node copies (--numa replicate), replicas[0] is the index itself
+  int num_replicas;
+  struct sa_index3 **replicas;
+
+  // mapping of the shared memory segment (index-load) the tables point to
+  void *shm;
+  size_t shm_size;
 } sa_index3_t;
 
+//--------------------------------------------------------------------------------------
+// allocates an index table according to the NUMA policy, the pages are
+// placed when first touched (i.e., when reading the table from file)
+//--------------------------------------------------------------------------------------
+
+static inline void *sa_index3_table_alloc(size_t size) {
+  void *p = malloc(size);
+  if (affinity_get_policy() == NUMA_INTERLEAVE) {
+    affinity_interleave(p, size);
+  } else if (affinity_get_policy() == NUMA_REPLICATE) {
+    affinity_bind(p, size, 0);
+  }
+  return p;
+}
+
 //--------------------------------------------------------------------------------------
 
 void sa_index3_build(char *genome_filename, uint k_value, char *sa_index_dirname);
@@ -215,6 +239,20 @@ sa_index3_t *sa_index3_parallel_new(char *sa_index_dirname, int num_threads);
 sa_index3_t *sa_index3_new(char *sa_index_dirname);
 void sa_index3_free(sa_index3_t *sa_index);
 
+void sa_index3_replicate(sa_index3_t *sa_index);
+void sa_index3_display_placement(sa_index3_t *sa_index);
+
+//--------------------------------------------------------------------------------------
+// returns the index copy placed on the node of the calling thread
+//--------------------------------------------------------------------------------------
+
+static inline sa_index3_t *sa_index3_local(sa_index3_t *p) {
+  if (p->replicas) {
+    return p->replicas[affinity_thread_node() % p->num_replicas];
+  }
+  return p;
+}
+
 //--------------------------------------------------------------------------------------
 
 static inline void sa_index3_display(sa_index3_t *p) {
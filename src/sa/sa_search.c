@@ -77,27 +77,17 @@ size_t search_prefix(char *sequence, size_t *low, size_t *high,
 size_t search_suffix(char *seq, uint len, int max_num_suffixes,
 		     sa_index3_t *sa_index, 
 		     size_t *low, size_t *high, size_t *suffix_len
-                     #ifdef _TIMING
-		     , double *prefix_time, double *suffix_time
-                     #endif
 		     ) {
-  #ifdef _TIMING
-  struct timeval stop, start;
-  #endif
+  uint64_t start;
 
   int display = 1;
   char *ref, *query;
   size_t num_suffixes = 0;
   uint matched, max_matched = 0;
 
-  #ifdef _TIMING
-  gettimeofday(&start, NULL);
-  #endif
+  PROFILE_START(start);
   size_t num_prefixes = search_prefix(seq, low, high, sa_index, display);
-  #ifdef _TIMING
-  gettimeofday(&stop, NULL);
-  *prefix_time = ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-  #endif
+  PROFILE_STOP(FUNC_SEARCH_PREFIX, start);
 
   #ifdef _VERBOSE	  
   printf("\t\tnum. prefixes = %lu\n", num_prefixes);
@@ -111,9 +101,7 @@ size_t search_suffix(char *seq, uint len, int max_num_suffixes,
     //    *suffix_len = sa_index->k_value;
     //    return num_prefixes;
     
-    #ifdef _TIMING
-    gettimeofday(&start, NULL);
-    #endif
+    PROFILE_START(start);
 
 
     #ifdef _VERBOSE1	  
@@ -173,10 +161,7 @@ size_t search_suffix(char *seq, uint len, int max_num_suffixes,
       }
     }
 
-    #ifdef _TIMING
-    gettimeofday(&stop, NULL);
-    *suffix_time = ((stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1000000.0f);  
-    #endif
+    PROFILE_STOP(FUNC_SEARCH_SA, start);
   }
 
   //  printf("\t\tnum_prefixes = %i, (num_suffixes = %i, length = %i)\n",
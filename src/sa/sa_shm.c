@@ -0,0 +1,416 @@
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+
+#include "sa_shm.h"
+
+//--------------------------------------------------------------------------------------
+
+typedef struct sa_shm_params {
+  char prefix[1024];
+  uint k_value;
+  uint prefix_length;
+  uint A_items;
+  uint IA_items;
+  uint num_suffixes;
+  uint num_chroms;
+  size_t genome_length;
+  size_t *chrom_lengths;
+  char **chrom_names;
+  size_t names_size;
+  time_t mtime;
+} sa_shm_params_t;
+
+//--------------------------------------------------------------------------------------
+
+static int sa_shm_read_params(char *dirname, sa_shm_params_t *params) {
+  char line[1024], filename[strlen(dirname) + 1024];
+  struct stat st;
+
+  memset(params, 0, sizeof(sa_shm_params_t));
+
+  sprintf(filename, "%s/params.txt", dirname);
+  if (stat(filename, &st) != 0) return -1;
+
+  FILE *f = fopen(filename, "r");
+  if (!f) return -1;
+
+  params->mtime = st.st_mtime;
+
+  if (!fgets(line, 1024, f)) { fclose(f); return -1; }
+  line[strlen(line) - 1] = 0;
+  strcpy(params->prefix, line);
+
+  if (!fgets(line, 1024, f)) { fclose(f); return -1; }
+  params->k_value = atoi(line);
+  if (!fgets(line, 1024, f)) { fclose(f); return -1; }
+  params->prefix_length = atoi(line);
+  if (!fgets(line, 1024, f)) { fclose(f); return -1; }
+  params->A_items = atoi(line);
+  if (!fgets(line, 1024, f)) { fclose(f); return -1; }
+  params->IA_items = atol(line);
+  if (!fgets(line, 1024, f)) { fclose(f); return -1; }
+  params->num_suffixes = atoi(line);
+  if (!fgets(line, 1024, f)) { fclose(f); return -1; }
+  params->genome_length = atol(line);
+  if (!fgets(line, 1024, f)) { fclose(f); return -1; }
+  params->num_chroms = atoi(line);
+
+  char chrom_name[1024];
+  size_t chrom_len;
+
+  params->chrom_lengths = (size_t *) calloc(params->num_chroms, sizeof(size_t));
+  params->chrom_names = (char **) calloc(params->num_chroms, sizeof(char *));
+  for (int i = 0; i < params->num_chroms; i++) {
+    if (!fgets(line, 1024, f)) { fclose(f); return -1; }
+    sscanf(line, "%s %lu\n", chrom_name, &chrom_len);
+    params->chrom_names[i] = strdup(chrom_name);
+    params->chrom_lengths[i] = chrom_len;
+    params->names_size += strlen(chrom_name) + 1;
+  }
+
+  fclose(f);
+  return 0;
+}
+
+//--------------------------------------------------------------------------------------
+
+static void sa_shm_params_free(sa_shm_params_t *params) {
+  if (params->chrom_names) {
+    for (int i = 0; i < params->num_chroms; i++) {
+      if (params->chrom_names[i]) free(params->chrom_names[i]);
+    }
+    free(params->chrom_names);
+  }
+  if (params->chrom_lengths) free(params->chrom_lengths);
+}
+
+//--------------------------------------------------------------------------------------
+
+void sa_shm_name(char *sa_index_dirname, char *name) {
+  char path[PATH_MAX];
+  if (!realpath(sa_index_dirname, path)) {
+    strcpy(path, sa_index_dirname);
+  }
+
+  // FNV-1a
+  uint64_t hash = 14695981039346656037LLU;
+  for (char *c = path; *c; c++) {
+    hash ^= (unsigned char) *c;
+    hash *= 1099511628211LLU;
+  }
+  sprintf(name, "%s%016lx", SA_SHM_NAME_PREFIX, hash);
+}
+
+//--------------------------------------------------------------------------------------
+
+static void sa_shm_hugepages_filename(char *name, char *filename) {
+  sprintf(filename, "%s%s", SA_SHM_HUGEPAGES_DIR, name);
+}
+
+//--------------------------------------------------------------------------------------
+
+static inline size_t sa_shm_align(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+//--------------------------------------------------------------------------------------
+
+static int sa_shm_read_table(char *dirname, char *prefix, char *ext,
+			     void *dst, size_t size, int required) {
+  char filename[strlen(dirname) + 1024];
+  sprintf(filename, "%s/%s.%s", dirname, prefix, ext);
+
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    if (required) {
+      printf("Error: could not open %s to read\n", filename);
+      return -1;
+    }
+    return 0;
+  }
+
+  size_t num_items = fread(dst, sizeof(char), size, f);
+  fclose(f);
+
+  if (num_items != size) {
+    printf("Error: (%s) mismatch read %lu bytes (it must be %lu)\n",
+	   filename, num_items, size);
+    return -1;
+  }
+  return 1;
+}
+
+//--------------------------------------------------------------------------------------
+// index-load
+//--------------------------------------------------------------------------------------
+
+int sa_shm_load(char *sa_index_dirname, int hugepages) {
+  char name[256], filename[PATH_MAX + 256];
+  sa_shm_params_t params;
+
+  if (sa_shm_read_params(sa_index_dirname, &params)) {
+    printf("Error: could not read the SA index parameters in %s\n", sa_index_dirname);
+    sa_shm_params_free(&params);
+    return -1;
+  }
+
+  // layout: header + page-aligned tables
+  size_t alignment = SA_SHM_ALIGNMENT;
+  int fd;
+
+  sa_shm_name(sa_index_dirname, name);
+  if (hugepages) {
+    struct statfs fs;
+    if (statfs(SA_SHM_HUGEPAGES_DIR, &fs) != 0) {
+      printf("Error: hugetlbfs is not mounted on %s\n", SA_SHM_HUGEPAGES_DIR);
+      sa_shm_params_free(&params);
+      return -1;
+    }
+    alignment = fs.f_bsize;
+    sa_shm_hugepages_filename(name, filename);
+    fd = open(filename, O_CREAT | O_EXCL | O_RDWR, 0644);
+  } else {
+    strcpy(filename, name);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  }
+
+  if (fd < 0) {
+    printf("Error: could not create the shared memory segment %s for %s (%s)%s\n",
+	   filename, sa_index_dirname, strerror(errno),
+	   (errno == EEXIST ? ", run index-unload first" : ""));
+    sa_shm_params_free(&params);
+    return -1;
+  }
+
+  size_t sizes[NUM_SA_SHM_TABLES], offsets[NUM_SA_SHM_TABLES];
+  sizes[SA_SHM_SA] = params.num_suffixes * sizeof(uint);
+  sizes[SA_SHM_CHROM] = params.num_suffixes * sizeof(unsigned char);
+  sizes[SA_SHM_PRE] = params.prefix_length * sizeof(uint);
+  sizes[SA_SHM_A] = params.A_items * sizeof(uint);
+  sizes[SA_SHM_IA] = params.IA_items * sizeof(uint);
+  sizes[SA_SHM_JA] = params.A_items * sizeof(unsigned char);
+  sizes[SA_SHM_S] = params.genome_length;
+  sizes[SA_SHM_CHROM_LENGTHS] = params.num_chroms * sizeof(size_t);
+  sizes[SA_SHM_CHROM_NAMES] = params.names_size;
+
+  size_t size = sa_shm_align(sizeof(sa_shm_header_t), alignment);
+  for (int i = 0; i < NUM_SA_SHM_TABLES; i++) {
+    offsets[i] = size;
+    size += sa_shm_align(sizes[i], alignment);
+  }
+
+  if (ftruncate(fd, size) != 0) {
+    printf("Error: could not allocate %0.2f GB for the shared memory segment %s (%s)\n",
+	   size / 1073741824.0f, filename, strerror(errno));
+    close(fd);
+    if (hugepages) unlink(filename); else shm_unlink(name);
+    sa_shm_params_free(&params);
+    return -1;
+  }
+
+  char *base = (char *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    printf("Error: could not map the shared memory segment %s (%s)\n",
+	   filename, strerror(errno));
+    if (hugepages) unlink(filename); else shm_unlink(name);
+    sa_shm_params_free(&params);
+    return -1;
+  }
+
+  sa_shm_header_t *header = (sa_shm_header_t *) base;
+  header->magic = SA_SHM_MAGIC;
+  header->version = SA_SHM_VERSION;
+  header->ready = 0;
+  header->size = size;
+  header->hugepages = hugepages;
+  char path[PATH_MAX];
+  if (!realpath(sa_index_dirname, path)) {
+    strcpy(path, sa_index_dirname);
+  }
+  strncpy(header->dirname, path, SA_SHM_MAX_PATH - 1);
+  header->params_mtime = params.mtime;
+  header->k_value = params.k_value;
+  header->prefix_length = params.prefix_length;
+  header->A_items = params.A_items;
+  header->IA_items = params.IA_items;
+  header->num_suffixes = params.num_suffixes;
+  header->num_chroms = params.num_chroms;
+  header->genome_length = params.genome_length;
+  memcpy(header->offsets, offsets, sizeof(offsets));
+  memcpy(header->sizes, sizes, sizeof(sizes));
+
+  // read the tables straight into the segment
+  int res[NUM_SA_SHM_TABLES];
+  char *exts[] = {"SA", "CHROM", "PRE", "A", "IA", "JA", "S"};
+  int required[] = {1, 1, 0, 0, 0, 0, 1};
+
+  #pragma omp parallel for num_threads(4) schedule(dynamic)
+  for (int i = 0; i <= SA_SHM_S; i++) {
+    res[i] = sa_shm_read_table(sa_index_dirname, params.prefix, exts[i],
+			       base + offsets[i], sizes[i], required[i]);
+  }
+
+  for (int i = 0; i <= SA_SHM_S; i++) {
+    if (res[i] < 0) {
+      munmap(base, size);
+      if (hugepages) unlink(filename); else shm_unlink(name);
+      sa_shm_params_free(&params);
+      return -1;
+    }
+    // optional tables not present in the index
+    if (res[i] == 0) header->sizes[i] = 0;
+  }
+
+  char *S = base + offsets[SA_SHM_S];
+  for (size_t i = 0; i < params.genome_length; i++) {
+    if (S[i] == 'N' || S[i] == 'n') {
+      S[i] = 'A';
+    }
+  }
+
+  memcpy(base + offsets[SA_SHM_CHROM_LENGTHS], params.chrom_lengths,
+	 sizes[SA_SHM_CHROM_LENGTHS]);
+  char *names = base + offsets[SA_SHM_CHROM_NAMES];
+  for (int i = 0; i < params.num_chroms; i++) {
+    strcpy(names, params.chrom_names[i]);
+    names += strlen(params.chrom_names[i]) + 1;
+  }
+
+  __sync_synchronize();
+  header->ready = 1;
+
+  printf("SA index %s loaded in %s (%0.2f GB%s)\n", header->dirname, filename,
+	 size / 1073741824.0f, (hugepages ? ", hugepages" : ""));
+
+  munmap(base, size);
+  sa_shm_params_free(&params);
+  return 0;
+}
+
+//--------------------------------------------------------------------------------------
+// index-unload
+//--------------------------------------------------------------------------------------
+
+int sa_shm_unload(char *sa_index_dirname) {
+  char name[256], filename[PATH_MAX + 256];
+  int found = 0;
+
+  sa_shm_name(sa_index_dirname, name);
+  if (shm_unlink(name) == 0) {
+    printf("SA index %s unloaded from %s\n", sa_index_dirname, name);
+    found = 1;
+  }
+
+  sa_shm_hugepages_filename(name, filename);
+  if (unlink(filename) == 0) {
+    printf("SA index %s unloaded from %s\n", sa_index_dirname, filename);
+    found = 1;
+  }
+
+  if (!found) {
+    printf("Error: SA index %s is not loaded in shared memory\n", sa_index_dirname);
+    return -1;
+  }
+  return 0;
+}
+
+//--------------------------------------------------------------------------------------
+// attach
+//--------------------------------------------------------------------------------------
+
+static void *sa_shm_map(char *sa_index_dirname, size_t *size) {
+  char name[256], filename[PATH_MAX + 256];
+  struct stat st;
+
+  sa_shm_name(sa_index_dirname, name);
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    sa_shm_hugepages_filename(name, filename);
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+  }
+
+  if (fstat(fd, &st) != 0 || st.st_size < sizeof(sa_shm_header_t)) {
+    close(fd);
+    return NULL;
+  }
+
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return NULL;
+
+  *size = st.st_size;
+  return base;
+}
+
+//--------------------------------------------------------------------------------------
+
+sa_index3_t *sa_shm_attach(char *sa_index_dirname) {
+  size_t size;
+  char *base = (char *) sa_shm_map(sa_index_dirname, &size);
+  if (!base) return NULL;
+
+  sa_shm_header_t *header = (sa_shm_header_t *) base;
+
+  // the segment must be complete and come from the current index files
+  char path[PATH_MAX], filename[strlen(sa_index_dirname) + 1024];
+  struct stat st;
+
+  sprintf(filename, "%s/params.txt", sa_index_dirname);
+  if (header->magic != SA_SHM_MAGIC || header->version != SA_SHM_VERSION ||
+      !header->ready || header->size != size ||
+      !realpath(sa_index_dirname, path) || strcmp(path, header->dirname) ||
+      stat(filename, &st) != 0 || st.st_mtime != header->params_mtime) {
+    printf("Warning: ignoring stale shared memory segment for SA index %s\n",
+	   sa_index_dirname);
+    munmap(base, size);
+    return NULL;
+  }
+
+  size_t num_chroms = header->num_chroms;
+  size_t *chrom_lengths = (size_t *) malloc(num_chroms * sizeof(size_t));
+  char **chrom_names = (char **) malloc(num_chroms * sizeof(char *));
+
+  memcpy(chrom_lengths, base + header->offsets[SA_SHM_CHROM_LENGTHS],
+	 num_chroms * sizeof(size_t));
+  char *names = base + header->offsets[SA_SHM_CHROM_NAMES];
+  for (int i = 0; i < num_chroms; i++) {
+    chrom_names[i] = strdup(names);
+    names += strlen(names) + 1;
+  }
+
+  sa_index3_t *p = (sa_index3_t *) malloc(sizeof(sa_index3_t));
+
+  p->num_suffixes = header->num_suffixes;
+  p->prefix_length = header->prefix_length;
+  p->A_items = header->A_items;
+  p->IA_items = header->IA_items;
+  p->k_value = header->k_value;
+  p->SA = (uint *) (base + header->offsets[SA_SHM_SA]);
+  p->CHROM = (unsigned char *) (base + header->offsets[SA_SHM_CHROM]);
+  p->PRE = (header->sizes[SA_SHM_PRE] ? (uint *) (base + header->offsets[SA_SHM_PRE]) : NULL);
+  p->A = (header->sizes[SA_SHM_A] ? (uint *) (base + header->offsets[SA_SHM_A]) : NULL);
+  p->IA = (header->sizes[SA_SHM_IA] ? (uint *) (base + header->offsets[SA_SHM_IA]) : NULL);
+  p->JA = (header->sizes[SA_SHM_JA] ? (unsigned char *) (base + header->offsets[SA_SHM_JA]) : NULL);
+  p->genome = sa_genome3_new(header->genome_length, num_chroms, chrom_lengths,
+			     chrom_names, base + header->offsets[SA_SHM_S]);
+  p->num_replicas = 1;
+  p->replicas = NULL;
+  p->shm = base;
+  p->shm_size = size;
+
+  printf("SA index %s attached from shared memory (%0.2f GB%s)\n", sa_index_dirname,
+	 size / 1073741824.0f, (header->hugepages ? ", hugepages" : ""));
+
+  return p;
+}
+
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,83 @@
+#ifndef SA_SHM_H
+#define SA_SHM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "sa_index3.h"
+
+//--------------------------------------------------------------------------------------
+// SA index in shared memory (index-load / index-unload commands)
+//
+// index-load reads the SA index tables and the genome into one named segment (POSIX
+// shared memory, or a file on a hugetlbfs mount with --hugepages) that outlives the
+// process; sa_index3_new attaches to it (read-only) when it exists, so every aligner
+// process on the host shares one copy of the index and skips the loading
+//
+// the segment name is derived from the absolute path of the index directory
+//--------------------------------------------------------------------------------------
+
+#define SA_SHM_MAGIC          0x4850475341534d31LLU  // "HPGSASM1"
+#define SA_SHM_VERSION        1
+#define SA_SHM_NAME_PREFIX    "/hpg-aligner-sa-"
+#define SA_SHM_HUGEPAGES_DIR  "/dev/hugepages"
+#define SA_SHM_MAX_PATH       1024
+#define SA_SHM_ALIGNMENT      4096
+
+// tables in the segment
+#define SA_SHM_SA             0
+#define SA_SHM_CHROM          1
+#define SA_SHM_PRE            2
+#define SA_SHM_A              3
+#define SA_SHM_IA             4
+#define SA_SHM_JA             5
+#define SA_SHM_S              6
+#define SA_SHM_CHROM_LENGTHS  7
+#define SA_SHM_CHROM_NAMES    8  // consecutive NUL-terminated names
+
+#define NUM_SA_SHM_TABLES (SA_SHM_CHROM_NAMES + 1)
+
+//--------------------------------------------------------------------------------------
+
+typedef struct sa_shm_header {
+  uint64_t magic;
+  uint32_t version;
+  volatile uint32_t ready;    // set when all the tables are in place
+  size_t size;
+  int hugepages;
+
+  char dirname[SA_SHM_MAX_PATH];
+  time_t params_mtime;        // params.txt of the index when it was loaded
+
+  uint k_value;
+  uint prefix_length;
+  uint A_items;
+  uint IA_items;
+  uint num_suffixes;
+  uint num_chroms;
+  size_t genome_length;
+
+  size_t offsets[NUM_SA_SHM_TABLES];
+  size_t sizes[NUM_SA_SHM_TABLES];
+} sa_shm_header_t;
+
+//--------------------------------------------------------------------------------------
+
+// creates the segment for the index in 'sa_index_dirname', returns 0 on success
+int sa_shm_load(char *sa_index_dirname, int hugepages);
+
+// removes the segment (attached processes keep their mapping until they exit)
+int sa_shm_unload(char *sa_index_dirname);
+
+// returns the index mapped from the segment or NULL when there is no valid segment
+sa_index3_t *sa_shm_attach(char *sa_index_dirname);
+
+// segment name for an index directory
+void sa_shm_name(char *sa_index_dirname, char *name);
+
+//--------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+
+#endif // SA_SHM_H
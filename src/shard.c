@@ -0,0 +1,641 @@
+#include <zlib.h>
+#include <sys/stat.h>
+
+#include "shard.h"
+
+//--------------------------------------------------------------------
+// arguments
+//--------------------------------------------------------------------
+
+void parse_shard(char *str, int *index, int *count) {
+  int i, n;
+  char c;
+  if (!str || sscanf(str, "%d/%d%c", &i, &n, &c) != 2 || n < 1 || i < 1 || i > n) {
+    printf("Invalid shard '%s'. It must be i/N, with 1 <= i <= N\n", (str ? str : ""));
+    exit(-1);
+  }
+  *index = i - 1;
+  *count = n;
+}
+
+//--------------------------------------------------------------------
+
+void shard_name(int index, int count, char *name) {
+  int digits = 1;
+  for (int n = count; n >= 10; n /= 10) digits++;
+  snprintf(name, SHARD_NAME_LENGTH, "shard-%0*i-of-%i", digits, index + 1, count);
+}
+
+//--------------------------------------------------------------------
+// shard_file_t: sequential reader over plain or BGZF files, the
+// positions are byte offsets or virtual offsets respectively
+//--------------------------------------------------------------------
+
+static inline int is_bgzf_header(unsigned char *h) {
+  return (h[0] == 31 && h[1] == 139 && h[2] == 8 && (h[3] & 4) &&
+	  h[10] == 6 && h[11] == 0 && h[12] == 'B' && h[13] == 'C' &&
+	  h[14] == 2 && h[15] == 0);
+}
+
+//--------------------------------------------------------------------
+
+static shard_file_t *shard_file_new(char *filename) {
+  FILE *fd = fopen(filename, "rb");
+  if (!fd) {
+    printf("Error: could not open %s to read\n", filename);
+    exit(-1);
+  }
+
+  struct stat st;
+  fstat(fileno(fd), &st);
+
+  unsigned char header[SHARD_BGZF_HEADER_SIZE];
+  size_t n = fread(header, 1, SHARD_BGZF_HEADER_SIZE, fd);
+
+  shard_file_t *p = (shard_file_t *) calloc(1, sizeof(shard_file_t));
+  p->fd = fd;
+  p->file_size = st.st_size;
+  p->format = SHARD_PLAIN;
+  if (n >= 2 && header[0] == 31 && header[1] == 139) {
+    if (n < SHARD_BGZF_HEADER_SIZE || !is_bgzf_header(header)) {
+      printf("Error: %s is gzip compressed but not BGZF, it can not be sharded (compress it with bgzip)\n",
+	     filename);
+      exit(-1);
+    }
+    p->format = SHARD_BGZF;
+  }
+
+  p->compressed = (unsigned char *) malloc(SHARD_BGZF_MAX_BLOCK);
+  p->block = (unsigned char *) malloc(SHARD_BGZF_MAX_BLOCK);
+  for (int i = 0; i < 4; i++) {
+    p->lines_size[i] = 1024;
+    p->lines[i] = (char *) malloc(p->lines_size[i]);
+  }
+  p->start = 0;
+  p->end = SHARD_END;
+
+  return p;
+}
+
+//--------------------------------------------------------------------
+
+static void shard_file_free(shard_file_t *p) {
+  if (p) {
+    if (p->fd) fclose(p->fd);
+    free(p->compressed);
+    free(p->block);
+    for (int i = 0; i < 4; i++) {
+      free(p->lines[i]);
+    }
+    free(p);
+  }
+}
+
+//--------------------------------------------------------------------
+// loads the block at 'address', returns 0 at the end of file
+//--------------------------------------------------------------------
+
+static int shard_file_load(shard_file_t *f, uint64_t address) {
+  f->block_address = address;
+  f->next_block_address = address;
+  f->block_length = 0;
+  f->block_offset = 0;
+
+  if (address >= f->file_size) return 0;
+  fseeko(f->fd, address, SEEK_SET);
+
+  if (f->format == SHARD_PLAIN) {
+    f->block_length = fread(f->block, 1, SHARD_BGZF_MAX_BLOCK, f->fd);
+    f->next_block_address = address + f->block_length;
+    return (f->block_length > 0);
+  }
+
+  unsigned char *h = f->compressed;
+  if (fread(h, 1, SHARD_BGZF_HEADER_SIZE, f->fd) != SHARD_BGZF_HEADER_SIZE ||
+      !is_bgzf_header(h)) {
+    printf("Error: invalid BGZF block at offset %lu\n", address);
+    exit(-1);
+  }
+  int block_size = (h[16] | (h[17] << 8)) + 1;
+  int remaining = block_size - SHARD_BGZF_HEADER_SIZE;
+  if (fread(h + SHARD_BGZF_HEADER_SIZE, 1, remaining, f->fd) != remaining) {
+    printf("Error: truncated BGZF block at offset %lu\n", address);
+    exit(-1);
+  }
+
+  z_stream zs;
+  memset(&zs, 0, sizeof(z_stream));
+  inflateInit2(&zs, -15);
+  zs.next_in = h + SHARD_BGZF_HEADER_SIZE;
+  zs.avail_in = block_size - SHARD_BGZF_HEADER_SIZE - SHARD_BGZF_FOOTER_SIZE;
+  zs.next_out = f->block;
+  zs.avail_out = SHARD_BGZF_MAX_BLOCK;
+  int ret = inflate(&zs, Z_FINISH);
+  inflateEnd(&zs);
+  if (ret != Z_STREAM_END) {
+    printf("Error: could not inflate the BGZF block at offset %lu\n", address);
+    exit(-1);
+  }
+
+  f->block_length = SHARD_BGZF_MAX_BLOCK - zs.avail_out;
+  f->next_block_address = address + block_size;
+  return 1;
+}
+
+//--------------------------------------------------------------------
+// makes sure there is data in the current block (skipping empty
+// blocks), returns 0 at the end of file
+//--------------------------------------------------------------------
+
+static inline int shard_file_fill(shard_file_t *f) {
+  while (f->block_offset >= f->block_length) {
+    if (f->next_block_address >= f->file_size) return 0;
+    shard_file_load(f, f->next_block_address);
+  }
+  return 1;
+}
+
+//--------------------------------------------------------------------
+
+static uint64_t shard_file_tell(shard_file_t *f) {
+  shard_file_fill(f);
+  if (f->format == SHARD_PLAIN) {
+    return f->block_address + f->block_offset;
+  }
+  return (f->block_address << 16) | f->block_offset;
+}
+
+//--------------------------------------------------------------------
+
+static void shard_file_seek(shard_file_t *f, uint64_t pos) {
+  if (f->format == SHARD_PLAIN) {
+    shard_file_load(f, pos);
+  } else {
+    shard_file_load(f, pos >> 16);
+    f->block_offset = pos & 0xFFFF;
+  }
+}
+
+//--------------------------------------------------------------------
+// reads a line (without the new line) in f->lines[k], returns its
+// length or -1 at the end of file
+//--------------------------------------------------------------------
+
+static int shard_file_getline(shard_file_t *f, int k) {
+  size_t len = 0;
+  int eol = 0;
+  while (shard_file_fill(f)) {
+    unsigned char *p = f->block + f->block_offset;
+    size_t avail = f->block_length - f->block_offset;
+    unsigned char *nl = (unsigned char *) memchr(p, '\n', avail);
+    size_t n = (nl ? nl - p : avail);
+
+    if (len + n + 1 > f->lines_size[k]) {
+      f->lines_size[k] = 2 * (len + n + 1);
+      f->lines[k] = (char *) realloc(f->lines[k], f->lines_size[k]);
+    }
+    memcpy(f->lines[k] + len, p, n);
+    len += n;
+    f->block_offset += n + (nl ? 1 : 0);
+    if (nl) {
+      eol = 1;
+      break;
+    }
+  }
+
+  if (len == 0 && !eol) return -1;
+  if (len && f->lines[k][len - 1] == '\r') len--;
+  f->lines[k][len] = 0;
+  return len;
+}
+
+//--------------------------------------------------------------------
+
+static inline void shard_file_swap_lines(shard_file_t *f, int i, int j) {
+  char *line = f->lines[i];
+  size_t size = f->lines_size[i];
+  f->lines[i] = f->lines[j];
+  f->lines_size[i] = f->lines_size[j];
+  f->lines[j] = line;
+  f->lines_size[j] = size;
+}
+
+//--------------------------------------------------------------------
+// first BGZF block starting at or after 'address'
+//--------------------------------------------------------------------
+
+static uint64_t shard_bgzf_next_block(shard_file_t *f, uint64_t address) {
+  if (address == 0) return 0;
+
+  unsigned char *buffer = f->compressed;
+  unsigned char h[SHARD_BGZF_HEADER_SIZE];
+
+  while (address < f->file_size) {
+    fseeko(f->fd, address, SEEK_SET);
+    size_t n = fread(buffer, 1, SHARD_BGZF_MAX_BLOCK, f->fd);
+    if (n < SHARD_BGZF_HEADER_SIZE) break;
+
+    for (size_t i = 0; i + SHARD_BGZF_HEADER_SIZE <= n; i++) {
+      if (buffer[i] != 31 || !is_bgzf_header(buffer + i)) continue;
+
+      // the next block must start right after this one
+      uint64_t next = address + i + (buffer[i + 16] | (buffer[i + 17] << 8)) + 1;
+      if (next == f->file_size) return address + i;
+      if (next > f->file_size) continue;
+      fseeko(f->fd, next, SEEK_SET);
+      if (fread(h, 1, SHARD_BGZF_HEADER_SIZE, f->fd) == SHARD_BGZF_HEADER_SIZE &&
+	  is_bgzf_header(h)) {
+	return address + i;
+      }
+    }
+    address += n - SHARD_BGZF_HEADER_SIZE + 1;
+  }
+  return f->file_size;
+}
+
+//--------------------------------------------------------------------
+// FastQ
+//--------------------------------------------------------------------
+
+// reads a FastQ record in f->lines[0..3], returns 0 at the end of file
+static int shard_fastq_record(shard_file_t *f) {
+  if (shard_file_getline(f, 0) < 0) return 0;
+  if (f->lines[0][0] == 0 && shard_file_getline(f, 0) < 0) return 0;
+  for (int i = 1; i < 4; i++) {
+    if (shard_file_getline(f, i) < 0) {
+      printf("Error: truncated FastQ record '%s'\n", f->lines[0]);
+      exit(-1);
+    }
+  }
+  if (f->lines[0][0] != '@' || f->lines[2][0] != '+') {
+    printf("Error: malformed FastQ record '%s'\n", f->lines[0]);
+    exit(-1);
+  }
+  return 1;
+}
+
+//--------------------------------------------------------------------
+// read name without the leading '@', the comment and the mate suffix
+//--------------------------------------------------------------------
+
+static void shard_fastq_name(char *header, char *name, int max_len) {
+  int len = 0;
+  for (char *c = header + 1; *c && *c != ' ' && *c != '\t' && len < max_len - 1; c++) {
+    name[len++] = *c;
+  }
+  if (len > 2 && name[len - 2] == '/' && (name[len - 1] == '1' || name[len - 1] == '2')) {
+    len -= 2;
+  }
+  name[len] = 0;
+}
+
+//--------------------------------------------------------------------
+// position of the first record starting in the block at or after
+// 'address' (compressed offset for BGZF), SHARD_END if there is none;
+// the record header is left in f->lines[0]
+//--------------------------------------------------------------------
+
+static uint64_t shard_fastq_sync(shard_file_t *f, uint64_t address) {
+  uint64_t pos[4];
+
+  if (f->format == SHARD_BGZF) {
+    address = shard_bgzf_next_block(f, address);
+    shard_file_seek(f, address << 16);
+  } else {
+    shard_file_seek(f, address);
+  }
+
+  // skip the partial line
+  if (address > 0 && shard_file_getline(f, 0) < 0) return SHARD_END;
+
+  // sliding window of four lines: '@' header, sequence, '+' and quality
+  for (int i = 0; i < 4; i++) {
+    pos[i] = shard_file_tell(f);
+    if (shard_file_getline(f, i) < 0) return SHARD_END;
+  }
+  while (1) {
+    if (f->lines[0][0] == '@' && f->lines[2][0] == '+' &&
+	strlen(f->lines[1]) == strlen(f->lines[3])) {
+      return pos[0];
+    }
+    for (int i = 0; i < 3; i++) {
+      shard_file_swap_lines(f, i, i + 1);
+      pos[i] = pos[i + 1];
+    }
+    pos[3] = shard_file_tell(f);
+    if (shard_file_getline(f, 3) < 0) return SHARD_END;
+  }
+}
+
+//--------------------------------------------------------------------
+
+static inline uint64_t shard_address(uint64_t pos, int format) {
+  return (format == SHARD_PLAIN ? pos : pos >> 16);
+}
+
+//--------------------------------------------------------------------
+// position of the record 'name' (mate file), searched around the
+// compressed offset 'hint'
+//--------------------------------------------------------------------
+
+static uint64_t shard_fastq_find_mate(shard_file_t *f, char *name, uint64_t hint) {
+  char mate_name[1024];
+
+  for (uint64_t window = SHARD_MATE_WINDOW; ; window *= 2) {
+    uint64_t from = (hint > window ? hint - window : 0);
+    uint64_t to = hint + window;
+
+    uint64_t pos = shard_fastq_sync(f, from);
+    if (pos != SHARD_END) shard_file_seek(f, pos);
+    while (pos != SHARD_END && shard_address(pos, f->format) <= to) {
+      if (!shard_fastq_record(f)) break;
+      shard_fastq_name(f->lines[0], mate_name, 1024);
+      if (!strcmp(name, mate_name)) return pos;
+      pos = shard_file_tell(f);
+    }
+
+    if (from == 0 && to >= f->file_size) break;
+  }
+
+  printf("Error: mate of read '%s' not found, paired-end files must have the same reads in the same order\n",
+	 name);
+  exit(-1);
+}
+
+//--------------------------------------------------------------------
+
+static inline uint64_t shard_offset(size_t size, int k, int count) {
+  return (uint64_t) ((double) size * k / count);
+}
+
+//--------------------------------------------------------------------
+
+shard_t *shard_fastq_new(char *filename1, char *filename2, int index, int count) {
+  shard_t *p = (shard_t *) calloc(1, sizeof(shard_t));
+  p->index = index;
+  p->count = count;
+  p->num_files = (filename2 ? 2 : 1);
+  p->files[0] = shard_file_new(filename1);
+  if (filename2) p->files[1] = shard_file_new(filename2);
+
+  char name[1024];
+  for (int k = index; k <= index + 1; k++) {
+    uint64_t pos1 = 0, pos2 = 0;
+    if (k == count) {
+      pos1 = pos2 = SHARD_END;
+    } else if (k > 0) {
+      pos1 = shard_fastq_sync(p->files[0], shard_offset(p->files[0]->file_size, k, count));
+      pos2 = SHARD_END;
+      if (filename2 && pos1 != SHARD_END) {
+	shard_fastq_name(p->files[0]->lines[0], name, 1024);
+	pos2 = shard_fastq_find_mate(p->files[1], name,
+				     shard_offset(p->files[1]->file_size, k, count));
+      }
+    }
+    for (int i = 0; i < p->num_files; i++) {
+      if (k == index) {
+	p->files[i]->start = (i == 0 ? pos1 : pos2);
+      } else {
+	p->files[i]->end = (i == 0 ? pos1 : pos2);
+      }
+    }
+  }
+
+  for (int i = 0; i < p->num_files; i++) {
+    shard_file_t *f = p->files[i];
+    if (f->start == SHARD_END) {
+      // empty shard
+      f->start = f->end = 0;
+    }
+    shard_file_seek(f, f->start);
+  }
+
+  return p;
+}
+
+//--------------------------------------------------------------------
+
+size_t shard_fastq_read(array_list_t *reads, size_t batch_size, shard_t *shard) {
+  size_t bytes = 0;
+  char *id;
+
+  shard_file_t *f1 = shard->files[0], *f2 = shard->files[1];
+
+  while (bytes < batch_size) {
+    if (shard_file_tell(f1) >= f1->end) break;
+    if (!shard_fastq_record(f1)) break;
+
+    for (id = f1->lines[0] + 1; *id && *id != ' ' && *id != '\t'; id++);
+    *id = 0;
+    array_list_insert(fastq_read_new(f1->lines[0] + 1, f1->lines[1], f1->lines[3]), reads);
+    bytes += (id - f1->lines[0]) + 2 * strlen(f1->lines[1]);
+
+    if (f2) {
+      if (!shard_fastq_record(f2)) {
+	printf("Error: missing mate of read '%s', paired-end files must have the same number of reads\n",
+	       f1->lines[0] + 1);
+	exit(-1);
+      }
+      for (id = f2->lines[0] + 1; *id && *id != ' ' && *id != '\t'; id++);
+      *id = 0;
+      array_list_insert(fastq_read_new(f2->lines[0] + 1, f2->lines[1], f2->lines[3]), reads);
+      bytes += (id - f2->lines[0]) + 2 * strlen(f2->lines[1]);
+    }
+  }
+
+  return bytes;
+}
+
+//--------------------------------------------------------------------
+// BAM
+//--------------------------------------------------------------------
+
+static inline int32_t bam_int32(unsigned char *p) {
+  return (int32_t) (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24));
+}
+
+//--------------------------------------------------------------------
+// checks whether a BAM record starts at 'data', returns the record size
+// (block_size + 4), 0 if it is not valid or -1 if it can not be checked
+// (not enough data)
+//--------------------------------------------------------------------
+
+static int bam_record_check(unsigned char *data, size_t len, int n_targets) {
+  if (len < 36) return -1;
+
+  int32_t block_size = bam_int32(data);
+  int32_t ref_id = bam_int32(data + 4);
+  int32_t pos = bam_int32(data + 8);
+  int l_read_name = data[12];
+  int n_cigar_op = data[16] | (data[17] << 8);
+  int32_t l_seq = bam_int32(data + 20);
+  int32_t next_ref_id = bam_int32(data + 24);
+  int32_t next_pos = bam_int32(data + 28);
+
+  if (block_size < 32 || block_size > (1 << 24)) return 0;
+  if (ref_id < -1 || ref_id >= n_targets || pos < -1) return 0;
+  if (next_ref_id < -1 || next_ref_id >= n_targets || next_pos < -1) return 0;
+  if (l_read_name < 1 || l_seq < 0) return 0;
+  if (32 + l_read_name + 4 * n_cigar_op + (l_seq + 1) / 2 + l_seq > block_size) return 0;
+
+  if (len < 36 + l_read_name) return -1;
+  if (data[36 + l_read_name - 1] != 0) return 0;
+  for (int i = 0; i < l_read_name - 1; i++) {
+    if (data[36 + i] < 33 || data[36 + i] > 126) return 0;
+  }
+
+  return block_size + 4;
+}
+
+//--------------------------------------------------------------------
+// virtual offset of the first record starting in the block at or after
+// 'address' and not before 'min_pos', SHARD_END if there is none
+//--------------------------------------------------------------------
+
+#define SHARD_BAM_BLOCKS 4
+
+static uint64_t shard_bam_sync(shard_file_t *f, uint64_t address, uint64_t min_pos, int n_targets) {
+  unsigned char *data = (unsigned char *) malloc(SHARD_BAM_BLOCKS * SHARD_BGZF_MAX_BLOCK);
+  uint64_t block_addresses[SHARD_BAM_BLOCKS];
+  size_t block_starts[SHARD_BAM_BLOCKS + 1];
+  uint64_t res = SHARD_END;
+
+  if ((address << 16) < min_pos) address = min_pos >> 16;
+  address = shard_bgzf_next_block(f, address);
+
+  while (address < f->file_size && res == SHARD_END) {
+    // uncompressed data of a few consecutive blocks, records span blocks
+    int num_blocks = 0;
+    size_t len = 0;
+    uint64_t next = address;
+    while (num_blocks < SHARD_BAM_BLOCKS && shard_file_load(f, next)) {
+      block_addresses[num_blocks] = next;
+      block_starts[num_blocks] = len;
+      memcpy(data + len, f->block, f->block_length);
+      len += f->block_length;
+      next = f->next_block_address;
+      num_blocks++;
+    }
+    block_starts[num_blocks] = len;
+    int eof = (next >= f->file_size);
+
+    size_t u = 0;
+    if ((address << 16) < min_pos) u = min_pos & 0xFFFF;
+    for (; num_blocks && u < block_starts[1]; u++) {
+      size_t q = u;
+      int valid = 1;
+      for (int r = 0; r < SHARD_BAM_CHAIN; r++) {
+	if (q == len && eof) break;
+	int size = bam_record_check(data + q, len - q, n_targets);
+	if (size == 0) { valid = 0; break; }
+	if (size < 0) { if (eof || r == 0) valid = 0; break; }
+	q += size;
+	if (q > len) break;
+      }
+      if (valid) {
+	res = (block_addresses[0] << 16) | u;
+	break;
+      }
+    }
+
+    // next block
+    address = (num_blocks > 1 ? block_addresses[1] : next);
+    if (!num_blocks) break;
+  }
+
+  free(data);
+  return res;
+}
+
+//--------------------------------------------------------------------
+
+shard_t *shard_bam_new(char *filename, int index, int count) {
+  // end of the header and number of references
+  bamFile bam_fd = bam_open(filename, "r");
+  if (!bam_fd) {
+    printf("Error: could not open %s to read\n", filename);
+    exit(-1);
+  }
+  bam_header_t *header = bam_header_read(bam_fd);
+  uint64_t header_end = bam_tell(bam_fd);
+  int n_targets = header->n_targets;
+  bam_header_destroy(header);
+  bam_close(bam_fd);
+
+  shard_t *p = (shard_t *) calloc(1, sizeof(shard_t));
+  p->index = index;
+  p->count = count;
+  p->num_files = 1;
+
+  shard_file_t *f = shard_file_new(filename);
+  if (f->format != SHARD_BGZF) {
+    printf("Error: %s is not a BAM file\n", filename);
+    exit(-1);
+  }
+  f->format = SHARD_BAM;
+
+  for (int k = index; k <= index + 1; k++) {
+    uint64_t pos;
+    if (k == 0) {
+      pos = header_end;
+    } else if (k == count) {
+      pos = SHARD_END;
+    } else {
+      pos = shard_bam_sync(f, shard_offset(f->file_size, k, count), header_end, n_targets);
+    }
+    if (k == index) {
+      f->start = pos;
+    } else {
+      f->end = pos;
+    }
+  }
+  if (f->start == SHARD_END) {
+    // empty shard
+    f->start = f->end = header_end;
+  }
+
+  // the records are read with the BAM library
+  fclose(f->fd);
+  f->fd = NULL;
+  p->files[0] = f;
+
+  return p;
+}
+
+//--------------------------------------------------------------------
+
+void shard_bam_seek(shard_t *shard, bamFile fd) {
+  if (shard) bam_seek(fd, shard->files[0]->start, SEEK_SET);
+}
+
+//--------------------------------------------------------------------
+
+int shard_bam_done(shard_t *shard, bamFile fd) {
+  return (shard && bam_tell(fd) >= shard->files[0]->end);
+}
+
+//--------------------------------------------------------------------
+
+size_t shard_total_bytes(shard_t *shard) {
+  size_t total = 0;
+  for (int i = 0; i < shard->num_files; i++) {
+    shard_file_t *f = shard->files[i];
+    if (f->format != SHARD_PLAIN) return 0;
+    total += (f->end == SHARD_END ? f->file_size : f->end) - f->start;
+  }
+  return total;
+}
+
+//--------------------------------------------------------------------
+
+void shard_free(shard_t *shard) {
+  if (shard) {
+    for (int i = 0; i < shard->num_files; i++) {
+      shard_file_free(shard->files[i]);
+    }
+    free(shard);
+  }
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
@@ -0,0 +1,111 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "containers/array_list.h"
+#include "bioformats/fastq/fastq_read.h"
+#include "bioformats/bam/bam_file.h"
+
+//--------------------------------------------------------------------
+// input sharding (--shard i/N)
+//
+// each input file is split in N slices and shard i maps only the
+// reads of slice i, the slices are located without reading the whole
+// file:
+//   - plain FastQ: byte ranges aligned to the record starts
+//   - BGZF FastQ : ranges of BGZF blocks, aligned to the record starts
+//                  (virtual offsets, as in BAM)
+//   - BAM        : ranges of BGZF blocks, aligned to the record starts
+//
+// for paired-end FastQ the slice of the second file starts at the mate
+// of the first read in the slice of the first file
+//--------------------------------------------------------------------
+
+#define SHARD_PLAIN  0
+#define SHARD_BGZF   1
+#define SHARD_BAM    2
+
+#define SHARD_FORMAT_STR(f) (f == SHARD_BGZF ? "BGZF" : (f == SHARD_BAM ? "BAM" : "plain"))
+
+#define SHARD_BGZF_HEADER_SIZE  18
+#define SHARD_BGZF_FOOTER_SIZE  8
+#define SHARD_BGZF_MAX_BLOCK    65536
+
+// initial window around the proportional offset where the mate of the
+// first read is searched (paired-end), it is doubled until found
+#define SHARD_MATE_WINDOW       (4 * 1048576)
+
+// number of BAM records validated to accept a record start
+#define SHARD_BAM_CHAIN         3
+
+#define SHARD_END               UINT64_MAX
+
+#define SHARD_NAME_LENGTH       64
+
+//--------------------------------------------------------------------
+// shard_file_t: one input file read from 'start' (included) to 'end'
+// (excluded), offsets are byte offsets for plain files and virtual
+// offsets (block address << 16 | offset in block) for BGZF files
+//--------------------------------------------------------------------
+
+typedef struct shard_file {
+  int format;
+  FILE *fd;
+  size_t file_size;
+  uint64_t start;
+  uint64_t end;
+
+  // current block (BGZF) or read buffer (plain)
+  uint64_t block_address;
+  uint64_t next_block_address;
+  int block_length;
+  int block_offset;
+  unsigned char *compressed;
+  unsigned char *block;
+
+  // lines of the current FastQ record
+  char *lines[4];
+  size_t lines_size[4];
+} shard_file_t;
+
+//--------------------------------------------------------------------
+
+typedef struct shard {
+  int index;     // 0-based
+  int count;
+  int num_files; // 2 for paired-end FastQ
+  shard_file_t *files[2];
+} shard_t;
+
+//--------------------------------------------------------------------
+
+// parses 'i/N' (i in 1..N)
+void parse_shard(char *str, int *index, int *count);
+
+// output name tag for the shard ('shard-03-of-16')
+void shard_name(int index, int count, char *name);
+
+shard_t *shard_fastq_new(char *filename1, char *filename2, int index, int count);
+shard_t *shard_bam_new(char *filename, int index, int count);
+void shard_free(shard_t *shard);
+
+// reads up to 'batch_size' bytes of FastQ records of the shard (mates
+// are inserted one after the other), returns the number of bytes read
+size_t shard_fastq_read(array_list_t *reads, size_t batch_size, shard_t *shard);
+
+// positions a BAM file (header already read) at the first record of the
+// shard, and checks whether the next record is out of the shard
+void shard_bam_seek(shard_t *shard, bamFile fd);
+int shard_bam_done(shard_t *shard, bamFile fd);
+
+// bytes of input in the shard, 0 if unknown (compressed input)
+size_t shard_total_bytes(shard_t *shard);
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+#endif // SHARD_H
@@ -47,9 +47,7 @@ void statistics_set(unsigned int section, unsigned int subsection, size_t value,
 //----------------------------------------------------------------------------------------------------------------------
 
 void statistics_add(unsigned int section, unsigned int subsection, size_t value, statistics_t* statistics_p) {
-  pthread_mutex_lock(&statistics_p->mutex);
-  statistics_p->values_p[section][subsection] += value;
-  pthread_mutex_unlock(&statistics_p->mutex);
+  __sync_fetch_and_add(&statistics_p->values_p[section][subsection], value);
 }
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -180,7 +178,6 @@ void basic_statistics_sp_init(size_t total_sp, size_t uniq_sp, basic_statistics_
 
 basic_statistics_t *basic_statistics_new() {
   basic_statistics_t *basic = (basic_statistics_t *)malloc(sizeof(basic_statistics_t));
-  pthread_mutex_init(&(basic->mutex), NULL);
   basic->total_reads = 0;
   basic->num_mapped_reads = 0;
   basic->total_mappings = 0;
@@ -193,11 +190,12 @@ basic_statistics_t *basic_statistics_new() {
 
 //-------------------------------------------------------------------------------------------
 
-void basic_statistics_add(size_t total_reads, size_t num_mapped_reads, size_t total_mappings, size_t reads_uniq_mappings, basic_statistics_t *basic) {
-  pthread_mutex_lock(&basic->mutex);
-  basic->total_reads         += total_reads;
-  basic->num_mapped_reads    += num_mapped_reads;
-  basic->total_mappings      += total_mappings;
-  basic->reads_uniq_mappings += reads_uniq_mappings;
-  pthread_mutex_unlock(&basic->mutex);
+void basic_statistics_reduce(basic_statistics_t *basic) {
+  uint64_t values[NUM_COUNTER_IDS];
+  counters_reduce(values);
+
+  basic->total_reads         = values[COUNTER_TOTAL_READS];
+  basic->num_mapped_reads    = values[COUNTER_MAPPED_READS];
+  basic->total_mappings      = values[COUNTER_TOTAL_MAPPINGS];
+  basic->reads_uniq_mappings = values[COUNTER_UNIQ_MAPPING_READS];
 }
@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "timing.h"
+#include "counters.h"
 
 typedef struct st_bwt {
   size_t multi_alig;
@@ -43,7 +44,6 @@ typedef struct basic_statistics {
   size_t reads_uniq_mappings;
   size_t total_sp;
   size_t uniq_sp;
-  pthread_mutex_t mutex;
 } basic_statistics_t;
 
 typedef struct cal_st {
@@ -76,7 +76,9 @@ void basic_statistics_sp_init(size_t total_sp, size_t uniq_sp, basic_statistics_
 void timing_and_statistics_display(statistics_t* statistics_p, 
 				   timing_t* timing_p);
 
-void basic_statistics_add(size_t total_reads, size_t num_mapped_reads, size_t total_mappings, size_t reads_uniq_mappings, basic_statistics_t *basic);
+// the mapping counters are updated per thread (see counters.h), this
+// sums them up into the basic statistics
+void basic_statistics_reduce(basic_statistics_t *basic);
 
 basic_statistics_t *basic_statistics_new();
 
@@ -41,7 +41,8 @@ static inline ERROR_CODE alig_region_filter_read(bam1_t *read, array_list_t *lis
 static inline ERROR_CODE alig_aux_write_to_disk(array_list_t *write_buffer, bam_file_t *output_bam_f, uint8_t force) /* DEPRECATED */;
 static inline ERROR_CODE alig_aux_read_from_disk(circular_buffer_t *read_buffer, bam_file_t *input_bam_f) /* DEPRECATED */;
 static ERROR_CODE alig_get_scores(alig_context_t *context);
-static ERROR_CODE alig_get_scores_from_read(bam1_t *read, alig_context_t *context, uint32_t *v_scores, size_t *v_positions);
+static alig_scores_buffer_t *alig_get_scores_buffer(alig_context_t *context, size_t seq_l);
+static ERROR_CODE alig_get_scores_from_read(bam1_t *read, alig_context_t *context, alig_scores_buffer_t *buffer, uint32_t *v_scores, size_t *v_positions);
 static inline ERROR_CODE alig_get_alternative_haplotype(alig_context_t *context, int *out_haplo_index, uint32_t *out_haplo_score, uint32_t *out_ref_score);
 static ERROR_CODE alig_indel_realign_from_haplo(alig_context_t *context, size_t alt_haplo_index);
 
@@ -156,12 +157,78 @@ alig_destroy(alig_context_t *context)
 	if(context->scores.m_scores)
 		free(context->scores.m_scores);
 
+	//Free own score buffers
+	if(context->score_buffers_owned)
+	{
+		for(i = 0; i < context->score_buffers_l; i++)
+		{
+			if(context->score_buffers[i])
+			{
+				alig_scores_buffer_free(context->score_buffers[i]);
+				free(context->score_buffers[i]);
+			}
+		}
+		free(context->score_buffers);
+	}
+
 	//Set all to NULL
 	memset(context, 0, sizeof(alig_context_t));
 
 	return NO_ERROR;
 }
 
+/**
+ * Use caller thread buffers to obtain the scores.
+ */
+ERROR_CODE
+alig_set_score_buffers(alig_context_t *context, alig_scores_buffer_t **buffers, int buffers_l)
+{
+	int i;
+
+	assert(context);
+	assert(buffers);
+	assert(buffers_l > 0);
+
+	//Free own buffers
+	if(context->score_buffers_owned)
+	{
+		for(i = 0; i < context->score_buffers_l; i++)
+		{
+			if(context->score_buffers[i])
+			{
+				alig_scores_buffer_free(context->score_buffers[i]);
+				free(context->score_buffers[i]);
+			}
+		}
+		free(context->score_buffers);
+	}
+
+	//Set buffers
+	context->score_buffers = buffers;
+	context->score_buffers_l = buffers_l;
+	context->score_buffers_owned = 0;
+
+	return NO_ERROR;
+}
+
+/**
+ * Free the content of a thread buffer.
+ */
+void
+alig_scores_buffer_free(void *buffer)
+{
+	alig_scores_buffer_t *b = (alig_scores_buffer_t *)buffer;
+
+	assert(b);
+
+	free(b->read_seq);
+	free(b->read_seq_ref);
+	free(b->quals_seq);
+	free(b->aux_cigar);
+	free(b->read_left_cigar);
+	memset(b, 0, sizeof(alig_scores_buffer_t));
+}
+
 /**
  * Check if a realigner context is valid.
  */
@@ -1212,6 +1279,43 @@ alig_bam_file_old(char *bam_path, char *ref_name, char *ref_path, char *outbam)
 //	ERRZZZZ
 //
 
+/**
+ * PRIVATE FUNCTION. Get the score buffer of the running thread, big enough for reads of 'seq_l' bases.
+ */
+static alig_scores_buffer_t *
+alig_get_scores_buffer(alig_context_t *context, size_t seq_l)
+{
+	int thread_id;
+	alig_scores_buffer_t *buffer;
+
+	//Get thread slot
+	thread_id = omp_get_thread_num();
+	assert(thread_id >= 0 && thread_id < context->score_buffers_l);
+	buffer = context->score_buffers[thread_id];
+	if(buffer == NULL)
+	{
+		buffer = (alig_scores_buffer_t *)calloc(1, sizeof(alig_scores_buffer_t));
+		assert(buffer);
+		context->score_buffers[thread_id] = buffer;
+	}
+
+	//Grow if needed
+	if(buffer->seq_l < seq_l)
+	{
+		buffer->read_seq = (char *) realloc(buffer->read_seq, (seq_l + 1) * sizeof(char));
+		buffer->read_seq_ref = (char *) realloc(buffer->read_seq_ref, (seq_l + 1) * sizeof(char));
+		buffer->quals_seq = (char *) realloc(buffer->quals_seq, (seq_l + 1) * sizeof(char));
+		buffer->seq_l = seq_l;
+	}
+	if(buffer->aux_cigar == NULL)
+	{
+		buffer->aux_cigar = (uint32_t *)malloc(MAX_CIGAR_LENGTH * sizeof(uint32_t));
+		buffer->read_left_cigar = (uint32_t *)malloc(MAX_CIGAR_LENGTH * sizeof(uint32_t));
+	}
+
+	return buffer;
+}
+
 /**
  * PRIVATE FUNCTION. Obtain score tables from present region.
  */
@@ -1236,10 +1340,9 @@ alig_get_scores(alig_context_t *context)
 	size_t read_list_l;
 	size_t haplo_list_l;
 
-	//Score vector
-	uint32_t *v_scores;
-	size_t *v_positions;
-	size_t v_total;
+	//Thread buffers
+	alig_scores_buffer_t *buffer;
+	size_t max_seq_l;
 
 	assert(context);
 
@@ -1287,35 +1390,42 @@ alig_get_scores(alig_context_t *context)
 		*((uint32_t*)m_scores + i) = UINT32_MAX;
 	}
 
-	//Iterate reads
-	//#pragma omp parallel private(read, err, j, i, v_total, v_positions, v_scores, index) firstprivate(read_list_l)
+	//Longest read
+	max_seq_l = 0;
+	for(i = 0; i < read_list_l; i++)
 	{
-		//Allocate new scores
-		v_total = context->scores.m_ldim;
-		v_positions = (size_t *)malloc(v_total * sizeof(size_t));
-		v_scores = (uint32_t *)malloc(v_total * sizeof(uint32_t));
+		read = array_list_get(i, read_list);
+		assert(read);
+		if(read->core.l_qseq > max_seq_l)
+			max_seq_l = read->core.l_qseq;
+	}
 
-		//#pragma omp for
-		for(i = 0; i < read_list_l; i++)
-		{
-			//Get read
-			read = array_list_get(i, read_list);
-			assert(read);
+	//Own buffers if the caller did not set them
+	if(context->score_buffers == NULL)
+	{
+		context->score_buffers_l = omp_get_max_threads();
+		context->score_buffers = (alig_scores_buffer_t **)calloc(context->score_buffers_l, sizeof(alig_scores_buffer_t *));
+		assert(context->score_buffers);
+		context->score_buffers_owned = 1;
+	}
 
-			//Get scores
-			err = alig_get_scores_from_read(read, context, v_scores, v_positions);
+	//Iterate reads, each one fills its row of the matrix.
+	//Tasks instead of a parallel region, this is called from the framework tasks
+	#pragma omp taskloop grainsize(4) if(read_list_l >= ALIG_SCORES_PARALLEL_MIN_READS) default(shared) private(read, err, index, buffer)
+	for(i = 0; i < read_list_l; i++)
+	{
+		//Get read
+		read = array_list_get(i, read_list);
+		assert(read);
 
-			//Merge scores
-			index = i * v_total;
-			memcpy((uint32_t*)m_scores + index, v_scores, v_total * sizeof(uint32_t));
-			memcpy((size_t*)m_positions + index, v_positions, v_total * sizeof(size_t));
+		//Get thread buffer
+		buffer = alig_get_scores_buffer(context, max_seq_l);
 
-		}//FOR reads
+		//Get scores
+		index = i * m_ldim;
+		err = alig_get_scores_from_read(read, context, buffer, m_scores + index, m_positions + index);
 
-		//Free
-		free(v_scores);
-		free(v_positions);
-	}
+	}//FOR reads
 
 	//Print table
 	/*{
@@ -1376,13 +1486,12 @@ alig_get_scores(alig_context_t *context)
  * PRIVATE FUNCTION.Obtain score tables from read.
  */
 static ERROR_CODE
-alig_get_scores_from_read(bam1_t *read, alig_context_t *context, uint32_t *v_scores, size_t *v_positions)
+alig_get_scores_from_read(bam1_t *read, alig_context_t *context, alig_scores_buffer_t *buffer, uint32_t *v_scores, size_t *v_positions)
 {
 	int i, err;
 
 	//Reads
 	char *read_seq;
-	char *comp_seq;
 	char *quals_seq;
 	size_t read_l;
 
@@ -1422,6 +1531,8 @@ alig_get_scores_from_read(bam1_t *read, alig_context_t *context, uint32_t *v_sco
 
 	assert(read);
 	assert(context);
+	assert(buffer);
+	assert(buffer->seq_l >= read->core.l_qseq);
 
 	//Lengths
 	haplo_list_l = array_list_size(context->haplo_list);
@@ -1436,16 +1547,13 @@ alig_get_scores_from_read(bam1_t *read, alig_context_t *context, uint32_t *v_sco
 	ref_pos_begin = reference->position;
 	ref_pos_end = ref_pos_begin + reference->length;
 
-	//Allocate new read
+	//Use thread buffers
 	read_l = read->core.l_qseq;
-	read_seq = (char *) malloc((read_l + 1) * sizeof(char));
-	comp_seq = (char *) malloc((read_l + 1) * sizeof(char));
-	read_seq_ref = (char *) malloc((read_l + 1) * sizeof(char));
-	quals_seq = (char *) malloc((read_l + 1) * sizeof(char));
-
-	//Allocate cigars
-	aux_cigar = (uint32_t *)malloc(MAX_CIGAR_LENGTH * sizeof(uint32_t));
-	read_left_cigar = (uint32_t *)malloc(MAX_CIGAR_LENGTH * sizeof(uint32_t));
+	read_seq = buffer->read_seq;
+	read_seq_ref = buffer->read_seq_ref;
+	quals_seq = buffer->quals_seq;
+	aux_cigar = buffer->aux_cigar;
+	read_left_cigar = buffer->read_left_cigar;
 
 	//Init scores
 	v_total = context->scores.m_ldim;
@@ -1477,7 +1585,7 @@ alig_get_scores_from_read(bam1_t *read, alig_context_t *context, uint32_t *v_sco
 			read_seq_ref, &read_seq_ref_l, NULL);
 
 	//Get raw score with reference
-	nucleotide_miss_qual_sum(read_seq_ref, read_seq, quals_seq, read_l, comp_seq, &misses, &misses_sum);
+	nucleotide_miss_qual_sum(read_seq_ref, read_seq, quals_seq, read_l, NULL, &misses, &misses_sum);
 	v_scores[0] = misses_sum;
 	v_positions[0] = read->core.pos;
 
@@ -1566,7 +1674,7 @@ alig_get_scores_from_read(bam1_t *read, alig_context_t *context, uint32_t *v_sco
 					//assert(read_seq_ref_l == read->core.l_qseq);
 
 					//Compare and miss with haplotype
-					nucleotide_miss_qual_sum(read_seq, read_seq_ref, quals_seq, read_seq_ref_l, comp_seq, &misses, &misses_sum);
+					nucleotide_miss_qual_sum(read_seq, read_seq_ref, quals_seq, read_seq_ref_l, NULL, &misses, &misses_sum);
 
 					//Better?
 					if(v_scores[i+1] > misses_sum)
@@ -1587,14 +1695,6 @@ alig_get_scores_from_read(bam1_t *read, alig_context_t *context, uint32_t *v_sco
 		} //Iterate haplotypes
 	} //Misses != 0 if
 
-	//Free
-	free(read_seq);
-	free(comp_seq);
-	free(read_seq_ref);
-	free(quals_seq);
-	free(read_left_cigar);
-	free(aux_cigar);
-
 	return NO_ERROR;
 }
 
@@ -53,6 +53,8 @@
 
 #define ALIG_IMPROVEMENT_THREHOLD 0.0
 
+#define ALIG_SCORES_PARALLEL_MIN_READS 16	//Minimum reads in region to score them in parallel
+
 //REALIGNER FLAGS
 #define ALIG_LEFT_ALIGN 0x01	//Left align cigars?
 #define ALIG_REFERENCE_PRIORITY 0x02	//Reference haplotype have priority over alternative? (if equals case)
@@ -84,6 +86,19 @@ typedef struct {
  * 		ERRZZZZ
  */
 
+/**
+ * REALIGNMENT SCORE BUFFERS
+ * One per thread, reused between regions (see alig_set_score_buffers).
+ */
+typedef struct {
+	char *read_seq;
+	char *read_seq_ref;
+	char *quals_seq;
+	uint32_t *aux_cigar;
+	uint32_t *read_left_cigar;
+	size_t seq_l;
+} alig_scores_buffer_t;
+
 /**
  * REALIGNER CONTEXT
  */
@@ -113,6 +128,9 @@ typedef struct {
 
 	//Scores
 	alig_scores_t scores;
+	alig_scores_buffer_t **score_buffers;	//Indexed by thread number
+	int score_buffers_l;
+	uint8_t score_buffers_owned;
 
 	//Left align
 	uint8_t flags;
@@ -156,6 +174,25 @@ EXTERNC ERROR_CODE alig_destroy(alig_context_t *context);
  */
 EXTERNC ERROR_CODE alig_validate(alig_context_t *context);
 
+/**
+ * \brief Use caller thread buffers to obtain the scores.
+ * The buffers are allocated on demand, one per slot, and outlive the context so they
+ * can be reused between regions. Must be freed with 'alig_scores_buffer_free'.
+ * If not set, the context keeps its own buffers until it is destroyed.
+ *
+ * \param[in] context Context to configure.
+ * \param[in] buffers Vector of thread buffers, indexed by thread number.
+ * \param[in] buffers_l Number of thread buffers.
+ */
+EXTERNC ERROR_CODE alig_set_score_buffers(alig_context_t *context, alig_scores_buffer_t **buffers, int buffers_l);
+
+/**
+ * \brief Free the content of a thread buffer, not the buffer itself.
+ *
+ * \param[in] buffer Buffer to free.
+ */
+EXTERNC void alig_scores_buffer_free(void *buffer);
+
 /**
  * REGION OPERATIONS
  */
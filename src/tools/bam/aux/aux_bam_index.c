@@ -0,0 +1,818 @@
+#include "aux_bam_index.h"
+
+//------------------------------------------------------------------------
+
+// first bin of a level
+static inline uint32_t level_first_bin(int level) {
+	return (uint32_t) (((1LLU << (3 * level)) - 1) / 7);
+}
+
+// smallest bin containing [beg, end), as htslib hts_reg2bin
+static inline uint32_t reg2bin(int64_t beg, int64_t end, int min_shift, int depth) {
+	int shift = min_shift;
+	end--;
+	for (int level = depth; level > 0; level--, shift += 3) {
+		if (beg >> shift == end >> shift) {
+			return level_first_bin(level) + (beg >> shift);
+		}
+	}
+	return 0;
+}
+
+// first window of the linear index inside a bin
+static inline int bin_first_window(uint32_t bin, int depth) {
+	int level = 0;
+	for (uint32_t b = bin; b; b = (b - 1) >> 3) {
+		level++;
+	}
+	return (bin - level_first_bin(level)) << (3 * (depth - level));
+}
+
+//------------------------------------------------------------------------
+
+bam_index_builder_t *bam_index_builder_new(const bam_header_t *header, int format, int min_shift) {
+	bam_index_builder_t *builder = (bam_index_builder_t *) calloc(1, sizeof(bam_index_builder_t));
+	int num_refs = header->n_targets;
+
+	int64_t max_len = 0;
+	for (int i = 0; i < num_refs; i++) {
+		if (max_len < header->target_len[i]) {
+			max_len = header->target_len[i];
+		}
+	}
+	if (max_len > BAM_INDEX_BAI_MAX_LEN) {
+		format = BAM_INDEX_CSI;
+	}
+
+	builder->format = format;
+	if (format == BAM_INDEX_BAI) {
+		builder->min_shift = BAM_INDEX_BAI_MIN_SHIFT;
+		builder->depth = BAM_INDEX_BAI_DEPTH;
+	} else {
+		builder->min_shift = (min_shift > 0 ? min_shift : BAM_INDEX_BAI_MIN_SHIFT);
+		// levels to cover the longest reference (as htslib)
+		max_len += 256;
+		for (int64_t s = 1LL << builder->min_shift; max_len > s; s <<= 3) {
+			builder->depth++;
+		}
+	}
+	builder->meta_bin = level_first_bin(builder->depth + 1) + 1;
+
+	builder->num_refs = num_refs;
+	builder->refs = (bam_index_ref_t *) calloc(num_refs > 0 ? num_refs : 1, sizeof(bam_index_ref_t));
+	builder->bin_pos = (int *) calloc(builder->meta_bin + 1, sizeof(int));
+
+	builder->tid = -1;
+	builder->last_pos = -1;
+	builder->save_bin = BAM_INDEX_NO_BIN;
+
+	return builder;
+}
+
+void bam_index_builder_free(bam_index_builder_t *builder) {
+	if (builder == NULL) {
+		return;
+	}
+	for (int i = 0; i < builder->num_refs; i++) {
+		bam_index_ref_t *ref = &builder->refs[i];
+		for (int j = 0; j < ref->num_bins; j++) {
+			free(ref->bins[j].chunks);
+		}
+		if (ref->bins) {
+			free(ref->bins);
+		}
+		if (ref->intervals) {
+			free(ref->intervals);
+		}
+	}
+	free(builder->refs);
+	free(builder->bin_pos);
+	free(builder);
+}
+
+//------------------------------------------------------------------------
+
+static void insert_chunk(bam_index_builder_t *builder, uint32_t bin, uint64_t beg, uint64_t end) {
+	bam_index_ref_t *ref = &builder->refs[builder->tid];
+
+	int pos = builder->bin_pos[bin] - 1;
+	if (pos < 0) {
+		if (ref->num_bins == ref->max_bins) {
+			ref->max_bins = (ref->max_bins ? 2 * ref->max_bins : 64);
+			ref->bins = (bam_index_bin_t *) realloc(ref->bins, ref->max_bins * sizeof(bam_index_bin_t));
+		}
+		pos = ref->num_bins++;
+		memset(&ref->bins[pos], 0, sizeof(bam_index_bin_t));
+		ref->bins[pos].bin = bin;
+		builder->bin_pos[bin] = pos + 1;
+	}
+
+	bam_index_bin_t *p = &ref->bins[pos];
+	if (p->num_chunks == p->max_chunks) {
+		p->max_chunks = (p->max_chunks ? 2 * p->max_chunks : 2);
+		p->chunks = (bam_index_chunk_t *) realloc(p->chunks, p->max_chunks * sizeof(bam_index_chunk_t));
+	}
+	p->chunks[p->num_chunks].beg = beg;
+	p->chunks[p->num_chunks].end = end;
+	p->num_chunks++;
+}
+
+static void insert_interval(bam_index_builder_t *builder, int beg, int end, uint64_t offset) {
+	bam_index_ref_t *ref = &builder->refs[builder->tid];
+
+	if (end >= ref->max_intervals) {
+		int max_intervals = (ref->max_intervals ? ref->max_intervals : 64);
+		while (max_intervals <= end) {
+			max_intervals *= 2;
+		}
+		ref->intervals = (uint64_t *) realloc(ref->intervals, max_intervals * sizeof(uint64_t));
+		memset(ref->intervals + ref->max_intervals, 0, (max_intervals - ref->max_intervals) * sizeof(uint64_t));
+		ref->max_intervals = max_intervals;
+	}
+	for (int i = beg; i <= end; i++) {
+		if (ref->intervals[i] == 0) {
+			ref->intervals[i] = offset;
+		}
+	}
+	if (ref->num_intervals < end + 1) {
+		ref->num_intervals = end + 1;
+	}
+}
+
+// closes the current reference
+static void flush_ref(bam_index_builder_t *builder, uint64_t offset) {
+	if (builder->tid < 0) {
+		return;
+	}
+	if (builder->save_bin != BAM_INDEX_NO_BIN) {
+		insert_chunk(builder, builder->save_bin, builder->save_off, offset);
+	}
+
+	bam_index_ref_t *ref = &builder->refs[builder->tid];
+	ref->has_meta = 1;
+	ref->off_beg = builder->off_beg;
+	ref->off_end = offset;
+	ref->num_mapped = builder->num_mapped;
+	ref->num_unmapped = builder->num_unmapped;
+
+	// only the bins used by the reference are reset
+	for (int i = 0; i < ref->num_bins; i++) {
+		builder->bin_pos[ref->bins[i].bin] = 0;
+	}
+	builder->save_bin = BAM_INDEX_NO_BIN;
+	builder->num_mapped = 0;
+	builder->num_unmapped = 0;
+}
+
+//------------------------------------------------------------------------
+
+int bam_index_builder_add(bam_index_builder_t *builder, const bam1_t *b, uint64_t beg, uint64_t end) {
+	return bam_index_builder_add_core(builder, &b->core, bam1_cigar(b), beg, end);
+}
+
+int bam_index_builder_add_core(bam_index_builder_t *builder, const bam1_core_t *c, const uint32_t *cigar,
+			       uint64_t beg, uint64_t end) {
+	if (builder->error) {
+		return -1;
+	}
+
+	// unplaced reads at the end of the file are only counted
+	if (c->tid < 0) {
+		if (!builder->no_coor) {
+			flush_ref(builder, beg);
+			builder->no_coor = 1;
+		}
+		builder->num_no_coor++;
+		return 0;
+	}
+
+	if (builder->no_coor || c->tid < builder->tid || c->tid >= builder->num_refs ||
+	    (c->tid == builder->tid && c->pos < builder->last_pos)) {
+		builder->error = 1;
+		return -1;
+	}
+
+	if (c->tid != builder->tid) {
+		flush_ref(builder, beg);
+		builder->tid = c->tid;
+		builder->off_beg = beg;
+	}
+
+	uint32_t pos_end = bam_calend(c, cigar);
+	if (pos_end <= (uint32_t) c->pos) {
+		pos_end = c->pos + 1;
+	}
+
+	if (!(c->flag & BAM_FUNMAP)) {
+		insert_interval(builder, c->pos >> builder->min_shift,
+				(pos_end - 1) >> builder->min_shift, beg);
+	}
+
+	uint32_t bin = reg2bin(c->pos, pos_end, builder->min_shift, builder->depth);
+	if (bin != builder->save_bin) {
+		if (builder->save_bin != BAM_INDEX_NO_BIN) {
+			insert_chunk(builder, builder->save_bin, builder->save_off, beg);
+		}
+		builder->save_bin = bin;
+		builder->save_off = beg;
+	}
+
+	if (c->flag & BAM_FUNMAP) {
+		builder->num_unmapped++;
+	} else {
+		builder->num_mapped++;
+	}
+	builder->last_pos = c->pos;
+
+	return 0;
+}
+
+int bam_index_builder_finish(bam_index_builder_t *builder, uint64_t end) {
+	if (!builder->no_coor) {
+		flush_ref(builder, end);
+		builder->no_coor = 1;
+	}
+	return builder->error ? -1 : 0;
+}
+
+//------------------------------------------------------------------------
+
+// index contents, written at once as a plain (BAI) or BGZF (CSI) file
+typedef struct index_buffer {
+	size_t length;
+	size_t max_length;
+	unsigned char *data;
+} index_buffer_t;
+
+static void put(index_buffer_t *buffer, const void *data, size_t length) {
+	if (buffer->length + length > buffer->max_length) {
+		buffer->max_length = 2 * (buffer->length + length);
+		buffer->data = (unsigned char *) realloc(buffer->data, buffer->max_length);
+	}
+	memcpy(buffer->data + buffer->length, data, length);
+	buffer->length += length;
+}
+
+static inline void put_int32(index_buffer_t *buffer, int32_t value) {
+	put(buffer, &value, 4);
+}
+
+static inline void put_uint64(index_buffer_t *buffer, uint64_t value) {
+	put(buffer, &value, 8);
+}
+
+static int write_buffer(index_buffer_t *buffer, const char *filename, int format) {
+	if (format == BAM_INDEX_CSI) {
+		bgzf_mt_writer_t *writer = bgzf_mt_writer_new(filename, BGZF_MT_DEFAULT_LEVEL, 1);
+		if (writer == NULL) {
+			return -1;
+		}
+		int ret = bgzf_mt_write(writer, buffer->data, buffer->length);
+		if (bgzf_mt_writer_close(writer) != 0) {
+			ret = -1;
+		}
+		bgzf_mt_writer_free(writer);
+		return ret;
+	}
+
+	FILE *fd = fopen(filename, "wb");
+	if (fd == NULL) {
+		return -1;
+	}
+	if (fwrite(buffer->data, 1, buffer->length, fd) != buffer->length) {
+		fclose(fd);
+		return -1;
+	}
+	return fclose(fd) == 0 ? 0 : -1;
+}
+
+int bam_index_builder_save(bam_index_builder_t *builder, const char *filename,
+			   bam_index_voffset_func_t voffset, void *data) {
+	if (builder->error || builder->saved) {
+		return -1;
+	}
+
+	int csi = (builder->format == BAM_INDEX_CSI);
+	index_buffer_t buffer;
+	memset(&buffer, 0, sizeof(index_buffer_t));
+
+	if (csi) {
+		put(&buffer, "CSI\1", 4);
+		put_int32(&buffer, builder->min_shift);
+		put_int32(&buffer, builder->depth);
+		put_int32(&buffer, 0);
+	} else {
+		put(&buffer, "BAI\1", 4);
+	}
+	put_int32(&buffer, builder->num_refs);
+
+	for (int i = 0; i < builder->num_refs; i++) {
+		bam_index_ref_t *ref = &builder->refs[i];
+		uint64_t off_beg = (voffset ? voffset(data, ref->off_beg) : ref->off_beg);
+		uint64_t off_end = (voffset ? voffset(data, ref->off_end) : ref->off_end);
+
+		// linear index, empty windows take the previous offset (CSI, the
+		// first record of the reference before the first one)
+		for (int j = 0; j < ref->num_intervals; j++) {
+			if (ref->intervals[j] == 0) {
+				ref->intervals[j] = (j > 0 ? ref->intervals[j - 1] : (csi ? off_beg : 0));
+			} else if (voffset) {
+				ref->intervals[j] = voffset(data, ref->intervals[j]);
+			}
+		}
+
+		// bins, chunks in the same BGZF block are merged
+		put_int32(&buffer, ref->num_bins + (ref->has_meta ? 1 : 0));
+		for (int j = 0; j < ref->num_bins; j++) {
+			bam_index_bin_t *p = &ref->bins[j];
+			int num_chunks = 0;
+			for (int k = 0; k < p->num_chunks; k++) {
+				uint64_t beg = p->chunks[k].beg, end = p->chunks[k].end;
+				if (voffset) {
+					beg = voffset(data, beg);
+					end = voffset(data, end);
+				}
+				if (num_chunks > 0 && p->chunks[num_chunks - 1].end >> 16 == beg >> 16) {
+					p->chunks[num_chunks - 1].end = end;
+				} else {
+					p->chunks[num_chunks].beg = beg;
+					p->chunks[num_chunks].end = end;
+					num_chunks++;
+				}
+			}
+			p->num_chunks = num_chunks;
+
+			put_int32(&buffer, p->bin);
+			if (csi) {
+				int window = bin_first_window(p->bin, builder->depth);
+				put_uint64(&buffer, window < ref->num_intervals ? ref->intervals[window] : 0);
+			}
+			put_int32(&buffer, p->num_chunks);
+			put(&buffer, p->chunks, p->num_chunks * sizeof(bam_index_chunk_t));
+		}
+		if (ref->has_meta) {
+			put_int32(&buffer, builder->meta_bin);
+			if (csi) {
+				put_uint64(&buffer, 0);
+			}
+			put_int32(&buffer, 2);
+			put_uint64(&buffer, off_beg);
+			put_uint64(&buffer, off_end);
+			put_uint64(&buffer, ref->num_mapped);
+			put_uint64(&buffer, ref->num_unmapped);
+		}
+
+		if (!csi) {
+			put_int32(&buffer, ref->num_intervals);
+			put(&buffer, ref->intervals, ref->num_intervals * sizeof(uint64_t));
+		}
+	}
+
+	put_uint64(&buffer, builder->num_no_coor);
+
+	// the offsets are translated in place, so the index is saved once
+	builder->saved = 1;
+
+	int ret = write_buffer(&buffer, filename, builder->format);
+	free(buffer.data);
+
+	return ret;
+}
+
+//------------------------------------------------------------------------
+
+void bam_index_filename(const char *prefix, int format, char *filename) {
+	sprintf(filename, "%s%s", prefix, (format == BAM_INDEX_CSI ? ".csi" : ".bai"));
+}
+
+int bam_index_build(const char *bam_filename, const char *prefix, int format,
+		    int min_shift, int num_threads) {
+	bgzf_mt_reader_t *reader = bgzf_mt_reader_new(bam_filename, 0, (num_threads > 0 ? num_threads : 1));
+	if (reader == NULL) {
+		return -1;
+	}
+	bam_header_t *header = bgzf_mt_read_bam_header(reader);
+	if (header == NULL) {
+		bgzf_mt_reader_free(reader);
+		return -1;
+	}
+
+	// the prefetch thread inflates the next batch of blocks on all the
+	// threads while the records of the current one are added
+	bam_index_builder_t *builder = bam_index_builder_new(header, format, min_shift);
+	bam1_t *b = bam_init1();
+	int ret;
+	uint64_t beg = bgzf_mt_tell(reader), end;
+	while ((ret = bgzf_mt_read_bam1(reader, b)) >= 0) {
+		end = bgzf_mt_tell(reader);
+		if (bam_index_builder_add(builder, b, beg, end) != 0) {
+			break;
+		}
+		beg = end;
+	}
+
+	if (ret == -1 && bam_index_builder_finish(builder, beg) == 0) {
+		if (prefix == NULL) {
+			prefix = bam_filename;
+		}
+		char filename[strlen(prefix) + 5];
+		bam_index_filename(prefix, builder->format, filename);
+		ret = (bam_index_builder_save(builder, filename, NULL, NULL) == 0 ? builder->format : -1);
+	} else {
+		ret = -1;
+	}
+
+	bam_destroy1(b);
+	bam_index_builder_free(builder);
+	bam_header_destroy(header);
+	bgzf_mt_reader_free(reader);
+
+	return ret;
+}
+
+//------------------------------------------------------------------------
+
+// reads the whole index, BGZF-compressed (CSI) or not (BAI)
+static unsigned char *load_index(const char *filename, size_t *length) {
+	FILE *fd = fopen(filename, "rb");
+	if (fd == NULL) {
+		return NULL;
+	}
+	unsigned char magic[2] = { 0, 0 };
+	size_t n = fread(magic, 1, 2, fd);
+
+	index_buffer_t buffer;
+	memset(&buffer, 0, sizeof(index_buffer_t));
+	unsigned char data[65536];
+	if (n == 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+		fclose(fd);
+		bgzf_mt_reader_t *reader = bgzf_mt_reader_new(filename, 0, 1);
+		if (reader == NULL) {
+			return NULL;
+		}
+		int64_t len;
+		while ((len = bgzf_mt_read(reader, data, sizeof(data))) > 0) {
+			put(&buffer, data, len);
+		}
+		bgzf_mt_reader_free(reader);
+		if (len < 0) {
+			free(buffer.data);
+			return NULL;
+		}
+	} else {
+		put(&buffer, magic, n);
+		while ((n = fread(data, 1, sizeof(data), fd)) > 0) {
+			put(&buffer, data, n);
+		}
+		fclose(fd);
+	}
+
+	*length = buffer.length;
+	return buffer.data;
+}
+
+typedef struct index_cursor {
+	const unsigned char *data;
+	size_t length;
+	size_t offset;
+	int error;
+} index_cursor_t;
+
+static inline const unsigned char *get(index_cursor_t *cursor, size_t length) {
+	if (cursor->error || cursor->offset + length > cursor->length) {
+		cursor->error = 1;
+		return NULL;
+	}
+	const unsigned char *p = cursor->data + cursor->offset;
+	cursor->offset += length;
+	return p;
+}
+
+static inline int32_t get_int32(index_cursor_t *cursor) {
+	int32_t value = 0;
+	const unsigned char *p = get(cursor, 4);
+	if (p) {
+		memcpy(&value, p, 4);
+	}
+	return value;
+}
+
+static inline uint64_t get_uint64(index_cursor_t *cursor) {
+	uint64_t value = 0;
+	const unsigned char *p = get(cursor, 8);
+	if (p) {
+		memcpy(&value, p, 8);
+	}
+	return value;
+}
+
+static void add_split(bam_index_split_t **splits, int *num_splits, int *max_splits,
+		      int32_t tid, int32_t pos, uint64_t voffset) {
+	if (*num_splits == *max_splits) {
+		*max_splits = (*max_splits ? 2 * *max_splits : 256);
+		*splits = (bam_index_split_t *) realloc(*splits, *max_splits * sizeof(bam_index_split_t));
+	}
+	(*splits)[*num_splits].tid = tid;
+	(*splits)[*num_splits].pos = pos;
+	(*splits)[*num_splits].voffset = voffset;
+	(*num_splits)++;
+}
+
+int bam_index_load_splits(const char *index_filename, int num_chunks, bam_index_split_t **splits) {
+	index_cursor_t cursor;
+	memset(&cursor, 0, sizeof(index_cursor_t));
+	cursor.data = load_index(index_filename, &cursor.length);
+	if (cursor.data == NULL) {
+		return -1;
+	}
+
+	int csi;
+	const unsigned char *magic = get(&cursor, 4);
+	if (magic && memcmp(magic, "BAI\1", 4) == 0) {
+		csi = 0;
+	} else if (magic && memcmp(magic, "CSI\1", 4) == 0) {
+		csi = 1;
+	} else {
+		free((void *) cursor.data);
+		return -1;
+	}
+	int depth = BAM_INDEX_BAI_DEPTH;
+	if (csi) {
+		get_int32(&cursor);		// min_shift
+		depth = get_int32(&cursor);
+		get(&cursor, get_int32(&cursor));
+	}
+	uint32_t meta_bin = level_first_bin(depth + 1) + 1;
+
+	// candidates: the start of every reference with records and, with a
+	// linear index (BAI), the start of every window
+	bam_index_split_t *candidates = NULL;
+	int num_candidates = 0, max_candidates = 0;
+	uint64_t last_offset = 0;
+	int num_refs = get_int32(&cursor);
+	for (int tid = 0; tid < num_refs && !cursor.error; tid++) {
+		int has_meta = 0;
+		uint64_t off_beg = 0;
+		int num_bins = get_int32(&cursor);
+		for (int i = 0; i < num_bins && !cursor.error; i++) {
+			uint32_t bin = (uint32_t) get_int32(&cursor);
+			if (csi) {
+				get_uint64(&cursor);	// loffset
+			}
+			int num_ck = get_int32(&cursor);
+			if (bin == meta_bin && num_ck > 0) {
+				has_meta = 1;
+				off_beg = get_uint64(&cursor);
+				uint64_t off_end = get_uint64(&cursor);
+				if (last_offset < off_end) {
+					last_offset = off_end;
+				}
+				get(&cursor, 16 * (num_ck - 1));
+			} else {
+				get(&cursor, 16 * num_ck);
+			}
+		}
+		if (has_meta) {
+			add_split(&candidates, &num_candidates, &max_candidates, tid, 0, off_beg);
+		}
+		if (!csi) {
+			int num_intervals = get_int32(&cursor);
+			const unsigned char *intervals = get(&cursor, 8 * (size_t) num_intervals);
+			for (int w = 1; has_meta && intervals && w < num_intervals; w++) {
+				// records of the previous window (or overlapping it)
+				// come before any record starting in this one
+				uint64_t offset;
+				memcpy(&offset, intervals + 8 * (w - 1), 8);
+				add_split(&candidates, &num_candidates, &max_candidates, tid,
+					  w << BAM_INDEX_BAI_MIN_SHIFT, (offset > off_beg ? offset : off_beg));
+			}
+		}
+	}
+	free((void *) cursor.data);
+	if (cursor.error) {
+		free(candidates);
+		return -1;
+	}
+
+	// splits every chunk_size compressed bytes
+	uint64_t first = (num_candidates > 0 ? candidates[0].voffset >> 16 : 0);
+	uint64_t size = ((last_offset >> 16) > first ? (last_offset >> 16) - first : 0);
+	uint64_t chunk_size = size / (num_chunks > 0 ? num_chunks : 1) + 1;
+	uint64_t next = 0;
+	int num_splits = 0, max_splits = 0;
+	*splits = NULL;
+	for (int i = 0; i < num_candidates; i++) {
+		uint64_t offset = candidates[i].voffset >> 16;
+		if (num_splits == 0 || offset >= next) {
+			add_split(splits, &num_splits, &max_splits, candidates[i].tid,
+				  candidates[i].pos, candidates[i].voffset);
+			next = offset + chunk_size;
+		}
+	}
+	free(candidates);
+
+	return num_splits;
+}
+
+//------------------------------------------------------------------------
+
+static int compare_regions(const void *a, const void *b) {
+	const bam_index_region_t *ra = (const bam_index_region_t *) a;
+	const bam_index_region_t *rb = (const bam_index_region_t *) b;
+	if (ra->tid != rb->tid) {
+		return (ra->tid < rb->tid ? -1 : 1);
+	}
+	return (ra->beg < rb->beg ? -1 : (ra->beg > rb->beg ? 1 : 0));
+}
+
+static int compare_chunks(const void *a, const void *b) {
+	const bam_index_chunk_t *ca = (const bam_index_chunk_t *) a;
+	const bam_index_chunk_t *cb = (const bam_index_chunk_t *) b;
+	return (ca->beg < cb->beg ? -1 : (ca->beg > cb->beg ? 1 : 0));
+}
+
+static void add_chunk(bam_index_chunk_t **chunks, int *num_chunks, int *max_chunks,
+		      uint64_t beg, uint64_t end) {
+	if (*num_chunks == *max_chunks) {
+		*max_chunks = (*max_chunks ? 2 * *max_chunks : 256);
+		*chunks = (bam_index_chunk_t *) realloc(*chunks, *max_chunks * sizeof(bam_index_chunk_t));
+	}
+	(*chunks)[*num_chunks].beg = beg;
+	(*chunks)[*num_chunks].end = end;
+	(*num_chunks)++;
+}
+
+// does a bin overlap [beg, end) ?
+static inline int bin_overlaps(uint32_t bin, int64_t beg, int64_t end, int min_shift, int depth) {
+	int level = 0;
+	for (uint32_t b = bin; b; b = (b - 1) >> 3) {
+		level++;
+	}
+	if (level > depth) {
+		return 0;
+	}
+	int shift = min_shift + 3 * (depth - level);
+	int64_t offset = bin - level_first_bin(level);
+	return (offset >= (beg >> shift) && offset <= ((end - 1) >> shift));
+}
+
+// bins of a reference, pointing to the index data
+typedef struct index_bin {
+	uint32_t bin;
+	uint64_t loffset;
+	int num_chunks;
+	const unsigned char *chunks;
+} index_bin_t;
+
+int bam_index_load_chunks(const char *index_filename, bam_index_region_t *regions, int num_regions,
+			  bam_index_chunk_t **chunks) {
+	*chunks = NULL;
+
+	// overlapping regions are merged
+	qsort(regions, num_regions, sizeof(bam_index_region_t), compare_regions);
+	int n = 0;
+	for (int i = 0; i < num_regions; i++) {
+		if (regions[i].tid < 0 || regions[i].end <= regions[i].beg) {
+			continue;
+		}
+		if (n > 0 && regions[n - 1].tid == regions[i].tid && regions[i].beg <= regions[n - 1].end) {
+			if (regions[n - 1].end < regions[i].end) {
+				regions[n - 1].end = regions[i].end;
+			}
+		} else {
+			regions[n++] = regions[i];
+		}
+	}
+	num_regions = n;
+
+	index_cursor_t cursor;
+	memset(&cursor, 0, sizeof(index_cursor_t));
+	cursor.data = load_index(index_filename, &cursor.length);
+	if (cursor.data == NULL) {
+		return -1;
+	}
+
+	int csi;
+	const unsigned char *magic = get(&cursor, 4);
+	if (magic && memcmp(magic, "BAI\1", 4) == 0) {
+		csi = 0;
+	} else if (magic && memcmp(magic, "CSI\1", 4) == 0) {
+		csi = 1;
+	} else {
+		free((void *) cursor.data);
+		return -1;
+	}
+	int min_shift = BAM_INDEX_BAI_MIN_SHIFT;
+	int depth = BAM_INDEX_BAI_DEPTH;
+	if (csi) {
+		min_shift = get_int32(&cursor);
+		depth = get_int32(&cursor);
+		get(&cursor, get_int32(&cursor));
+	}
+	uint32_t meta_bin = level_first_bin(depth + 1) + 1;
+
+	index_bin_t *bins = NULL;
+	int max_bins = 0;
+	int num_chunks = 0, max_chunks = 0;
+	int r = 0;
+	int num_refs = get_int32(&cursor);
+	for (int tid = 0; tid < num_refs && !cursor.error; tid++) {
+		int num_bins = get_int32(&cursor);
+		if (num_bins > max_bins) {
+			max_bins = num_bins;
+			bins = (index_bin_t *) realloc(bins, max_bins * sizeof(index_bin_t));
+		}
+		for (int i = 0; i < num_bins && !cursor.error; i++) {
+			bins[i].bin = (uint32_t) get_int32(&cursor);
+			bins[i].loffset = (csi ? get_uint64(&cursor) : 0);
+			bins[i].num_chunks = get_int32(&cursor);
+			bins[i].chunks = get(&cursor, 16 * (size_t) bins[i].num_chunks);
+		}
+		int num_intervals = 0;
+		const unsigned char *intervals = NULL;
+		if (!csi) {
+			num_intervals = get_int32(&cursor);
+			intervals = get(&cursor, 8 * (size_t) num_intervals);
+		}
+		if (cursor.error) {
+			break;
+		}
+
+		while (r < num_regions && regions[r].tid < tid) {
+			r++;
+		}
+		for (; r < num_regions && regions[r].tid == tid; r++) {
+			int64_t beg = regions[r].beg, end = regions[r].end;
+
+			// records ending before this offset do not reach the region
+			uint64_t min_off = 0;
+			if (!csi) {
+				if (num_intervals > 0) {
+					int w = beg >> BAM_INDEX_BAI_MIN_SHIFT;
+					memcpy(&min_off, intervals + 8 * (size_t) (w < num_intervals ? w : num_intervals - 1), 8);
+				}
+			} else {
+				// offset of the smallest existing bin holding beg
+				for (int level = depth; level >= 0 && !min_off; level--) {
+					uint32_t bin = level_first_bin(level) + (beg >> (min_shift + 3 * (depth - level)));
+					for (int i = 0; i < num_bins; i++) {
+						if (bins[i].bin == bin) {
+							min_off = bins[i].loffset;
+							break;
+						}
+					}
+				}
+			}
+
+			for (int i = 0; i < num_bins; i++) {
+				if (bins[i].bin == meta_bin || !bin_overlaps(bins[i].bin, beg, end, min_shift, depth)) {
+					continue;
+				}
+				for (int j = 0; j < bins[i].num_chunks; j++) {
+					uint64_t ck[2];
+					memcpy(ck, bins[i].chunks + 16 * j, 16);
+					if (ck[1] > min_off) {
+						add_chunk(chunks, &num_chunks, &max_chunks, ck[0], ck[1]);
+					}
+				}
+			}
+		}
+	}
+	free(bins);
+	free((void *) cursor.data);
+	if (cursor.error) {
+		free(*chunks);
+		*chunks = NULL;
+		return -1;
+	}
+
+	// sorted, and merged when they overlap or share a BGZF block
+	qsort(*chunks, num_chunks, sizeof(bam_index_chunk_t), compare_chunks);
+	n = 0;
+	for (int i = 0; i < num_chunks; i++) {
+		if (n > 0 && ((*chunks)[i].beg <= (*chunks)[n - 1].end
+			      || (*chunks)[i].beg >> 16 == (*chunks)[n - 1].end >> 16)) {
+			if ((*chunks)[n - 1].end < (*chunks)[i].end) {
+				(*chunks)[n - 1].end = (*chunks)[i].end;
+			}
+		} else {
+			(*chunks)[n++] = (*chunks)[i];
+		}
+	}
+
+	return n;
+}
+
+//------------------------------------------------------------------------
+
+int bam_index_find(const char *bam_filename, char *index_filename) {
+	bam_index_filename(bam_filename, BAM_INDEX_BAI, index_filename);
+	if (access(index_filename, R_OK) == 0) {
+		return 0;
+	}
+	bam_index_filename(bam_filename, BAM_INDEX_CSI, index_filename);
+	if (access(index_filename, R_OK) == 0) {
+		return 0;
+	}
+	return -1;
+}
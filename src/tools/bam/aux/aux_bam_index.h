@@ -0,0 +1,218 @@
+#ifndef AUX_BAM_INDEX_H_
+#define AUX_BAM_INDEX_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "bioformats/bam/samtools/bam.h"
+
+#include "aux_bgzf.h"
+
+/***************************
+ * BAM INDEX BUILDER
+ *
+ * Builds the index of a coordinate-sorted BAM file while it is being
+ * written, records are added in file order with their start and end offsets
+ * (the same bins, chunks and linear index as samtools 0.1.18 bam_index_core).
+ *
+ * BAI indexes use 16 kbp windows and 5 levels of bins, so they are limited
+ * to references of 512 Mbp. CSI indexes (as htslib) take the size of the
+ * smallest window (min_shift) and as many levels as the longest reference
+ * needs, and store the linear index as an offset per bin.
+ *
+ * Offsets can be virtual offsets or any monotonic offset translated into
+ * virtual offsets when the index is saved (e.g. uncompressed offsets of the
+ * multithreaded BGZF writer).
+ **************************/
+
+#define BAM_INDEX_BAI           0
+#define BAM_INDEX_CSI           1
+
+#define BAM_INDEX_BAI_MIN_SHIFT 14
+#define BAM_INDEX_BAI_DEPTH     5
+#define BAM_INDEX_BAI_MAX_LEN   (1LL << 29)
+
+#define BAM_INDEX_NO_BIN        0xffffffffu
+
+typedef uint64_t (*bam_index_voffset_func_t)(void *data, uint64_t offset);
+
+typedef struct bam_index_chunk {
+	uint64_t beg;
+	uint64_t end;
+} bam_index_chunk_t;
+
+typedef struct bam_index_bin {
+	uint32_t bin;
+	int num_chunks;
+	int max_chunks;
+	bam_index_chunk_t *chunks;
+} bam_index_bin_t;
+
+typedef struct bam_index_ref {
+	int num_bins;
+	int max_bins;
+	bam_index_bin_t *bins;
+
+	int num_intervals;
+	int max_intervals;
+	uint64_t *intervals;
+
+	int has_meta;
+	uint64_t off_beg;
+	uint64_t off_end;
+	uint64_t num_mapped;
+	uint64_t num_unmapped;
+} bam_index_ref_t;
+
+typedef struct bam_index_builder {
+	int format;
+	int min_shift;
+	int depth;
+	uint32_t meta_bin;		// pseudo-bin with the reference metadata
+
+	int num_refs;
+	bam_index_ref_t *refs;
+
+	// position + 1 of every bin of the current reference in refs[tid].bins
+	int *bin_pos;
+
+	int32_t tid;
+	int32_t last_pos;
+	uint32_t save_bin;
+	uint64_t save_off;
+	uint64_t off_beg;
+	uint64_t num_mapped;
+	uint64_t num_unmapped;
+	uint64_t num_no_coor;
+	int no_coor;
+
+	int error;
+	int saved;
+} bam_index_builder_t;
+
+/**
+ * \param header BAM header.
+ * \param format BAM_INDEX_BAI or BAM_INDEX_CSI, a BAI index turns into a CSI
+ *        one if a reference is longer than BAM_INDEX_BAI_MAX_LEN.
+ * \param min_shift Size of the smallest CSI window (bits), 0 for the default one.
+ */
+bam_index_builder_t *bam_index_builder_new(const bam_header_t *header, int format, int min_shift);
+
+void bam_index_builder_free(bam_index_builder_t *builder);
+
+/**
+ * Adds a record.
+ * \param b Record.
+ * \param beg Offset of the record in the file.
+ * \param end Offset of the next record.
+ * \return 0 on success, -1 if the records are not sorted by coordinate.
+ */
+int bam_index_builder_add(bam_index_builder_t *builder, const bam1_t *b, uint64_t beg, uint64_t end);
+
+/**
+ * Adds a record given its core and CIGAR (e.g. a record still in BAM layout).
+ */
+int bam_index_builder_add_core(bam_index_builder_t *builder, const bam1_core_t *c, const uint32_t *cigar,
+			       uint64_t beg, uint64_t end);
+
+/**
+ * Closes the last reference.
+ * \param end Offset of the end of the records.
+ */
+int bam_index_builder_finish(bam_index_builder_t *builder, uint64_t end);
+
+/**
+ * Saves the index (BAI or BGZF-compressed CSI).
+ * \param filename Output file name.
+ * \param voffset Function translating the offsets into virtual offsets, NULL if they are virtual offsets.
+ * \param data Argument for voffset.
+ * \return 0 on success, the index can be saved only once.
+ */
+int bam_index_builder_save(bam_index_builder_t *builder, const char *filename,
+			   bam_index_voffset_func_t voffset, void *data);
+
+/**
+ * Index file name: prefix + ".bai" or ".csi".
+ * \param filename Buffer of strlen(prefix) + 5 bytes at least.
+ */
+void bam_index_filename(const char *prefix, int format, char *filename);
+
+/**
+ * Indexes a BAM file, BGZF blocks are inflated on several threads while
+ * the records are added to the index.
+ * \param bam_filename Input file name.
+ * \param prefix Index file name without extension, NULL for bam_filename.
+ * \param format BAM_INDEX_BAI or BAM_INDEX_CSI.
+ * \param min_shift Size of the smallest CSI window (bits), 0 for the default one.
+ * \param num_threads Threads to inflate blocks.
+ * \return Format of the index (see bam_index_builder_new), -1 on error.
+ */
+int bam_index_build(const char *bam_filename, const char *prefix, int format,
+		    int min_shift, int num_threads);
+
+/***************************
+ * BAM INDEX SPLITS
+ *
+ * Splits a coordinate-sorted BAM file into chunks that can be read on their
+ * own: chunk i holds the records at (tid, pos) >= splits[i] and < splits[i+1]
+ * (the last one up to the end of the file, unplaced reads included), and
+ * all of them come after splits[i].voffset, though some records of the
+ * previous chunk may come after it too.
+ *
+ * Splits fall at the start of a reference or, with a BAI index, of a 16 kbp
+ * window of the linear index (CSI indexes have no linear index).
+ **************************/
+
+typedef struct bam_index_split {
+	int32_t tid;
+	int32_t pos;
+	uint64_t voffset;
+} bam_index_split_t;
+
+/**
+ * Loads the splits from an index.
+ * \param index_filename BAI or CSI file.
+ * \param num_chunks Number of chunks wanted, of similar compressed size.
+ * \param splits Output array (free), sorted by position.
+ * \return Number of splits (about num_chunks), -1 on error.
+ */
+int bam_index_load_splits(const char *index_filename, int num_chunks, bam_index_split_t **splits);
+
+/***************************
+ * BAM INDEX REGIONS
+ *
+ * Chunks of a coordinate-sorted BAM file holding the records that overlap
+ * a set of regions (as samtools bam_fetch): the bins overlapping every
+ * region give the chunks, those ending before the first record of the
+ * region (linear index of BAI, bin offsets of CSI) are dropped, and the
+ * rest are sorted and merged. The chunks may hold records outside the
+ * regions too, they must be tested by the caller.
+ **************************/
+
+typedef struct bam_index_region {
+	int32_t tid;
+	int32_t beg;		// 0-based
+	int32_t end;		// exclusive
+} bam_index_region_t;
+
+/**
+ * Loads the chunks of a set of regions from an index.
+ * \param index_filename BAI or CSI file.
+ * \param regions Regions in any order, overlapping regions are merged (the array is sorted).
+ * \param chunks Output array (free), sorted and not overlapping.
+ * \return Number of chunks, -1 on error.
+ */
+int bam_index_load_chunks(const char *index_filename, bam_index_region_t *regions, int num_regions,
+			  bam_index_chunk_t **chunks);
+
+/**
+ * Index of a BAM file: bam_filename + ".bai" or ".csi".
+ * \param index_filename Buffer of strlen(bam_filename) + 5 bytes at least.
+ * \return 0 if there is an index, -1 if not.
+ */
+int bam_index_find(const char *bam_filename, char *index_filename);
+
+#endif /* AUX_BAM_INDEX_H_ */
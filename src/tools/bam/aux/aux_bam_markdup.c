@@ -0,0 +1,687 @@
+#include "aux_bam_markdup.h"
+
+#include "containers/khash.h"
+#include "commons/log.h"
+
+//------------------------------------------------------------------------
+
+#define PAIR_PENDING  0
+#define PAIR_KEPT     1
+#define PAIR_DUP      2
+
+// group key: library, 5' end and strand of the read and, for pairs, of the
+// mate (the two ends in position order), tid2 is -1 for fragments
+typedef struct md_key {
+	int32_t lib;
+	int32_t tid1;
+	int32_t pos1;
+	int32_t strand1;
+	int32_t tid2;
+	int32_t pos2;
+	int32_t strand2;
+} md_key_t;
+
+typedef struct md_pair {
+	char *name;
+	int state;
+	int32_t mtid;
+	int waiting;			// the mate is in the window
+} md_pair_t;
+
+typedef struct md_record {
+	bam1_t *bam;
+	int score;
+	int resolved;
+	struct md_group *group;		// group of the read, until it is decided
+	md_pair_t *pair;		// pair of the read, until it is resolved
+	struct md_record *next;		// window
+	struct md_record *next_member;	// group
+} md_record_t;
+
+typedef struct md_group {
+	md_key_t key;
+	uint64_t hash;
+	int32_t tid;
+	int32_t pos;			// 5' end of the read that opened it
+	int32_t opened;			// input position when it was opened
+	int has_pairs;			// fragments: a pair read has the same end
+	md_record_t *first;
+	md_record_t *last;
+	struct md_group *next;		// same hash
+	struct md_group *prev_open;	// open groups, in creation order
+	struct md_group *next_open;
+} md_group_t;
+
+KHASH_MAP_INIT_INT64(md_group, md_group_t*)
+KHASH_MAP_INIT_STR(md_pair, md_pair_t*)
+
+struct bam_markdup {
+	int remove;
+	bam_markdup_write_func_t write;
+	void *data;
+	int error;
+
+	// libraries by read group
+	int num_rgs;
+	char **rg_ids;
+	int *rg_libs;
+
+	// last position of the input
+	int32_t tid;
+	int32_t pos;
+	int32_t window;			// longest unclipped read
+
+	// records in input order
+	md_record_t *head;
+	md_record_t *tail;
+
+	md_group_t *first_open;
+	md_group_t *last_open;
+
+	khash_t(md_group) *groups;
+	khash_t(md_pair) *pairs;
+
+	// recycled memory
+	md_record_t *free_records;
+	int num_free_bams;
+	int max_free_bams;
+	bam1_t **free_bams;
+
+	bam_markdup_stats_t stats;
+};
+
+//------------------------------------------------------------------------
+// libraries
+//------------------------------------------------------------------------
+
+// value of the tag in a tab-separated header line, 0 if not found
+static int header_tag(const char *line, const char *end, const char *tag, const char **value) {
+	for (const char *p = line; p && p < end; p = memchr(p, '\t', end - p)) {
+		p++;
+		if (p + 3 <= end && p[0] == tag[0] && p[1] == tag[1] && p[2] == ':') {
+			*value = p + 3;
+			const char *q = *value;
+			while (q < end && *q != '\t') {
+				q++;
+			}
+			return q - *value;
+		}
+	}
+	return 0;
+}
+
+static void load_libraries(bam_markdup_t *md, const bam_header_t *header) {
+	const char *text = header->text, *text_end = header->text + header->l_text;
+	char **libs = NULL;
+	int num_libs = 0, max_rgs = 0;
+
+	for (const char *line = text; line && line < text_end; ) {
+		const char *end = memchr(line, '\n', text_end - line);
+		if (end == NULL) {
+			end = text_end;
+		}
+		const char *id, *lb;
+		int id_len, lb_len;
+		if (end - line > 4 && strncmp(line, "@RG\t", 4) == 0 &&
+		    (id_len = header_tag(line, end, "ID", &id)) > 0) {
+			if (md->num_rgs == max_rgs) {
+				max_rgs = (max_rgs ? 2 * max_rgs : 16);
+				md->rg_ids = (char **) realloc(md->rg_ids, max_rgs * sizeof(char *));
+				md->rg_libs = (int *) realloc(md->rg_libs, max_rgs * sizeof(int));
+				libs = (char **) realloc(libs, max_rgs * sizeof(char *));
+			}
+			md->rg_ids[md->num_rgs] = strndup(id, id_len);
+
+			// read groups without library are libraries on their own
+			char *lib = ((lb_len = header_tag(line, end, "LB", &lb)) > 0 ? strndup(lb, lb_len) : NULL);
+			int l;
+			for (l = 0; lib && l < num_libs && (libs[l] == NULL || strcmp(libs[l], lib) != 0); l++);
+			if (lib == NULL || l == num_libs) {
+				libs[num_libs] = lib;
+				l = num_libs++;
+			} else {
+				free(lib);
+			}
+			md->rg_libs[md->num_rgs] = l + 1;
+			md->num_rgs++;
+		}
+		line = end + 1;
+	}
+
+	for (int i = 0; i < num_libs; i++) {
+		if (libs[i]) {
+			free(libs[i]);
+		}
+	}
+	free(libs);
+}
+
+// 0 for the records without read group
+static inline int get_library(bam_markdup_t *md, const bam1_t *b) {
+	if (md->num_rgs == 0) {
+		return 0;
+	}
+	uint8_t *s = bam_aux_get(b, "RG");
+	if (s == NULL) {
+		return 0;
+	}
+	const char *id = bam_aux2Z(s);
+	for (int i = 0; id && i < md->num_rgs; i++) {
+		if (strcmp(md->rg_ids[i], id) == 0) {
+			return md->rg_libs[i];
+		}
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------
+// 5' ends
+//------------------------------------------------------------------------
+
+// unclipped 5' end, the clips (soft and hard) are added to the alignment
+static inline int32_t unclipped_end(int32_t pos, int reverse, int lead, int ref_len, int trail) {
+	return (reverse ? pos + ref_len - 1 + trail : pos - lead);
+}
+
+static int32_t read_end(const bam1_t *b, int32_t *length) {
+	uint32_t *cigar = bam1_cigar(b);
+	int n = b->core.n_cigar;
+	int lead = 0, trail = 0, ref_len = 0, i;
+
+	for (i = 0; i < n; i++) {
+		int op = cigar[i] & BAM_CIGAR_MASK;
+		if (op != BAM_CSOFT_CLIP && op != BAM_CHARD_CLIP) {
+			break;
+		}
+		lead += cigar[i] >> BAM_CIGAR_SHIFT;
+	}
+	for (int j = n - 1; j >= i; j--) {
+		int op = cigar[j] & BAM_CIGAR_MASK;
+		if (op != BAM_CSOFT_CLIP && op != BAM_CHARD_CLIP) {
+			break;
+		}
+		trail += cigar[j] >> BAM_CIGAR_SHIFT;
+		n = j;
+	}
+	for (; i < n; i++) {
+		int op = cigar[i] & BAM_CIGAR_MASK;
+		if (op == BAM_CMATCH || op == BAM_CDEL || op == BAM_CREF_SKIP || op == 7 || op == 8) {
+			ref_len += cigar[i] >> BAM_CIGAR_SHIFT;
+		}
+	}
+
+	*length = lead + ref_len + trail;
+	return unclipped_end(b->core.pos, bam1_strand(b), lead, ref_len, trail);
+}
+
+// from the CIGAR of the mate (MC tag), its position otherwise
+static int32_t mate_end(const bam1_t *b) {
+	int reverse = bam1_mstrand(b);
+	uint8_t *s = bam_aux_get(b, "MC");
+	const char *p = (s ? bam_aux2Z(s) : NULL);
+	if (p == NULL) {
+		return b->core.mpos;
+	}
+
+	int lead = 0, trail = 0, ref_len = 0, aligned = 0;
+	while (*p) {
+		char *q;
+		long len = strtol(p, &q, 10);
+		if (q == p || *q == 0) {
+			return b->core.mpos;
+		}
+		switch (*q) {
+		case 'S':
+		case 'H':
+			if (aligned) {
+				trail += len;
+			} else {
+				lead += len;
+			}
+			break;
+		case 'M':
+		case 'D':
+		case 'N':
+		case '=':
+		case 'X':
+			ref_len += len;
+			aligned = 1;
+			trail = 0;
+			break;
+		default:
+			aligned = 1;
+			break;
+		}
+		p = q + 1;
+	}
+	return unclipped_end(b->core.mpos, reverse, lead, ref_len, trail);
+}
+
+// sum of the base qualities >= BAM_MARKDUP_MIN_QUALITY, and the mate score
+// (ms tag), pairs without it are scored by this read only
+static int read_score(const bam1_t *b) {
+	uint8_t *qual = bam1_qual(b);
+	int score = 0;
+	for (int i = 0; i < b->core.l_qseq; i++) {
+		if (qual[i] >= BAM_MARKDUP_MIN_QUALITY) {
+			score += qual[i];
+		}
+	}
+	uint8_t *s = bam_aux_get(b, "ms");
+	if (s) {
+		score += bam_aux2i(s);
+	}
+	return score;
+}
+
+//------------------------------------------------------------------------
+// groups
+//------------------------------------------------------------------------
+
+static inline uint64_t key_hash(const md_key_t *key) {
+	const int32_t *x = (const int32_t *) key;
+	uint64_t h = 0x9e3779b97f4a7c15LLU;
+	for (int i = 0; i < 7; i++) {
+		h ^= (uint32_t) x[i];
+		h *= 0xff51afd7ed558ccdLLU;
+		h ^= h >> 32;
+	}
+	return h;
+}
+
+static md_group_t *group_get(bam_markdup_t *md, const md_key_t *key, int32_t tid, int32_t pos) {
+	uint64_t h = key_hash(key);
+	md_group_t *first = NULL;
+
+	khiter_t k = kh_get(md_group, md->groups, h);
+	if (k != kh_end(md->groups)) {
+		first = kh_value(md->groups, k);
+		for (md_group_t *g = first; g; g = g->next) {
+			if (memcmp(&g->key, key, sizeof(md_key_t)) == 0) {
+				return g;
+			}
+		}
+	} else {
+		int ret;
+		k = kh_put(md_group, md->groups, h, &ret);
+	}
+
+	md_group_t *g = (md_group_t *) calloc(1, sizeof(md_group_t));
+	g->key = *key;
+	g->hash = h;
+	g->tid = tid;
+	g->pos = pos;
+	g->opened = md->pos;
+	g->next = first;
+	kh_value(md->groups, k) = g;
+
+	g->prev_open = md->last_open;
+	if (md->last_open) {
+		md->last_open->next_open = g;
+	} else {
+		md->first_open = g;
+	}
+	md->last_open = g;
+
+	return g;
+}
+
+static void group_free(bam_markdup_t *md, md_group_t *g) {
+	khiter_t k = kh_get(md_group, md->groups, g->hash);
+	md_group_t *first = kh_value(md->groups, k);
+	if (first == g) {
+		if (g->next) {
+			kh_value(md->groups, k) = g->next;
+		} else {
+			kh_del(md_group, md->groups, k);
+		}
+	} else {
+		md_group_t *prev = first;
+		while (prev->next != g) {
+			prev = prev->next;
+		}
+		prev->next = g->next;
+	}
+
+	if (g->prev_open) {
+		g->prev_open->next_open = g->next_open;
+	} else {
+		md->first_open = g->next_open;
+	}
+	if (g->next_open) {
+		g->next_open->prev_open = g->prev_open;
+	} else {
+		md->last_open = g->prev_open;
+	}
+
+	free(g);
+}
+
+static inline int group_closed(bam_markdup_t *md, md_group_t *g) {
+	return (g->tid != md->tid || (int64_t) md->pos > (int64_t) g->pos + md->window);
+}
+
+// the 5' end of a read is at most a read length away from its position,
+// so the groups opened two read lengths ago are closed
+static inline int group_old(bam_markdup_t *md, md_group_t *g) {
+	return (g->tid != md->tid || (int64_t) md->pos > (int64_t) g->opened + 2 * (int64_t) md->window);
+}
+
+// marks all the reads of the group but the best one (or all of them,
+// fragments at the end of a pair)
+static void group_decide(bam_markdup_t *md, md_group_t *g) {
+	md_record_t *best = NULL;
+	if (!g->has_pairs) {
+		for (md_record_t *r = g->first; r; r = r->next_member) {
+			if (best == NULL || r->score > best->score) {
+				best = r;
+			}
+		}
+	}
+
+	for (md_record_t *r = g->first; r; r = r->next_member) {
+		int dup = (r != best);
+		if (dup) {
+			r->bam->core.flag |= BAM_FDUP;
+			if (r->pair) {
+				md->stats.num_dup_pairs++;
+			} else {
+				md->stats.num_dup_fragments++;
+			}
+		}
+		if (r->pair) {
+			r->pair->state = (dup ? PAIR_DUP : PAIR_KEPT);
+			r->pair = NULL;
+		}
+		r->group = NULL;
+		r->resolved = 1;
+	}
+
+	group_free(md, g);
+}
+
+//------------------------------------------------------------------------
+// pairs
+//------------------------------------------------------------------------
+
+static void pair_free(bam_markdup_t *md, md_pair_t *p) {
+	khiter_t k = kh_get(md_pair, md->pairs, p->name);
+	if (k != kh_end(md->pairs)) {
+		kh_del(md_pair, md->pairs, k);
+	}
+	free(p->name);
+	free(p);
+}
+
+// pairs whose mate should have come already (a previous reference)
+static void pairs_purge(bam_markdup_t *md) {
+	for (khiter_t k = kh_begin(md->pairs); k != kh_end(md->pairs); k++) {
+		if (!kh_exist(md->pairs, k)) {
+			continue;
+		}
+		md_pair_t *p = kh_value(md->pairs, k);
+		if (p->state != PAIR_PENDING && !p->waiting && (uint32_t) p->mtid < (uint32_t) md->tid) {
+			kh_del(md_pair, md->pairs, k);
+			free(p->name);
+			free(p);
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+// window
+//------------------------------------------------------------------------
+
+static inline void recycle_bam(bam_markdup_t *md, bam1_t *b) {
+	if (md->num_free_bams == md->max_free_bams) {
+		md->max_free_bams = (md->max_free_bams ? 2 * md->max_free_bams : 64);
+		md->free_bams = (bam1_t **) realloc(md->free_bams, md->max_free_bams * sizeof(bam1_t *));
+	}
+	md->free_bams[md->num_free_bams++] = b;
+}
+
+// writes the records of the head of the window whose status is known
+static void window_write(bam_markdup_t *md, int flush) {
+	// groups the input went past, in creation order
+	while (md->first_open && (flush || group_old(md, md->first_open))) {
+		group_decide(md, md->first_open);
+	}
+
+	md_record_t *r;
+	while ((r = md->head)) {
+		if (!r->resolved && r->group) {
+			if (!group_closed(md, r->group)) {
+				break;
+			}
+			group_decide(md, r->group);
+		}
+		if (!r->resolved) {
+			// a mate waiting for its pair
+			if (r->pair == NULL || r->pair->state == PAIR_PENDING) {
+				break;
+			}
+			if (r->pair->state == PAIR_DUP) {
+				r->bam->core.flag |= BAM_FDUP;
+			}
+			pair_free(md, r->pair);
+			r->pair = NULL;
+			r->resolved = 1;
+		}
+
+		md->head = r->next;
+		if (md->head == NULL) {
+			md->tail = NULL;
+		}
+
+		if (md->remove && (r->bam->core.flag & BAM_FDUP)) {
+			md->stats.num_removed++;
+		} else if (md->write(md->data, r->bam) < 0) {
+			md->error = 1;
+		}
+		recycle_bam(md, r->bam);
+
+		r->next = md->free_records;
+		md->free_records = r;
+	}
+}
+
+//------------------------------------------------------------------------
+
+bam_markdup_t *bam_markdup_new(const bam_header_t *header, int remove,
+			       bam_markdup_write_func_t write, void *data) {
+	bam_markdup_t *md = (bam_markdup_t *) calloc(1, sizeof(bam_markdup_t));
+	md->remove = remove;
+	md->write = write;
+	md->data = data;
+	md->tid = -1;
+	md->groups = kh_init(md_group);
+	md->pairs = kh_init(md_pair);
+
+	load_libraries(md, header);
+
+	return md;
+}
+
+void bam_markdup_free(bam_markdup_t *md) {
+	if (md == NULL) {
+		return;
+	}
+
+	// records not flushed
+	for (md_record_t *r = md->head, *next; r; r = next) {
+		next = r->next;
+		bam_destroy1(r->bam);
+		free(r);
+	}
+	while (md->first_open) {
+		group_free(md, md->first_open);
+	}
+	for (khiter_t k = kh_begin(md->pairs); k != kh_end(md->pairs); k++) {
+		if (kh_exist(md->pairs, k)) {
+			md_pair_t *p = kh_value(md->pairs, k);
+			free(p->name);
+			free(p);
+		}
+	}
+	kh_destroy(md_group, md->groups);
+	kh_destroy(md_pair, md->pairs);
+
+	for (md_record_t *r = md->free_records, *next; r; r = next) {
+		next = r->next;
+		free(r);
+	}
+	for (int i = 0; i < md->num_free_bams; i++) {
+		bam_destroy1(md->free_bams[i]);
+	}
+	free(md->free_bams);
+
+	for (int i = 0; i < md->num_rgs; i++) {
+		free(md->rg_ids[i]);
+	}
+	free(md->rg_ids);
+	free(md->rg_libs);
+
+	free(md);
+}
+
+bam1_t *bam_markdup_add(bam_markdup_t *md, bam1_t *b) {
+	bam1_core_t *c = &b->core;
+
+	md->stats.num_records++;
+
+	// unplaced reads (tid -1) go at the end
+	if (md->stats.num_records > 1 &&
+	    ((uint32_t) c->tid < (uint32_t) md->tid || (c->tid == md->tid && c->pos < md->pos))) {
+		if (!md->error) {
+			LOG_ERROR_F("Records not sorted by coordinate (record %lu), duplicates are not marked\n",
+				    md->stats.num_records);
+		}
+		md->error = 1;
+	} else if (c->tid != md->tid) {
+		md->tid = c->tid;
+		md->pos = c->pos;
+		pairs_purge(md);
+	} else {
+		md->pos = c->pos;
+	}
+
+	md_record_t *r = md->free_records;
+	if (r) {
+		md->free_records = r->next;
+	} else {
+		r = (md_record_t *) malloc(sizeof(md_record_t));
+	}
+	memset(r, 0, sizeof(md_record_t));
+	r->bam = b;
+	r->resolved = 1;
+
+	if (!md->error && c->tid >= 0 && !(c->flag & (BAM_FUNMAP | BAM_FSECONDARY | 0x800))) {
+		c->flag &= ~BAM_FDUP;
+
+		int32_t length, end;
+		int member = 0;
+		md_key_t key;
+		memset(&key, 0, sizeof(md_key_t));
+		key.lib = get_library(md, b);
+		key.tid1 = c->tid;
+		key.pos1 = end = read_end(b, &length);
+		key.strand1 = bam1_strand(b);
+		key.tid2 = -1;
+		key.pos2 = -1;
+		if (length > md->window) {
+			md->window = length;
+		}
+
+		if ((c->flag & BAM_FPAIRED) && !(c->flag & BAM_FMUNMAP) && c->mtid >= 0) {
+			// the reads of pairs are not fragment duplicates
+			group_get(md, &key, c->tid, end)->has_pairs = 1;
+
+			khiter_t k = kh_get(md_pair, md->pairs, bam1_qname(b));
+			if (k != kh_end(md->pairs)) {
+				// the mate decided for both
+				md_pair_t *p = kh_value(md->pairs, k);
+				if (p->state == PAIR_PENDING) {
+					r->pair = p;
+					r->resolved = 0;
+					p->waiting = 1;
+				} else {
+					if (p->state == PAIR_DUP) {
+						c->flag |= BAM_FDUP;
+					}
+					pair_free(md, p);
+				}
+			} else {
+				md_pair_t *p = (md_pair_t *) calloc(1, sizeof(md_pair_t));
+				p->name = strdup(bam1_qname(b));
+				p->mtid = c->mtid;
+				int ret;
+				k = kh_put(md_pair, md->pairs, p->name, &ret);
+				kh_value(md->pairs, k) = p;
+
+				// the two ends in position order
+				int32_t mpos = mate_end(b);
+				int mstrand = bam1_mstrand(b);
+				if (c->mtid < key.tid1 || (c->mtid == key.tid1 && (mpos < key.pos1 ||
+						(mpos == key.pos1 && mstrand < key.strand1)))) {
+					key.tid2 = key.tid1;
+					key.pos2 = key.pos1;
+					key.strand2 = key.strand1;
+					key.tid1 = c->mtid;
+					key.pos1 = mpos;
+					key.strand1 = mstrand;
+				} else {
+					key.tid2 = c->mtid;
+					key.pos2 = mpos;
+					key.strand2 = mstrand;
+				}
+
+				r->pair = p;
+				member = 1;
+				md->stats.num_pairs++;
+			}
+		} else {
+			member = 1;
+			md->stats.num_fragments++;
+		}
+
+		if (member) {
+			// first read of a pair or fragment
+			md_group_t *g = group_get(md, &key, c->tid, end);
+			r->group = g;
+			r->score = read_score(b);
+			r->resolved = 0;
+			if (g->last) {
+				g->last->next_member = r;
+			} else {
+				g->first = r;
+			}
+			g->last = r;
+		}
+	}
+
+	if (md->tail) {
+		md->tail->next = r;
+	} else {
+		md->head = r;
+	}
+	md->tail = r;
+
+	window_write(md, 0);
+
+	if (md->num_free_bams > 0) {
+		return md->free_bams[--md->num_free_bams];
+	}
+	return bam_init1();
+}
+
+void bam_markdup_flush(bam_markdup_t *md) {
+	window_write(md, 1);
+}
+
+int bam_markdup_error(bam_markdup_t *md) {
+	return md->error;
+}
+
+const bam_markdup_stats_t *bam_markdup_stats(bam_markdup_t *md) {
+	return &md->stats;
+}
@@ -0,0 +1,87 @@
+#ifndef AUX_BAM_MARKDUP_H_
+#define AUX_BAM_MARKDUP_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "bioformats/bam/samtools/bam.h"
+
+/***************************
+ * BAM DUPLICATE MARKING
+ *
+ * Streaming duplicate marker for records sorted by coordinate, meant to
+ * sit between a reader (or a merge/sort) and the BGZF writer. Records are
+ * kept in a window until their duplicate status is known, and handed to
+ * the output function in input order.
+ *
+ * Reads are grouped by library (LB of the read group) and by the unclipped
+ * 5' end and strand of the read:
+ *  - pairs with both reads mapped, also by the 5' end and strand of the
+ *    mate (from the MC tag, or the mate position without it), the best pair
+ *    of every group is kept and the others are duplicates (both reads),
+ *  - fragments (single reads or reads with the mate unmapped), the best one
+ *    is kept, unless a pair has a read at the same 5' end and strand, then
+ *    all of them are duplicates.
+ * The best one is the one with the highest sum of base qualities >= 15
+ * (plus the mate score of the ms tag, if any), the first one on ties.
+ *
+ * The first read of a pair in the input decides for both, its mate is
+ * marked when it arrives. The mate may be far away, so its qualities are
+ * not waited for: a pair is scored by the first read plus the ms tag, or
+ * by the first read only without it.
+ *
+ * A group is decided once the input goes past its 5' end by more than the
+ * longest unclipped read seen, so the window only holds the records of a
+ * read length, and the pending mates of the pairs.
+ *
+ * Unmapped, secondary and supplementary records are not marked.
+ **************************/
+
+#define BAM_MARKDUP_MIN_QUALITY  15
+
+typedef int (*bam_markdup_write_func_t)(void *data, bam1_t *b);
+
+typedef struct bam_markdup_stats {
+	uint64_t num_records;
+	uint64_t num_fragments;		// mapped reads with no mapped mate
+	uint64_t num_pairs;		// pairs with both reads mapped
+	uint64_t num_dup_fragments;
+	uint64_t num_dup_pairs;
+	uint64_t num_removed;
+} bam_markdup_stats_t;
+
+typedef struct bam_markdup bam_markdup_t;
+
+/**
+ * \param header BAM header, read groups give the libraries.
+ * \param remove Whether duplicates are removed (not written) instead of marked.
+ * \param write Output function, records are written in input order.
+ * \param data Argument for write.
+ */
+bam_markdup_t *bam_markdup_new(const bam_header_t *header, int remove,
+			       bam_markdup_write_func_t write, void *data);
+
+void bam_markdup_free(bam_markdup_t *md);
+
+/**
+ * Adds a record, the marker takes it.
+ * \return A free record to reuse for the next one.
+ */
+bam1_t *bam_markdup_add(bam_markdup_t *md, bam1_t *b);
+
+/**
+ * Writes the records left in the window, at the end of the input.
+ */
+void bam_markdup_flush(bam_markdup_t *md);
+
+/**
+ * \return Non-zero if the records were not sorted by coordinate or the
+ *         output function failed.
+ */
+int bam_markdup_error(bam_markdup_t *md);
+
+const bam_markdup_stats_t *bam_markdup_stats(bam_markdup_t *md);
+
+#endif /* AUX_BAM_MARKDUP_H_ */
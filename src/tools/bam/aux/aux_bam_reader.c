@@ -0,0 +1,137 @@
+#include "aux_bam_reader.h"
+
+//------------------------------------------------------------------------
+
+bam_reader_t *bam_reader_new(const char *filename, int num_threads) {
+	bgzf_mt_reader_t *bgzf = bgzf_mt_reader_new(filename, 0, (num_threads > 0 ? num_threads : 1));
+	if (bgzf == NULL) {
+		return NULL;
+	}
+	bam_header_t *header = bgzf_mt_read_bam_header(bgzf);
+	if (header == NULL) {
+		bgzf_mt_reader_free(bgzf);
+		return NULL;
+	}
+
+	bam_reader_t *reader = (bam_reader_t *) calloc(1, sizeof(bam_reader_t));
+	reader->bgzf = bgzf;
+	reader->header = header;
+	pthread_mutex_init(&reader->mutex, NULL);
+
+	return reader;
+}
+
+void bam_reader_free(bam_reader_t *reader) {
+	if (reader == NULL) {
+		return;
+	}
+	bgzf_mt_reader_free(reader->bgzf);
+	if (reader->chunks) {
+		free(reader->chunks);
+	}
+	if (reader->header) {
+		bam_header_destroy(reader->header);
+	}
+	pthread_mutex_destroy(&reader->mutex);
+	free(reader);
+}
+
+int bam_reader_seek(bam_reader_t *reader, uint64_t voffset) {
+	pthread_mutex_lock(&reader->mutex);
+	int ret = bgzf_mt_seek(reader->bgzf, voffset);
+	reader->eof = 0;
+	reader->error = (ret == 0 ? 0 : -2);
+	pthread_mutex_unlock(&reader->mutex);
+
+	return ret;
+}
+
+int bam_reader_set_chunks(bam_reader_t *reader, bam_index_chunk_t *chunks, int num_chunks) {
+	pthread_mutex_lock(&reader->mutex);
+	if (reader->chunks) {
+		free(reader->chunks);
+	}
+	reader->chunks = chunks;
+	reader->num_chunks = num_chunks;
+	reader->chunk = 0;
+	reader->eof = (num_chunks == 0);
+	reader->error = 0;
+	int ret = 0;
+	if (num_chunks > 0) {
+		ret = bgzf_mt_seek(reader->bgzf, chunks[0].beg);
+		reader->error = (ret == 0 ? 0 : -2);
+	}
+	pthread_mutex_unlock(&reader->mutex);
+
+	return ret;
+}
+
+//------------------------------------------------------------------------
+
+// moves to the next chunk once the current one is over,
+// the caller holds the mutex
+static inline int next_chunk(bam_reader_t *reader) {
+	uint64_t offset = bgzf_mt_tell(reader->bgzf);
+	while (reader->chunk < reader->num_chunks && offset >= reader->chunks[reader->chunk].end) {
+		reader->chunk++;
+	}
+	if (reader->chunk == reader->num_chunks) {
+		reader->eof = 1;
+		return -1;
+	}
+	if (offset < reader->chunks[reader->chunk].beg) {
+		if (bgzf_mt_seek(reader->bgzf, reader->chunks[reader->chunk].beg) != 0) {
+			reader->error = -2;
+			return -2;
+		}
+	}
+	return 0;
+}
+
+// the caller holds the mutex
+static inline int read1(bam_reader_t *reader, bam1_t *b) {
+	if (reader->eof || reader->error) {
+		return (reader->error ? reader->error : -1);
+	}
+	if (reader->chunks) {
+		int ret = next_chunk(reader);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+	int ret = bgzf_mt_read_bam1(reader->bgzf, b);
+	if (ret >= 0) {
+		reader->num_reads++;
+	} else if (ret == -1) {
+		reader->eof = 1;
+	} else {
+		reader->error = ret;
+	}
+	return ret;
+}
+
+int bam_reader_read1(bam_reader_t *reader, bam1_t *b) {
+	pthread_mutex_lock(&reader->mutex);
+	int ret = read1(reader, b);
+	pthread_mutex_unlock(&reader->mutex);
+
+	return ret;
+}
+
+size_t bam_reader_read_batch(bam_reader_t *reader, bam1_t **bams, size_t max_bams) {
+	size_t num_bams = 0;
+
+	pthread_mutex_lock(&reader->mutex);
+	while (num_bams < max_bams) {
+		if (bams[num_bams] == NULL) {
+			bams[num_bams] = bam_init1();
+		}
+		if (read1(reader, bams[num_bams]) < 0) {
+			break;
+		}
+		num_bams++;
+	}
+	pthread_mutex_unlock(&reader->mutex);
+
+	return num_bams;
+}
@@ -0,0 +1,81 @@
+#ifndef AUX_BAM_READER_H_
+#define AUX_BAM_READER_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "bioformats/bam/samtools/bam.h"
+
+#include "aux_bgzf.h"
+#include "aux_bam_index.h"
+
+/***************************
+ * BAM READER
+ *
+ * BAM input shared by the hpg-bam tools (stats, filter and the bfwork
+ * framework used by realign and recalibrate): BGZF blocks are prefetched
+ * and inflated on a thread pool (see aux_bgzf.h) and the records are
+ * handed out one by one or in batches of bam1_t. Several threads can read
+ * from the same reader.
+ **************************/
+
+#define BAM_READER_DEFAULT_THREADS 4
+
+typedef struct bam_reader {
+	bgzf_mt_reader_t *bgzf;
+	bam_header_t *header;		// set to NULL to keep it after bam_reader_free
+	pthread_mutex_t mutex;
+
+	uint64_t num_reads;
+	int eof;
+	int error;
+
+	// chunks to read (see bam_reader_set_chunks), NULL for the whole file
+	bam_index_chunk_t *chunks;
+	int num_chunks;
+	int chunk;
+} bam_reader_t;
+
+/**
+ * Opens a BAM file and reads its header.
+ * \param filename Input file name.
+ * \param num_threads Threads to inflate BGZF blocks.
+ * \return Reader or NULL if the file could not be opened or is not a BAM file.
+ */
+bam_reader_t *bam_reader_new(const char *filename, int num_threads);
+
+void bam_reader_free(bam_reader_t *reader);
+
+/**
+ * Moves the reader to a virtual offset (e.g. from an index).
+ * \return 0 on success.
+ */
+int bam_reader_seek(bam_reader_t *reader, uint64_t voffset);
+
+/**
+ * Restricts the reader to some chunks of the file (e.g. the chunks of a set
+ * of regions from bam_index_load_chunks), the reader moves to the first one
+ * and jumps to the next one when a chunk is over.
+ * \param chunks Sorted and not overlapping chunks, the reader takes them (freed by bam_reader_free).
+ * \return 0 on success.
+ */
+int bam_reader_set_chunks(bam_reader_t *reader, bam_index_chunk_t *chunks, int num_chunks);
+
+/**
+ * Reads the next record.
+ * \return Bytes read, -1 at the end of file, < -1 if the file is truncated (as samtools bam_read1).
+ */
+int bam_reader_read1(bam_reader_t *reader, bam1_t *b);
+
+/**
+ * Reads a batch of records, the empty slots (NULL) of the batch are allocated
+ * and the others are reused.
+ * \param bams Batch of max_bams slots.
+ * \return Number of records read, 0 at the end of the file or on error.
+ */
+size_t bam_reader_read_batch(bam_reader_t *reader, bam1_t **bams, size_t max_bams);
+
+#endif /* AUX_BAM_READER_H_ */
@@ -0,0 +1,663 @@
+#include "aux_bam_sort.h"
+
+#include <ctype.h>
+#include <omp.h>
+
+#include "commons/log.h"
+
+//------------------------------------------------------------------------
+
+typedef struct sort_buffer {
+	int order;
+
+	// records as in the BAM file
+	unsigned char *data;
+	size_t length;
+	size_t max_length;
+
+	bam_sort_entry_t *entries;
+	bam_sort_entry_t *tmp;
+	size_t num_entries;
+	size_t max_entries;
+} sort_buffer_t;
+
+typedef struct sort_run {
+	bgzf_mt_reader_t *reader;
+	bam1_t *bam;
+	uint64_t key;
+	int eof;
+} sort_run_t;
+
+#define RECORD_CORE(p)  ((const uint32_t *) ((p) + 4))
+#define RECORD_NAME(p)  ((const char *) ((p) + 36))
+#define RECORD_FLAG(p)  (RECORD_CORE(p)[3] >> 16)
+
+//------------------------------------------------------------------------
+// orders
+//------------------------------------------------------------------------
+
+static int strnum_cmp(const char *a, const char *b) {
+	const char *pa = a, *pb = b;
+	while (*pa && *pb) {
+		if (isdigit((unsigned char) *pa) && isdigit((unsigned char) *pb)) {
+			char *end_a, *end_b;
+			long ai = strtol(pa, &end_a, 10);
+			long bi = strtol(pb, &end_b, 10);
+			if (ai != bi) {
+				return (ai < bi ? -1 : 1);
+			}
+			pa = end_a;
+			pb = end_b;
+		} else {
+			if (*pa != *pb) {
+				break;
+			}
+			++pa;
+			++pb;
+		}
+	}
+	if (*pa == *pb) {
+		return ((pa - a) < (pb - b) ? -1 : ((pa - a) > (pb - b) ? 1 : 0));
+	}
+	return (*pa < *pb ? -1 : 1);
+}
+
+int bam_sort_name_cmp(const char *name_a, int flag_a, const char *name_b, int flag_b) {
+	int cmp = strnum_cmp(name_a, name_b);
+	if (cmp) {
+		return cmp;
+	}
+	return (flag_a & 0xc0) - (flag_b & 0xc0);
+}
+
+//------------------------------------------------------------------------
+
+void bam_sort_set_order(bam_header_t *header, int order) {
+	const char *so = (order == BAM_SORT_NAME ? "queryname" : "coordinate");
+	size_t l_text = (header->text ? header->l_text : 0);
+	char *text = (char *) malloc(l_text + 64);
+	size_t len = 0;
+
+	if (l_text >= 4 && strncmp(header->text, "@HD\t", 4) == 0) {
+		// @HD fields but SO, and the new SO
+		size_t hd_len = strcspn(header->text, "\n");
+		const char *p = header->text, *end = header->text + hd_len;
+		while (p < end) {
+			size_t n = strcspn(p, "\t\n");
+			if (p + n > end) {
+				n = end - p;
+			}
+			if (strncmp(p, "SO:", 3) != 0) {
+				if (len) {
+					text[len++] = '\t';
+				}
+				memcpy(text + len, p, n);
+				len += n;
+			}
+			p += n + 1;
+		}
+		len += sprintf(text + len, "\tSO:%s", so);
+		memcpy(text + len, header->text + hd_len, l_text - hd_len);
+		len += l_text - hd_len;
+	} else {
+		len = sprintf(text, "@HD\tVN:1.0\tSO:%s\n", so);
+		if (l_text) {
+			memcpy(text + len, header->text, l_text);
+			len += l_text;
+		}
+	}
+	text[len] = 0;
+
+	if (header->text) {
+		free(header->text);
+	}
+	header->text = text;
+	header->l_text = len;
+}
+
+//------------------------------------------------------------------------
+// in-memory sort
+//------------------------------------------------------------------------
+
+// LSD radix sort on the keys, every pass is split among the threads, the
+// passes where all the keys have the same byte are skipped
+static void radix_sort(sort_buffer_t *buffer, int num_threads) {
+	size_t n = buffer->num_entries;
+	size_t *counts = (size_t *) malloc(num_threads * 256 * sizeof(size_t));
+
+	for (int shift = 0; shift < 64; shift += 8) {
+		bam_sort_entry_t *src = buffer->entries, *dst = buffer->tmp;
+		int skip = 0;
+
+		#pragma omp parallel num_threads(num_threads)
+		{
+			int t = omp_get_thread_num(), nt = omp_get_num_threads();
+			size_t beg = n * t / nt, end = n * (t + 1) / nt;
+			size_t *c = counts + t * 256;
+
+			memset(c, 0, 256 * sizeof(size_t));
+			for (size_t i = beg; i < end; i++) {
+				c[(src[i].key >> shift) & 0xff]++;
+			}
+
+			#pragma omp barrier
+			#pragma omp single
+			{
+				size_t offset = 0;
+				for (int b = 0; b < 256 && !skip; b++) {
+					size_t total = 0;
+					for (int k = 0; k < nt; k++) {
+						total += counts[k * 256 + b];
+					}
+					skip = (total == n);
+				}
+				for (int b = 0; b < 256 && !skip; b++) {
+					for (int k = 0; k < nt; k++) {
+						size_t count = counts[k * 256 + b];
+						counts[k * 256 + b] = offset;
+						offset += count;
+					}
+				}
+			}
+
+			if (!skip) {
+				for (size_t i = beg; i < end; i++) {
+					dst[c[(src[i].key >> shift) & 0xff]++] = src[i];
+				}
+			}
+		}
+
+		if (!skip) {
+			buffer->entries = dst;
+			buffer->tmp = src;
+		}
+	}
+
+	free(counts);
+}
+
+//------------------------------------------------------------------------
+
+static int entry_name_cmp(const void *a, const void *b, void *data) {
+	const bam_sort_entry_t *ea = (const bam_sort_entry_t *) a, *eb = (const bam_sort_entry_t *) b;
+	const unsigned char *pa = (unsigned char *) data + ea->offset, *pb = (unsigned char *) data + eb->offset;
+
+	int cmp = bam_sort_name_cmp(RECORD_NAME(pa), RECORD_FLAG(pa), RECORD_NAME(pb), RECORD_FLAG(pb));
+	if (cmp) {
+		return cmp;
+	}
+	return (ea->offset < eb->offset ? -1 : (ea->offset > eb->offset ? 1 : 0));
+}
+
+// every thread sorts one part, and the parts are merged by pairs
+static void name_sort(sort_buffer_t *buffer, int num_threads) {
+	size_t n = buffer->num_entries;
+	int num_parts = (n < 1024 ? 1 : num_threads);
+	size_t bounds[num_parts + 1];
+	for (int i = 0; i <= num_parts; i++) {
+		bounds[i] = n * i / num_parts;
+	}
+
+	#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 1)
+	for (int i = 0; i < num_parts; i++) {
+		qsort_r(buffer->entries + bounds[i], bounds[i + 1] - bounds[i], sizeof(bam_sort_entry_t),
+			entry_name_cmp, buffer->data);
+	}
+
+	for (int width = 1; width < num_parts; width *= 2) {
+		bam_sort_entry_t *src = buffer->entries, *dst = buffer->tmp;
+
+		#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 1)
+		for (int i = 0; i < num_parts; i += 2 * width) {
+			size_t lo = bounds[i];
+			size_t mid = bounds[(i + width < num_parts ? i + width : num_parts)];
+			size_t hi = bounds[(i + 2 * width < num_parts ? i + 2 * width : num_parts)];
+			size_t a = lo, b = mid, k = lo;
+			while (a < mid && b < hi) {
+				if (entry_name_cmp(&src[b], &src[a], buffer->data) < 0) {
+					dst[k++] = src[b++];
+				} else {
+					dst[k++] = src[a++];
+				}
+			}
+			while (a < mid) {
+				dst[k++] = src[a++];
+			}
+			while (b < hi) {
+				dst[k++] = src[b++];
+			}
+		}
+
+		buffer->entries = dst;
+		buffer->tmp = src;
+	}
+}
+
+//------------------------------------------------------------------------
+// records
+//------------------------------------------------------------------------
+
+// reads records until the buffer takes max_memory bytes or the end of file
+static int read_records(bgzf_mt_reader_t *reader, sort_buffer_t *buffer, size_t max_memory, int *eof) {
+	buffer->length = 0;
+	buffer->num_entries = 0;
+
+	while (buffer->length + 2 * sizeof(bam_sort_entry_t) * buffer->num_entries < max_memory) {
+		int32_t block_len;
+		int64_t ret = bgzf_mt_read(reader, &block_len, 4);
+		if (ret == 0) {
+			*eof = 1;
+			break;
+		}
+		if (ret != 4 || block_len < 32) {
+			return -1;
+		}
+
+		if (buffer->length + 4 + block_len > buffer->max_length) {
+			size_t needed = buffer->length + 4 + block_len;
+			buffer->max_length = 2 * needed;
+			if (buffer->max_length > max_memory) {
+				buffer->max_length = (needed > max_memory ? needed : max_memory);
+			}
+			buffer->data = (unsigned char *) realloc(buffer->data, buffer->max_length);
+		}
+		if (buffer->num_entries == buffer->max_entries) {
+			buffer->max_entries = (buffer->max_entries ? 2 * buffer->max_entries : 65536);
+			buffer->entries = (bam_sort_entry_t *) realloc(buffer->entries, buffer->max_entries * sizeof(bam_sort_entry_t));
+			buffer->tmp = (bam_sort_entry_t *) realloc(buffer->tmp, buffer->max_entries * sizeof(bam_sort_entry_t));
+		}
+
+		unsigned char *p = buffer->data + buffer->length;
+		memcpy(p, &block_len, 4);
+		if (bgzf_mt_read(reader, p + 4, block_len) != block_len) {
+			return -1;
+		}
+
+		bam_sort_entry_t *entry = &buffer->entries[buffer->num_entries++];
+		entry->offset = buffer->length;
+		if (buffer->order == BAM_SORT_COORD) {
+			const uint32_t *x = RECORD_CORE(p);
+			entry->key = bam_sort_coord_key(x[0], x[1], (x[3] >> 16) & BAM_FREVERSE);
+		} else {
+			entry->key = 0;
+		}
+		buffer->length += 4 + block_len;
+	}
+
+	return 0;
+}
+
+// record of the buffer (BAM layout) to b, as bgzf_mt_read_bam1
+static void record_to_bam(const unsigned char *p, bam1_t *b) {
+	bam1_core_t *c = &b->core;
+	int32_t block_len;
+	uint32_t x[8];
+	memcpy(&block_len, p, 4);
+	memcpy(x, p + 4, sizeof(x));
+
+	c->tid = x[0];
+	c->pos = x[1];
+	c->bin = x[2] >> 16;
+	c->qual = x[2] >> 8 & 0xff;
+	c->l_qname = x[2] & 0xff;
+	c->flag = x[3] >> 16;
+	c->n_cigar = x[3] & 0xffff;
+	c->l_qseq = x[4];
+	c->mtid = x[5];
+	c->mpos = x[6];
+	c->isize = x[7];
+
+	b->data_len = block_len - sizeof(x);
+	if (b->m_data < b->data_len) {
+		b->m_data = b->data_len;
+		kroundup32(b->m_data);
+		b->data = (uint8_t *) realloc(b->data, b->m_data);
+	}
+	memcpy(b->data, p + 4 + sizeof(x), b->data_len);
+	b->l_aux = b->data_len - c->n_cigar * 4 - c->l_qname - c->l_qseq - (c->l_qseq + 1) / 2;
+}
+
+// the records go through the duplicate marker if any, which writes them
+// with output_write
+static int write_records(bgzf_mt_writer_t *writer, sort_buffer_t *buffer, bam_index_builder_t *builder,
+			 bam_markdup_t *markdup) {
+	bam1_core_t c;
+	bam1_t *b = (markdup ? bam_init1() : NULL);
+	for (size_t i = 0; i < buffer->num_entries; i++) {
+		unsigned char *p = buffer->data + buffer->entries[i].offset;
+		if (markdup) {
+			record_to_bam(p, b);
+			b = bam_markdup_add(markdup, b);
+			continue;
+		}
+
+		int32_t block_len;
+		memcpy(&block_len, p, 4);
+		uint64_t beg = bgzf_mt_writer_tell(writer);
+		if (bgzf_mt_write(writer, p, 4 + block_len) != 0) {
+			return -1;
+		}
+		if (builder) {
+			// the record is still in BAM layout
+			uint32_t x[4];
+			memcpy(x, p + 4, sizeof(x));
+			c.tid = x[0];
+			c.pos = x[1];
+			c.l_qname = x[2] & 0xff;
+			c.flag = x[3] >> 16;
+			c.n_cigar = x[3] & 0xffff;
+			if (bam_index_builder_add_core(builder, &c, (uint32_t *) (p + 36 + c.l_qname),
+						       beg, bgzf_mt_writer_tell(writer)) != 0) {
+				return -1;
+			}
+		}
+	}
+	if (b) {
+		bam_destroy1(b);
+	}
+	return 0;
+}
+
+// output of the duplicate marker
+typedef struct sort_output {
+	bgzf_mt_writer_t *writer;
+	bam_index_builder_t *builder;
+} sort_output_t;
+
+static int output_write(void *data, bam1_t *b) {
+	sort_output_t *output = (sort_output_t *) data;
+	uint64_t beg = bgzf_mt_writer_tell(output->writer);
+	if (bgzf_mt_write_bam1(output->writer, b) < 0) {
+		return -1;
+	}
+	if (output->builder && bam_index_builder_add(output->builder, b, beg, bgzf_mt_writer_tell(output->writer)) != 0) {
+		return -1;
+	}
+	return 0;
+}
+
+static bam_markdup_t *markdup_new(const bam_header_t *header, int markdup, sort_output_t *output) {
+	if (!markdup) {
+		return NULL;
+	}
+	return bam_markdup_new(header, (markdup == BAM_SORT_RMDUP), output_write, output);
+}
+
+// writes the records left in the marker
+static int markdup_close(bam_markdup_t *markdup, int ret) {
+	if (markdup == NULL) {
+		return ret;
+	}
+	if (ret == 0) {
+		bam_markdup_flush(markdup);
+		if (bam_markdup_error(markdup)) {
+			ret = -1;
+		}
+	}
+	const bam_markdup_stats_t *stats = bam_markdup_stats(markdup);
+	LOG_INFO_F("Duplicates: %lu of %lu fragments, %lu of %lu pairs, %lu records removed\n",
+		   stats->num_dup_fragments, stats->num_fragments, stats->num_dup_pairs, stats->num_pairs,
+		   stats->num_removed);
+	bam_markdup_free(markdup);
+	return ret;
+}
+
+static uint64_t writer_voffset(void *data, uint64_t offset) {
+	return bgzf_mt_writer_voffset((bgzf_mt_writer_t *) data, offset);
+}
+
+// closes the output file and saves its index
+static int close_output(bgzf_mt_writer_t *writer, const char *out_filename, bam_index_builder_t *builder) {
+	uint64_t end = bgzf_mt_writer_tell(writer);
+	if (bgzf_mt_writer_close(writer) != 0) {
+		LOG_ERROR_F("Error writing file %s\n", out_filename);
+		return -1;
+	}
+	if (builder) {
+		char filename[strlen(out_filename) + 5];
+		bam_index_filename(out_filename, builder->format, filename);
+		if (bam_index_builder_finish(builder, end) != 0 ||
+		    bam_index_builder_save(builder, filename, writer_voffset, writer) != 0) {
+			LOG_ERROR_F("Could not write index file %s\n", filename);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void run_filename(const char *out_filename, int run, char *filename) {
+	sprintf(filename, "%s.tmp.%04i.bam", out_filename, run);
+}
+
+//------------------------------------------------------------------------
+// merge of the sorted runs
+//------------------------------------------------------------------------
+
+// whether the record of run a goes after the one of run b, the index
+// num_runs is a sentinel smaller than any run
+static inline int run_after(sort_run_t *runs, int num_runs, int order, int a, int b) {
+	if (b == num_runs) {
+		return 1;
+	}
+	if (a == num_runs) {
+		return 0;
+	}
+
+	sort_run_t *x = &runs[a], *y = &runs[b];
+	if (x->eof || y->eof) {
+		return (x->eof != y->eof ? x->eof : a > b);
+	}
+	if (order == BAM_SORT_COORD) {
+		return (x->key != y->key ? x->key > y->key : a > b);
+	}
+	int cmp = bam_sort_name_cmp(bam1_qname(x->bam), x->bam->core.flag, bam1_qname(y->bam), y->bam->core.flag);
+	return (cmp ? cmp > 0 : a > b);
+}
+
+static void loser_tree_adjust(int *tree, sort_run_t *runs, int num_runs, int order, int s) {
+	for (int t = (s + num_runs) / 2; t > 0; t /= 2) {
+		if (run_after(runs, num_runs, order, s, tree[t])) {
+			int tmp = s;
+			s = tree[t];
+			tree[t] = tmp;
+		}
+	}
+	tree[0] = s;
+}
+
+static int run_next(sort_run_t *run) {
+	int ret = bgzf_mt_read_bam1(run->reader, run->bam);
+	if (ret == -1) {
+		run->eof = 1;
+		return 0;
+	}
+	if (ret < 0) {
+		return -1;
+	}
+	run->key = bam_sort_coord_key(run->bam->core.tid, run->bam->core.pos, bam1_strand(run->bam));
+	return 0;
+}
+
+static int merge_runs(const char *out_filename, bam_header_t *header, int order, int num_runs, int num_threads,
+		      bam_index_builder_t *builder, int markdup) {
+	char filename[strlen(out_filename) + 32];
+	int ret = 0;
+
+	sort_run_t *runs = (sort_run_t *) calloc(num_runs, sizeof(sort_run_t));
+	int reader_threads = (num_threads / num_runs > 0 ? num_threads / num_runs : 1);
+	for (int i = 0; i < num_runs; i++) {
+		run_filename(out_filename, i, filename);
+		runs[i].reader = bgzf_mt_reader_new(filename, 0, reader_threads);
+		if (runs[i].reader == NULL) {
+			LOG_FATAL_F("Could not open temporary file %s\n", filename);
+		}
+		bam_header_t *run_header = bgzf_mt_read_bam_header(runs[i].reader);
+		if (run_header == NULL) {
+			LOG_FATAL_F("Invalid temporary file %s\n", filename);
+		}
+		bam_header_destroy(run_header);
+
+		runs[i].bam = bam_init1();
+		if (run_next(&runs[i]) != 0) {
+			LOG_FATAL_F("Invalid temporary file %s\n", filename);
+		}
+	}
+
+	bgzf_mt_writer_t *writer = bgzf_mt_writer_new(out_filename, BGZF_MT_DEFAULT_LEVEL, num_threads);
+	if (writer == NULL) {
+		LOG_FATAL_F("Could not open file %s\n", out_filename);
+	}
+	bgzf_mt_write_bam_header(writer, header);
+
+	int *tree = (int *) malloc(num_runs * sizeof(int));
+	for (int i = 0; i < num_runs; i++) {
+		tree[i] = num_runs;
+	}
+	for (int i = num_runs - 1; i >= 0; i--) {
+		loser_tree_adjust(tree, runs, num_runs, order, i);
+	}
+
+	sort_output_t output = { writer, builder };
+	bam_markdup_t *md = markdup_new(header, markdup, &output);
+
+	while (!runs[tree[0]].eof) {
+		int i = tree[0];
+		if (md) {
+			runs[i].bam = bam_markdup_add(md, runs[i].bam);
+		} else if (output_write(&output, runs[i].bam) != 0) {
+			ret = -1;
+			break;
+		}
+		if (run_next(&runs[i]) != 0) {
+			ret = -1;
+			break;
+		}
+		loser_tree_adjust(tree, runs, num_runs, order, i);
+	}
+	ret = markdup_close(md, ret);
+
+	if (close_output(writer, out_filename, (ret == 0 ? builder : NULL)) != 0) {
+		ret = -1;
+	}
+	bgzf_mt_writer_free(writer);
+
+	for (int i = 0; i < num_runs; i++) {
+		bgzf_mt_reader_free(runs[i].reader);
+		bam_destroy1(runs[i].bam);
+		run_filename(out_filename, i, filename);
+		remove(filename);
+	}
+	free(runs);
+	free(tree);
+
+	return ret;
+}
+
+//------------------------------------------------------------------------
+
+int bam_sort_file(const char *in_filename, const char *out_filename, int order,
+		  size_t max_memory, int num_threads, int index, int markdup) {
+	if (order != BAM_SORT_COORD) {
+		markdup = 0;
+	}
+	if (max_memory < BAM_SORT_MIN_MEMORY) {
+		max_memory = BAM_SORT_MIN_MEMORY;
+	}
+	if (num_threads < 1) {
+		num_threads = 1;
+	}
+
+	bgzf_mt_reader_t *reader = bgzf_mt_reader_new(in_filename, 0, num_threads);
+	if (reader == NULL) {
+		LOG_ERROR_F("Could not open file %s\n", in_filename);
+		return -1;
+	}
+	bam_header_t *header = bgzf_mt_read_bam_header(reader);
+	if (header == NULL) {
+		LOG_ERROR_F("Invalid BAM file %s\n", in_filename);
+		bgzf_mt_reader_free(reader);
+		return -1;
+	}
+	bam_sort_set_order(header, order);
+
+	bam_index_builder_t *builder = NULL;
+	if (index && order == BAM_SORT_COORD) {
+		builder = bam_index_builder_new(header, BAM_INDEX_BAI, 0);
+	}
+
+	sort_buffer_t buffer;
+	memset(&buffer, 0, sizeof(sort_buffer_t));
+	buffer.order = order;
+
+	int ret = 0, eof = 0, num_runs = 0;
+	char filename[strlen(out_filename) + 32];
+
+	while (!eof) {
+		if (read_records(reader, &buffer, max_memory, &eof) != 0) {
+			LOG_ERROR_F("Truncated or corrupted BAM file %s\n", in_filename);
+			ret = -1;
+			break;
+		}
+		if (buffer.num_entries == 0 && num_runs > 0) {
+			break;
+		}
+
+		if (order == BAM_SORT_COORD) {
+			radix_sort(&buffer, num_threads);
+		} else {
+			name_sort(&buffer, num_threads);
+		}
+
+		// everything fits in memory: straight to the output, otherwise
+		// the buffer is a sorted run
+		int last = (eof && num_runs == 0);
+		if (last) {
+			strcpy(filename, out_filename);
+		} else {
+			run_filename(out_filename, num_runs, filename);
+		}
+		bgzf_mt_writer_t *writer = bgzf_mt_writer_new(filename, (last ? BGZF_MT_DEFAULT_LEVEL : BAM_SORT_RUN_LEVEL),
+							      num_threads);
+		if (writer == NULL) {
+			LOG_ERROR_F("Could not open file %s\n", filename);
+			ret = -1;
+			break;
+		}
+		bgzf_mt_write_bam_header(writer, header);
+		sort_output_t output = { writer, builder };
+		bam_markdup_t *md = markdup_new(header, (last ? markdup : 0), &output);
+		if (markdup_close(md, write_records(writer, &buffer, (last ? builder : NULL), md)) != 0) {
+			LOG_ERROR_F("Error writing file %s\n", filename);
+			ret = -1;
+		}
+		if (close_output(writer, filename, (last && ret == 0 ? builder : NULL)) != 0) {
+			ret = -1;
+		}
+		bgzf_mt_writer_free(writer);
+		if (ret) {
+			break;
+		}
+
+		if (!last) {
+			num_runs++;
+		}
+	}
+
+	bgzf_mt_reader_free(reader);
+	free(buffer.data);
+	free(buffer.entries);
+	free(buffer.tmp);
+
+	if (ret == 0 && num_runs > 0) {
+		ret = merge_runs(out_filename, header, order, num_runs, num_threads, builder, markdup);
+	} else {
+		for (int i = 0; i < num_runs; i++) {
+			run_filename(out_filename, i, filename);
+			remove(filename);
+		}
+	}
+	bam_index_builder_free(builder);
+	bam_header_destroy(header);
+
+	return ret;
+}
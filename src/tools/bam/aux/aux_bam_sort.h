@@ -0,0 +1,82 @@
+#ifndef AUX_BAM_SORT_H_
+#define AUX_BAM_SORT_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "bioformats/bam/samtools/bam.h"
+
+#include "aux_bgzf.h"
+#include "aux_bam_index.h"
+#include "aux_bam_markdup.h"
+
+/***************************
+ * BAM SORT
+ *
+ * Records are read (parallel BGZF inflate) into a memory buffer limited by
+ * max_memory, then sorted on several threads: a parallel LSD radix sort on
+ * (tid, pos, strand) keys by coordinate, or a parallel merge sort by read
+ * name (same order as samtools 0.1.18 sort -n). Full buffers are spilled
+ * as sorted runs (fast compression), and the runs are merged into the
+ * output (parallel BGZF deflate). Both orders are stable. The index of
+ * a file sorted by coordinate can be built, and its duplicates marked
+ * (aux_bam_markdup), while the output is written.
+ **************************/
+
+#define BAM_SORT_COORD            0
+#define BAM_SORT_NAME             1
+
+#define BAM_SORT_MARKDUP          1
+#define BAM_SORT_RMDUP            2
+
+#define BAM_SORT_DEFAULT_MEMORY   500000000
+#define BAM_SORT_MIN_MEMORY       10000000
+#define BAM_SORT_RUN_LEVEL        1
+
+/**
+ * Record in the sort buffer: key and offset in the buffer, where the
+ * record is stored as in the BAM file (block_len, core, data).
+ */
+typedef struct bam_sort_entry {
+	uint64_t key;
+	uint64_t offset;
+} bam_sort_entry_t;
+
+/**
+ * Key by coordinate: unplaced reads (tid -1) go at the end.
+ */
+static inline uint64_t bam_sort_coord_key(int32_t tid, int32_t pos, int strand) {
+	uint64_t t = (tid < 0 ? 0x7fffffffLLU : (uint64_t) tid);
+	return (t << 33) | ((uint64_t) (uint32_t) (pos + 1) << 1) | (strand ? 1 : 0);
+}
+
+/**
+ * Order by read name (numbers in the name compared by value) and then
+ * by flags (read 1 before read 2), as samtools 0.1.18.
+ */
+int bam_sort_name_cmp(const char *name_a, int flag_a, const char *name_b, int flag_b);
+
+/**
+ * Sets the sort order (SO tag in the @HD line) of the header.
+ */
+void bam_sort_set_order(bam_header_t *header, int order);
+
+/**
+ * Sorts a BAM file.
+ * \param in_filename Input file name.
+ * \param out_filename Output file name.
+ * \param order BAM_SORT_COORD or BAM_SORT_NAME.
+ * \param max_memory Approximate memory for the records being sorted.
+ * \param num_threads Threads to inflate, sort and deflate.
+ * \param index Whether to create the index (out_filename + ".bai", or ".csi"
+ *        for references longer than 512 Mbp), only by coordinate.
+ * \param markdup 0, BAM_SORT_MARKDUP to mark the duplicates or BAM_SORT_RMDUP
+ *        to remove them, only by coordinate.
+ * \return 0 on success.
+ */
+int bam_sort_file(const char *in_filename, const char *out_filename, int order,
+		  size_t max_memory, int num_threads, int index, int markdup);
+
+#endif /* AUX_BAM_SORT_H_ */
@@ -0,0 +1,691 @@
+#include "aux_bgzf.h"
+
+//------------------------------------------------------------------------
+// batches
+//------------------------------------------------------------------------
+
+static void batch_init(bgzf_mt_batch_t *batch, int max_blocks) {
+	memset(batch, 0, sizeof(bgzf_mt_batch_t));
+	batch->max_blocks = max_blocks;
+	batch->addresses = (uint64_t *) calloc(max_blocks, sizeof(uint64_t));
+	batch->c_sizes = (int *) calloc(max_blocks, sizeof(int));
+	batch->u_sizes = (int *) calloc(max_blocks, sizeof(int));
+	batch->c_data = (unsigned char *) malloc((size_t) max_blocks * BGZF_MT_MAX_BLOCK_SIZE);
+	batch->u_data = (unsigned char *) malloc((size_t) max_blocks * BGZF_MT_MAX_BLOCK_SIZE);
+}
+
+static void batch_free(bgzf_mt_batch_t *batch) {
+	free(batch->addresses);
+	free(batch->c_sizes);
+	free(batch->u_sizes);
+	free(batch->c_data);
+	free(batch->u_data);
+}
+
+static int num_blocks_by_threads(int num_threads) {
+	return (num_threads < 1 ? 1 : num_threads) * BGZF_MT_BLOCKS_PER_THREAD;
+}
+
+//------------------------------------------------------------------------
+// block codecs
+//------------------------------------------------------------------------
+
+static inline int unpack_int16(const unsigned char *p) {
+	return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t unpack_int32(const unsigned char *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline void pack_int16(unsigned char *p, uint16_t v) {
+	p[0] = v & 0xff;
+	p[1] = v >> 8;
+}
+
+static inline void pack_int32(unsigned char *p, uint32_t v) {
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = v >> 24;
+}
+
+/**
+ * Reads one block (gzip member with the BC extra subfield).
+ * \return Block size, 0 at end of file, -1 on error.
+ */
+static int read_block(FILE *fd, unsigned char *c_data) {
+	size_t count = fread(c_data, 1, BGZF_MT_HEADER_SIZE, fd);
+	if (count == 0) {
+		return 0;
+	}
+	if (count != BGZF_MT_HEADER_SIZE || c_data[0] != 31 || c_data[1] != 139 ||
+	    c_data[2] != 8 || (c_data[3] & 4) == 0) {
+		return -1;
+	}
+
+	// BSIZE is in the 'BC' subfield of the extra field
+	int xlen = unpack_int16(c_data + 10);
+	if (xlen < 6 || 12 + xlen > BGZF_MT_MAX_BLOCK_SIZE) {
+		return -1;
+	}
+	if (12 + xlen > BGZF_MT_HEADER_SIZE &&
+	    fread(c_data + BGZF_MT_HEADER_SIZE, 1, 12 + xlen - BGZF_MT_HEADER_SIZE, fd) != (size_t) (12 + xlen - BGZF_MT_HEADER_SIZE)) {
+		return -1;
+	}
+	int size = -1;
+	for (int i = 12; i + 4 <= 12 + xlen; ) {
+		int slen = unpack_int16(c_data + i + 2);
+		if (c_data[i] == 'B' && c_data[i + 1] == 'C' && slen == 2) {
+			size = unpack_int16(c_data + i + 4) + 1;
+			break;
+		}
+		i += 4 + slen;
+	}
+	if (size < 12 + xlen + BGZF_MT_FOOTER_SIZE) {
+		return -1;
+	}
+
+	if (fread(c_data + 12 + xlen, 1, size - 12 - xlen, fd) != (size_t) (size - 12 - xlen)) {
+		return -1;
+	}
+	return size;
+}
+
+/**
+ * \return Uncompressed size, -1 on error.
+ */
+static int inflate_block(unsigned char *c_data, int c_size, unsigned char *u_data) {
+	int xlen = unpack_int16(c_data + 10);
+	int u_size = (int) unpack_int32(c_data + c_size - 4);
+	if (u_size > BGZF_MT_MAX_BLOCK_SIZE) {
+		return -1;
+	}
+	if (u_size == 0) {
+		return 0;
+	}
+
+	z_stream zs;
+	memset(&zs, 0, sizeof(z_stream));
+	zs.next_in = c_data + 12 + xlen;
+	zs.avail_in = c_size - 12 - xlen - BGZF_MT_FOOTER_SIZE;
+	zs.next_out = u_data;
+	zs.avail_out = BGZF_MT_MAX_BLOCK_SIZE;
+
+	if (inflateInit2(&zs, -15) != Z_OK) {
+		return -1;
+	}
+	int ret = inflate(&zs, Z_FINISH);
+	inflateEnd(&zs);
+
+	if (ret != Z_STREAM_END || (int) zs.total_out != u_size) {
+		return -1;
+	}
+	return u_size;
+}
+
+/**
+ * \return Compressed block size (header and footer included), -1 on error.
+ */
+static int deflate_block(unsigned char *u_data, int u_size, unsigned char *c_data, int level) {
+	static const unsigned char header[BGZF_MT_HEADER_SIZE] =
+		{ 31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 0, 0 };
+
+	z_stream zs;
+	memset(&zs, 0, sizeof(z_stream));
+	zs.next_in = u_data;
+	zs.avail_in = u_size;
+	zs.next_out = c_data + BGZF_MT_HEADER_SIZE;
+	zs.avail_out = BGZF_MT_MAX_BLOCK_SIZE - BGZF_MT_HEADER_SIZE - BGZF_MT_FOOTER_SIZE;
+
+	if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		return -1;
+	}
+	int ret = deflate(&zs, Z_FINISH);
+	deflateEnd(&zs);
+
+	// BGZF_MT_BLOCK_SIZE leaves room enough for incompressible data
+	if (ret != Z_STREAM_END) {
+		return -1;
+	}
+
+	int size = BGZF_MT_HEADER_SIZE + zs.total_out + BGZF_MT_FOOTER_SIZE;
+	memcpy(c_data, header, BGZF_MT_HEADER_SIZE);
+	pack_int16(c_data + 16, size - 1);
+	pack_int32(c_data + size - 8, crc32(crc32(0L, NULL, 0L), u_data, u_size));
+	pack_int32(c_data + size - 4, u_size);
+
+	return size;
+}
+
+//------------------------------------------------------------------------
+// reader
+//------------------------------------------------------------------------
+
+static void fill_batch(bgzf_mt_reader_t *reader, bgzf_mt_batch_t *batch) {
+	batch->num_blocks = 0;
+	batch->eof = 0;
+	batch->error = 0;
+
+	// sequential read of the compressed blocks
+	while (batch->num_blocks < batch->max_blocks) {
+		int i = batch->num_blocks;
+		uint64_t address = ftello(reader->fd);
+		int size = read_block(reader->fd, batch->c_data + (size_t) i * BGZF_MT_MAX_BLOCK_SIZE);
+		if (size <= 0) {
+			batch->eof = 1;
+			batch->error = (size < 0);
+			break;
+		}
+		batch->addresses[i] = address;
+		batch->c_sizes[i] = size;
+		batch->num_blocks++;
+	}
+
+	// parallel inflate
+	int error = 0;
+	#pragma omp parallel for num_threads(reader->num_threads) schedule(dynamic, 1) reduction(|:error)
+	for (int i = 0; i < batch->num_blocks; i++) {
+		batch->u_sizes[i] = inflate_block(batch->c_data + (size_t) i * BGZF_MT_MAX_BLOCK_SIZE, batch->c_sizes[i],
+						  batch->u_data + (size_t) i * BGZF_MT_MAX_BLOCK_SIZE);
+		if (batch->u_sizes[i] < 0) {
+			error = 1;
+		}
+	}
+	if (error) {
+		batch->eof = 1;
+		batch->error = 1;
+	}
+}
+
+static void *reader_thread(void *arg) {
+	bgzf_mt_reader_t *reader = (bgzf_mt_reader_t *) arg;
+
+	int slot = 0;
+	while (1) {
+		pthread_mutex_lock(&reader->mutex);
+		while (reader->full[slot] && !reader->stop) {
+			pthread_cond_wait(&reader->cond, &reader->mutex);
+		}
+		int stop = reader->stop;
+		pthread_mutex_unlock(&reader->mutex);
+		if (stop) {
+			break;
+		}
+
+		fill_batch(reader, &reader->batches[slot]);
+
+		pthread_mutex_lock(&reader->mutex);
+		reader->full[slot] = 1;
+		pthread_cond_broadcast(&reader->cond);
+		pthread_mutex_unlock(&reader->mutex);
+
+		if (reader->batches[slot].eof) {
+			break;
+		}
+		slot ^= 1;
+	}
+
+	return NULL;
+}
+
+static void reader_stop(bgzf_mt_reader_t *reader) {
+	pthread_mutex_lock(&reader->mutex);
+	reader->stop = 1;
+	pthread_cond_broadcast(&reader->cond);
+	pthread_mutex_unlock(&reader->mutex);
+	pthread_join(reader->thread, NULL);
+}
+
+// waits for the batch of the current slot
+static bgzf_mt_batch_t *reader_wait(bgzf_mt_reader_t *reader) {
+	pthread_mutex_lock(&reader->mutex);
+	while (!reader->full[reader->slot]) {
+		pthread_cond_wait(&reader->cond, &reader->mutex);
+	}
+	pthread_mutex_unlock(&reader->mutex);
+
+	bgzf_mt_batch_t *batch = &reader->batches[reader->slot];
+	if (batch->error) {
+		reader->error = 1;
+	}
+	return batch;
+}
+
+// returns the current batch to the prefetch thread
+static void reader_release(bgzf_mt_reader_t *reader) {
+	pthread_mutex_lock(&reader->mutex);
+	reader->full[reader->slot] = 0;
+	pthread_cond_broadcast(&reader->cond);
+	pthread_mutex_unlock(&reader->mutex);
+
+	reader->slot ^= 1;
+	reader->batch = NULL;
+	reader->block = 0;
+	reader->offset = 0;
+}
+
+// moves to the next non-empty block, returns 0 at end of file
+static int reader_next(bgzf_mt_reader_t *reader) {
+	while (1) {
+		if (reader->batch == NULL) {
+			reader->batch = reader_wait(reader);
+		}
+		bgzf_mt_batch_t *batch = reader->batch;
+		if (reader->block < batch->num_blocks && reader->offset < batch->u_sizes[reader->block]) {
+			return 1;
+		}
+		if (reader->block < batch->num_blocks) {
+			reader->block++;
+			reader->offset = 0;
+			continue;
+		}
+		if (batch->eof) {
+			return 0;
+		}
+		reader_release(reader);
+	}
+}
+
+static int reader_start(bgzf_mt_reader_t *reader, uint64_t voffset) {
+	reader->stop = 0;
+	reader->full[0] = reader->full[1] = 0;
+	reader->slot = 0;
+	reader->batch = NULL;
+	reader->block = 0;
+	reader->offset = 0;
+
+	if (fseeko(reader->fd, voffset >> 16, SEEK_SET) != 0) {
+		reader->error = 1;
+		return -1;
+	}
+	if (pthread_create(&reader->thread, NULL, reader_thread, reader) != 0) {
+		reader->error = 1;
+		return -1;
+	}
+
+	// offset inside the first block
+	int offset = voffset & 0xffff;
+	if (offset) {
+		reader->batch = reader_wait(reader);
+		if (reader->batch->num_blocks == 0 || offset > reader->batch->u_sizes[0]) {
+			reader->error = 1;
+			return -1;
+		}
+		reader->offset = offset;
+	}
+	return 0;
+}
+
+bgzf_mt_reader_t *bgzf_mt_reader_new(const char *filename, uint64_t voffset, int num_threads) {
+	FILE *fd = fopen(filename, "rb");
+	if (fd == NULL) {
+		return NULL;
+	}
+
+	bgzf_mt_reader_t *reader = (bgzf_mt_reader_t *) calloc(1, sizeof(bgzf_mt_reader_t));
+	reader->fd = fd;
+	reader->num_threads = (num_threads < 1 ? 1 : num_threads);
+	batch_init(&reader->batches[0], num_blocks_by_threads(num_threads));
+	batch_init(&reader->batches[1], num_blocks_by_threads(num_threads));
+	pthread_mutex_init(&reader->mutex, NULL);
+	pthread_cond_init(&reader->cond, NULL);
+
+	if (reader_start(reader, voffset) != 0) {
+		bgzf_mt_reader_free(reader);
+		return NULL;
+	}
+	return reader;
+}
+
+void bgzf_mt_reader_free(bgzf_mt_reader_t *reader) {
+	if (reader == NULL) {
+		return;
+	}
+	reader_stop(reader);
+
+	batch_free(&reader->batches[0]);
+	batch_free(&reader->batches[1]);
+	pthread_mutex_destroy(&reader->mutex);
+	pthread_cond_destroy(&reader->cond);
+	fclose(reader->fd);
+	free(reader);
+}
+
+int bgzf_mt_seek(bgzf_mt_reader_t *reader, uint64_t voffset) {
+	reader_stop(reader);
+	reader->error = 0;
+	return reader_start(reader, voffset);
+}
+
+uint64_t bgzf_mt_tell(bgzf_mt_reader_t *reader) {
+	bgzf_mt_batch_t *batch = reader->batch;
+	if (batch == NULL || batch->num_blocks == 0) {
+		if (batch == NULL) {
+			batch = reader_wait(reader);
+			reader->batch = batch;
+		}
+		if (batch->num_blocks == 0) {
+			return (uint64_t) ftello(reader->fd) << 16;
+		}
+	}
+
+	// a consumed block points to the start of the next one, as samtools does
+	int i = reader->block;
+	if (i >= batch->num_blocks) {
+		i = batch->num_blocks - 1;
+		return (batch->addresses[i] + batch->c_sizes[i]) << 16;
+	}
+	if (reader->offset >= batch->u_sizes[i]) {
+		return (batch->addresses[i] + batch->c_sizes[i]) << 16;
+	}
+	return (batch->addresses[i] << 16) | reader->offset;
+}
+
+int64_t bgzf_mt_read(bgzf_mt_reader_t *reader, void *data, size_t length) {
+	unsigned char *p = (unsigned char *) data;
+	size_t count = 0;
+
+	while (count < length) {
+		if (!reader_next(reader)) {
+			break;
+		}
+		bgzf_mt_batch_t *batch = reader->batch;
+		int available = batch->u_sizes[reader->block] - reader->offset;
+		size_t n = (length - count < (size_t) available ? length - count : (size_t) available);
+		memcpy(p + count, batch->u_data + (size_t) reader->block * BGZF_MT_MAX_BLOCK_SIZE + reader->offset, n);
+		reader->offset += n;
+		count += n;
+	}
+
+	if (reader->error) {
+		return -1;
+	}
+	return count;
+}
+
+//------------------------------------------------------------------------
+// writer
+//------------------------------------------------------------------------
+
+static void *writer_thread(void *arg) {
+	bgzf_mt_writer_t *writer = (bgzf_mt_writer_t *) arg;
+	bgzf_mt_batch_t *batch = &writer->batches[writer->current ^ 1];
+
+	// parallel deflate
+	int error = 0;
+	#pragma omp parallel for num_threads(writer->num_threads) schedule(dynamic, 1) reduction(|:error)
+	for (int i = 0; i < batch->num_blocks; i++) {
+		batch->c_sizes[i] = deflate_block(batch->u_data + (size_t) i * BGZF_MT_BLOCK_SIZE, batch->u_sizes[i],
+						  batch->c_data + (size_t) i * BGZF_MT_MAX_BLOCK_SIZE, writer->level);
+		if (batch->c_sizes[i] < 0) {
+			error = 1;
+		}
+	}
+
+	// sequential write
+	if (writer->num_block_addresses + batch->num_blocks > writer->max_block_addresses) {
+		writer->max_block_addresses = 2 * (writer->num_block_addresses + batch->num_blocks);
+		writer->block_addresses = (uint64_t *) realloc(writer->block_addresses,
+							       writer->max_block_addresses * sizeof(uint64_t));
+	}
+	for (int i = 0; i < batch->num_blocks && !error; i++) {
+		if (fwrite(batch->c_data + (size_t) i * BGZF_MT_MAX_BLOCK_SIZE, 1, batch->c_sizes[i], writer->fd) != (size_t) batch->c_sizes[i]) {
+			error = 1;
+			break;
+		}
+		writer->block_addresses[writer->num_block_addresses++] = writer->address;
+		writer->address += batch->c_sizes[i];
+	}
+
+	batch->error = error;
+	return NULL;
+}
+
+static int writer_wait(bgzf_mt_writer_t *writer) {
+	if (writer->running) {
+		pthread_join(writer->thread, NULL);
+		writer->running = 0;
+		if (writer->batches[writer->current ^ 1].error) {
+			writer->error = 1;
+		}
+	}
+	return writer->error ? -1 : 0;
+}
+
+// hands the current batch to the writer thread
+static int writer_flush(bgzf_mt_writer_t *writer) {
+	if (writer_wait(writer) != 0) {
+		return -1;
+	}
+	if (writer->length == 0) {
+		return 0;
+	}
+
+	bgzf_mt_batch_t *batch = &writer->batches[writer->current];
+	batch->num_blocks = (writer->length + BGZF_MT_BLOCK_SIZE - 1) / BGZF_MT_BLOCK_SIZE;
+	for (int i = 0; i < batch->num_blocks; i++) {
+		batch->u_sizes[i] = BGZF_MT_BLOCK_SIZE;
+	}
+	batch->u_sizes[batch->num_blocks - 1] = writer->length - (size_t) (batch->num_blocks - 1) * BGZF_MT_BLOCK_SIZE;
+	batch->error = 0;
+
+	writer->u_offset += writer->length;
+	writer->length = 0;
+	writer->current ^= 1;
+
+	if (pthread_create(&writer->thread, NULL, writer_thread, writer) != 0) {
+		writer->error = 1;
+		return -1;
+	}
+	writer->running = 1;
+	return 0;
+}
+
+bgzf_mt_writer_t *bgzf_mt_writer_new(const char *filename, int level, int num_threads) {
+	FILE *fd = fopen(filename, "wb");
+	if (fd == NULL) {
+		return NULL;
+	}
+
+	bgzf_mt_writer_t *writer = (bgzf_mt_writer_t *) calloc(1, sizeof(bgzf_mt_writer_t));
+	writer->fd = fd;
+	writer->level = level;
+	writer->num_threads = (num_threads < 1 ? 1 : num_threads);
+	batch_init(&writer->batches[0], num_blocks_by_threads(num_threads));
+	batch_init(&writer->batches[1], num_blocks_by_threads(num_threads));
+
+	return writer;
+}
+
+int bgzf_mt_write(bgzf_mt_writer_t *writer, const void *data, size_t length) {
+	const unsigned char *p = (const unsigned char *) data;
+	size_t capacity = (size_t) writer->batches[0].max_blocks * BGZF_MT_BLOCK_SIZE;
+
+	while (length > 0) {
+		size_t n = capacity - writer->length;
+		if (n > length) {
+			n = length;
+		}
+		memcpy(writer->batches[writer->current].u_data + writer->length, p, n);
+		writer->length += n;
+		p += n;
+		length -= n;
+
+		if (writer->length == capacity && writer_flush(writer) != 0) {
+			return -1;
+		}
+	}
+	return writer->error ? -1 : 0;
+}
+
+int bgzf_mt_writer_close(bgzf_mt_writer_t *writer) {
+	// empty block marking the end of file
+	static const unsigned char eof_block[28] =
+		{ 31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 27, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+	if (writer->fd == NULL) {
+		return writer->error ? -1 : 0;
+	}
+
+	writer_flush(writer);
+	writer_wait(writer);
+
+	if (fwrite(eof_block, 1, sizeof(eof_block), writer->fd) != sizeof(eof_block)) {
+		writer->error = 1;
+	}
+	if (fclose(writer->fd) != 0) {
+		writer->error = 1;
+	}
+	writer->fd = NULL;
+
+	return writer->error ? -1 : 0;
+}
+
+void bgzf_mt_writer_free(bgzf_mt_writer_t *writer) {
+	if (writer == NULL) {
+		return;
+	}
+	if (writer->fd) {
+		bgzf_mt_writer_close(writer);
+	}
+
+	batch_free(&writer->batches[0]);
+	batch_free(&writer->batches[1]);
+	if (writer->block_addresses) {
+		free(writer->block_addresses);
+	}
+	free(writer);
+}
+
+uint64_t bgzf_mt_writer_voffset(bgzf_mt_writer_t *writer, uint64_t u_offset) {
+	// every block but the last one is full
+	size_t i = u_offset / BGZF_MT_BLOCK_SIZE;
+	if (i >= writer->num_block_addresses) {
+		return writer->address << 16;
+	}
+	return (writer->block_addresses[i] << 16) | (u_offset % BGZF_MT_BLOCK_SIZE);
+}
+
+//------------------------------------------------------------------------
+// BAM header and records
+//------------------------------------------------------------------------
+
+bam_header_t *bgzf_mt_read_bam_header(bgzf_mt_reader_t *reader) {
+	char magic[4];
+	int32_t l_text, n_targets, l_name;
+
+	if (bgzf_mt_read(reader, magic, 4) != 4 || strncmp(magic, "BAM\1", 4) != 0) {
+		return NULL;
+	}
+
+	bam_header_t *header = bam_header_init();
+	if (bgzf_mt_read(reader, &l_text, 4) != 4 || l_text < 0) {
+		goto error;
+	}
+	header->l_text = l_text;
+	header->text = (char *) calloc(l_text + 1, 1);
+	if (bgzf_mt_read(reader, header->text, l_text) != l_text) {
+		goto error;
+	}
+
+	if (bgzf_mt_read(reader, &n_targets, 4) != 4 || n_targets < 0) {
+		goto error;
+	}
+	header->n_targets = n_targets;
+	header->target_name = (char **) calloc(n_targets, sizeof(char *));
+	header->target_len = (uint32_t *) calloc(n_targets, sizeof(uint32_t));
+	for (int i = 0; i < n_targets; i++) {
+		if (bgzf_mt_read(reader, &l_name, 4) != 4 || l_name <= 0) {
+			goto error;
+		}
+		header->target_name[i] = (char *) calloc(l_name, 1);
+		if (bgzf_mt_read(reader, header->target_name[i], l_name) != l_name ||
+		    bgzf_mt_read(reader, &header->target_len[i], 4) != 4) {
+			goto error;
+		}
+	}
+	return header;
+
+ error:
+	bam_header_destroy(header);
+	return NULL;
+}
+
+int bgzf_mt_read_bam1(bgzf_mt_reader_t *reader, bam1_t *b) {
+	bam1_core_t *c = &b->core;
+	int32_t block_len;
+	uint32_t x[8];
+
+	int64_t ret = bgzf_mt_read(reader, &block_len, 4);
+	if (ret != 4) {
+		return (ret == 0 ? -1 : -2);
+	}
+	if (block_len < (int32_t) sizeof(x) || bgzf_mt_read(reader, x, sizeof(x)) != sizeof(x)) {
+		return -3;
+	}
+
+	c->tid = x[0];
+	c->pos = x[1];
+	c->bin = x[2] >> 16;
+	c->qual = x[2] >> 8 & 0xff;
+	c->l_qname = x[2] & 0xff;
+	c->flag = x[3] >> 16;
+	c->n_cigar = x[3] & 0xffff;
+	c->l_qseq = x[4];
+	c->mtid = x[5];
+	c->mpos = x[6];
+	c->isize = x[7];
+
+	b->data_len = block_len - sizeof(x);
+	if (b->m_data < b->data_len) {
+		b->m_data = b->data_len;
+		kroundup32(b->m_data);
+		b->data = (uint8_t *) realloc(b->data, b->m_data);
+	}
+	if (bgzf_mt_read(reader, b->data, b->data_len) != b->data_len) {
+		return -4;
+	}
+	b->l_aux = b->data_len - c->n_cigar * 4 - c->l_qname - c->l_qseq - (c->l_qseq + 1) / 2;
+
+	return 4 + block_len;
+}
+
+int bgzf_mt_write_bam_header(bgzf_mt_writer_t *writer, const bam_header_t *header) {
+	int32_t l_text = header->l_text, n_targets = header->n_targets, l_name;
+
+	bgzf_mt_write(writer, "BAM\1", 4);
+	bgzf_mt_write(writer, &l_text, 4);
+	if (l_text) {
+		bgzf_mt_write(writer, header->text, l_text);
+	}
+	bgzf_mt_write(writer, &n_targets, 4);
+	for (int i = 0; i < n_targets; i++) {
+		l_name = strlen(header->target_name[i]) + 1;
+		bgzf_mt_write(writer, &l_name, 4);
+		bgzf_mt_write(writer, header->target_name[i], l_name);
+		bgzf_mt_write(writer, &header->target_len[i], 4);
+	}
+	return writer->error ? -1 : 0;
+}
+
+int bgzf_mt_write_bam1(bgzf_mt_writer_t *writer, const bam1_t *b) {
+	const bam1_core_t *c = &b->core;
+	int32_t block_len = b->data_len + 32;
+	uint32_t x[8];
+
+	x[0] = c->tid;
+	x[1] = c->pos;
+	x[2] = (uint32_t) c->bin << 16 | c->qual << 8 | c->l_qname;
+	x[3] = (uint32_t) c->flag << 16 | c->n_cigar;
+	x[4] = c->l_qseq;
+	x[5] = c->mtid;
+	x[6] = c->mpos;
+	x[7] = c->isize;
+
+	bgzf_mt_write(writer, &block_len, 4);
+	bgzf_mt_write(writer, x, sizeof(x));
+	bgzf_mt_write(writer, b->data, b->data_len);
+
+	return writer->error ? -1 : 4 + block_len;
+}
@@ -0,0 +1,171 @@
+#ifndef AUX_BGZF_H_
+#define AUX_BGZF_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#include "bioformats/bam/samtools/bam.h"
+
+/***************************
+ * MULTITHREADED BGZF
+ *
+ * BGZF blocks are independent deflate streams, so they are inflated and
+ * deflated in batches on several threads. A background thread prefetches
+ * (reader) or writes (writer) one batch while the caller works on the other.
+ *
+ * BAM records are read and written with the same layout as samtools 0.1.18
+ * bam_read1/bam_write1 (little-endian hosts).
+ **************************/
+
+#define BGZF_MT_BLOCK_SIZE        0xff00   // uncompressed bytes per written block (as samtools)
+#define BGZF_MT_MAX_BLOCK_SIZE    0x10000
+#define BGZF_MT_HEADER_SIZE       18
+#define BGZF_MT_FOOTER_SIZE       8
+#define BGZF_MT_BLOCKS_PER_THREAD 16
+
+#define BGZF_MT_DEFAULT_LEVEL     Z_DEFAULT_COMPRESSION
+
+/**
+ * Batch of BGZF blocks.
+ */
+typedef struct bgzf_mt_batch {
+	int num_blocks;
+	int max_blocks;
+	uint64_t *addresses;		// file offset of every block
+	int *c_sizes;			// compressed block sizes (header and footer included)
+	int *u_sizes;			// uncompressed block sizes
+	unsigned char *c_data;		// max_blocks * BGZF_MT_MAX_BLOCK_SIZE
+	unsigned char *u_data;		// max_blocks * BGZF_MT_MAX_BLOCK_SIZE
+	int eof;
+	int error;
+} bgzf_mt_batch_t;
+
+/**
+ * Reader: prefetches and inflates batches of blocks.
+ */
+typedef struct bgzf_mt_reader {
+	FILE *fd;
+	int num_threads;
+	int error;
+
+	// double buffer shared with the prefetch thread
+	bgzf_mt_batch_t batches[2];
+	int full[2];
+	int stop;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+
+	// consumer position
+	int slot;
+	bgzf_mt_batch_t *batch;
+	int block;
+	int offset;
+} bgzf_mt_reader_t;
+
+/**
+ * Writer: deflates batches of blocks and writes them in order.
+ */
+typedef struct bgzf_mt_writer {
+	FILE *fd;
+	int level;
+	int num_threads;
+	int error;
+
+	// the caller fills batches[current] while the previous one is written
+	bgzf_mt_batch_t batches[2];
+	int current;
+	size_t length;			// uncompressed bytes in the current batch
+	uint64_t u_offset;		// uncompressed bytes written so far
+	int running;
+	pthread_t thread;
+
+	// file offset of every written block, to translate uncompressed
+	// offsets into virtual offsets once the data is flushed
+	uint64_t address;
+	uint64_t *block_addresses;
+	size_t num_block_addresses;
+	size_t max_block_addresses;
+} bgzf_mt_writer_t;
+
+/**
+ * Opens a BGZF file and starts reading at the given virtual offset.
+ * \param filename Input file name.
+ * \param voffset Virtual offset (block address << 16 | offset in block), 0 for the beginning.
+ * \param num_threads Threads to inflate blocks.
+ * \return Reader or NULL if the file could not be opened.
+ */
+bgzf_mt_reader_t *bgzf_mt_reader_new(const char *filename, uint64_t voffset, int num_threads);
+
+/**
+ * Stops the prefetch thread and closes the file.
+ */
+void bgzf_mt_reader_free(bgzf_mt_reader_t *reader);
+
+/**
+ * Moves the reader to a virtual offset.
+ * \return 0 on success.
+ */
+int bgzf_mt_seek(bgzf_mt_reader_t *reader, uint64_t voffset);
+
+/**
+ * Virtual offset of the next byte to read.
+ */
+uint64_t bgzf_mt_tell(bgzf_mt_reader_t *reader);
+
+/**
+ * Copies up to 'length' uncompressed bytes.
+ * \return Bytes read (less than 'length' at the end of file), -1 on error.
+ */
+int64_t bgzf_mt_read(bgzf_mt_reader_t *reader, void *data, size_t length);
+
+/**
+ * Creates a BGZF file.
+ * \param filename Output file name.
+ * \param level Compression level (zlib), BGZF_MT_DEFAULT_LEVEL for the default one.
+ * \param num_threads Threads to deflate blocks.
+ * \return Writer or NULL if the file could not be created.
+ */
+bgzf_mt_writer_t *bgzf_mt_writer_new(const char *filename, int level, int num_threads);
+
+/**
+ * Writes the pending blocks and the EOF marker and closes the file, virtual
+ * offsets can be still translated until the writer is freed.
+ * \return 0 on success.
+ */
+int bgzf_mt_writer_close(bgzf_mt_writer_t *writer);
+
+void bgzf_mt_writer_free(bgzf_mt_writer_t *writer);
+
+/**
+ * Appends uncompressed data.
+ * \return 0 on success.
+ */
+int bgzf_mt_write(bgzf_mt_writer_t *writer, const void *data, size_t length);
+
+/**
+ * Uncompressed offset of the next byte to write.
+ */
+static inline uint64_t bgzf_mt_writer_tell(bgzf_mt_writer_t *writer) {
+	return writer->u_offset + writer->length;
+}
+
+/**
+ * Translates an uncompressed offset (bgzf_mt_writer_tell) into a virtual offset,
+ * only valid for data already written (after bgzf_mt_writer_close).
+ */
+uint64_t bgzf_mt_writer_voffset(bgzf_mt_writer_t *writer, uint64_t u_offset);
+
+/**
+ * BAM header and records.
+ */
+bam_header_t *bgzf_mt_read_bam_header(bgzf_mt_reader_t *reader);
+int bgzf_mt_read_bam1(bgzf_mt_reader_t *reader, bam1_t *b);
+int bgzf_mt_write_bam_header(bgzf_mt_writer_t *writer, const bam_header_t *header);
+int bgzf_mt_write_bam1(bgzf_mt_writer_t *writer, const bam1_t *b);
+
+#endif /* AUX_BGZF_H_ */
@@ -152,7 +152,11 @@ enum ERROR_C {
 	WANDER_PROC_FUNC_FULL,
 
 	//CIGAR
-	CIGAR_INVALID_INDEL
+	CIGAR_INVALID_INDEL,
+
+	//SIMD dispatch
+	SIMD_UNKNOWN_ISA = 6000,
+	SIMD_UNSUPPORTED_ISA
 };
 typedef enum ERROR_C ERROR_CODE;
 
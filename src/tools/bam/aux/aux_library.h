@@ -41,6 +41,10 @@
 //Auxiliar headers
 #include "aux_simd.h"
 #include "aux_bam.h"
+#include "aux_bgzf.h"
+#include "aux_bam_reader.h"
+#include "aux_bam_index.h"
+#include "aux_bam_sort.h"
 #include "aux_cigar.h"
 #include "aux_math.h"
 #include "aux_misc.h"
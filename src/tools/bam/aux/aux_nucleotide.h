@@ -19,10 +19,16 @@
 #define AUX_NUCLEOTIDE_H_
 
 #include "aux_library.h"
+#include "aux_simd.h"
 #include "x86intrin.h"
 
 /***************************
  * NUCLEOTIDE OPERATIONS
+ *
+ * Sequences are compared with unaligned loads and masked (or padded) tails,
+ * no memory is allocated. There is a variant for each instruction set
+ * (SSE2, AVX2 and AVX-512BW), built with target attributes so they are
+ * available whatever the compiler flags, selected at run time (aux_simd.h).
  **************************/
 
 /**
@@ -30,7 +36,7 @@
  * \param[in] ref_seq First sequence.
  * \param[in] bam_seq Second sequence. 
  * \param[in] bam_seq_l Length of input sequences. 
- * \param[out] comp_seq Output sequence to store individual missmatch value. 0 means equal, 1 means differ.
+ * \param[out] comp_seq Output sequence to store individual missmatch value. 0 means equal, 1 means differ. Optional, set to NULL in case.
  * \param[out] miss_count Number of missmatches in comparation. Optional, set to NULL in case.
  */
 static inline ERROR_CODE nucleotide_compare(const char *ref_seq, const char *bam_seq, size_t bam_seq_l, char *comp_res, uint32_t *miss_count) __ATTR_HOT __ATTR_INLINE;
@@ -41,12 +47,23 @@ static inline ERROR_CODE nucleotide_compare(const char *ref_seq, const char *bam
  * \param[in] bam_seq Second sequence.
  * \param[in] bam_qual Sequence qualities.
  * \param[in] bam_seq_l Length of input sequences.
- * \param[out] comp_seq Output sequence to store individual missmatch value. 0 means equal, 1 means differ.
+ * \param[out] comp_seq Output sequence to store individual missmatch value. 0 means equal, 1 means differ. Optional, set to NULL in case.
  * \param[out] out_miss_count Number of missmatches in comparation. Optional, set to NULL in case.
  * \param[out] out_sum_quals Summatory of missmatch qualities.
  */
 static inline ERROR_CODE nucleotide_miss_qual_sum(const char *ref_seq, const char *bam_seq, const char *bam_qual, size_t bam_seq_l, char *comp_res, uint32_t *out_miss_count, uint32_t *out_sum_quals) __ATTR_HOT __ATTR_INLINE;
 
+/**
+ * Instruction set variants, same arguments as nucleotide_miss_qual_sum but
+ * bam_qual is optional (NULL for no qualities summatory) and outputs are mandatory.
+ */
+static inline void nucleotide_miss_qual_sum_scalar(const char *ref_seq, const char *bam_seq, const char *bam_qual, size_t bam_seq_l, char *comp_res, uint32_t *out_miss_count, uint32_t *out_sum_quals) __ATTR_HOT;
+#ifdef SIMD_X86
+static inline void nucleotide_miss_qual_sum_sse2(const char *ref_seq, const char *bam_seq, const char *bam_qual, size_t bam_seq_l, char *comp_res, uint32_t *out_miss_count, uint32_t *out_sum_quals) __ATTR_HOT __attribute__((target("sse2")));
+static inline void nucleotide_miss_qual_sum_avx2(const char *ref_seq, const char *bam_seq, const char *bam_qual, size_t bam_seq_l, char *comp_res, uint32_t *out_miss_count, uint32_t *out_sum_quals) __ATTR_HOT __attribute__((target("avx2")));
+static inline void nucleotide_miss_qual_sum_avx512(const char *ref_seq, const char *bam_seq, const char *bam_qual, size_t bam_seq_l, char *comp_res, uint32_t *out_miss_count, uint32_t *out_sum_quals) __ATTR_HOT __attribute__((target("avx512f,avx512bw")));
+#endif
+
 
 
 /**
@@ -59,270 +76,301 @@ static inline ERROR_CODE nucleotide_miss_qual_sum(const char *ref_seq, const cha
 static inline ERROR_CODE
 nucleotide_compare(const char *ref_seq, const char *bam_seq, size_t bam_seq_l, char *comp_res, uint32_t *miss_count)
 {
-	int i;
-
 	uint32_t misses;
+	uint32_t sum;
 
 	assert(ref_seq);
 	assert(bam_seq);
 	assert(bam_seq_l > 0);
-	assert(comp_res);
 
-	//SSE
-#ifdef __SSE2__	 //SSE2 block
-	__m128i v_ref, v_seq, v_count;
+	simd_kernels.nucleotide_miss_qual_sum(ref_seq, bam_seq, NULL, bam_seq_l, comp_res, &misses, &sum);
 
-	//Comparation
-	__m128i v_comp;
+	//Set miss count
+	if(miss_count)
+	{
+		*miss_count = misses;
+	}
 
-	//Constants
-	const __m128i v_zero = _mm_set1_epi8(0);
-	const __m128i v_one = _mm_set1_epi8(1);
+	return NO_ERROR;
+}
 
+/**
+ * Compare two sequences and obtain missmatches and missmatches qualities summatory. 
+ */
+static inline ERROR_CODE
+nucleotide_miss_qual_sum(const char *ref_seq, const char *bam_seq, const char *bam_qual, size_t bam_seq_l, char *comp_res, uint32_t *out_miss_count, uint32_t *out_sum_quals)
+{
+	uint32_t misses;
+	uint32_t sum;
 
-	char *ref_aux;
-	char *bam_aux;
-	char *comp_aux;
-	size_t aux_l;
+	assert(ref_seq);
+	assert(bam_seq);
+	assert(bam_qual);
+	assert(bam_seq_l > 0);
 
-	//Allocate buffers
-	aux_l = bam_seq_l + (16 - (bam_seq_l % 16));
-	ref_aux = (char *) _mm_malloc(aux_l * sizeof(char), MEM_ALIG_SSE_SIZE);
-	bam_aux = (char *) _mm_malloc(aux_l * sizeof(char), MEM_ALIG_SSE_SIZE);
-	comp_aux = (char *) _mm_malloc(aux_l * sizeof(char), MEM_ALIG_SSE_SIZE);
+	simd_kernels.nucleotide_miss_qual_sum(ref_seq, bam_seq, bam_qual, bam_seq_l, comp_res, &misses, &sum);
 
-	//Init buffers
-	memcpy(ref_aux, ref_seq, bam_seq_l);
-	memcpy(bam_aux, bam_seq, bam_seq_l);
-	memset(ref_aux + bam_seq_l, 0, aux_l - bam_seq_l);	//Set last elements to match
-	memset(bam_aux + bam_seq_l, 0, aux_l - bam_seq_l);
+	//Set miss count
+	if(out_miss_count)
+	{
+		*out_miss_count = misses;
+	}
 
-	//Init count
-	v_count = _mm_set1_epi16(0);
+	//Sum diff qualities
+	if(out_sum_quals)
+	{
+		//Set output
+		*out_sum_quals = sum;
+	}
+
+	return NO_ERROR;
+}
+
+/**
+ * Sequential variant.
+ */
+static inline void
+nucleotide_miss_qual_sum_scalar(const char *ref_seq, const char *bam_seq, const char *bam_qual, size_t bam_seq_l, char *comp_res, uint32_t *out_miss_count, uint32_t *out_sum_quals)
+{
+	size_t i;
+	uint32_t misses;
+	uint32_t sum;
+	char diff;
 
 	//Iterates nucleotides in this read
 	misses = 0;
-	for(i = 0; i < bam_seq_l; i += 16)
+	sum = 0;
+	for(i = 0; i < bam_seq_l; i++)
 	{
-		//Pack sequences
-		v_ref = _mm_load_si128((__m128i const *)(ref_aux + i));
-		v_seq = _mm_load_si128((__m128i const *)(bam_aux + i));
-
-		//Compare sequences
-		v_comp = _mm_cmpeq_epi8(v_ref, v_seq);	//0xFF Equals, 0x00 Diff
+		//0 Equals, 1 Diff
+		diff = (ref_seq[i] != bam_seq[i]);
+		if(diff)
+		{
+			misses++;
+			if(bam_qual)
+				sum += bam_qual[i];
+		}
+		if(comp_res)
+			comp_res[i] = diff;
+	}
 
-		//Change result
-		v_comp = _mm_add_epi8(v_comp, v_one);	//Now equals = 0 and diff = 1
+	*out_miss_count = misses;
+	*out_sum_quals = sum;
+}
 
-		//Sum number of differences
-		//Accumulate 8 bit values to two 64 bit partial sum
-		v_count = _mm_add_epi64(v_count, _mm_sad_epu8(v_comp, v_zero));
+#ifdef SIMD_X86
 
-		//Store comparation values
-		_mm_store_si128((__m128i*)(comp_aux + i), v_comp);
-	}
+/**
+ * SSE2 variant. The tail is compared in a zero padded block on the stack.
+ */
+static inline void
+nucleotide_miss_qual_sum_sse2(const char *ref_seq, const char *bam_seq, const char *bam_qual, size_t bam_seq_l, char *comp_res, uint32_t *out_miss_count, uint32_t *out_sum_quals)
+{
+	size_t i;
+	size_t tail_l;
+	uint32_t misses;
 
-	//Horizontal add of two 64 bit partial sums
-	misses = _mm_cvtsi128_si32(v_count) + _mm_cvtsi128_si32(_mm_srli_si128(v_count, 8));
+	//Tail block
+	char ref_tail[16] __attribute__((aligned(16)));
+	char bam_tail[16] __attribute__((aligned(16)));
+	char qual_tail[16] __attribute__((aligned(16)));
+	char comp_tail[16] __attribute__((aligned(16)));
 
-	//Set result
-	memcpy(comp_res, comp_aux, bam_seq_l);
+	//Constants
+	const __m128i v_zero = _mm_setzero_si128();
+	const __m128i v_one = _mm_set1_epi8(1);
 
-	//Set miss count
-	if(miss_count)
-	{
-		*miss_count = misses;
-	}
+	//Nucleotides
+	__m128i v_equal, v_comp;
 
-	//Free
-	_mm_free(ref_aux);
-	_mm_free(bam_aux);
-	_mm_free(comp_aux);
+	//Sums
+	__m128i v_sum;
 
-#else //Sequential Block
+	misses = 0;
+	v_sum = _mm_setzero_si128();
 
 	//Iterates nucleotides in this read
-	count = 0;
-	for(i = 0; i < bam_seq_l; i++)
+	for(i = 0; i + 16 <= bam_seq_l; i += 16)
 	{
-		//0 Equals, 1 Diff
-		if(ref_seq[i] != bam_seq[i])
-		{
-			comp_res[i] = 1;
-			count++;
-		}
-		else
+		//Compare sequences
+		v_equal = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const *)(ref_seq + i)),
+				_mm_loadu_si128((__m128i const *)(bam_seq + i)));	//0xFF Equals, 0x00 Diff
+
+		//Count differences
+		misses += __builtin_popcount(~_mm_movemask_epi8(v_equal) & 0xFFFF);
+
+		//Sum different qualities, 8 bit values to two 64 bit partial sums
+		if(bam_qual)
+			v_sum = _mm_add_epi64(v_sum, _mm_sad_epu8(_mm_andnot_si128(v_equal, _mm_loadu_si128((__m128i const *)(bam_qual + i))), v_zero));
+
+		//Store comparation values, equals = 0 and diff = 1
+		if(comp_res)
 		{
-			comp_res[i] = 0;
+			v_comp = _mm_andnot_si128(v_equal, v_one);
+			_mm_storeu_si128((__m128i*)(comp_res + i), v_comp);
 		}
-
 	}
 
-	//Count misses
-	if(miss_count)
+	//Tail
+	tail_l = bam_seq_l - i;
+	if(tail_l)
 	{
-		*miss_count = count;
+		//Set last elements to match
+		memset(ref_tail, 0, 16);
+		memset(bam_tail, 0, 16);
+		memset(qual_tail, 0, 16);
+		memcpy(ref_tail, ref_seq + i, tail_l);
+		memcpy(bam_tail, bam_seq + i, tail_l);
+		if(bam_qual)
+			memcpy(qual_tail, bam_qual + i, tail_l);
+
+		v_equal = _mm_cmpeq_epi8(_mm_load_si128((__m128i const *)ref_tail), _mm_load_si128((__m128i const *)bam_tail));
+		misses += __builtin_popcount(~_mm_movemask_epi8(v_equal) & 0xFFFF);
+		v_sum = _mm_add_epi64(v_sum, _mm_sad_epu8(_mm_andnot_si128(v_equal, _mm_load_si128((__m128i const *)qual_tail)), v_zero));
+		if(comp_res)
+		{
+			_mm_store_si128((__m128i*)comp_tail, _mm_andnot_si128(v_equal, v_one));
+			memcpy(comp_res + i, comp_tail, tail_l);
+		}
 	}
 
-#endif	//End SSE if
+	//Horizontal add of two 64 bit partial sums
+	v_sum = _mm_add_epi64(v_sum, _mm_srli_si128(v_sum, 8));
 
-	return NO_ERROR;
+	*out_miss_count = misses;
+	*out_sum_quals = _mm_cvtsi128_si32(v_sum);
 }
 
 /**
- * Compare two sequences and obtain missmatches and missmatches qualities summatory. 
+ * AVX2 variant. The tail is compared in a zero padded block on the stack.
  */
-static inline ERROR_CODE
-nucleotide_miss_qual_sum(const char *ref_seq, const char *bam_seq, const char *bam_qual, size_t bam_seq_l, char *comp_res, uint32_t *out_miss_count, uint32_t *out_sum_quals)
+static inline void
+nucleotide_miss_qual_sum_avx2(const char *ref_seq, const char *bam_seq, const char *bam_qual, size_t bam_seq_l, char *comp_res, uint32_t *out_miss_count, uint32_t *out_sum_quals)
 {
-	int i;
+	size_t i;
+	size_t tail_l;
 	uint32_t misses;
-	uint32_t sum;
 
-	assert(ref_seq);
-	assert(bam_seq);
-	assert(bam_qual);
-	assert(bam_seq_l > 0);
-	assert(comp_res);
+	//Tail block
+	char ref_tail[32] __attribute__((aligned(32)));
+	char bam_tail[32] __attribute__((aligned(32)));
+	char qual_tail[32] __attribute__((aligned(32)));
+	char comp_tail[32] __attribute__((aligned(32)));
 
-	//SSE
-#ifdef __SSE2__	 //SSE2 block
 	//Constants
-	const __m128i v_zero = _mm_set1_epi8(0);
-	const __m128i v_one = _mm_set1_epi8(1);
-
+	const __m256i v_zero = _mm256_setzero_si256();
+	const __m256i v_one = _mm256_set1_epi8(1);
 
 	//Nucleotides
-	__m128i v_ref, v_seq, v_qual;
-	__m128i vl_qual, vh_qual;
-
-	//Comparations
-	__m128i v_comp, vl_comp, vh_comp;
+	__m256i v_equal;
 
 	//Sums
-	__m128i v_sum, v_count;
-
-	char *ref_aux;
-	char *bam_aux;
-	char *qual_aux;
-	char *comp_aux;
-	size_t aux_l;
-
-	//Allocate buffers
-	aux_l = bam_seq_l + (16 - (bam_seq_l % 16));
-	ref_aux = (char *) _mm_malloc(aux_l * sizeof(char), MEM_ALIG_SSE_SIZE);
-	bam_aux = (char *) _mm_malloc(aux_l * sizeof(char), MEM_ALIG_SSE_SIZE);
-	qual_aux = (char *) _mm_malloc(aux_l * sizeof(char), MEM_ALIG_SSE_SIZE);
-	comp_aux = (char *) _mm_malloc(aux_l * sizeof(char), MEM_ALIG_SSE_SIZE);
-
-	//Init buffers
-	memcpy(ref_aux, ref_seq, bam_seq_l);
-	memcpy(bam_aux, bam_seq, bam_seq_l);
-	memcpy(qual_aux, bam_qual, bam_seq_l);
-	memset(ref_aux + bam_seq_l, 0, aux_l - bam_seq_l);	//Set last elements to match
-	memset(bam_aux + bam_seq_l, 0, aux_l - bam_seq_l);
-	memset(qual_aux + bam_seq_l, 0, aux_l - bam_seq_l);
-
-	//Init count
-	v_sum = _mm_set1_epi32(0);
-	v_count = _mm_set1_epi32(0);
+	__m256i v_sum;
+	__m128i v_sum128;
+
+	misses = 0;
+	v_sum = _mm256_setzero_si256();
 
 	//Iterates nucleotides in this read
-	for(i = 0; i < bam_seq_l; i += 16)
+	for(i = 0; i + 32 <= bam_seq_l; i += 32)
 	{
-		//Pack sequences
-		v_ref = _mm_load_si128((__m128i const *)(ref_aux + i));
-		v_seq = _mm_load_si128((__m128i const *)(bam_aux + i));
-		v_qual = _mm_load_si128((__m128i const *)(qual_aux + i));
-
 		//Compare sequences
-		v_comp = _mm_cmpeq_epi8(v_ref, v_seq);	//0xFF Equals, 0x00 Diff
-
-		//Transform result
-		v_comp = _mm_add_epi8(v_comp, v_one);	//Now equals = 0 and diff = 1
+		v_equal = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *)(ref_seq + i)),
+				_mm256_loadu_si256((__m256i const *)(bam_seq + i)));	//0xFF Equals, 0x00 Diff
 
-		//Sum number of differences
-		v_count = _mm_add_epi64(v_count, _mm_sad_epu8(v_comp, v_zero));
+		//Count differences
+		misses += __builtin_popcount(~(uint32_t)_mm256_movemask_epi8(v_equal));
 
-		//Sum different qualities
-		{
-			//Convert diffs to 16 bits integer
-			vl_comp = _mm_unpacklo_epi8(v_comp, v_zero);
-			vh_comp = _mm_unpackhi_epi8(v_comp, v_zero);
+		//Sum different qualities, 8 bit values to four 64 bit partial sums
+		if(bam_qual)
+			v_sum = _mm256_add_epi64(v_sum, _mm256_sad_epu8(_mm256_andnot_si256(v_equal, _mm256_loadu_si256((__m256i const *)(bam_qual + i))), v_zero));
 
-			//Convert qualities to 16 bits integer
-			vl_qual = _mm_unpacklo_epi8(v_qual, v_zero);
-			vh_qual = _mm_unpackhi_epi8(v_qual, v_zero);
+		//Store comparation values, equals = 0 and diff = 1
+		if(comp_res)
+			_mm256_storeu_si256((__m256i*)(comp_res + i), _mm256_andnot_si256(v_equal, v_one));
+	}
 
-			//Accumulate 16 bit values to 32 bit partial sum (only different)
-			v_sum = _mm_add_epi32(v_sum, _mm_madd_epi16(vl_qual, vl_comp));
-			v_sum = _mm_add_epi32(v_sum, _mm_madd_epi16(vh_qual, vh_comp));
+	//Tail
+	tail_l = bam_seq_l - i;
+	if(tail_l)
+	{
+		//Set last elements to match
+		memset(ref_tail, 0, 32);
+		memset(bam_tail, 0, 32);
+		memset(qual_tail, 0, 32);
+		memcpy(ref_tail, ref_seq + i, tail_l);
+		memcpy(bam_tail, bam_seq + i, tail_l);
+		if(bam_qual)
+			memcpy(qual_tail, bam_qual + i, tail_l);
+
+		v_equal = _mm256_cmpeq_epi8(_mm256_load_si256((__m256i const *)ref_tail), _mm256_load_si256((__m256i const *)bam_tail));
+		misses += __builtin_popcount(~(uint32_t)_mm256_movemask_epi8(v_equal));
+		v_sum = _mm256_add_epi64(v_sum, _mm256_sad_epu8(_mm256_andnot_si256(v_equal, _mm256_load_si256((__m256i const *)qual_tail)), v_zero));
+		if(comp_res)
+		{
+			_mm256_store_si256((__m256i*)comp_tail, _mm256_andnot_si256(v_equal, v_one));
+			memcpy(comp_res + i, comp_tail, tail_l);
 		}
-
-		//Store comparation values
-		_mm_store_si128((__m128i*)(comp_aux + i), v_comp);
 	}
 
-	//Horizontal add of four 32 bit partial sums
-#ifdef __SSSE3__
-	v_sum = _mm_hadd_epi32(_mm_hadd_epi32(v_sum, v_zero), v_zero);
-#else
-	v_sum = _mm_add_epi32(v_sum, _mm_srli_si128(v_sum, 8));
-	v_sum = _mm_add_epi32(v_sum, _mm_srli_si128(v_sum, 4));
-#endif
-	sum = _mm_cvtsi128_si32(v_sum);
+	//Horizontal add of four 64 bit partial sums
+	v_sum128 = _mm_add_epi64(_mm256_castsi256_si128(v_sum), _mm256_extracti128_si256(v_sum, 1));
+	v_sum128 = _mm_add_epi64(v_sum128, _mm_srli_si128(v_sum128, 8));
 
-	v_count = _mm_add_epi32(v_count, _mm_srli_si128(v_count, 8));
-	misses = _mm_cvtsi128_si32(v_count);
+	*out_miss_count = misses;
+	*out_sum_quals = _mm_cvtsi128_si32(v_sum128);
+}
 
-	//Set result
-	memcpy(comp_res, comp_aux, bam_seq_l);
+/**
+ * AVX-512BW variant. The tail is loaded and stored with masks.
+ */
+static inline void
+nucleotide_miss_qual_sum_avx512(const char *ref_seq, const char *bam_seq, const char *bam_qual, size_t bam_seq_l, char *comp_res, uint32_t *out_miss_count, uint32_t *out_sum_quals)
+{
+	size_t i;
+	uint32_t misses;
 
-	//Free
-	_mm_free(ref_aux);
-	_mm_free(bam_aux);
-	_mm_free(qual_aux);
-	_mm_free(comp_aux);
+	//Masks
+	__mmask64 m_load;
+	__mmask64 m_diff;
 
-#else //Sequential Block
+	//Constants
+	const __m512i v_zero = _mm512_setzero_si512();
+	const __m512i v_one = _mm512_set1_epi8(1);
+
+	//Sums
+	__m512i v_sum;
 
-	//Iterates nucleotides in this read
 	misses = 0;
-	sum = 0;
-	for(i = 0; i < bam_seq_l; i++)
+	v_sum = _mm512_setzero_si512();
+
+	//Iterates nucleotides in this read
+	for(i = 0; i < bam_seq_l; i += 64)
 	{
-		//0 Equals, 1 Diff
-		if(ref_seq[i] != bam_seq[i])
-		{
-			comp_res[i] = 1;
-			sum += bam_qual[i];
-			misses++;
-		}
-		else
-		{
-			comp_res[i] = 0;
-		}
+		//Elements in this block
+		m_load = (bam_seq_l - i >= 64) ? ~(__mmask64)0 : (((__mmask64)1 << (bam_seq_l - i)) - 1);
 
-	}
+		//Compare sequences
+		m_diff = _mm512_mask_cmpneq_epi8_mask(m_load,
+				_mm512_maskz_loadu_epi8(m_load, ref_seq + i),
+				_mm512_maskz_loadu_epi8(m_load, bam_seq + i));
 
-#endif	//End SSE if
+		//Count differences
+		misses += __builtin_popcountll(m_diff);
 
-	//Set miss count
-	if(out_miss_count)
-	{
-		*out_miss_count = misses;
-	}
+		//Sum different qualities, 8 bit values to eight 64 bit partial sums
+		if(bam_qual)
+			v_sum = _mm512_add_epi64(v_sum, _mm512_sad_epu8(_mm512_maskz_loadu_epi8(m_diff, bam_qual + i), v_zero));
 
-	//Sum diff qualities
-	if(out_sum_quals)
-	{
-		//Set output
-		*out_sum_quals = sum;
+		//Store comparation values, equals = 0 and diff = 1
+		if(comp_res)
+			_mm512_mask_storeu_epi8(comp_res + i, m_load, _mm512_maskz_mov_epi8(m_diff, v_one));
 	}
 
-	return NO_ERROR;
+	*out_miss_count = misses;
+	*out_sum_quals = (uint32_t)_mm512_reduce_add_epi64(v_sum);
 }
 
-
+#endif	//End SIMD_X86 if
 
 #endif /* AUX_NUCLEOTIDE_H_ */
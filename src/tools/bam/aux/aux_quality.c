@@ -58,17 +58,15 @@ recal_get_estimated_Q(U_BASES *v_bases, size_t count, U_QUALS start_quality, dou
 }
 
 /**
- * Obtains empirical quality from a count of bases and misses and a theorical quality.
+ * PRIVATE. Posterior probability of every empirical quality (0 to 90) from a count of bases and misses and a theorical quality.
  */
-ERROR_CODE
-recal_get_empirical_Q(double miss, U_BASES bases, double initial_quality, double *emp_qual)
+static void
+recal_get_empirical_Q_posterior(double miss, U_BASES bases, double initial_quality, double *norm)
 {
 	U_BASES mismatches;
 	U_BASES observations;
 	double log10[91];
-	double norm[91];
 	double sum_norm;
-	uint16_t mle;
 	double qempprior;
 	double qemplike;
 	double max;
@@ -97,6 +95,18 @@ recal_get_empirical_Q(double miss, U_BASES bases, double initial_quality, double
 	{
 		norm[i] = norm[i] / sum_norm;
 	}
+}
+
+/**
+ * Obtains empirical quality from a count of bases and misses and a theorical quality.
+ */
+ERROR_CODE
+recal_get_empirical_Q(double miss, U_BASES bases, double initial_quality, double *emp_qual)
+{
+	double norm[91];
+	uint16_t mle;
+
+	recal_get_empirical_Q_posterior(miss, bases, initial_quality, norm);
 
 	//Get maximum log index
 	max_index(norm, 91, &mle);
@@ -106,6 +116,43 @@ recal_get_empirical_Q(double miss, U_BASES bases, double initial_quality, double
 	return NO_ERROR;
 }
 
+/**
+ * Obtains the interval of empirical qualities around the empirical quality with a given probability.
+ */
+ERROR_CODE
+recal_get_empirical_Q_interval(double miss, U_BASES bases, double initial_quality, double confidence, double *low_qual, double *high_qual)
+{
+	double norm[91];
+	double prob;
+	uint16_t mle;
+	int low, high;
+
+	recal_get_empirical_Q_posterior(miss, bases, initial_quality, norm);
+	max_index(norm, 91, &mle);
+
+	//Grow interval by the most probable neighbour
+	low = high = mle;
+	prob = norm[mle];
+	while(prob < confidence && (low > 0 || high < 90))
+	{
+		if(high == 90 || (low > 0 && norm[low - 1] >= norm[high + 1]))
+		{
+			low--;
+			prob += norm[low];
+		}
+		else
+		{
+			high++;
+			prob += norm[high];
+		}
+	}
+
+	*low_qual = (double)low;
+	*high_qual = (double)high;
+
+	return NO_ERROR;
+}
+
 /**
  * Obtains how much one empirical quality approximates one theorical quality, expressed by logarithm.
  */
@@ -45,6 +45,17 @@ EXTERNC ERROR_CODE recal_get_estimated_Q(U_BASES *v_bases, size_t count, U_QUALS
  */
 EXTERNC ERROR_CODE recal_get_empirical_Q(double miss, U_BASES bases, double initial_quality, double *emp_qual);
 
+/**
+ * Obtains the smallest interval of empirical qualities around the empirical quality with a given probability.
+ * \param[in] miss Counts how many errors are in bases.
+ * \param[in] bases Counts how many bases.
+ * \param[in] initial_quality Theorical quality.
+ * \param[in] confidence Probability of the interval (e.g. 0.95).
+ * \param[out] low_qual Pointer to store lowest quality of the interval.
+ * \param[out] high_qual Pointer to store highest quality of the interval.
+ */
+EXTERNC ERROR_CODE recal_get_empirical_Q_interval(double miss, U_BASES bases, double initial_quality, double confidence, double *low_qual, double *high_qual);
+
 /**
  * Obtains how much one empirical quality approximates one theorical quality, expressed by logarithm.
  * \param[in] Qemp Empirical quality to be evaluated.
@@ -0,0 +1,171 @@
+/*
+ * aux_simd.c
+ *
+ *  Created on: Feb 14, 2014
+ *      Author: rmoreno
+ */
+
+#include "aux_simd.h"
+#include "aux_library.h"
+#include "recalibrate/bam_recal_library.h"
+
+/**
+ * Kernels of the instruction set the binary is built for
+ */
+#ifndef SIMD_X86
+	#define SIMD_ISA_BUILD SIMD_ISA_SCALAR
+	#define SIMD_BUILD_KERNELS { SIMD_ISA_SCALAR, nucleotide_miss_qual_sum_scalar, recal_select_bases_scalar }
+#elif defined(__AVX512F__) && defined(__AVX512BW__)
+	#define SIMD_ISA_BUILD SIMD_ISA_AVX512
+	#define SIMD_BUILD_KERNELS { SIMD_ISA_AVX512, nucleotide_miss_qual_sum_avx512, recal_select_bases_avx512 }
+#elif defined(__AVX2__)
+	#define SIMD_ISA_BUILD SIMD_ISA_AVX2
+	#define SIMD_BUILD_KERNELS { SIMD_ISA_AVX2, nucleotide_miss_qual_sum_avx2, recal_select_bases_avx2 }
+#elif defined(__SSE2__)
+	#define SIMD_ISA_BUILD SIMD_ISA_SSE2
+	#define SIMD_BUILD_KERNELS { SIMD_ISA_SSE2, nucleotide_miss_qual_sum_sse2, recal_select_bases_sse2 }
+#else
+	#define SIMD_ISA_BUILD SIMD_ISA_SCALAR
+	#define SIMD_BUILD_KERNELS { SIMD_ISA_SCALAR, nucleotide_miss_qual_sum_scalar, recal_select_bases_scalar }
+#endif
+
+simd_kernels_t simd_kernels = SIMD_BUILD_KERNELS;
+
+/**
+ * Kernels of every instruction set
+ */
+static const simd_kernels_t simd_isa_kernels[SIMD_ISA_NUM] = {
+	{ SIMD_ISA_SCALAR, nucleotide_miss_qual_sum_scalar, recal_select_bases_scalar },
+#ifdef SIMD_X86
+	{ SIMD_ISA_SSE2, nucleotide_miss_qual_sum_sse2, recal_select_bases_sse2 },
+	{ SIMD_ISA_AVX2, nucleotide_miss_qual_sum_avx2, recal_select_bases_avx2 },
+	{ SIMD_ISA_AVX512, nucleotide_miss_qual_sum_avx512, recal_select_bases_avx512 }
+#endif
+};
+
+static const char *simd_isa_names[SIMD_ISA_NUM] = { "scalar", "sse2", "avx2", "avx512" };
+
+//Detected instruction set, -1 if not detected yet
+static int simd_detected_isa = -1;
+
+/**
+ * Detect CPU features (only once) and select the kernels.
+ */
+int
+simd_init()
+{
+	int isa;
+	const char *forced;
+
+	isa = simd_cpu_isa();
+
+	//Forced instruction set
+	forced = getenv(SIMD_ISA_ENV);
+	if(forced != NULL && forced[0] != '\0')
+	{
+		if(simd_isa_from_name(forced) < 0)
+		{
+			fprintf(stderr, "Warning: unknown instruction set %s=%s, using %s\n", SIMD_ISA_ENV, forced, simd_isa_name(isa));
+		}
+		else if(!simd_isa_supported(simd_isa_from_name(forced)))
+		{
+			fprintf(stderr, "Warning: instruction set %s=%s not supported by this CPU, using %s\n", SIMD_ISA_ENV, forced, simd_isa_name(isa));
+		}
+		else
+		{
+			isa = simd_isa_from_name(forced);
+		}
+	}
+
+	simd_set_isa(isa);
+
+	return isa;
+}
+
+/**
+ * Select the kernels of an instruction set.
+ */
+ERROR_CODE
+simd_set_isa(int isa)
+{
+	if(isa < 0 || isa >= SIMD_ISA_NUM)
+		return SIMD_UNKNOWN_ISA;
+
+	if(!simd_isa_supported(isa))
+		return SIMD_UNSUPPORTED_ISA;
+
+	simd_kernels = simd_isa_kernels[isa];
+
+	return NO_ERROR;
+}
+
+/**
+ * Best instruction set supported by this CPU.
+ */
+int
+simd_cpu_isa()
+{
+	int isa;
+
+	if(simd_detected_isa >= 0)
+		return simd_detected_isa;
+
+	isa = SIMD_ISA_SCALAR;
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2"))
+		isa = SIMD_ISA_SSE2;
+	if(__builtin_cpu_supports("avx2"))
+		isa = SIMD_ISA_AVX2;
+	if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+		isa = SIMD_ISA_AVX512;
+#endif
+
+	simd_detected_isa = isa;
+
+	return isa;
+}
+
+/**
+ * Check if this CPU supports an instruction set.
+ */
+int
+simd_isa_supported(int isa)
+{
+#ifndef SIMD_X86
+	if(isa != SIMD_ISA_SCALAR)
+		return 0;
+#endif
+	return isa >= 0 && isa <= simd_cpu_isa();
+}
+
+/**
+ * Instruction set name.
+ */
+const char *
+simd_isa_name(int isa)
+{
+	if(isa < 0 || isa >= SIMD_ISA_NUM)
+		return "unknown";
+
+	return simd_isa_names[isa];
+}
+
+/**
+ * Instruction set from name.
+ */
+int
+simd_isa_from_name(const char *name)
+{
+	int i;
+
+	assert(name);
+
+	for(i = 0; i < SIMD_ISA_NUM; i++)
+	{
+		if(strcasecmp(name, simd_isa_names[i]) == 0)
+			return i;
+	}
+
+	return -1;
+}
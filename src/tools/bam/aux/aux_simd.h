@@ -8,8 +8,87 @@
 #ifndef AUX_SIMD_H_
 #define AUX_SIMD_H_
 
-#include "aux_library.h"
+#include <stddef.h>
+#include <stdint.h>
 
+#include "aux_common.h"
 
+/***************************
+ * SIMD DISPATCH
+ *
+ * Vectorised kernels are built for every instruction set with target
+ * attributes, and the best one supported by the CPU is selected at run
+ * time by simd_init. Until then the kernels of the instruction set the
+ * binary was built for are used. The environment variable SIMD_ISA_ENV
+ * forces an instruction set (e.g. to benchmark the others).
+ **************************/
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#endif
+
+//Instruction sets
+#define SIMD_ISA_SCALAR		0
+#define SIMD_ISA_SSE2		1
+#define SIMD_ISA_AVX2		2
+#define SIMD_ISA_AVX512		3	//AVX-512F + AVX-512BW
+#define SIMD_ISA_NUM		4
+
+#define SIMD_ISA_ENV		"HPG_SIMD_ISA"
+
+/**
+ * Compare two sequences, missmatches and missmatch qualities summatory (see nucleotide_miss_qual_sum).
+ */
+typedef void (*simd_miss_qual_sum_f)(const char *ref_seq, const char *bam_seq, const char *bam_qual, size_t bam_seq_l,
+		char *comp_res, uint32_t *out_miss_count, uint32_t *out_sum_quals);
+
+/**
+ * Select the bases to count in recalibration (see recal_select_bases).
+ */
+typedef void (*simd_select_bases_f)(const char *seq, const char *quals, const char *mask, size_t seq_l,
+		uint64_t *out_valid, uint64_t *out_bad);
+
+/**
+ * KERNELS TABLE
+ */
+typedef struct {
+	int isa;
+	simd_miss_qual_sum_f nucleotide_miss_qual_sum;
+	simd_select_bases_f recal_select_bases;
+} simd_kernels_t;
+
+extern simd_kernels_t simd_kernels;
+
+/**
+ * Detect CPU features (only once) and select the kernels.
+ * \return Selected instruction set, the best one supported or the one forced in SIMD_ISA_ENV.
+ */
+EXTERNC int simd_init();
+
+/**
+ * Select the kernels of an instruction set.
+ * \param[in] isa Instruction set.
+ */
+EXTERNC ERROR_CODE simd_set_isa(int isa);
+
+/**
+ * Best instruction set supported by this CPU.
+ */
+EXTERNC int simd_cpu_isa();
+
+/**
+ * Check if this CPU supports an instruction set.
+ */
+EXTERNC int simd_isa_supported(int isa);
+
+/**
+ * Instruction set name ("scalar", "sse2", "avx2", "avx512").
+ */
+EXTERNC const char *simd_isa_name(int isa);
+
+/**
+ * Instruction set from name, -1 if unknown.
+ */
+EXTERNC int simd_isa_from_name(const char *name);
 
 #endif /* AUX_SIMD_H_ */
@@ -36,6 +36,26 @@ int recalibrate_recalibrate_processor(bam_fwork_t *fwork, bam_region_t *region);
 void recalibrate_reduce_data(void *dest, void *data);
 void recalibrate_destroy_data(void *data);
 
+/**
+ * Data collection shared data
+ */
+typedef struct {
+	//Cycles of threads data
+	U_CYCLES cycles;
+
+	//Sampled collection, OPTIONAL
+	const recal_sample_t *sample;
+	recal_info_t *sampled;		//Quality counters of all threads, if targets to check
+	double *last_deltas;		//Quality deltas in last check
+	U_BASES next_check;
+} recalibrate_collect_t;
+
+static void recalibrate_collect_init(recalibrate_collect_t *collect, U_CYCLES cycles, const recal_sample_t *sample);
+static void recalibrate_collect_destroy(recalibrate_collect_t *collect);
+static int recalibrate_sample_read(const bam1_t *read, double fraction);
+static int recalibrate_sample_check(recalibrate_collect_t *collect);
+static void recalibrate_sample_bounds(const recal_info_t *data, double *out_error, U_BASES *out_bases);
+
 /***********************************************
  * FRAMEWORK REALIGNER
  **********************************************/
@@ -89,6 +109,9 @@ alig_bam_file(const char *bam_path, const char *ref_path, const char *outbam, co
 	//Destroy wanderer
 	bfwork_destroy(&fwork);
 
+	//Free score buffers
+	bfwork_context_local_scratch_free(&context, alig_scores_buffer_free);
+
 	//Destroy context
 	bfwork_context_destroy(&context);
 
@@ -103,14 +126,16 @@ alig_bam_file(const char *bam_path, const char *ref_path, const char *outbam, co
  * Recalibrate BAM file
  */
 ERROR_CODE
-recal_bam_file(uint8_t flags, const char *bam_path, const char *ref, const char *data_file, const char *info_file, const char *outbam, int cycles, const char *stats_path)
+recal_bam_file(uint8_t flags, const char *bam_path, const char *ref, const char *data_file, const char *info_file, const char *outbam, int cycles, const char *stats_path, const recal_sample_t *sample)
 {
 
 
 	//Data
 	recal_info_t info;
 	U_CYCLES aux_cycles;
-	int cycles_param;
+	recalibrate_collect_t collect;
+	double error;
+	U_BASES bases;
 
 	//Times
 
@@ -136,6 +161,13 @@ recal_bam_file(uint8_t flags, const char *bam_path, const char *ref, const char
 	//Init wandering
 	bfwork_init(&fwork);
 
+	//Sampled collection stops before the end of input, so no output without recalibration
+	if(sample && !(flags & RECALIBRATE_RECALIBRATE) && outbam)
+	{
+		LOG_WARN("Sampled data collection only, no output BAM will be written\n");
+		outbam = NULL;
+	}
+
 	//Configure framework
 	bfwork_configure(&fwork, bam_path, outbam, ref, NULL);
 
@@ -158,13 +190,22 @@ recal_bam_file(uint8_t flags, const char *bam_path, const char *ref, const char
 #endif
 
 		//Set user data
-		cycles_param = cycles;
-		bfwork_context_set_user_data(&collect_context, &cycles_param);
+		recalibrate_collect_init(&collect, cycles, sample);
+		bfwork_context_set_user_data(&collect_context, &collect);
 
 		//Add context for data collection
 		bfwork_add_context(&fwork, &collect_context, FWORK_CONTEXT_SEQUENTIAL);
 
 		printf("Cycles: %d\n",cycles);
+		if(sample)
+		{
+			printf("Sampled collection: %.2f%% of reads", sample->fraction * 100.0);
+			if(sample->qual_bases)
+				printf(", %lu bases per quality", (unsigned long)sample->qual_bases);
+			if(sample->max_error > 0.0)
+				printf(", quality deltas error %.2f", sample->max_error);
+			printf("\n");
+		}
 	}
 
 	//Recalibration is needed?
@@ -212,6 +253,16 @@ recal_bam_file(uint8_t flags, const char *bam_path, const char *ref, const char
 	//Collection last operations
 	if(flags & RECALIBRATE_COLLECT)
 	{
+		//Achieved error bounds
+		if(sample)
+		{
+			recalibrate_sample_bounds(&info, &error, &bases);
+			printf("Sampled collection: %lu bases, quality deltas within +-%.1f (%.0f%% confidence), %lu bases in least sampled quality\n",
+					(unsigned long)info.total_bases, error, SAMPLE_CONFIDENCE * 100.0, (unsigned long)bases);
+			LOG_INFO_F("Sampled collection: %lu bases, quality deltas within +-%.1f (%.0f%% confidence), %lu bases in least sampled quality\n",
+					(unsigned long)info.total_bases, error, SAMPLE_CONFIDENCE * 100.0, (unsigned long)bases);
+		}
+
 		//Save data file
 		if(data_file)
 		{
@@ -236,6 +287,7 @@ recal_bam_file(uint8_t flags, const char *bam_path, const char *ref, const char
 
 		//Destroy context
 		bfwork_context_destroy(&collect_context);
+		recalibrate_collect_destroy(&collect);
 	}
 
 	//Recalibration last operations
@@ -276,7 +328,7 @@ alig_recal_bam_file(const char *bam_path, const char *ref_path, const char *data
 	//Data
 	recal_info_t info;
 	U_CYCLES aux_cycles;
-	int cycles_param;
+	recalibrate_collect_t collect;
 
 	//Times
 
@@ -324,8 +376,8 @@ alig_recal_bam_file(const char *bam_path, const char *ref_path, const char *data
 #endif
 
 	//Set user data
-	cycles_param = cycles;
-	bfwork_context_set_user_data(&realign_context, &cycles_param);
+	recalibrate_collect_init(&collect, cycles, NULL);
+	bfwork_context_set_user_data(&realign_context, &collect);
 	bfwork_context_set_user_data(&recal_context, &info);
 	printf("Cycles: %d\n",cycles);
 
@@ -350,6 +402,7 @@ alig_recal_bam_file(const char *bam_path, const char *ref_path, const char *data
 
 	//Free local data
 	bfwork_context_local_user_data_free(&realign_context, recalibrate_destroy_data);
+	bfwork_context_local_scratch_free(&realign_context, alig_scores_buffer_free);
 	bfwork_context_local_user_data_free(&recal_context, recalibrate_destroy_data);
 
 #ifdef D_TIME_DEBUG
@@ -365,6 +418,7 @@ alig_recal_bam_file(const char *bam_path, const char *ref_path, const char *data
 	//Destroy context
 	bfwork_context_destroy(&realign_context);
 	bfwork_context_destroy(&recal_context);
+	recalibrate_collect_destroy(&collect);
 
 	//Destroy wanderer
 	bfwork_destroy(&fwork);
@@ -457,12 +511,18 @@ realigner_processor(bam_fwork_t *fwork, bam_region_t *region)
 	alig_context_t context;
 	bam1_t **v_reads;
 	size_t v_reads_l;
+	void **scratch;
+	int scratch_l;
 
 	//Create contexts
 	omp_set_lock(&fwork->reference_lock);
 	alig_init(&context, fwork->reference, ALIG_LEFT_ALIGN | ALIG_REFERENCE_PRIORITY);
 	omp_unset_lock(&fwork->reference_lock);
 
+	//Score buffers are kept by the framework between regions
+	bfwork_local_scratch(fwork, &scratch, &scratch_l);
+	alig_set_score_buffers(&context, (alig_scores_buffer_t **)scratch, scratch_l);
+
 	//Load region reads in aligner context
 	v_reads = region->reads;
 	v_reads_l = region->size;
@@ -543,9 +603,22 @@ recalibrate_collect_processor(bam_fwork_t *fwork, bam_region_t *region)
 	int i;
 	recal_data_collect_env_t *collect_env;
 	bam1_t *read;
-	size_t *cycles;
+	recalibrate_collect_t *collect;
+	const recal_sample_t *sample;
 
 	recal_info_t *data;
+	recal_info_t *sampled;
+
+	//Region counters for sampled collection
+	U_BASES qual_bases[MAX_QUALITY - MIN_QUALITY];
+	double qual_miss[MAX_QUALITY - MIN_QUALITY];
+	U_BASES total_bases;
+	double total_miss;
+
+	//Get shared data
+	bfwork_lock_user_data(fwork, (void **)&collect);
+	bfwork_unlock_user_data(fwork);
+	sample = collect->sample;
 
 	//Get data
 	bfwork_local_user_data(fwork, (void **)&data);
@@ -553,16 +626,21 @@ recalibrate_collect_processor(bam_fwork_t *fwork, bam_region_t *region)
 	{
 		//Local data is not initialized
 		data = (recal_info_t *)malloc(sizeof(recal_info_t));
-
-		//Lock cycles
-		bfwork_lock_user_data(fwork, (void **)&cycles);
-		recal_init_info(*cycles, data);
-		bfwork_unlock_user_data(fwork);
+		recal_init_info(collect->cycles, data);
 
 		//Set local data
 		bfwork_local_user_data_set(fwork, data);
 	}
 
+	//Counters before this region (flushed after every region)
+	if(collect->sampled)
+	{
+		memcpy(qual_bases, data->qual_bases, data->num_quals * sizeof(U_BASES));
+		memcpy(qual_miss, data->qual_miss, data->num_quals * sizeof(double));
+		total_bases = data->total_bases;
+		total_miss = data->total_miss;
+	}
+
 	//Initialize get data environment
 	collect_env = (recal_data_collect_env_t *) malloc(sizeof(recal_data_collect_env_t));
 	recal_get_data_init_env(data->num_cycles, collect_env);
@@ -574,6 +652,10 @@ recalibrate_collect_processor(bam_fwork_t *fwork, bam_region_t *region)
 		read = region->reads[i];
 		assert(read);
 
+		//Read not sampled?
+		if(sample && sample->fraction < 1.0 && !recalibrate_sample_read(read, sample->fraction))
+			continue;
+
 		//Get data
 		omp_set_lock(&fwork->reference_lock);
 		recal_get_data_from_bam_alignment(read, fwork->reference, data, collect_env);
@@ -583,6 +665,33 @@ recalibrate_collect_processor(bam_fwork_t *fwork, bam_region_t *region)
 	//Destroy environment
 	recal_get_data_destroy_env(collect_env);
 
+	//Add region counters to all threads ones and check targets
+	if(collect->sampled)
+	{
+		recal_flush_counts(data);
+
+		bfwork_lock_user_data(fwork, (void **)&collect);
+		sampled = collect->sampled;
+		for(i = 0; i < data->num_quals; i++)
+		{
+			sampled->qual_bases[i] += data->qual_bases[i] - qual_bases[i];
+			sampled->qual_miss[i] += data->qual_miss[i] - qual_miss[i];
+		}
+		sampled->total_bases += data->total_bases - total_bases;
+		sampled->total_miss += data->total_miss - total_miss;
+
+		if(sampled->total_bases >= collect->next_check)
+		{
+			collect->next_check = sampled->total_bases + SAMPLE_CHECK_BASES;
+			if(recalibrate_sample_check(collect))
+			{
+				printf("\nSampled collection reached its targets with %lu bases\n", (unsigned long)sampled->total_bases);
+				bfwork_stop(fwork);
+			}
+		}
+		bfwork_unlock_user_data(fwork);
+	}
+
 	return NO_ERROR;
 }
 
@@ -675,3 +784,138 @@ recalibrate_destroy_data(void *data)
 	recal_destroy_info(aux);
 }
 
+/***********************************************
+ * SAMPLED DATA COLLECTION
+ **********************************************/
+
+/**
+ * PRIVATE. Initialize data collection shared data.
+ */
+static void
+recalibrate_collect_init(recalibrate_collect_t *collect, U_CYCLES cycles, const recal_sample_t *sample)
+{
+	assert(collect);
+
+	memset(collect, 0, sizeof(recalibrate_collect_t));
+	collect->cycles = cycles;
+	collect->sample = sample;
+
+	//Targets to check?
+	if(sample && (sample->qual_bases || sample->max_error > 0.0))
+	{
+		//Only quality counters are needed
+		collect->sampled = (recal_info_t *)malloc(sizeof(recal_info_t));
+		recal_init_info(1, collect->sampled);
+		collect->last_deltas = (double *)calloc(collect->sampled->num_quals, sizeof(double));
+		collect->next_check = SAMPLE_CHECK_BASES;
+	}
+}
+
+/**
+ * PRIVATE. Destroy data collection shared data.
+ */
+static void
+recalibrate_collect_destroy(recalibrate_collect_t *collect)
+{
+	assert(collect);
+
+	if(collect->sampled)
+	{
+		recal_destroy_info(collect->sampled);
+		free(collect->sampled);
+		free(collect->last_deltas);
+	}
+}
+
+/**
+ * PRIVATE. Read is in sample, by read name so both mates are sampled.
+ */
+static int
+recalibrate_sample_read(const bam1_t *read, double fraction)
+{
+	const char *name;
+	uint32_t hash;
+
+	//FNV-1a and final mix
+	hash = 2166136261u;
+	for(name = bam1_qname(read); *name; name++)
+	{
+		hash ^= (uint8_t)*name;
+		hash *= 16777619u;
+	}
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+
+	return hash < fraction * 4294967296.0;
+}
+
+/**
+ * PRIVATE. Worst confidence interval half-width of quality deltas and least bases,
+ * of the qualities which are recalibrated and hold some share of bases.
+ */
+static void
+recalibrate_sample_bounds(const recal_info_t *data, double *out_error, U_BASES *out_bases)
+{
+	double errors[MAX_QUALITY - MIN_QUALITY];
+	int i;
+
+	*out_error = 0.0;
+	*out_bases = 0;
+
+	recal_get_qual_errors(data, SAMPLE_CONFIDENCE, errors);
+	for(i = 0; i < data->num_quals; i++)
+	{
+		if(i + data->min_qual <= MIN_QUALITY_TO_STAT
+				|| data->qual_bases[i] == 0
+				|| data->qual_bases[i] < SAMPLE_MIN_QUAL_SHARE * data->total_bases)
+			continue;
+
+		if(errors[i] > *out_error)
+			*out_error = errors[i];
+		if(*out_bases == 0 || data->qual_bases[i] < *out_bases)
+			*out_bases = data->qual_bases[i];
+	}
+}
+
+/**
+ * PRIVATE. Check if sampled collection reached its targets and deltas are stable since last check.
+ * Shared data must be locked.
+ */
+static int
+recalibrate_sample_check(recalibrate_collect_t *collect)
+{
+	recal_info_t *sampled;
+	const recal_sample_t *sample;
+	double error;
+	U_BASES bases;
+	int i, stable;
+
+	sampled = collect->sampled;
+	sample = collect->sample;
+
+	//Current estimation
+	recal_calc_deltas(sampled);
+	recalibrate_sample_bounds(sampled, &error, &bases);
+
+	//Deltas are quality steps, stable if same as last check
+	stable = 1;
+	for(i = 0; i < sampled->num_quals; i++)
+	{
+		if(fabs(sampled->qual_delta[i] - collect->last_deltas[i]) > 0.5)
+			stable = 0;
+		collect->last_deltas[i] = sampled->qual_delta[i];
+	}
+
+	LOG_INFO_F("Sampled %lu bases, quality deltas within +-%.1f, %lu bases in least sampled quality, %s\n",
+			(unsigned long)sampled->total_bases, error, (unsigned long)bases, stable ? "stable" : "not stable");
+
+	if(!stable)
+		return 0;
+	if(sample->max_error > 0.0 && error > sample->max_error)
+		return 0;
+	if(sample->qual_bases && bases < sample->qual_bases)
+		return 0;
+
+	return 1;
+}
@@ -58,8 +58,10 @@ EXTERNC ERROR_CODE alig_bam_file(const char *bam_path, const char *ref_path, con
  * \param[in] outbam Output BAM path. OPTIONAL, if NULL no output will be written.
  * \param[in] cycles Max cycles to recalibrate.
  * \param[in] stats_path Path to timing stats output folder. OPTIONAL, if NULL no timing output will be written.
+ * \param[in] sample Sampled data collection, it stops when the targets are reached (no output if RECALIBRATE_COLLECT only).
+ * 					OPTIONAL, if NULL all reads are collected.
  */
-EXTERNC ERROR_CODE recal_bam_file(uint8_t flags, const char *bam_path, const char *ref_path, const char *data_file, const char *info_file, const char *outbam, int cycles, const char *stats_path);
+EXTERNC ERROR_CODE recal_bam_file(uint8_t flags, const char *bam_path, const char *ref_path, const char *data_file, const char *info_file, const char *outbam, int cycles, const char *stats_path, const recal_sample_t *sample);
 
 /**
  * \brief Realign and recalibrate BAM file
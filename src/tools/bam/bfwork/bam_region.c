@@ -73,6 +73,13 @@ breg_destroy(bam_region_t *region, int free_bam)
 		region->reads = NULL;
 	}
 
+	//Free wanderer data
+	if(region->user_data)
+	{
+		free(region->user_data);
+		region->user_data = NULL;
+	}
+
 	omp_unset_lock(&region->lock);
 
 	//Destroy lock
@@ -80,7 +87,7 @@ breg_destroy(bam_region_t *region, int free_bam)
 }
 
 /*int
-breg_fill(bam_region_t *region, bam_file_t *input_file)
+breg_fill(bam_region_t *region, bam_reader_t *input_file)
 {
 	int free_slots, i, err;
 	bam1_t *read;
@@ -122,7 +129,7 @@ breg_fill(bam_region_t *region, bam_file_t *input_file)
 		//Get first read from file
 		read = bam_init1();
 		assert(read);
-		bytes = bam_read1(input_file->bam_fd, read);
+		bytes = bam_reader_read1(input_file, read);
 
 		//Check
 		if(bytes <= 0)
@@ -160,7 +167,7 @@ breg_fill(bam_region_t *region, bam_file_t *input_file)
 		//Read next bam read
 		read = bam_init1();
 		assert(read);
-		bytes = bam_read1(input_file->bam_fd, read);
+		bytes = bam_reader_read1(input_file, read);
 
 		//Valid read?
 		if(bytes > 0)
@@ -44,6 +44,9 @@ typedef struct {
 	size_t end_pos;
 	int chrom;
 
+	//Wanderer data of this region, a single memory block freed with the region. OPTIONAL
+	void *user_data;
+
 	//Lock
 	omp_lock_t lock;
 	omp_lock_t write_lock;
@@ -55,7 +58,7 @@ typedef struct {
 EXTERNC void breg_init(bam_region_t *region);
 EXTERNC void breg_destroy(bam_region_t *region, int free_bam);
 
-//EXTERNC int breg_fill(bam_region_t *region, bam_file_t *input_file);
+//EXTERNC int breg_fill(bam_region_t *region, bam_reader_t *input_file);
 EXTERNC void breg_write_n(bam_region_t *region, size_t n, bam_file_t *output_file);
 
 //EXTERNC void breg_load_window(bam_region_t *region, size_t init_pos, size_t end_pos, uint8_t filters, bam_region_window_t *window);
@@ -16,15 +16,50 @@
 */
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "bfwork.h"
 
+/**
+ * INPUT OF A WANDERING
+ */
+typedef struct {
+	bam_reader_t *reader;
+
+	//First read of next region
+	bam1_t *last_read;
+	int last_read_bytes;
+
+	//Chunk bounds (coordinate keys), reads before begin are skipped
+	//and the input ends at end
+	uint64_t begin_key;
+	uint64_t end_key;
+} bfwork_input_t;
+
+/**
+ * CHUNKS OF A REGION-PARALLEL RUN
+ */
+typedef struct {
+	bam_index_split_t *splits;
+	size_t chunks_l;
+
+	//Processed regions waiting for previous chunks to be written
+	linked_list_t **pending;
+	uint8_t *done;
+	size_t pending_reads;
+
+	//Chunk being written
+	size_t next;
+
+	omp_lock_t lock;
+} bfwork_chunks_t;
+
 /**
  * STATIC VARS
  */
 //bfwork_obtain_region
-static bam1_t *last_read = NULL;
-static int last_read_bytes = 0;
+static bfwork_input_t main_input;
 
 /**
  * STATIC FUNCTIONS
@@ -42,9 +77,54 @@ static int bfwork_region_insert(bam_fwork_t *fwork, bam_region_t *region);
  * \brief PRIVATE. Wander for a region.
  *
  * \param[in] fwork Target framework.
+ * \param[in] input Input to read from.
  * \param[out] region Region to fill using current context wandering function.
  */
-static int bfwork_obtain_region(bam_fwork_t *fwork, bam_region_t *current_region);
+static int bfwork_obtain_region(bam_fwork_t *fwork, bfwork_input_t *input, bam_region_t *current_region);
+
+/**
+ * \brief PRIVATE. Read next alignment of an input.
+ *
+ * \param[in] input Input to read from.
+ * \param[out] read Alignment read.
+ * \return Bytes read, -1 at the end of input (as bam_read1).
+ */
+static int bfwork_input_read(bfwork_input_t *input, bam1_t *read);
+
+/**
+ * \brief PRIVATE. Remove a temporary BAM file and its index.
+ *
+ * \param[in] bam_file_str Path to BAM file.
+ */
+static void bfwork_remove_bam(const char *bam_file_str);
+
+/**
+ * \brief PRIVATE. Split input BAM in chunks using its index.
+ *
+ * \param[in] bam_file_str Path to sorted BAM file.
+ * \param[out] splits First position of every chunk.
+ * \return Number of chunks, 0 if the input has no usable index.
+ */
+static int bfwork_load_splits(const char *bam_file_str, bam_index_split_t **splits);
+
+/**
+ * \brief PRIVATE. Write a processed region of a chunk, or keep it until previous chunks are written.
+ *
+ * \param[in] fwork Target framework.
+ * \param[in] chunks Chunks of the run.
+ * \param[in] c Chunk of the region.
+ * \param[in] region Processed region, freed when written.
+ */
+static void bfwork_chunk_output(bam_fwork_t *fwork, bfwork_chunks_t *chunks, size_t c, bam_region_t *region);
+
+/**
+ * \brief PRIVATE. Set a chunk as processed and write the next ones in turn.
+ *
+ * \param[in] fwork Target framework.
+ * \param[in] chunks Chunks of the run.
+ * \param[in] c Processed chunk.
+ */
+static void bfwork_chunk_done(bam_fwork_t *fwork, bfwork_chunks_t *chunks, size_t c);
 
 /**
  * Initialize empty BAM framework data structure.
@@ -164,11 +244,12 @@ bfwork_add_context(bam_fwork_t *fwork, bfwork_context_t *context, uint8_t flags)
 	{
 		//Not supported yet
 		LOG_WARN("FWORK_CONTEXT_QUEUE_PARALLEL is not supported yet, changing to FWORK_CONTEXT_QUEUE_SEQUENTIAL\n");
-		flags = FWORK_CONTEXT_SEQUENTIAL;
+		flags = (flags & ~FWORK_CONTEXT_PARALLEL) | FWORK_CONTEXT_SEQUENTIAL;
 	}
 	if(flags & FWORK_CONTEXT_SEQUENTIAL)
 	{
 		//Add to sequential execution queue
+		context->flags = flags;
 		fwork->v_context[fwork->v_context_l] = context;
 		fwork->v_context_l++;
 	}
@@ -206,7 +287,7 @@ bfwork_run_sequential(bam_fwork_t *fwork)
 #ifdef D_TIME_DEBUG
 		times = omp_get_wtime();
 #endif
-		err = bfwork_obtain_region(fwork, region);
+		err = bfwork_obtain_region(fwork, &main_input, region);
 #ifdef D_TIME_DEBUG
 		times = omp_get_wtime() - times;
 		if(region->size != 0)
@@ -331,7 +412,7 @@ bfwork_run_threaded(bam_fwork_t *fwork)
 #ifdef D_TIME_DEBUG
 					times = omp_get_wtime();
 #endif
-					err = bfwork_obtain_region(fwork, region);
+					err = bfwork_obtain_region(fwork, &main_input, region);
 #ifdef D_TIME_DEBUG
 					times = omp_get_wtime() - times;
 					omp_set_lock(&region->lock);
@@ -502,6 +583,169 @@ bfwork_run_threaded(bam_fwork_t *fwork)
 	return NO_ERROR;
 }
 
+static int
+bfwork_run_chunks(bam_fwork_t *fwork, const char *input_str, bam_index_split_t *splits, size_t splits_l)
+{
+	int err;
+	size_t c, i, r, stride, reads;
+	size_t *order;
+	bfwork_chunks_t chunks;
+
+	printf("Running in region-parallel mode with %d threads and %lu chunks\n", omp_get_max_threads(), splits_l);
+
+	//Init chunks
+	memset(&chunks, 0, sizeof(bfwork_chunks_t));
+	chunks.splits = splits;
+	chunks.chunks_l = splits_l;
+	chunks.pending = (linked_list_t **)malloc(splits_l * sizeof(linked_list_t *));
+	chunks.done = (uint8_t *)calloc(splits_l, sizeof(uint8_t));
+	for(c = 0; c < splits_l; c++)
+	{
+		chunks.pending[c] = linked_list_new(COLLECTION_MODE_ASYNCHRONIZED);
+	}
+	omp_init_lock(&chunks.lock);
+
+	//Chunks are taken in order to write them, without output they are taken
+	//across the genome so a stopped run has seen all of it
+	order = (size_t *)malloc(splits_l * sizeof(size_t));
+	stride = 1;
+	if(fwork->output_file == NULL)
+	{
+		while(stride * stride < splits_l)
+			stride++;
+	}
+	for(r = 0, i = 0; r < stride; r++)
+	{
+		for(c = r; c < splits_l; c += stride)
+		{
+			order[i++] = c;
+		}
+	}
+
+	err = NO_ERROR;
+	reads = 0;
+
+	#pragma omp parallel private(c, i)
+	{
+		int j, ret;
+		size_t pf_l;
+		double times;
+		bam_region_t *region;
+		bfwork_input_t input;
+
+		//Every thread reads its own chunks
+		memset(&input, 0, sizeof(bfwork_input_t));
+		input.reader = bam_reader_new(input_str, 1);
+		if(input.reader == NULL)
+		{
+			LOG_ERROR_F("Failed to open BAM \"%s\"\n", input_str);
+		}
+		pf_l = fwork->context->processing_f_l;
+
+		//Chunks are taken in order, so the chunk in turn for writing is always being processed
+		#pragma omp for schedule(dynamic, 1)
+		for(i = 0; i < splits_l; i++)
+		{
+			c = order[i];
+
+			//Seek chunk start
+			input.last_read = NULL;
+			input.begin_key = bam_sort_coord_key(splits[c].tid, splits[c].pos, 0);
+			input.end_key = (c + 1 < splits_l) ? bam_sort_coord_key(splits[c + 1].tid, splits[c + 1].pos, 0) : UINT64_MAX;
+			ret = WANDER_READ_TRUNCATED;
+			if(input.reader != NULL && bam_reader_seek(input.reader, splits[c].voffset) == 0)
+			{
+				ret = WANDER_REGION_CHANGED;
+			}
+
+			while(ret == WANDER_REGION_CHANGED)
+			{
+				//Too many regions waiting for previous chunks?
+				omp_set_lock(&chunks.lock);
+				while(c != chunks.next && chunks.pending_reads >= FWORK_REGIONS_MAX * BAM_REGION_DEFAULT_SIZE)
+				{
+					omp_unset_lock(&chunks.lock);
+					usleep(1000);
+					omp_set_lock(&chunks.lock);
+				}
+				omp_unset_lock(&chunks.lock);
+
+				//Create new current region
+				region = (bam_region_t *)malloc(sizeof(bam_region_t));
+				breg_init(region);
+
+				//Fill region
+				ret = bfwork_obtain_region(fwork, &input, region);
+				if(ret != WANDER_REGION_CHANGED && ret != WANDER_READ_EOF)
+				{
+					breg_destroy(region, 1);
+					free(region);
+					break;
+				}
+
+				//Process region
+#ifdef D_TIME_DEBUG
+				times = omp_get_wtime();
+#endif
+				for(j = 0; j < pf_l; j++)
+				{
+					fwork->context->processing_f[j](fwork, region);
+				}
+#ifdef D_TIME_DEBUG
+				times = omp_get_wtime() - times;
+				omp_set_lock(&chunks.lock);
+				if(fwork->context->time_stats)
+				if(region->size != 0)
+					time_add_time_slot(D_FWORK_PROC_FUNC, fwork->context->time_stats, times / (double)region->size);
+				omp_unset_lock(&chunks.lock);
+#endif
+
+				#pragma omp atomic
+				reads += region->size;
+
+				//Write in order
+				bfwork_chunk_output(fwork, &chunks, c, region);
+			}
+
+			if(ret != WANDER_READ_EOF)
+			{
+				if(ret == WANDER_READ_TRUNCATED)
+				{
+					LOG_WARN_F("Readed truncated read in chunk %lu\n", c);
+				}
+				else
+				{
+					LOG_ERROR_F("Failed to read next region in chunk %lu, error code: %d\n", c, ret);
+				}
+				#pragma omp critical
+				err = ret;
+			}
+
+			//Chunk processed, even on error, so next chunks can be written
+			bfwork_chunk_done(fwork, &chunks, c);
+			printf("Reads processed: %lu\r", reads);
+		}
+
+		//Free reader
+		bam_reader_free(input.reader);
+	}
+
+	//Lineskip
+	printf("\n");
+
+	//Free
+	for(c = 0; c < splits_l; c++)
+	{
+		linked_list_free(chunks.pending[c], NULL);
+	}
+	free(chunks.pending);
+	free(chunks.done);
+	free(order);
+	omp_destroy_lock(&chunks.lock);
+
+	return err;
+}
+
 /**
  * Run framework contexts.
  */
@@ -510,6 +754,9 @@ bfwork_run(bam_fwork_t *fwork)
 {
 	int err = 0, c;
 	double times;
+	const char *input_str;
+	bam_index_split_t *splits;
+	int splits_l;
 
 
 	assert(fwork);
@@ -557,6 +804,7 @@ bfwork_run(bam_fwork_t *fwork)
 		//Select next context
 		fwork->context = fwork->v_context[c];
 		assert(fwork->context);
+		fwork->stop = 0;
 
 #ifdef D_TIME_DEBUG
 		times = omp_get_wtime();
@@ -569,7 +817,8 @@ bfwork_run(bam_fwork_t *fwork)
 			{
 				//Open initial input file
 				printf("Opening BAM from \"%s\" ...\n", fwork->input_file_str);
-				fwork->input_file = bam_fopen(fwork->input_file_str);
+				input_str = fwork->input_file_str;
+				fwork->input_file = bam_reader_new(input_str, omp_get_max_threads());
 				assert(fwork->input_file);
 				printf("BAM opened!...\n");
 			}
@@ -577,10 +826,16 @@ bfwork_run(bam_fwork_t *fwork)
 			{
 				//Open last context output
 				printf("Opening intermediate BAM from \"%s\" ...\n", fwork->last_temp_file_str);
-				fwork->input_file = bam_fopen(fwork->last_temp_file_str);
+				input_str = fwork->last_temp_file_str;
+				fwork->input_file = bam_reader_new(input_str, omp_get_max_threads());
 				assert(fwork->input_file);
 				printf("Intermediate BAM opened!...\n");
 			}
+
+			//Wander from the beginning
+			memset(&main_input, 0, sizeof(bfwork_input_t));
+			main_input.reader = fwork->input_file;
+			main_input.end_key = UINT64_MAX;
 		}
 
 		//Create new output bam if last context
@@ -617,7 +872,7 @@ bfwork_run(bam_fwork_t *fwork)
 		if(fwork->context->output_file_str != NULL)
 		{
 			printf("Creating new intermediate bam file in \"%s\"...\n", fwork->context->output_file_str);
-			fwork->output_file = bam_fopen_mode(fwork->context->output_file_str, fwork->input_file->bam_header_p, "w");
+			fwork->output_file = bam_fopen_mode(fwork->context->output_file_str, fwork->input_file->header, "w");
 			assert(fwork->output_file);
 			bam_fwrite_header(fwork->output_file->bam_header_p, fwork->output_file);
 			fwork->output_file->bam_header_p = NULL;
@@ -645,7 +900,19 @@ bfwork_run(bam_fwork_t *fwork)
 #endif
 
 		//Run this context
-		if(omp_get_max_threads() > 1)
+		splits_l = 0;
+		splits = NULL;
+		if(omp_get_max_threads() > 1 && !(fwork->context->flags & FWORK_CONTEXT_ORDERED))
+		{
+			//Split input in chunks by the index
+			splits_l = bfwork_load_splits(input_str, &splits);
+		}
+		if(splits_l > 1)
+		{
+			//Run in region-parallel mode
+			err = bfwork_run_chunks(fwork, input_str, splits, splits_l);
+		}
+		else if(omp_get_max_threads() > 1)
 		{
 			//Run in multithreaded mode
 			err = bfwork_run_threaded(fwork);
@@ -671,10 +938,12 @@ bfwork_run(bam_fwork_t *fwork)
 
 		//Close input BAM
 		printf("\nClosing BAM file...\n");
-		bam_fclose(fwork->input_file);
+		bam_reader_free(fwork->input_file);
 		fwork->input_file = NULL;
 		printf("BAM closed.\n");
 
+		free(splits);
+
 		//Close output file
 		if(fwork->output_file != NULL)
 		{
@@ -682,6 +951,15 @@ bfwork_run(bam_fwork_t *fwork)
 			bam_fclose(fwork->output_file);
 			fwork->output_file = NULL;
 			printf("BAM closed.\n");
+
+			//Index intermediate output so next context can run by regions (if still sorted)
+			if(c < fwork->v_context_l - 1 && omp_get_max_threads() > 1)
+			{
+				if(bam_index_build(fwork->context->output_file_str, NULL, BAM_INDEX_BAI, 0, omp_get_max_threads()) < 0)
+				{
+					LOG_INFO_F("Intermediate BAM \"%s\" not indexed, it is not sorted\n", fwork->context->output_file_str);
+				}
+			}
 		}
 
 		//Remove last temporary file
@@ -689,7 +967,7 @@ bfwork_run(bam_fwork_t *fwork)
 		{
 			//Delete file
 			printf("Deleting %s...\n", fwork->last_temp_file_str);
-			remove(fwork->last_temp_file_str);
+			bfwork_remove_bam(fwork->last_temp_file_str);
 			fwork->last_temp_file_str = NULL;
 			fwork->erase_tmp = 0;
 		}
@@ -712,7 +990,7 @@ bfwork_run(bam_fwork_t *fwork)
 	{
 		//Delete file
 		printf("Deleting %s...\n", fwork->last_temp_file_str);
-		remove(fwork->last_temp_file_str);
+		bfwork_remove_bam(fwork->last_temp_file_str);
 	}
 
 	//Close reference
@@ -731,6 +1009,17 @@ bfwork_run(bam_fwork_t *fwork)
 	return err;
 }
 
+/**
+ * Stop running context.
+ */
+void
+bfwork_stop(bam_fwork_t *fwork)
+{
+	assert(fwork);
+
+	fwork->stop = 1;
+}
+
 /**
  * WANDERING CONTEXT OPERATIONS
  */
@@ -754,6 +1043,9 @@ bfwork_context_init(bfwork_context_t *context, wanderer_function wf, processor_f
 	threads = omp_get_max_threads();
 	context->local_user_data = (void **)malloc(threads * sizeof(void*));
 	memset(context->local_user_data, 0, threads * sizeof(void*));
+	context->local_scratch = (void **)malloc(threads * sizeof(void*));
+	memset(context->local_scratch, 0, threads * sizeof(void*));
+	context->local_scratch_l = threads;
 
 	//Assign functions
 	context->wander_f = wf;
@@ -777,6 +1069,8 @@ bfwork_context_destroy(bfwork_context_t *context)
 	//Free
 	if(context->output_file_str)
 		free(context->output_file_str);
+	if(context->local_scratch)
+		free(context->local_scratch);
 
 	//Destroy locks
 	omp_destroy_lock(&context->user_data_lock);
@@ -1086,25 +1380,36 @@ bfwork_region_insert(bam_fwork_t *fwork, bam_region_t *region)
  * PRIVATE. Wander for a region.
  */
 static inline int
-bfwork_obtain_region(bam_fwork_t *fwork, bam_region_t *region)
+bfwork_obtain_region(bam_fwork_t *fwork, bfwork_input_t *input, bam_region_t *region)
 {
 	int err, bytes;
 	bam1_t *read;
 	double times;
 
+	//Context stopped, no more input
+	if(fwork->stop)
+	{
+		if(input->last_read != NULL)
+		{
+			bam_destroy1(input->last_read);
+			input->last_read = NULL;
+		}
+		return WANDER_READ_EOF;
+	}
+
 	//Get first read
-	if(last_read != NULL)
+	if(input->last_read != NULL)
 	{
-		read = last_read;
-		bytes = last_read_bytes;
-		last_read = NULL;
+		read = input->last_read;
+		bytes = input->last_read_bytes;
+		input->last_read = NULL;
 	}
 	else
 	{
 		//Get first read from file
 		read = bam_init1();
 		assert(read);
-		bytes = bam_read1(fwork->input_file->bam_fd, read);
+		bytes = bfwork_input_read(input, read);
 	}
 
 	//Iterate reads
@@ -1143,13 +1448,13 @@ bfwork_obtain_region(bam_fwork_t *fwork, bam_region_t *region)
 			//Get next read from file
 			read = bam_init1();
 			assert(read);
-			bytes = bam_read1(fwork->input_file->bam_fd, read);
+			bytes = bfwork_input_read(input, read);
 			break;
 
 		case WANDER_REGION_CHANGED:
 			//The region have changed
-			last_read = read;
-			last_read_bytes = bytes;
+			input->last_read = read;
+			input->last_read_bytes = bytes;
 			return err;
 
 		default:
@@ -1178,3 +1483,155 @@ bfwork_obtain_region(bam_fwork_t *fwork, bam_region_t *region)
 
 	return NO_ERROR;
 }
+
+/**
+ * PRIVATE. Read next alignment of an input.
+ */
+static inline int
+bfwork_input_read(bfwork_input_t *input, bam1_t *read)
+{
+	int bytes;
+	uint64_t key;
+
+	do
+	{
+		bytes = bam_reader_read1(input->reader, read);
+		if(bytes <= 0)
+			return bytes;
+
+		key = bam_sort_coord_key(read->core.tid, read->core.pos, 0);
+	}
+	while(key < input->begin_key);	//Read of previous chunk
+
+	//Read of next chunk?
+	if(key >= input->end_key)
+		return -1;
+
+	return bytes;
+}
+
+/**
+ * PRIVATE. Remove a temporary BAM file and its index.
+ */
+static void
+bfwork_remove_bam(const char *bam_file_str)
+{
+	char index_str[strlen(bam_file_str) + 5];
+
+	remove(bam_file_str);
+
+	//Remove index if any
+	bam_index_filename(bam_file_str, BAM_INDEX_BAI, index_str);
+	remove(index_str);
+	bam_index_filename(bam_file_str, BAM_INDEX_CSI, index_str);
+	remove(index_str);
+}
+
+/**
+ * PRIVATE. Split input BAM in chunks using its index.
+ */
+static int
+bfwork_load_splits(const char *bam_file_str, bam_index_split_t **splits)
+{
+	int format, splits_l;
+	char index_str[strlen(bam_file_str) + 5];
+	struct stat bam_stat, index_stat;
+
+	assert(bam_file_str);
+	assert(splits);
+
+	if(stat(bam_file_str, &bam_stat))
+		return 0;
+
+	//Look for BAI or CSI index
+	for(format = BAM_INDEX_BAI; format <= BAM_INDEX_CSI; format++)
+	{
+		bam_index_filename(bam_file_str, format, index_str);
+		if(stat(index_str, &index_stat) == 0)
+			break;
+	}
+	if(format > BAM_INDEX_CSI)
+	{
+		LOG_INFO_F("No index found for \"%s\", regions will be read by a single thread\n", bam_file_str);
+		return 0;
+	}
+
+	//Index older than BAM?
+	if(index_stat.st_mtime < bam_stat.st_mtime)
+	{
+		LOG_WARN_F("Index \"%s\" is older than BAM file, ignoring it\n", index_str);
+		return 0;
+	}
+
+	//Load splits
+	splits_l = bam_index_load_splits(index_str, omp_get_max_threads() * FWORK_CHUNKS_PER_THREAD, splits);
+	if(splits_l < 0)
+	{
+		LOG_WARN_F("Failed to load index \"%s\", ignoring it\n", index_str);
+		return 0;
+	}
+
+	return splits_l;
+}
+
+/**
+ * PRIVATE. Write all pending regions of a chunk.
+ */
+static void
+bfwork_chunk_flush(bam_fwork_t *fwork, bfwork_chunks_t *chunks, size_t c)
+{
+	bam_region_t *region;
+
+	while((region = linked_list_remove_first(chunks->pending[c])) != NULL)
+	{
+		chunks->pending_reads -= region->size;
+		breg_write_n(region, region->size, fwork->output_file);
+		breg_destroy(region, 1);
+		free(region);
+	}
+}
+
+/**
+ * PRIVATE. Write a processed region of a chunk, or keep it until previous chunks are written.
+ */
+static void
+bfwork_chunk_output(bam_fwork_t *fwork, bfwork_chunks_t *chunks, size_t c, bam_region_t *region)
+{
+	omp_set_lock(&chunks->lock);
+
+	if(c == chunks->next || fwork->output_file == NULL)
+	{
+		//Chunk in turn or no output, write now
+		breg_write_n(region, region->size, fwork->output_file);
+		breg_destroy(region, 1);
+		free(region);
+	}
+	else
+	{
+		//Wait for previous chunks
+		chunks->pending_reads += region->size;
+		linked_list_insert_last(region, chunks->pending[c]);
+	}
+
+	omp_unset_lock(&chunks->lock);
+}
+
+/**
+ * PRIVATE. Set a chunk as processed and write the next ones in turn.
+ */
+static void
+bfwork_chunk_done(bam_fwork_t *fwork, bfwork_chunks_t *chunks, size_t c)
+{
+	omp_set_lock(&chunks->lock);
+
+	chunks->done[c] = 1;
+	while(chunks->next < chunks->chunks_l && chunks->done[chunks->next])
+	{
+		//Next chunk in turn
+		chunks->next++;
+		if(chunks->next < chunks->chunks_l)
+			bfwork_chunk_flush(fwork, chunks, chunks->next);
+	}
+
+	omp_unset_lock(&chunks->lock);
+}
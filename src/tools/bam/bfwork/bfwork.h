@@ -38,12 +38,16 @@
 //CONTEXT EXECUTION
 #define FWORK_CONTEXT_SEQUENTIAL	0x01
 #define FWORK_CONTEXT_PARALLEL 0x02
+#define FWORK_CONTEXT_ORDERED	0x04	//Regions read in input order by one thread, for wanderers keeping state between reads
 
 //FIXED SIZES
 #define FWORK_REGIONS_MAX 1000
 #define FWORK_CONTEXT_MAX 	16
 #define FWORK_PROC_FUNC_MAX 	16
 
+//REGION-PARALLEL EXECUTION
+#define FWORK_CHUNKS_PER_THREAD	8
+
 //ALIGNMENTS FILTERS
 #define FILTER_ZERO_QUAL 1
 #define FILTER_DIFF_MATE_CHROM 2
@@ -76,6 +80,9 @@ typedef struct {
 	reducer_function reduce;
 	void *reduce_dest;
 
+	//Execution flags
+	uint8_t flags;
+
 	//Intermediate output
 	char *output_file_str;
 	uint8_t output_temp;
@@ -85,6 +92,10 @@ typedef struct {
 	omp_lock_t user_data_lock;
 	void **local_user_data;
 
+	//Processing buffers, one per thread, kept between regions
+	void **local_scratch;
+	int local_scratch_l;
+
 	//Timing
 	p_timestats time_stats;
 	char *tag;
@@ -100,7 +111,7 @@ typedef struct {
 	char *reference_str;
 	char *last_temp_file_str;
 	int erase_tmp;
-	bam_file_t *input_file;
+	bam_reader_t *input_file;
 	bam_file_t *output_file;
 	genome_t *reference;
 	omp_lock_t output_file_lock;
@@ -115,6 +126,9 @@ typedef struct {
 	//Current wandering context
 	bfwork_context_t *context;
 
+	//No more regions are read in current context (see bfwork_stop)
+	volatile int stop;
+
 	//Contexts
 	bfwork_context_t *v_context[FWORK_CONTEXT_MAX];
 	size_t v_context_l;
@@ -155,16 +169,30 @@ EXTERNC int bfwork_configure(bam_fwork_t *fwork, const char *in_file, const char
  * \param[in] fwork Framework to add context.
  * \param[in] context Context to be used in framework.
  * \param[in] flags Specify execution queue for this context. Can be FWORK_CONTEXT_SEQUENTIAL or FWORK_CONTEXT_PARALLEL.
+ * 					With FWORK_CONTEXT_ORDERED the input is never split in chunks, so the wanderer sees every read in input order.
  */
 EXTERNC int bfwork_add_context(bam_fwork_t *fwork, bfwork_context_t *context, uint8_t flags);
 
 /**
  * \brief Run framework contexts.
+ * With several threads and an index of the input BAM (BAI or CSI, e.g. from 'hpg-bam index'),
+ * the input is split in chunks that every thread reads and processes on its own,
+ * and regions are written in input order. Without index (or with FWORK_CONTEXT_ORDERED contexts), one thread reads the regions.
  *
  * \param[in] fwork Framework to run.
  */
 EXTERNC int bfwork_run(bam_fwork_t *fwork);
 
+/**
+ * \brief Stop running context, to be used in processing functions.
+ * No more regions are read and the ones being processed end normally. Reads not read
+ * are not written, so only for contexts without output (e.g. sampled data collection).
+ * Without output, regions of an index split input are taken across the whole genome.
+ *
+ * \param[in] fwork Framework running.
+ */
+EXTERNC void bfwork_stop(bam_fwork_t *fwork);
+
 /**
  * WANDERING CONTEXT OPERATIONS
  */
@@ -270,6 +298,27 @@ static int bfwork_context_local_user_data_reduce(bfwork_context_t *context, void
  */
 static int bfwork_context_local_user_data_free(bfwork_context_t *context, void (*cb_free)(void *));
 
+/**
+ * \brief Get the processing buffers of every thread in current context of the framework.
+ * The slots are indexed by thread number and outlive the regions, so a processing function
+ * can reuse its buffers (and the tasks it spawns can use the slot of the thread running them).
+ * A thread must only use its own slot.
+ *
+ * \param[in] fwork Target framework which contains current context.
+ * \param[out] scratch Vector of thread slots.
+ * \param[out] scratch_l Number of slots.
+ */
+static int bfwork_local_scratch(bam_fwork_t *fwork, void ***scratch, int *scratch_l);
+
+/**
+ * \brief Free all threads processing buffers using custom function.
+ * 'cb_free' must take as argument a thread buffer that must be free.
+ *
+ * \param[in] context Target context to destroy its threads buffers.
+ * \param[in] cb_free Callback free function. OPTIONAL, set NULL to only use default free.
+ */
+static int bfwork_context_local_scratch_free(bfwork_context_t *context, void (*cb_free)(void *));
+
 /**
  * TIMING
  */
@@ -465,6 +514,58 @@ bfwork_context_local_user_data_free(bfwork_context_t *context, void (*cb_free)(v
 	return NO_ERROR;
 }
 
+/**
+ * Get the processing buffers of every thread in current context of the framework.
+ */
+static inline int
+bfwork_local_scratch(bam_fwork_t *fwork, void ***scratch, int *scratch_l)
+{
+	assert(fwork);
+	assert(scratch);
+	assert(scratch_l);
+
+	//Get slots
+	*scratch = fwork->context->local_scratch;
+	*scratch_l = fwork->context->local_scratch_l;
+
+	return NO_ERROR;
+}
+
+/**
+ * Free all threads processing buffers using custom function.
+ */
+static inline int
+bfwork_context_local_scratch_free(bfwork_context_t *context, void (*cb_free)(void *))
+{
+	int i;
+	void *data;
+
+	assert(context);
+
+	//Iterate buffers
+	for(i = 0; i < context->local_scratch_l; i++)
+	{
+		//Get next buffer
+		data = context->local_scratch[i];
+
+		//Free if buffer exists
+		if(data != NULL)
+		{
+			//Callback
+			if(cb_free != NULL)
+			{
+				cb_free(data);
+			}
+
+			//Free memory
+			free(data);
+			context->local_scratch[i] = NULL;
+		}
+	}
+
+	return NO_ERROR;
+}
+
 /**
  * Filter a read using input filters.
  */
@@ -152,6 +152,95 @@ region_table_t *build_region_table(char *bam_filename, char *by_string,
   return region_table;
 }
 
+//--------------------------------------------------------------------
+
+void add_index_region(int tid, int beg, int end, bam_index_region_t **regions,
+		      int *num_regions, int *max_regions) {
+  if (*num_regions == *max_regions) {
+    *max_regions = (*max_regions ? 2 * *max_regions : 64);
+    *regions = (bam_index_region_t *) realloc(*regions, *max_regions * sizeof(bam_index_region_t));
+  }
+  (*regions)[*num_regions].tid = tid;
+  (*regions)[*num_regions].beg = beg;
+  (*regions)[*num_regions].end = end;
+  (*num_regions)++;
+}
+
+//--------------------------------------------------------------------
+
+int bam_reader_set_regions(bam_reader_t *reader, char *bam_filename, 
+			   char *by_string, char *by_gff_file) {
+  char index_filename[strlen(bam_filename) + 5];
+  if (bam_index_find(bam_filename, index_filename) != 0) {
+    LOG_INFO_F("BAM file %s not indexed, the whole file is read to filter the regions\n", bam_filename);
+    return -1;
+  }
+
+  bam_header_t *header = reader->header;
+  bam_index_region_t *regions = NULL;
+  int num_regions = 0, max_regions = 0;
+  int tid, beg, end, ok = 1;
+
+  if (by_string) {
+    // chromosome[:start[-end]] separated by commas, 1-based positions
+    char *list = strdup(by_string), *saveptr, *colon;
+    for (char *token = strtok_r(list, ",", &saveptr); token && ok; 
+	 token = strtok_r(NULL, ",", &saveptr)) {
+      if ((colon = strchr(token, ':'))) *colon = '\0';
+      if ((tid = bam_get_tid(header, token)) < 0) {
+	LOG_WARN_F("Region chromosome %s not found in the BAM header\n", token);
+	continue;
+      }
+      beg = 0;
+      end = header->target_len[tid];
+      if (colon) {
+	if (sscanf(colon + 1, "%d-%d", &beg, &end) == 1) {
+	  end = beg;
+	}
+	beg--;
+	ok = (beg >= 0 && end > beg);
+      }
+      if (ok) add_index_region(tid, beg, end, &regions, &num_regions, &max_regions);
+    }
+    free(list);
+  } else if (by_gff_file) {
+    // seqname, source, feature, start, end... 1-based positions
+    FILE *f = fopen(by_gff_file, "r");
+    char line[4096], seqname[1024];
+    ok = (f != NULL);
+    while (ok && fgets(line, sizeof(line), f)) {
+      if (line[0] == '#' || line[0] == '\n') continue;
+      if (sscanf(line, "%1023[^\t]\t%*[^\t]\t%*[^\t]\t%d\t%d", seqname, &beg, &end) != 3) {
+	ok = 0;
+      } else if ((tid = bam_get_tid(header, seqname)) >= 0) {
+	add_index_region(tid, beg - 1, end, &regions, &num_regions, &max_regions);
+      }
+    }
+    if (f) fclose(f);
+  }
+
+  if (!ok) {
+    LOG_WARN("Regions could not be read for the BAM index, the whole file is read to filter them\n");
+    if (regions) free(regions);
+    return -1;
+  }
+
+  bam_index_chunk_t *chunks;
+  int num_chunks = bam_index_load_chunks(index_filename, regions, num_regions, &chunks);
+  if (regions) free(regions);
+  if (num_chunks < 0) {
+    LOG_WARN_F("Could not load the BAM index %s, the whole file is read to filter the regions\n", index_filename);
+    return -1;
+  }
+
+  if (bam_reader_set_chunks(reader, chunks, num_chunks) != 0) {
+    LOG_FATAL_F("Could not seek the regions in the BAM file %s\n", bam_filename);
+  }
+
+  LOG_INFO_F("Regions read through the BAM index %s (%i chunks)\n", index_filename, num_chunks);
+  return num_chunks;
+}
+
 //--------------------------------------------------------------------
 //--------------------------------------------------------------------
 
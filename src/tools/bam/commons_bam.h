@@ -18,6 +18,8 @@
 #include "bioformats/features/region/region_table_utils.h"
 #include "bioformats/bam/bam_file.h"
 
+#include "aux/aux_bam_reader.h"
+
 //------------------------------------------------------------------------
 
 #define NO_VALUE       -1
@@ -38,6 +40,15 @@ int parse_range(int *min, int *max, char *range, char *msg);
 region_table_t *build_region_table(char *bam_filename, char *by_string, 
 				   char *by_gff_file);
 
+// restricts the reader to the index chunks of the regions (from a
+// string or a GFF file) when the BAM file has an index (.bai or .csi),
+// the reads still have to be filtered by the region table since the
+// chunks may hold reads out of the regions
+//
+// returns the number of chunks, -1 if the whole file has to be read
+int bam_reader_set_regions(bam_reader_t *reader, char *bam_filename, 
+			   char *by_string, char *by_gff_file);
+
 #endif	/*  COMMONS_BAM_H  */
 
 //------------------------------------------------------------------------
@@ -0,0 +1,694 @@
+#include "depth_bam.h"
+
+//------------------------------------------------------------------------
+
+// aligned block of a read, [beg, end)
+typedef struct depth_block {
+  uint32_t beg;
+  uint32_t end;
+} depth_block_t;
+
+typedef struct depth_target {
+  int32_t tid;
+  uint32_t beg;
+  uint32_t end;
+  uint32_t max_end;	// max end of the targets of the reference up to this one
+  char *name;
+} depth_target_t;
+
+// BED targets sorted by reference and start
+typedef struct depth_targets {
+  int num;
+  int max;
+  depth_target_t *targets;
+
+  // targets of every reference: first and number
+  int *ref_first;
+  int *ref_num;
+} depth_targets_t;
+
+typedef struct depth_counters {
+  int num_refs;
+  int num_targets;
+  int num_thresholds;
+  int max_depth;
+
+  // positions by depth, bin 0 is filled when reporting
+  uint64_t *histogram;
+
+  // by reference: sum of depths, covered positions and positions by threshold
+  uint64_t *ref_bases;
+  uint64_t *ref_covered;
+  uint64_t *ref_breadth;
+
+  // by target: sum of depths and positions by threshold
+  uint64_t *target_bases;
+  uint64_t *target_breadth;
+
+  // difference array (then depth) of the region being processed
+  int32_t *depth;
+  size_t max_depth_len;
+} depth_counters_t;
+
+// blocks of previous regions that reach the positions of a region,
+// allocated in one block as it is freed with the region
+typedef struct depth_region {
+  int32_t tid;
+  uint32_t beg;
+  uint32_t end;		// UINT32_MAX up to the end of the reference
+  size_t num_blocks;
+  depth_block_t blocks[];
+} depth_region_t;
+
+typedef struct depth_data {
+  const depth_options_t *opts;
+  const bam_header_t *header;
+  const depth_targets_t *targets;
+
+  // wanderer state, only used by the thread reading the regions
+  int32_t last_tid;
+  int32_t last_pos;
+  int32_t active_tid;
+  depth_block_t *active;
+  size_t num_active;
+  size_t max_active;
+
+  uint64_t num_reads;
+  uint64_t num_filtered;
+} depth_data_t;
+
+//------------------------------------------------------------------------
+// counters
+//------------------------------------------------------------------------
+
+static void counters_init(depth_counters_t *counters, int num_refs, int num_targets,
+			  int num_thresholds, int max_depth) {
+  memset(counters, 0, sizeof(depth_counters_t));
+  counters->num_refs = num_refs;
+  counters->num_targets = num_targets;
+  counters->num_thresholds = num_thresholds;
+  counters->max_depth = max_depth;
+
+  counters->histogram = (uint64_t *) calloc(max_depth + 1, sizeof(uint64_t));
+  counters->ref_bases = (uint64_t *) calloc(num_refs, sizeof(uint64_t));
+  counters->ref_covered = (uint64_t *) calloc(num_refs, sizeof(uint64_t));
+  counters->ref_breadth = (uint64_t *) calloc((size_t) num_refs * num_thresholds, sizeof(uint64_t));
+  if (num_targets) {
+    counters->target_bases = (uint64_t *) calloc(num_targets, sizeof(uint64_t));
+    counters->target_breadth = (uint64_t *) calloc((size_t) num_targets * num_thresholds, sizeof(uint64_t));
+  }
+}
+
+static void counters_free(depth_counters_t *counters) {
+  free(counters->histogram);
+  free(counters->ref_bases);
+  free(counters->ref_covered);
+  free(counters->ref_breadth);
+  if (counters->target_bases) { free(counters->target_bases); }
+  if (counters->target_breadth) { free(counters->target_breadth); }
+  if (counters->depth) { free(counters->depth); }
+}
+
+static void add_array(uint64_t *dest, const uint64_t *src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    dest[i] += src[i];
+  }
+}
+
+// reduction of the counters of a thread (bfwork reducer)
+static int depth_reduce(void *dest, void *data) {
+  depth_counters_t *total = (depth_counters_t *) dest;
+  depth_counters_t *local = (depth_counters_t *) data;
+
+  add_array(total->histogram, local->histogram, total->max_depth + 1);
+  add_array(total->ref_bases, local->ref_bases, total->num_refs);
+  add_array(total->ref_covered, local->ref_covered, total->num_refs);
+  add_array(total->ref_breadth, local->ref_breadth, (size_t) total->num_refs * total->num_thresholds);
+  if (total->num_targets) {
+    add_array(total->target_bases, local->target_bases, total->num_targets);
+    add_array(total->target_breadth, local->target_breadth, (size_t) total->num_targets * total->num_thresholds);
+  }
+
+  return NO_ERROR;
+}
+
+static void depth_destroy_counters(void *data) {
+  counters_free((depth_counters_t *) data);
+}
+
+//------------------------------------------------------------------------
+// BED targets
+//------------------------------------------------------------------------
+
+static int target_cmp(const void *a, const void *b) {
+  const depth_target_t *ta = (const depth_target_t *) a;
+  const depth_target_t *tb = (const depth_target_t *) b;
+
+  if (ta->tid != tb->tid) { return (ta->tid < tb->tid ? -1 : 1); }
+  if (ta->beg != tb->beg) { return (ta->beg < tb->beg ? -1 : 1); }
+  if (ta->end != tb->end) { return (ta->end < tb->end ? -1 : 1); }
+  return 0;
+}
+
+static void targets_load(const char *filename, const bam_header_t *header, depth_targets_t *targets) {
+  memset(targets, 0, sizeof(depth_targets_t));
+
+  FILE *fd = fopen(filename, "r");
+  if (fd == NULL) {
+    LOG_FATAL_F("Could not open the BED file %s\n", filename);
+  }
+
+  char line[4096], chrom[1024], name[1024];
+  size_t num_lines = 0, num_skipped = 0;
+  long beg, end;
+  while (fgets(line, sizeof(line), fd)) {
+    num_lines++;
+    if (line[0] == '#' || line[0] == '\n' || line[0] == '\r'
+	|| strncmp(line, "track", 5) == 0 || strncmp(line, "browser", 7) == 0) {
+      continue;
+    }
+
+    name[0] = 0;
+    if (sscanf(line, "%1023s %ld %ld %1023s", chrom, &beg, &end, name) < 3 || beg < 0 || end < beg) {
+      LOG_FATAL_F("Invalid line %lu in the BED file %s\n", num_lines, filename);
+    }
+
+    int32_t tid = bam_get_tid(header, chrom);
+    if (tid < 0) {
+      num_skipped++;
+      continue;
+    }
+    if (end > header->target_len[tid]) {
+      end = header->target_len[tid];
+    }
+    if (end <= beg) {
+      continue;
+    }
+
+    if (targets->num == targets->max) {
+      targets->max = (targets->max ? 2 * targets->max : 1024);
+      targets->targets = (depth_target_t *) realloc(targets->targets, targets->max * sizeof(depth_target_t));
+    }
+    depth_target_t *target = &targets->targets[targets->num++];
+    target->tid = tid;
+    target->beg = (uint32_t) beg;
+    target->end = (uint32_t) end;
+    target->name = (name[0] ? strdup(name) : NULL);
+  }
+  fclose(fd);
+
+  if (num_skipped) {
+    LOG_WARN_F("%lu targets of the BED file %s are on references not found in the BAM file, skipped\n",
+	       num_skipped, filename);
+  }
+
+  qsort(targets->targets, targets->num, sizeof(depth_target_t), target_cmp);
+
+  targets->ref_first = (int *) calloc(header->n_targets, sizeof(int));
+  targets->ref_num = (int *) calloc(header->n_targets, sizeof(int));
+  for (int i = 0; i < targets->num; i++) {
+    depth_target_t *target = &targets->targets[i];
+    if (targets->ref_num[target->tid] == 0) {
+      targets->ref_first[target->tid] = i;
+      target->max_end = target->end;
+    } else {
+      target->max_end = (target->end > target[-1].max_end ? target->end : target[-1].max_end);
+    }
+    targets->ref_num[target->tid]++;
+  }
+}
+
+static void targets_free(depth_targets_t *targets) {
+  for (int i = 0; i < targets->num; i++) {
+    if (targets->targets[i].name) { free(targets->targets[i].name); }
+  }
+  if (targets->targets) { free(targets->targets); }
+  if (targets->ref_first) { free(targets->ref_first); }
+  if (targets->ref_num) { free(targets->ref_num); }
+}
+
+//------------------------------------------------------------------------
+// reads
+//------------------------------------------------------------------------
+
+static inline int depth_filter(const bam1_t *read, const depth_options_t *opts) {
+  uint32_t mask = BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL;
+  if (!opts->count_duplicates) {
+    mask |= BAM_FDUP;
+  }
+  return (read->core.tid < 0 || (read->core.flag & mask) || read->core.qual < opts->min_mapq
+	  || read->core.n_cigar == 0);
+}
+
+// runs body with the bounds of every aligned block of the read
+#define DEPTH_FOREACH_BLOCK(read, block_beg, block_end, body) do {	\
+    const uint32_t *cigar_ = bam1_cigar(read);				\
+    uint32_t pos_ = (uint32_t) (read)->core.pos;			\
+    for (int c_ = 0; c_ < (read)->core.n_cigar; c_++) {			\
+      int op_ = cigar_[c_] & BAM_CIGAR_MASK;				\
+      uint32_t len_ = cigar_[c_] >> BAM_CIGAR_SHIFT;			\
+      if (op_ == BAM_CMATCH || op_ == BAM_CEQUAL || op_ == BAM_CDIFF) {	\
+	uint32_t block_beg = pos_, block_end = pos_ + len_;		\
+	body;								\
+	pos_ += len_;							\
+      } else if (op_ == BAM_CDEL || op_ == BAM_CREF_SKIP) {		\
+	pos_ += len_;							\
+      }									\
+    }									\
+  } while (0)
+
+//------------------------------------------------------------------------
+// framework functions
+//------------------------------------------------------------------------
+
+// new region starting with the read, with the blocks of previous reads that reach it
+static depth_region_t *depth_region_new(depth_data_t *data, const bam1_t *read) {
+  size_t i, n;
+  uint32_t pos = (uint32_t) read->core.pos;
+
+  // blocks of other references or ended before the region are no longer needed
+  if (read->core.tid != data->active_tid) {
+    data->num_active = 0;
+    data->active_tid = read->core.tid;
+  }
+  for (i = 0, n = 0; i < data->num_active; i++) {
+    if (data->active[i].end > pos) {
+      data->active[n++] = data->active[i];
+    }
+  }
+  data->num_active = n;
+
+  depth_region_t *region = (depth_region_t *) malloc(sizeof(depth_region_t) + n * sizeof(depth_block_t));
+  region->tid = read->core.tid;
+  region->beg = pos;
+  region->end = UINT32_MAX;
+  region->num_blocks = n;
+  memcpy(region->blocks, data->active, n * sizeof(depth_block_t));
+
+  return region;
+}
+
+static int depth_wanderer(bam_fwork_t *fwork, bam_region_t *region, bam1_t *read) {
+  depth_data_t *data;
+  depth_region_t *region_data;
+
+  bfwork_lock_user_data(fwork, (void **) &data);
+  bfwork_unlock_user_data(fwork);
+
+  // first read of the region, or the next region starts with this read
+  // (before the region is full, so that the end of the region is known)
+  region_data = (depth_region_t *) region->user_data;
+  if (region_data == NULL) {
+    region->user_data = depth_region_new(data, read);
+  } else if (read->core.tid != region_data->tid || region->size + 1 >= region->max_size) {
+    if (read->core.tid == region_data->tid) {
+      region_data->end = (uint32_t) read->core.pos;
+    }
+    return WANDER_REGION_CHANGED;
+  }
+
+  // the regions own their positions only if the input is sorted
+  if (read->core.tid >= 0) {
+    if (read->core.tid < data->last_tid
+	|| (read->core.tid == data->last_tid && read->core.pos < data->last_pos)) {
+      LOG_FATAL_F("BAM file is not sorted by coordinate, read %s\n", bam1_qname(read));
+    }
+    data->last_tid = read->core.tid;
+    data->last_pos = read->core.pos;
+  }
+
+  data->num_reads++;
+  if (depth_filter(read, data->opts)) {
+    data->num_filtered++;
+    return WANDER_READ_FILTERED;
+  }
+
+  // blocks of this read for the next regions
+  if (data->num_active + read->core.n_cigar > data->max_active) {
+    data->max_active = 2 * (data->num_active + read->core.n_cigar);
+    data->active = (depth_block_t *) realloc(data->active, data->max_active * sizeof(depth_block_t));
+  }
+  DEPTH_FOREACH_BLOCK(read, beg, end, {
+      data->active[data->num_active].beg = beg;
+      data->active[data->num_active].end = end;
+      data->num_active++;
+    });
+
+  // region bounds
+  if (region->init_pos > read->core.pos) {
+    region->init_pos = read->core.pos;
+    region->chrom = read->core.tid;
+  }
+  if (region->end_pos == SIZE_MAX || region->end_pos < read->core.pos) {
+    region->end_pos = read->core.pos;
+  }
+
+  return NO_ERROR;
+}
+
+//------------------------------------------------------------------------
+
+static inline void add_block(int32_t *diff, uint32_t beg, uint32_t end,
+			     uint32_t region_beg, uint32_t region_end) {
+  if (beg < region_beg) { beg = region_beg; }
+  if (end > region_end) { end = region_end; }
+  if (beg < end) {
+    diff[beg - region_beg]++;
+    diff[end - region_beg]--;
+  }
+}
+
+static int depth_processor(bam_fwork_t *fwork, bam_region_t *region) {
+  size_t i;
+  int k;
+  bam1_t *read;
+  depth_data_t *data;
+  depth_counters_t *counters;
+  depth_region_t *region_data;
+
+  region_data = (depth_region_t *) region->user_data;
+  if (region_data == NULL || region_data->tid < 0) {
+    return NO_ERROR;
+  }
+
+  bfwork_lock_user_data(fwork, (void **) &data);
+  bfwork_unlock_user_data(fwork);
+  const depth_options_t *opts = data->opts;
+
+  bfwork_local_user_data(fwork, (void **) &counters);
+  if (counters == NULL) {
+    counters = (depth_counters_t *) malloc(sizeof(depth_counters_t));
+    counters_init(counters, data->header->n_targets, (data->targets ? data->targets->num : 0),
+		  opts->num_thresholds, opts->max_depth);
+    bfwork_local_user_data_set(fwork, counters);
+  }
+
+  // positions of the region: up to the next region, or the last aligned block
+  int32_t tid = region_data->tid;
+  uint32_t beg = region_data->beg, end = beg, limit = region_data->end;
+  if (limit > data->header->target_len[tid]) {
+    limit = data->header->target_len[tid];
+  }
+  for (i = 0; i < region_data->num_blocks; i++) {
+    if (region_data->blocks[i].end > end) { end = region_data->blocks[i].end; }
+  }
+  for (i = 0; i < region->size; i++) {
+    read = region->reads[i];
+    if (!depth_filter(read, opts)) {
+      uint32_t read_end = bam_calend(&read->core, bam1_cigar(read));
+      if (read_end > end) { end = read_end; }
+    }
+  }
+  if (end > limit) { end = limit; }
+  if (end <= beg) {
+    return NO_ERROR;
+  }
+
+  // difference array
+  size_t len = end - beg;
+  if (len + 1 > counters->max_depth_len) {
+    counters->max_depth_len = 2 * (len + 1);
+    counters->depth = (int32_t *) realloc(counters->depth, counters->max_depth_len * sizeof(int32_t));
+  }
+  int32_t *depth = counters->depth;
+  memset(depth, 0, (len + 1) * sizeof(int32_t));
+
+  for (i = 0; i < region_data->num_blocks; i++) {
+    add_block(depth, region_data->blocks[i].beg, region_data->blocks[i].end, beg, end);
+  }
+  for (i = 0; i < region->size; i++) {
+    read = region->reads[i];
+    if (!depth_filter(read, opts)) {
+      DEPTH_FOREACH_BLOCK(read, block_beg, block_end, add_block(depth, block_beg, block_end, beg, end));
+    }
+  }
+
+  // depth, histogram and reference counters
+  uint64_t bases = 0, covered = 0;
+  uint64_t breadth[MAX_DEPTH_THRESHOLDS] = { 0 };
+  int32_t d = 0;
+  for (i = 0; i < len; i++) {
+    d += depth[i];
+    depth[i] = d;
+    if (d > 0) {
+      counters->histogram[(d < opts->max_depth ? d : opts->max_depth)]++;
+      bases += d;
+      covered++;
+      for (k = 0; k < opts->num_thresholds && d >= opts->thresholds[k]; k++) {
+	breadth[k]++;
+      }
+    }
+  }
+  counters->ref_bases[tid] += bases;
+  counters->ref_covered[tid] += covered;
+  for (k = 0; k < opts->num_thresholds; k++) {
+    counters->ref_breadth[(size_t) tid * opts->num_thresholds + k] += breadth[k];
+  }
+
+  // targets overlapping the region, the first one is the first whose max end is after the region start
+  const depth_targets_t *targets = data->targets;
+  if (targets && targets->ref_num[tid]) {
+    int first = targets->ref_first[tid], last = first + targets->ref_num[tid];
+    int lo = first, hi = last;
+    while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (targets->targets[mid].max_end <= beg) { lo = mid + 1; } else { hi = mid; }
+    }
+    for (int t = lo; t < last && targets->targets[t].beg < end; t++) {
+      const depth_target_t *target = &targets->targets[t];
+      uint32_t s = (target->beg > beg ? target->beg : beg);
+      uint32_t e = (target->end < end ? target->end : end);
+      if (s >= e) { continue; }
+
+      uint64_t target_bases = 0;
+      uint64_t *target_breadth = &counters->target_breadth[(size_t) t * opts->num_thresholds];
+      for (uint32_t p = s - beg; p < e - beg; p++) {
+	d = depth[p];
+	target_bases += d;
+	for (k = 0; k < opts->num_thresholds && d >= opts->thresholds[k]; k++) {
+	  target_breadth[k]++;
+	}
+      }
+      counters->target_bases[t] += target_bases;
+    }
+  }
+
+  return NO_ERROR;
+}
+
+//------------------------------------------------------------------------
+// reports
+//------------------------------------------------------------------------
+
+static double ratio(uint64_t a, uint64_t b) {
+  return (b ? (double) a / b : 0.0);
+}
+
+static void report_summary(const char *prefix, const depth_options_t *opts, const bam_header_t *header,
+			   const depth_data_t *data, const depth_counters_t *counters,
+			   const depth_targets_t *targets) {
+  int k;
+  char path[strlen(prefix) + 100];
+  sprintf(path, "%s.depth.summary.txt", prefix);
+
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    LOG_FATAL_F("Could not create the file %s\n", path);
+  }
+
+  fprintf(f, "# Alignments: %lu, counted: %lu\n", data->num_reads, data->num_reads - data->num_filtered);
+  fprintf(f, "#reference\tlength\tbases\tmean_depth");
+  for (k = 0; k < opts->num_thresholds; k++) {
+    fprintf(f, "\tbreadth_%ix", opts->thresholds[k]);
+  }
+  fprintf(f, "\n");
+
+  uint64_t length = 0, bases = 0;
+  uint64_t breadth[MAX_DEPTH_THRESHOLDS] = { 0 };
+  for (int i = 0; i < header->n_targets; i++) {
+    const uint64_t *ref_breadth = &counters->ref_breadth[(size_t) i * opts->num_thresholds];
+    fprintf(f, "%s\t%u\t%lu\t%.4f", header->target_name[i], header->target_len[i],
+	    counters->ref_bases[i], ratio(counters->ref_bases[i], header->target_len[i]));
+    for (k = 0; k < opts->num_thresholds; k++) {
+      fprintf(f, "\t%.4f", ratio(ref_breadth[k], header->target_len[i]));
+      breadth[k] += ref_breadth[k];
+    }
+    fprintf(f, "\n");
+    length += header->target_len[i];
+    bases += counters->ref_bases[i];
+  }
+
+  fprintf(f, "genome\t%lu\t%lu\t%.4f", length, bases, ratio(bases, length));
+  for (k = 0; k < opts->num_thresholds; k++) {
+    fprintf(f, "\t%.4f", ratio(breadth[k], length));
+  }
+  fprintf(f, "\n");
+
+  // all the targets (overlapping positions counted once by every target)
+  if (targets) {
+    length = bases = 0;
+    memset(breadth, 0, sizeof(breadth));
+    for (int t = 0; t < targets->num; t++) {
+      length += targets->targets[t].end - targets->targets[t].beg;
+      bases += counters->target_bases[t];
+      for (k = 0; k < opts->num_thresholds; k++) {
+	breadth[k] += counters->target_breadth[(size_t) t * opts->num_thresholds + k];
+      }
+    }
+    fprintf(f, "targets\t%lu\t%lu\t%.4f", length, bases, ratio(bases, length));
+    for (k = 0; k < opts->num_thresholds; k++) {
+      fprintf(f, "\t%.4f", ratio(breadth[k], length));
+    }
+    fprintf(f, "\n");
+  }
+
+  fclose(f);
+}
+
+static void report_histogram(const char *prefix, const bam_header_t *header, depth_counters_t *counters) {
+  char path[strlen(prefix) + 100];
+  sprintf(path, "%s.depth.histogram.data", prefix);
+
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    LOG_FATAL_F("Could not create the file %s\n", path);
+  }
+
+  // positions not covered
+  uint64_t length = 0, covered = 0;
+  for (int i = 0; i < header->n_targets; i++) {
+    length += header->target_len[i];
+    covered += counters->ref_covered[i];
+  }
+  counters->histogram[0] = length - covered;
+
+  int last = counters->max_depth;
+  while (last > 0 && counters->histogram[last] == 0) {
+    last--;
+  }
+
+  // depth, positions, fraction of positions and fraction with at least that depth
+  uint64_t remaining = length;
+  fprintf(f, "#depth\tpositions\tfraction\tcumulative_fraction\n");
+  for (int d = 0; d <= last; d++) {
+    fprintf(f, "%i%s\t%lu\t%.6f\t%.6f\n", d, (d == counters->max_depth ? "+" : ""), counters->histogram[d],
+	    ratio(counters->histogram[d], length), ratio(remaining, length));
+    remaining -= counters->histogram[d];
+  }
+
+  fclose(f);
+}
+
+static void report_targets(const char *prefix, const depth_options_t *opts, const bam_header_t *header,
+			   const depth_counters_t *counters, const depth_targets_t *targets) {
+  char path[strlen(prefix) + 100];
+  sprintf(path, "%s.depth.targets.txt", prefix);
+
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    LOG_FATAL_F("Could not create the file %s\n", path);
+  }
+
+  fprintf(f, "#reference\tstart\tend\tname\tbases\tmean_depth");
+  for (int k = 0; k < opts->num_thresholds; k++) {
+    fprintf(f, "\tbreadth_%ix", opts->thresholds[k]);
+  }
+  fprintf(f, "\n");
+
+  for (int t = 0; t < targets->num; t++) {
+    const depth_target_t *target = &targets->targets[t];
+    uint32_t length = target->end - target->beg;
+    fprintf(f, "%s\t%u\t%u\t%s\t%lu\t%.4f", header->target_name[target->tid], target->beg, target->end,
+	    (target->name ? target->name : "."), counters->target_bases[t], ratio(counters->target_bases[t], length));
+    for (int k = 0; k < opts->num_thresholds; k++) {
+      fprintf(f, "\t%.4f", ratio(counters->target_breadth[(size_t) t * opts->num_thresholds + k], length));
+    }
+    fprintf(f, "\n");
+  }
+
+  fclose(f);
+}
+
+//------------------------------------------------------------------------
+// depth
+//------------------------------------------------------------------------
+
+void depth_bam(depth_options_t *opts) {
+  bam_fwork_t fwork;
+  bfwork_context_t context;
+  depth_data_t data;
+  depth_counters_t counters;
+  depth_targets_t targets;
+
+  // threads of the framework
+  omp_set_num_threads(opts->num_threads);
+
+  // header
+  bam_reader_t *reader = bam_reader_new(opts->in_filename, 1);
+  if (reader == NULL) {
+    LOG_FATAL_F("Could not open the BAM file %s\n", opts->in_filename);
+  }
+  bam_header_t *header = reader->header;
+  reader->header = NULL;
+  bam_reader_free(reader);
+
+  if (opts->bed_filename) {
+    targets_load(opts->bed_filename, header, &targets);
+    printf("Targets: %i\n", targets.num);
+  }
+
+  memset(&data, 0, sizeof(depth_data_t));
+  data.opts = opts;
+  data.header = header;
+  data.targets = (opts->bed_filename ? &targets : NULL);
+  data.last_tid = -1;
+  data.active_tid = -1;
+
+  counters_init(&counters, header->n_targets, (data.targets ? targets.num : 0),
+		opts->num_thresholds, opts->max_depth);
+
+  // run the framework, the wanderer has to see the reads in input order
+  bfwork_init(&fwork);
+  bfwork_context_init(&context,
+		      (int (*)(void *, bam_region_t *, bam1_t *)) depth_wanderer,
+		      (int (*)(void *, bam_region_t *)) depth_processor,
+		      (int (*)(void *, void *)) depth_reduce,
+		      &counters);
+  bfwork_context_set_user_data(&context, &data);
+  bfwork_configure(&fwork, opts->in_filename, NULL, NULL, NULL);
+  bfwork_add_context(&fwork, &context, FWORK_CONTEXT_SEQUENTIAL | FWORK_CONTEXT_ORDERED);
+
+  double t = omp_get_wtime();
+  bfwork_run(&fwork);
+  printf("Depth computed in %.2f s\n", omp_get_wtime() - t);
+
+  bfwork_context_local_user_data_free(&context, depth_destroy_counters);
+  bfwork_context_destroy(&context);
+  bfwork_destroy(&fwork);
+
+  // reports
+  int len = strlen(opts->in_filename) + strlen(opts->out_dirname) + 100;
+  char filename[len], prefix[len], *p;
+  sprintf(filename, "%s", ((p = strrchr(opts->in_filename, '/')) ? (p + 1) : opts->in_filename));
+  sprintf(prefix, "%s/%s", opts->out_dirname, filename);
+
+  report_summary(prefix, opts, header, &data, &counters, data.targets);
+  report_histogram(prefix, header, &counters);
+  if (data.targets) {
+    report_targets(prefix, opts, header, &counters, data.targets);
+  }
+  printf("Report files were stored in '%s' directory\n", opts->out_dirname);
+
+  // free memory
+  counters_free(&counters);
+  if (data.targets) {
+    targets_free(&targets);
+  }
+  if (data.active) {
+    free(data.active);
+  }
+  bam_header_destroy(header);
+}
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
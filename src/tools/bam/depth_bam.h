@@ -0,0 +1,48 @@
+#ifndef DEPTH_BAM_H
+#define DEPTH_BAM_H
+
+/*
+ * depth_bam.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bioformats/bam/samtools/bam.h"
+
+#include "aux/aux_bam_reader.h"
+#include "bfwork/bfwork.h"
+
+#include "depth_options.h"
+
+//------------------------------------------------------------------------
+
+// per-base depth of a coordinate-sorted BAM file on the bfwork framework
+//
+// every region of reads owns the positions from its first read to the
+// first read of the next region, the wanderer (which sees the reads in
+// input order) hands every region the aligned blocks of previous reads
+// that reach its positions, so each region gets the exact depth of its
+// positions from a difference array, and the depth histogram and the
+// counters by reference and BED target are kept by thread and added at
+// the end
+//
+// aligned blocks are the M, = and X operations of the CIGAR (deletions
+// and skipped regions are not counted), unmapped, secondary, QC failed
+// and (by default) duplicate alignments are not counted
+//
+// reports (prefix: output dirname + BAM file name):
+//   prefix.depth.summary.txt     mean depth and breadth by reference
+//   prefix.depth.histogram.data  positions by depth
+//   prefix.depth.targets.txt     mean depth and breadth by BED target
+
+void depth_bam(depth_options_t *opts);
+
+//------------------------------------------------------------------------
+
+#endif // end of DEPTH_BAM_H
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
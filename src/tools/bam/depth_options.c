@@ -0,0 +1,212 @@
+#include "depth_options.h"
+
+//------------------------------------------------------------------------
+
+void usage_depth_options(depth_options_t *opts);
+
+void **new_argtable_depth_options();
+depth_options_t *read_cli_depth_options(void **argtable, depth_options_t *opts);
+
+extern void free_argtable(int num_options, void **argtable);
+extern void usage_argtable(char *exec_name, char *command_name, void **argtable);
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+
+depth_options_t *depth_options_new(char *exec_name, char *command_name) {
+  depth_options_t *opts = (depth_options_t*) calloc (1, sizeof(depth_options_t));
+
+  opts->help = 0;
+  opts->num_threads = DEFAULT_DEPTH_NUM_THREADS;
+  opts->max_depth = DEFAULT_DEPTH_MAX_DEPTH;
+  opts->min_mapq = 0;
+  opts->count_duplicates = 0;
+
+  opts->num_thresholds = 0;
+  opts->thresholds_str = NULL;
+
+  opts->in_filename = NULL;
+  opts->out_dirname = NULL;
+  opts->bed_filename = NULL;
+
+  opts->exec_name = strdup(exec_name);
+  opts->command_name = strdup(command_name);
+
+  return opts;
+}
+
+//------------------------------------------------------------------------
+
+depth_options_t *depth_options_parse(char *exec_name, char *command_name,
+				     int argc, char **argv) {
+  void **argtable = new_argtable_depth_options();
+
+  depth_options_t *opts = depth_options_new(exec_name, command_name);
+  if (argc < 2) {
+    usage_argtable(exec_name, command_name, argtable);
+  } else {
+    int num_errors = arg_parse(argc, argv, argtable);
+
+    // show help
+    if (((struct arg_int*) argtable[0])->count) {
+      usage_argtable(exec_name, command_name, argtable);
+    }
+
+    if (num_errors > 0) {
+      arg_print_errors(stdout, argtable[NUM_DEPTH_OPTIONS], exec_name);
+      usage_argtable(exec_name, command_name, argtable);
+    } else {
+      opts = read_cli_depth_options(argtable, opts);
+      if (opts->help) {
+	usage_argtable(exec_name, command_name, argtable);
+      }
+    }
+  }
+
+  free_argtable(NUM_DEPTH_OPTIONS + 1, argtable);
+
+  return opts;
+}
+
+//------------------------------------------------------------------------
+
+void depth_options_free(depth_options_t *opts) {
+  if (opts == NULL) { return; }
+
+  if (opts->thresholds_str) { free(opts->thresholds_str); }
+  if (opts->in_filename) { free(opts->in_filename); }
+  if (opts->out_dirname) { free(opts->out_dirname); }
+  if (opts->bed_filename) { free(opts->bed_filename); }
+
+  if (opts->exec_name) { free(opts->exec_name); }
+  if (opts->command_name) { free(opts->command_name); }
+
+  free(opts);
+}
+
+//------------------------------------------------------------------------
+
+void depth_options_validate(depth_options_t *opts) {
+  if (! exists(opts->in_filename)) {
+    printf("\nError: Input file name not found !\n\n");
+    usage_depth_options(opts);
+  }
+
+  if (opts->bed_filename && ! exists(opts->bed_filename)) {
+    printf("\nError: BED file name %s not found !\n\n", opts->bed_filename);
+    usage_depth_options(opts);
+  }
+
+  if (! exists(opts->out_dirname)) {
+    opts->out_dirname = strdup(".");
+  }
+
+  if (opts->num_threads < 1) {
+    printf("\nError: Invalid number of threads (%i), it must be greater than 0 !\n\n",
+	   opts->num_threads);
+    usage_depth_options(opts);
+  }
+
+  if (opts->max_depth < 1 || opts->max_depth > MAX_DEPTH_MAX_DEPTH) {
+    printf("\nError: Invalid maximum depth (%i), it must be between 1 and %i !\n\n",
+	   opts->max_depth, MAX_DEPTH_MAX_DEPTH);
+    usage_depth_options(opts);
+  }
+
+  if (opts->min_mapq < 0 || opts->min_mapq > 255) {
+    printf("\nError: Invalid minimum mapping quality (%i), valid values are from 0 to 255 !\n\n",
+	   opts->min_mapq);
+    usage_depth_options(opts);
+  }
+
+  // thresholds, comma separated and in increasing order
+  if (!opts->thresholds_str) {
+    opts->thresholds_str = strdup(DEFAULT_DEPTH_THRESHOLDS);
+  }
+  opts->num_thresholds = 0;
+  char *p = opts->thresholds_str, *end;
+  while (*p) {
+    long value = strtol(p, &end, 10);
+    if (end == p || (*end != ',' && *end != 0) || value < 1 || value > opts->max_depth
+	|| (opts->num_thresholds > 0 && value <= opts->thresholds[opts->num_thresholds - 1])) {
+      printf("\nError: Invalid depth thresholds (%s), they must be increasing values from 1 to the maximum depth (%i) !\n\n",
+	     opts->thresholds_str, opts->max_depth);
+      usage_depth_options(opts);
+    }
+    if (opts->num_thresholds >= MAX_DEPTH_THRESHOLDS) {
+      printf("\nError: Too many depth thresholds, the maximum is %i !\n\n", MAX_DEPTH_THRESHOLDS);
+      usage_depth_options(opts);
+    }
+    opts->thresholds[opts->num_thresholds++] = (int) value;
+    p = (*end == ',') ? end + 1 : end;
+  }
+}
+
+//------------------------------------------------------------------------
+
+void depth_options_display(depth_options_t *opts) {
+  printf("PARAMETERS CONFIGURATION\n");
+  printf("=================================================\n");
+  printf("Main options\n");
+  printf("\tBAM input filename  : %s\n", opts->in_filename);
+  printf("\tOutput dirname      : %s\n", opts->out_dirname);
+  printf("\tBED targets         : %s\n", opts->bed_filename ? opts->bed_filename : "none");
+  printf("\tDepth thresholds    : %s\n", opts->thresholds_str);
+  printf("\tMaximum depth       : %i\n", opts->max_depth);
+  printf("\tMin. mapping quality: %i\n", opts->min_mapq);
+  printf("\tCount duplicates    : %s\n", opts->count_duplicates ? "yes" : "no");
+  printf("\n");
+
+  printf("Architecture options\n");
+  printf("\tNum. threads: %d\n", opts->num_threads);
+  printf("=================================================\n");
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+depth_options_t *read_cli_depth_options(void **argtable, depth_options_t *opts) {
+  if (((struct arg_int*)argtable[0])->count) { opts->help = ((struct arg_int*)argtable[0])->count; }
+  if (((struct arg_file*)argtable[1])->count) { opts->in_filename = strdup(*(((struct arg_file*)argtable[1])->filename)); }
+  if (((struct arg_file*)argtable[2])->count) { opts->out_dirname = strdup(*(((struct arg_file*)argtable[2])->filename)); }
+  if (((struct arg_file*)argtable[3])->count) { opts->bed_filename = strdup(*(((struct arg_file*)argtable[3])->filename)); }
+  if (((struct arg_str*)argtable[4])->count) { opts->thresholds_str = strdup(*(((struct arg_str*)argtable[4])->sval)); }
+  if (((struct arg_int*)argtable[5])->count) { opts->max_depth = *(((struct arg_int*)argtable[5])->ival); }
+  if (((struct arg_int*)argtable[6])->count) { opts->min_mapq = *(((struct arg_int*)argtable[6])->ival); }
+  if (((struct arg_int*)argtable[7])->count) { opts->count_duplicates = ((struct arg_int*)argtable[7])->count; }
+  if (((struct arg_int*)argtable[8])->count) { opts->num_threads = *(((struct arg_int*)argtable[8])->ival); }
+
+  return opts;
+}
+
+//--------------------------------------------------------------------
+
+void usage_depth_options(depth_options_t *opts) {
+  void **argtable = new_argtable_depth_options();
+  usage_argtable(opts->exec_name, opts->command_name, argtable);
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+void** new_argtable_depth_options() {
+  void **argtable = (void**)malloc((NUM_DEPTH_OPTIONS + 1) * sizeof(void*));
+
+  // NOTICE that order cannot be changed as is accessed by index in other functions
+  argtable[0] = arg_lit0("h", "help", "Help option");
+  argtable[1] = arg_file0("b", "bam-file", NULL, "Input file name (BAM format, sorted by coordinate)");
+  argtable[2] = arg_file0("o", "outdir", NULL, "Output directory name");
+  argtable[3] = arg_file0(NULL, "bed-file", NULL, "Targets (BED format), their mean depth and breadth are reported");
+  argtable[4] = arg_str0(NULL, "thresholds", NULL, "Depths to report the breadth (fraction of positions with at least that depth), comma separated [1,5,10,20,30]");
+  argtable[5] = arg_int0(NULL, "max-depth", NULL, "Last bin of the depth histogram, higher depths are added to it [10000]");
+  argtable[6] = arg_int0(NULL, "min-mapq", NULL, "Minimum mapping quality of the alignments [0]");
+  argtable[7] = arg_lit0(NULL, "count-duplicates", "Count alignments marked as duplicates too");
+  argtable[8] = arg_int0(NULL, "num-threads", NULL, "Number of threads [4]");
+
+  argtable[NUM_DEPTH_OPTIONS] = arg_end(20);
+
+  return argtable;
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
@@ -0,0 +1,69 @@
+#ifndef DEPTH_OPTIONS_H
+#define DEPTH_OPTIONS_H
+
+/*
+ * depth_options.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "argtable2.h"
+#include "libconfig.h"
+#include "commons/log.h"
+#include "commons/system_utils.h"
+#include "commons/file_utils.h"
+
+//============================ DEFAULT VALUES ============================
+
+#define DEFAULT_DEPTH_NUM_THREADS   4
+#define DEFAULT_DEPTH_MAX_DEPTH     10000
+#define DEFAULT_DEPTH_THRESHOLDS    "1,5,10,20,30"
+
+#define MAX_DEPTH_THRESHOLDS        16
+#define MAX_DEPTH_MAX_DEPTH         10000000
+
+//------------------------------------------------------------------------
+
+#define NUM_DEPTH_OPTIONS	9
+
+//------------------------------------------------------------------------
+
+typedef struct depth_options {
+  int help;
+  int num_threads;
+  int max_depth;
+  int min_mapq;
+  int count_duplicates;
+
+  int num_thresholds;
+  int thresholds[MAX_DEPTH_THRESHOLDS];
+  char *thresholds_str;
+
+  char *in_filename;
+  char *out_dirname;
+  char *bed_filename;
+
+  char *exec_name;
+  char *command_name;
+} depth_options_t;
+
+//------------------------------------------------------------------------
+
+depth_options_t *depth_options_new(char *exec_name, char *command_nane);
+
+depth_options_t *depth_options_parse(char *exec_name, char *command_nane,
+				     int argc, char **argv);
+
+void depth_options_free(depth_options_t *opts);
+
+void depth_options_validate(depth_options_t *opts);
+
+void depth_options_display(depth_options_t *opts);
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+
+#endif
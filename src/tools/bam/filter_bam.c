@@ -21,13 +21,13 @@ typedef struct bam_filter_wf_input {
   size_t num_passed;
   size_t num_failed;
   filter_options_t *options;
-  bam_file_t *in_file;
+  bam_reader_t *in_file;
   bam_file_t *passed_file;
   bam_file_t *failed_file;
 } bam_filter_wf_input_t;
 
 bam_filter_wf_input_t *bam_filter_wf_input_new(filter_options_t *opts,
-					       bam_file_t *in_file,
+					       bam_reader_t *in_file,
 					       bam_file_t *passed_file,
 					       bam_file_t *failed_file) {
   
@@ -117,24 +117,26 @@ void *bam_filter_producer(void *input) {
   bam_filter_wf_batch_t *new_batch = NULL;
   int max_num_bam1s = wf_input->options->batch_size;
 
-  bamFile bam_file = wf_input->in_file->bam_fd;
-  bam1_t *bam1;
+  bam_reader_t *reader = wf_input->in_file;
 
-  array_list_t *bam1_list = array_list_new(max_num_bam1s, 1.25f, COLLECTION_MODE_ASYNCHRONIZED);  
-  for (int i = 0; i < max_num_bam1s; i++) {
-    bam1 = bam_init1();    
-    if (bam_read1(bam_file, bam1) > 0) {
+  // the records are read in one go, their BGZF blocks have been inflated
+  // in the background
+  bam1_t **bam1s = (bam1_t **) calloc(max_num_bam1s, sizeof(bam1_t *));
+  size_t num_bam1s = bam_reader_read_batch(reader, bam1s, max_num_bam1s);
 
-      if (++read_progress % 500000 == 0) {
-	LOG_INFO_F("%i reads extracting from disk...\n", read_progress);
-      }
+  array_list_t *bam1_list = array_list_new(max_num_bam1s, 1.25f, COLLECTION_MODE_ASYNCHRONIZED);  
+  for (size_t i = 0; i < num_bam1s; i++) {
+    array_list_insert(bam1s[i], bam1_list);
+  }
+  if (num_bam1s < max_num_bam1s && bam1s[num_bam1s]) {
+    bam_destroy1(bam1s[num_bam1s]);
+  }
+  free(bam1s);
 
-      array_list_insert(bam1, bam1_list);
-    } else {
-      bam_destroy1(bam1);
-      break;
-    }
+  if (num_bam1s && (read_progress + num_bam1s) / 500000 > read_progress / 500000) {
+    LOG_INFO_F("%lu reads extracting from disk...\n", read_progress + num_bam1s);
   }
+  read_progress += num_bam1s;
 
   size_t num_items = array_list_size(bam1_list);
   
@@ -207,17 +209,27 @@ void filter_bam(filter_options_t *opts) {
 
   int name_length = strlen(opts->out_dirname) + 100;
 
-  bam_file_t *in_file = bam_fopen(opts->in_filename);
+  bam_reader_t *in_file = bam_reader_new(opts->in_filename, opts->num_threads);
+  if (in_file == NULL) {
+    LOG_FATAL_F("Could not open the BAM file %s\n", opts->in_filename);
+  }
+
+  // regions: only their chunks are read if the BAM file is indexed
+  int num_chunks = -1;
+  if (opts->region_table) {
+    num_chunks = bam_reader_set_regions(in_file, opts->in_filename, 
+					opts->region_list, opts->gff_region_filename);
+  }
 
   char passed_filename[name_length];
   sprintf(passed_filename, "%s/passed.bam", opts->out_dirname);
-  bam_file_t *passed_file = bam_fopen_mode(passed_filename, in_file->bam_header_p, "w");
-  bam_fwrite_header(in_file->bam_header_p, passed_file);
+  bam_file_t *passed_file = bam_fopen_mode(passed_filename, in_file->header, "w");
+  bam_fwrite_header(in_file->header, passed_file);
 
   char failed_filename[name_length];
   sprintf(failed_filename, "%s/failed.bam", opts->out_dirname);
-  bam_file_t *failed_file = bam_fopen_mode(failed_filename, in_file->bam_header_p, "w");
-  bam_fwrite_header(in_file->bam_header_p, failed_file);
+  bam_file_t *failed_file = bam_fopen_mode(failed_filename, in_file->header, "w");
+  bam_fwrite_header(in_file->header, failed_file);
 
   // update opts
   if (opts->min_length == NO_VALUE) opts->min_length = MIN_VALUE;
@@ -253,6 +265,10 @@ void filter_bam(filter_options_t *opts) {
   printf("======================================================\n");
   printf("Num. passed alignments: %lu (%s)\n", wf_input->num_passed, passed_filename);
   printf("Num. failed alignments: %lu (%s)\n", wf_input->num_failed, failed_filename);
+  if (num_chunks >= 0) {
+    printf("Regions read through the BAM index (%i chunks), alignments out of them\n", num_chunks);
+    printf("are not read, so they are not in %s\n", failed_filename);
+  }
   printf("======================================================\n");
 
   // free memory
@@ -263,8 +279,8 @@ void filter_bam(filter_options_t *opts) {
   //------------------------------------------------------------------
 
   // free memory and close files
-  in_file->bam_header_p = NULL;
-  bam_fclose(in_file);     
+  in_file->header = NULL;
+  bam_reader_free(in_file);
   passed_file->bam_header_p = NULL;
   bam_fclose(passed_file); 
   bam_fclose(failed_file);
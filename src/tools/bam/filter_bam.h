@@ -25,6 +25,8 @@
 #include "bioformats/bam/bam_filter.h"
 
 #include "commons_bam.h"
+#include "aux/aux_bam_reader.h"
+
 #include "filter_options.h"
 
 //------------------------------------------------------------------------
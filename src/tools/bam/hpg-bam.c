@@ -20,11 +20,13 @@
 #include "filter_bam.h"
 #include "index_options.h"
 #include "sort_options.h"
+#include "merge_bam.h"
+#include "depth_bam.h"
+#include "markdup_bam.h"
+#include "aux/aux_bam_sort.h"
+#include "aux/aux_simd.h"
 
 
-bam_index_t *bam_index_core(bamFile fp);
-void bam_index_save(const bam_index_t *idx, FILE *fp);
-void bam_sort_core_ext(int is_by_qname, const char *fn, const char *prefix, size_t max_mem, int is_stdout);
 
 //------------------------------------------------------------------------
 
@@ -43,8 +45,11 @@ void usage(char *exec_name) {
     printf("         filter\t\tfilter a BAM file by using advanced criteria\n");
     printf("         recalibrate\tbase quality recalibrate from a BAM file\n");
     printf("         realign\tlocal realign from BAM file\n");
-    printf("         index\t\tindex a BAM file (using the samtools 0.1.18)\n");
-    printf("         sort\t\tsort a BAM file (using the samtools 0.1.18)\n");
+    printf("         index\t\tindex a BAM file (BAI or CSI)\n");
+    printf("         sort\t\tsort a BAM file by coordinate or read name\n");
+    printf("         merge\t\tmerge BAM files sorted by coordinate\n");
+    printf("         depth\t\tdepth histogram, mean depth and breadth by reference and target\n");
+    printf("         markdup\tmark duplicates in a BAM file sorted by coordinate\n");
 
     //    printf("         compare\tcompare two BAM files\n");
     //    printf("         realignment\trealign locally a BAM file\n");
@@ -66,6 +71,9 @@ int main (int argc, char *argv[]) {
   log_verbose = 1;
   log_file = NULL;
 
+  // select the vectorised kernels for this CPU
+  simd_init();
+
   char *exec_name = argv[0];  
   if (argc == 1 || !strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
     usage(exec_name);
@@ -200,27 +208,26 @@ int main (int argc, char *argv[]) {
     index_options_display(opts);
 
     // set parameters
-    char idx_filename[strlen(opts->out_dirname) + strlen(opts->in_filename) + 10];
+    char prefix[strlen(opts->out_dirname) + strlen(opts->in_filename) + 10];
     char *p = strrchr(opts->in_filename, '/');
     if (p) {
-      sprintf(idx_filename, "%s/%s.bai", opts->out_dirname, p + 1);
+      sprintf(prefix, "%s/%s", opts->out_dirname, p + 1);
     } else {
-      sprintf(idx_filename, "%s/%s.bai", opts->out_dirname, opts->in_filename);
+      sprintf(prefix, "%s/%s", opts->out_dirname, opts->in_filename);
     }
 
     // run index
-    bamFile bf = bam_open(opts->in_filename, "r");
-    bam_index_t *idx = bam_index_core(bf);
-    bam_close(bf);
-    
-    FILE *idxf = fopen(idx_filename, "wb");
-    if (idxf == NULL) {
-      LOG_FATAL_F("Could not open file %s", idx_filename);
+    int format = bam_index_build(opts->in_filename, prefix, (opts->csi ? BAM_INDEX_CSI : BAM_INDEX_BAI),
+				 opts->min_shift, opts->num_threads);
+    if (format < 0) {
+      LOG_FATAL_F("Could not index the BAM file %s, check that it is sorted by coordinate\n", opts->in_filename);
     }
-    bam_index_save(idx, idxf);
-    bam_index_destroy(idx);
-    fclose(idxf);
 
+    char idx_filename[strlen(prefix) + 5];
+    bam_index_filename(prefix, format, idx_filename);
+    if (format == BAM_INDEX_CSI && !opts->csi) {
+      printf("References longer than 512 Mbp, CSI index instead of BAI\n");
+    }
     printf("Index created in %s\n", idx_filename);
 
     // free memory
@@ -239,8 +246,8 @@ int main (int argc, char *argv[]) {
     sort_options_display(opts);
 
     // set parameters
-    int is_by_qname = 0, is_stdout = 0;
-    char sorted_filename[strlen(opts->in_filename)];
+    int order = BAM_SORT_COORD;
+    char sorted_filename[strlen(opts->in_filename) + 1];
     char path[strlen(opts->out_dirname) + strlen(opts->in_filename) + 100];
 
     strcpy(sorted_filename, opts->in_filename);
@@ -248,19 +255,81 @@ int main (int argc, char *argv[]) {
     if (ext) {
       *ext = 0;
     } 
-    sprintf(path, "%s/%s.sorted", opts->out_dirname, sorted_filename);
+    sprintf(path, "%s/%s.sorted.bam", opts->out_dirname, sorted_filename);
 
     if (strcmp("name", opts->criteria) == 0) {
-      is_by_qname = 1;
+      order = BAM_SORT_NAME;
+    }
+
+    int markdup = 0;
+    if (opts->markdup) {
+      markdup = (opts->remove_duplicates ? BAM_SORT_RMDUP : BAM_SORT_MARKDUP);
     }
 
     // run sort
-    bam_sort_core_ext(is_by_qname, opts->in_filename, path, opts->max_memory, is_stdout);
+    if (bam_sort_file(opts->in_filename, path, order, opts->max_memory, opts->num_threads, opts->index, markdup) != 0) {
+      LOG_FATAL_F("Could not sort the BAM file %s\n", opts->in_filename);
+    }
 
-    printf("Sorted BAM file in %s.bam\n", path);
+    printf("Sorted BAM file in %s\n", path);
 
     // free memory
     sort_options_free(opts);
+
+  } else if (strcmp(command_name, "merge" ) == 0) {
+
+    //--------------------------------------------------------------------
+    //                  M E R G E     C O M M A N D
+    //--------------------------------------------------------------------
+
+    // parse, validate and display merge options
+    merge_options_t *opts = merge_options_parse(exec_name, command_name, 
+						argc, argv);
+    merge_options_validate(opts);
+    merge_options_display(opts);
+
+    // run merge
+    merge_bam(opts);
+
+    // free memory
+    merge_options_free(opts);
+
+  } else if (strcmp(command_name, "depth" ) == 0) {
+
+    //--------------------------------------------------------------------
+    //                  D E P T H     C O M M A N D
+    //--------------------------------------------------------------------
+
+    // parse, validate and display depth options
+    depth_options_t *opts = depth_options_parse(exec_name, command_name,
+						argc, argv);
+    depth_options_validate(opts);
+    depth_options_display(opts);
+
+    // run depth
+    depth_bam(opts);
+
+    // free memory
+    depth_options_free(opts);
+
+  } else if (strcmp(command_name, "markdup" ) == 0) {
+
+    //--------------------------------------------------------------------
+    //                  M A R K D U P     C O M M A N D
+    //--------------------------------------------------------------------
+
+    // parse, validate and display markdup options
+    markdup_options_t *opts = markdup_options_parse(exec_name, command_name,
+						    argc, argv);
+    markdup_options_validate(opts);
+    markdup_options_display(opts);
+
+    // run markdup
+    markdup_bam(opts);
+
+    // free memory
+    markdup_options_free(opts);
+
   } else {
 
     //--------------------------------------------------------------------
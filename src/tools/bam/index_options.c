@@ -17,6 +17,9 @@ index_options_t *index_options_new(char *exec_name, char *command_name) {
   index_options_t *opts = (index_options_t*) calloc (1, sizeof(index_options_t));
   
   opts->help = 0;
+  opts->num_threads = DEFAULT_INDEX_NUM_THREADS;
+  opts->csi = 0;
+  opts->min_shift = DEFAULT_INDEX_MIN_SHIFT;
   opts->in_filename = NULL;
 
   opts->exec_name = strdup(exec_name);
@@ -82,6 +85,18 @@ void index_options_validate(index_options_t *opts) {
   if (! exists(opts->out_dirname)) {
     opts->out_dirname = strdup(".");
   }
+
+  if (opts->num_threads < 1) {
+    printf("\nError: Invalid number of threads (%i), it must be greater than 0 !\n\n",
+	   opts->num_threads);
+    usage_index_options(opts);
+  }
+
+  if (opts->min_shift < 10 || opts->min_shift > 20) {
+    printf("\nError: Invalid minimum interval size (%i), it must be between 10 and 20 bits !\n\n",
+	   opts->min_shift);
+    usage_index_options(opts);
+  }
 }
 
 //------------------------------------------------------------------------
@@ -92,17 +107,20 @@ void index_options_display(index_options_t *opts) {
   printf("Main options\n");
   printf("\tBAM input filename  : %s\n", opts->in_filename);
   printf("\tOutput dirname      : %s\n", opts->out_dirname);
+  printf("\tIndex format        : %s\n", opts->csi ? "CSI" : "BAI");
+  if (opts->csi) {
+    printf("\tMin. interval size  : %i bits\n", opts->min_shift);
+  }
   printf("\n");
   /*
   printf("Report options\n");
   printf("\tLog level: %d\n",  (int) opts->log_level);
   printf("\tVerbose  : %d\n",  (int) opts->verbose);
   printf("\n");
-
+  */
   printf("Architecture options\n");
   printf("\tNum. threads: %d\n",  (int) opts->num_threads);
-  printf("\tBatch size  : %d alignments\n",  (int) opts->batch_size);
-  */
+  //  printf("\tBatch size  : %d alignments\n",  (int) opts->batch_size);
   printf("=================================================\n");
 }
 
@@ -113,6 +131,9 @@ index_options_t *read_cli_index_options(void **argtable, index_options_t *opts)
   if (((struct arg_int*)argtable[0])->count) { opts->help = ((struct arg_int*)argtable[0])->count; }
   if (((struct arg_file*)argtable[1])->count) { opts->in_filename = strdup(*(((struct arg_file*)argtable[1])->filename)); }
   if (((struct arg_file*)argtable[2])->count) { opts->out_dirname = strdup(*(((struct arg_file*)argtable[2])->filename)); }
+  if (((struct arg_int*)argtable[3])->count) { opts->num_threads = *(((struct arg_int*)argtable[3])->ival); }
+  if (((struct arg_int*)argtable[4])->count) { opts->csi = ((struct arg_int*)argtable[4])->count; }
+  if (((struct arg_int*)argtable[5])->count) { opts->min_shift = *(((struct arg_int*)argtable[5])->ival); }
   
   return opts;
 }
@@ -134,6 +155,9 @@ void** new_argtable_index_options() {
   argtable[0] = arg_lit0("h", "help", "Help option");
   argtable[1] = arg_file0("b", "bam-file", NULL, "Input file name (BAM format)");
   argtable[2] = arg_file0("o", "outdir", NULL, "Output file name (BAM format)");
+  argtable[3] = arg_int0(NULL, "num-threads", NULL, "Number of threads to decompress the BAM file [4]");
+  argtable[4] = arg_lit0(NULL, "csi", "Create a CSI index instead of a BAI one (BAI is limited to references of 512 Mbp, longer references get a CSI index anyway)");
+  argtable[5] = arg_int0(NULL, "min-shift", NULL, "Size of the smallest CSI interval, in bits [14]");
   
   argtable[NUM_INDEX_OPTIONS] = arg_end(20);
   
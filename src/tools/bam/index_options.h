@@ -19,9 +19,12 @@
 
 //============================ DEFAULT VALUES ============================
 
+#define DEFAULT_INDEX_NUM_THREADS	4
+#define DEFAULT_INDEX_MIN_SHIFT		14
+
 //------------------------------------------------------------------------
 
-#define NUM_INDEX_OPTIONS	3
+#define NUM_INDEX_OPTIONS	6
 
 //------------------------------------------------------------------------
 
@@ -29,8 +32,10 @@ typedef struct index_options {
   //  int log_level;
   //  int verbose;
   int help;
-  //  int num_threads;
+  int num_threads;
   //  int batch_size;
+  int csi;
+  int min_shift;
 
   char* in_filename;
   char* out_dirname;
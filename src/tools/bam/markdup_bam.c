@@ -0,0 +1,113 @@
+#include "markdup_bam.h"
+
+//------------------------------------------------------------------------
+
+typedef struct markdup_output {
+  char *filename;
+  bgzf_mt_writer_t *writer;
+  bam_index_builder_t *builder;
+} markdup_output_t;
+
+static int markdup_write(void *data, bam1_t *b) {
+  markdup_output_t *output = (markdup_output_t *) data;
+
+  uint64_t beg = bgzf_mt_writer_tell(output->writer);
+  if (bgzf_mt_write_bam1(output->writer, b) < 0) {
+    LOG_FATAL_F("Error writing file %s\n", output->filename);
+  }
+  if (output->builder && bam_index_builder_add(output->builder, b, beg, bgzf_mt_writer_tell(output->writer)) != 0) {
+    LOG_FATAL_F("Error indexing file %s, records are not sorted by coordinate\n", output->filename);
+  }
+  return 0;
+}
+
+static uint64_t writer_voffset(void *data, uint64_t offset) {
+  return bgzf_mt_writer_voffset((bgzf_mt_writer_t *) data, offset);
+}
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+
+void markdup_bam(markdup_options_t *opts) {
+  // the threads are shared out between inflating the input and deflating
+  // the output, the marker is a single stream
+  int reader_threads = opts->num_threads / 2;
+  if (reader_threads < 1) { reader_threads = 1; }
+
+  bgzf_mt_reader_t *reader = bgzf_mt_reader_new(opts->in_filename, 0, reader_threads);
+  if (reader == NULL) {
+    LOG_FATAL_F("Could not open file %s\n", opts->in_filename);
+  }
+  bam_header_t *header = bgzf_mt_read_bam_header(reader);
+  if (header == NULL) {
+    LOG_FATAL_F("Invalid BAM file %s\n", opts->in_filename);
+  }
+
+  bgzf_mt_writer_t *writer = bgzf_mt_writer_new(opts->out_filename, opts->compression_level,
+						opts->num_threads);
+  if (writer == NULL) {
+    LOG_FATAL_F("Could not open file %s\n", opts->out_filename);
+  }
+  bgzf_mt_write_bam_header(writer, header);
+
+  bam_index_builder_t *builder = NULL;
+  if (opts->index) {
+    builder = bam_index_builder_new(header, BAM_INDEX_BAI, 0);
+  }
+
+  markdup_output_t output = { opts->out_filename, writer, builder };
+  bam_markdup_t *markdup = bam_markdup_new(header, opts->remove_duplicates, markdup_write, &output);
+
+  int ret;
+  bam1_t *b = bam_init1();
+  while ((ret = bgzf_mt_read_bam1(reader, b)) >= 0) {
+    b = bam_markdup_add(markdup, b);
+    if (bam_markdup_error(markdup)) {
+      LOG_FATAL_F("%s is not sorted by coordinate\n", opts->in_filename);
+    }
+  }
+  if (ret < -1) {
+    LOG_FATAL_F("Truncated or corrupted BAM file %s\n", opts->in_filename);
+  }
+  bam_markdup_flush(markdup);
+  if (bam_markdup_error(markdup)) {
+    LOG_FATAL_F("Error writing file %s\n", opts->out_filename);
+  }
+
+  uint64_t end = bgzf_mt_writer_tell(writer);
+  if (bgzf_mt_writer_close(writer) != 0) {
+    LOG_FATAL_F("Error writing file %s\n", opts->out_filename);
+  }
+
+  const bam_markdup_stats_t *stats = bam_markdup_stats(markdup);
+  printf("Records            : %lu\n", stats->num_records);
+  printf("Duplicate fragments: %lu of %lu\n", stats->num_dup_fragments, stats->num_fragments);
+  printf("Duplicate pairs    : %lu of %lu\n", stats->num_dup_pairs, stats->num_pairs);
+  if (opts->remove_duplicates) {
+    printf("Removed records    : %lu\n", stats->num_removed);
+  }
+  printf("Output in %s\n", opts->out_filename);
+
+  if (builder) {
+    char idx_filename[strlen(opts->out_filename) + 5];
+    bam_index_filename(opts->out_filename, builder->format, idx_filename);
+
+    bam_index_builder_finish(builder, end);
+    if (bam_index_builder_save(builder, idx_filename, writer_voffset, writer) != 0) {
+      LOG_FATAL_F("Could not write index file %s\n", idx_filename);
+    }
+    bam_index_builder_free(builder);
+
+    printf("Index created in %s\n", idx_filename);
+  }
+
+  // free memory
+  bam_destroy1(b);
+  bam_markdup_free(markdup);
+  bam_header_destroy(header);
+  bgzf_mt_reader_free(reader);
+  bgzf_mt_writer_free(writer);
+}
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
@@ -0,0 +1,39 @@
+#ifndef MARKDUP_BAM_H
+#define MARKDUP_BAM_H
+
+/*
+ * markdup_bam.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bioformats/bam/samtools/bam.h"
+
+#include "aux/aux_bgzf.h"
+#include "aux/aux_bam_index.h"
+#include "aux/aux_bam_markdup.h"
+
+#include "markdup_options.h"
+
+//------------------------------------------------------------------------
+
+// marks (or removes) the duplicate reads of a coordinate-sorted BAM file
+// in one pass: the input is inflated and the output deflated on several
+// threads (aux_bgzf), and the records stream through the duplicate marker
+// (aux_bam_markdup), whose memory is bounded by a read length window and
+// the pairs whose mate is still to come
+//
+// the same marker can run while the output of sort and merge is written
+// (--markdup)
+
+void markdup_bam(markdup_options_t *opts);
+
+//------------------------------------------------------------------------
+
+#endif // end of MARKDUP_BAM_H
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
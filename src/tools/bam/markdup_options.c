@@ -0,0 +1,185 @@
+#include "markdup_options.h"
+
+//------------------------------------------------------------------------
+
+void usage_markdup_options(markdup_options_t *opts);
+
+void **new_argtable_markdup_options();
+markdup_options_t *read_cli_markdup_options(void **argtable, markdup_options_t *opts);
+
+extern void free_argtable(int num_options, void **argtable);
+extern void usage_argtable(char *exec_name, char *command_name, void **argtable);
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+
+markdup_options_t *markdup_options_new(char *exec_name, char *command_name) {
+  markdup_options_t *opts = (markdup_options_t*) calloc (1, sizeof(markdup_options_t));
+  
+  opts->help = 0;
+  opts->num_threads = DEFAULT_MARKDUP_NUM_THREADS;
+  opts->index = 0;
+  opts->compression_level = -1;
+  opts->remove_duplicates = 0;
+
+  opts->in_filename = NULL;
+  opts->out_filename = NULL;
+
+  opts->exec_name = strdup(exec_name);
+  opts->command_name = strdup(command_name);
+
+  return opts;
+}
+
+//------------------------------------------------------------------------
+
+markdup_options_t *markdup_options_parse(char *exec_name, char *command_name,
+					 int argc, char **argv) {
+  void **argtable = new_argtable_markdup_options();
+  
+  markdup_options_t *opts = markdup_options_new(exec_name, command_name);
+  if (argc < 2) {
+    usage_argtable(exec_name, command_name, argtable);
+  } else {  
+    int num_errors = arg_parse(argc, argv, argtable);
+    
+    // show help
+    if (((struct arg_int*) argtable[0])->count) {
+      usage_argtable(exec_name, command_name, argtable);
+    }
+        
+    if (num_errors > 0) {
+      arg_print_errors(stdout, argtable[NUM_MARKDUP_OPTIONS], exec_name);
+      usage_argtable(exec_name, command_name, argtable);
+    } else {
+      opts = read_cli_markdup_options(argtable, opts);
+      if (opts->help) {
+	usage_argtable(exec_name, command_name, argtable);
+      }
+    }
+  }
+
+  free_argtable(NUM_MARKDUP_OPTIONS + 1, argtable);
+
+  return opts;
+}
+
+//------------------------------------------------------------------------
+
+void markdup_options_free(markdup_options_t *opts) {
+  if (opts == NULL) { return; }
+  
+  if (opts->in_filename) { free(opts->in_filename); }
+  if (opts->out_filename) { free(opts->out_filename); }
+  
+  if (opts->exec_name) { free(opts->exec_name); }
+  if (opts->command_name) { free(opts->command_name); }
+  
+  free(opts);
+}
+
+//------------------------------------------------------------------------
+
+void markdup_options_validate(markdup_options_t *opts) {
+  if (! exists(opts->in_filename)) {
+    printf("\nError: Input file name not found !\n\n");
+    usage_markdup_options(opts);
+  }
+
+  // input file name with the .markdup.bam extension
+  if (!opts->out_filename) {
+    char *p = strrchr(opts->in_filename, '/');
+    char *name = (p ? p + 1 : opts->in_filename);
+    opts->out_filename = (char *) malloc(strlen(name) + 16);
+    strcpy(opts->out_filename, name);
+    char *ext = strstr(opts->out_filename, ".bam");
+    if (ext) {
+      *ext = 0;
+    }
+    strcat(opts->out_filename, ".markdup.bam");
+  }
+
+  if (strcmp(opts->in_filename, opts->out_filename) == 0) {
+    printf("\nError: Output file name %s is also the input file !\n\n", opts->out_filename);
+    usage_markdup_options(opts);
+  }
+
+  if (opts->num_threads < 1) {
+    printf("\nError: Invalid number of threads (%i), it must be greater than 0 !\n\n",
+	   opts->num_threads);
+    usage_markdup_options(opts);
+  }
+
+  if (opts->compression_level < -1 || opts->compression_level > 9) {
+    printf("\nError: Invalid compression level (%i), valid values are from 0 to 9 !\n\n",
+	   opts->compression_level);
+    usage_markdup_options(opts);
+  }
+}
+
+//------------------------------------------------------------------------
+
+void markdup_options_display(markdup_options_t *opts) {
+  printf("PARAMETERS CONFIGURATION\n");
+  printf("=================================================\n");
+  printf("Main options\n");
+  printf("\tBAM input filename  : %s\n", opts->in_filename);
+  printf("\tOutput filename     : %s\n", opts->out_filename);
+  printf("\tDuplicates          : %s\n", opts->remove_duplicates ? "removed" : "marked");
+  printf("\tIndex output        : %s\n", opts->index ? "yes" : "no");
+  if (opts->compression_level >= 0) {
+    printf("\tCompression level   : %i\n", opts->compression_level);
+  } else {
+    printf("\tCompression level   : default\n");
+  }
+  printf("\n");
+
+  printf("Architecture options\n");
+  printf("\tNum. threads: %d\n", opts->num_threads);
+  printf("=================================================\n");
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+markdup_options_t *read_cli_markdup_options(void **argtable, markdup_options_t *opts) {	
+  if (((struct arg_int*)argtable[0])->count) { opts->help = ((struct arg_int*)argtable[0])->count; }
+  if (((struct arg_file*)argtable[1])->count) { opts->in_filename = strdup(*(((struct arg_file*)argtable[1])->filename)); }
+  if (((struct arg_file*)argtable[2])->count) { opts->out_filename = strdup(*(((struct arg_file*)argtable[2])->filename)); }
+  if (((struct arg_int*)argtable[3])->count) { opts->remove_duplicates = ((struct arg_int*)argtable[3])->count; }
+  if (((struct arg_int*)argtable[4])->count) { opts->num_threads = *(((struct arg_int*)argtable[4])->ival); }
+  if (((struct arg_int*)argtable[5])->count) { opts->index = ((struct arg_int*)argtable[5])->count; }
+  if (((struct arg_int*)argtable[6])->count) { opts->compression_level = *(((struct arg_int*)argtable[6])->ival); }
+  
+  return opts;
+}
+
+//--------------------------------------------------------------------
+
+void usage_markdup_options(markdup_options_t *opts) {
+  void **argtable = new_argtable_markdup_options();
+  usage_argtable(opts->exec_name, opts->command_name, argtable);
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+void** new_argtable_markdup_options() {
+  void **argtable = (void**)malloc((NUM_MARKDUP_OPTIONS + 1) * sizeof(void*));
+  
+  // NOTICE that order cannot be changed as is accessed by index in other functions
+  argtable[0] = arg_lit0("h", "help", "Help option");
+  argtable[1] = arg_file0("b", "bam-file", NULL, "Input file name (BAM format, sorted by coordinate)");
+  argtable[2] = arg_file0("o", "out-file", NULL, "Output file name (BAM format) [input name with .markdup.bam]");
+  argtable[3] = arg_lit0(NULL, "remove-duplicates", "Remove the duplicate reads instead of marking them");
+  argtable[4] = arg_int0(NULL, "num-threads", NULL, "Number of threads to decompress and compress the BAM blocks [4]");
+  argtable[5] = arg_lit0(NULL, "index", "Create the index of the output file while it is written (BAI, CSI for references longer than 512 Mbp)");
+  argtable[6] = arg_int0(NULL, "compression-level", NULL, "Compression level of the output file, from 0 to 9 [zlib default]");
+  
+  argtable[NUM_MARKDUP_OPTIONS] = arg_end(20);
+  
+  return argtable;
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
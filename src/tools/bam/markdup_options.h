@@ -0,0 +1,59 @@
+#ifndef MARKDUP_OPTIONS_H
+#define MARKDUP_OPTIONS_H
+
+/*
+ * markdup_options.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "argtable2.h"
+#include "libconfig.h"
+#include "commons/log.h"
+#include "commons/system_utils.h"
+#include "commons/file_utils.h"
+
+//============================ DEFAULT VALUES ============================
+
+#define DEFAULT_MARKDUP_NUM_THREADS   4
+
+//------------------------------------------------------------------------
+
+#define NUM_MARKDUP_OPTIONS	7
+
+//------------------------------------------------------------------------
+
+typedef struct markdup_options { 
+  int help;
+  int num_threads;
+  int index;
+  int compression_level;
+  int remove_duplicates;
+
+  char *in_filename;
+  char *out_filename;
+
+  char *exec_name;
+  char *command_name;
+} markdup_options_t;
+
+//------------------------------------------------------------------------
+
+markdup_options_t *markdup_options_new(char *exec_name, char *command_nane);
+
+markdup_options_t *markdup_options_parse(char *exec_name, char *command_nane,
+					 int argc, char **argv);
+
+void markdup_options_free(markdup_options_t *opts);
+
+void markdup_options_validate(markdup_options_t *opts);
+
+void markdup_options_display(markdup_options_t *opts);
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,545 @@
+#include "merge_bam.h"
+
+//------------------------------------------------------------------------
+
+typedef struct merge_ids {
+  int num;
+  int max;
+  char **ids;
+  char **lines;
+} merge_ids_t;
+
+typedef struct merge_input {
+  char *filename;
+  bgzf_mt_reader_t *reader;
+  bam_header_t *header;
+
+  bam1_t *bam;
+  int eof;
+  size_t num_records;
+
+  // read groups renamed in the merged header (ids: old, lines: new id)
+  merge_ids_t rg_renames;
+} merge_input_t;
+
+//------------------------------------------------------------------------
+// header lines
+//------------------------------------------------------------------------
+
+static void ids_add(merge_ids_t *set, const char *id, const char *line) {
+  if (set->num == set->max) {
+    set->max = (set->max ? 2 * set->max : 16);
+    set->ids = (char **) realloc(set->ids, set->max * sizeof(char *));
+    set->lines = (char **) realloc(set->lines, set->max * sizeof(char *));
+  }
+  set->ids[set->num] = strdup(id);
+  set->lines[set->num] = strdup(line);
+  set->num++;
+}
+
+static int ids_find(merge_ids_t *set, const char *id) {
+  for (int i = 0; i < set->num; i++) {
+    if (strcmp(set->ids[i], id) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void ids_free(merge_ids_t *set) {
+  for (int i = 0; i < set->num; i++) {
+    free(set->ids[i]);
+    free(set->lines[i]);
+  }
+  if (set->ids) { free(set->ids); }
+  if (set->lines) { free(set->lines); }
+  memset(set, 0, sizeof(merge_ids_t));
+}
+
+//------------------------------------------------------------------------
+
+static void text_append(char **text, size_t *len, size_t *max, const char *str, int new_line) {
+  size_t n = strlen(str);
+  if (*len + n + 2 > *max) {
+    *max = 2 * (*len + n + 2);
+    *text = (char *) realloc(*text, *max);
+  }
+  memcpy(*text + *len, str, n);
+  *len += n;
+  if (new_line) {
+    (*text)[(*len)++] = '\n';
+  }
+  (*text)[*len] = 0;
+}
+
+//------------------------------------------------------------------------
+
+// value of the tag in a tab-separated header line, NULL if not found
+static char *get_tag(const char *line, const char *tag, char *value, size_t max) {
+  size_t tag_len = strlen(tag);
+  const char *p = strchr(line, '\t');
+  while (p) {
+    p++;
+    if (strncmp(p, tag, tag_len) == 0 && p[tag_len] == ':') {
+      p += tag_len + 1;
+      size_t n = strcspn(p, "\t");
+      if (n >= max) { n = max - 1; }
+      memcpy(value, p, n);
+      value[n] = 0;
+      return value;
+    }
+    p = strchr(p, '\t');
+  }
+  return NULL;
+}
+
+// new line with the value of the tag replaced
+static char *set_tag(const char *line, const char *tag, const char *value) {
+  char *new_line = (char *) malloc(strlen(line) + strlen(value) + strlen(tag) + 3);
+  size_t tag_len = strlen(tag);
+
+  const char *p = strchr(line, '\t');
+  while (p) {
+    if (strncmp(p + 1, tag, tag_len) == 0 && p[tag_len + 1] == ':') {
+      const char *end = p + 1 + tag_len + 1;
+      end += strcspn(end, "\t");
+      size_t n = p - line;
+      memcpy(new_line, line, n);
+      sprintf(new_line + n, "\t%s:%s%s", tag, value, end);
+      return new_line;
+    }
+    p = strchr(p + 1, '\t');
+  }
+
+  sprintf(new_line, "%s\t%s:%s", line, tag, value);
+  return new_line;
+}
+
+//------------------------------------------------------------------------
+
+// id not used in the set, derived from the original id and the input
+static void unique_id(merge_ids_t *set, const char *id, int input, char *new_id, size_t max) {
+  snprintf(new_id, max, "%s-%i", id, input + 1);
+  for (int i = 2; ids_find(set, new_id) >= 0; i++) {
+    snprintf(new_id, max, "%s-%i.%i", id, input + 1, i);
+  }
+}
+
+//------------------------------------------------------------------------
+
+static bam_header_t *merge_headers(merge_input_t *inputs, int num_inputs) {
+  bam_header_t *first = inputs[0].header;
+
+  // reference sequences
+  for (int i = 1; i < num_inputs; i++) {
+    bam_header_t *h = inputs[i].header;
+    int equal = (h->n_targets == first->n_targets);
+    for (int j = 0; equal && j < h->n_targets; j++) {
+      equal = (strcmp(h->target_name[j], first->target_name[j]) == 0 &&
+	       h->target_len[j] == first->target_len[j]);
+    }
+    if (!equal) {
+      LOG_FATAL_F("Reference sequences of %s and %s differ, BAM files mapped to the same reference are required\n",
+		  inputs[0].filename, inputs[i].filename);
+    }
+  }
+
+  char *hd = NULL, *sq = NULL, *others = NULL;
+  size_t hd_len = 0, hd_max = 0, sq_len = 0, sq_max = 0, others_len = 0, others_max = 0;
+  merge_ids_t rg = { 0, 0, NULL, NULL }, pg = { 0, 0, NULL, NULL }, co = { 0, 0, NULL, NULL };
+  char id[1024], new_id[1100], value[1024];
+
+  for (int i = 0; i < num_inputs; i++) {
+    bam_header_t *h = inputs[i].header;
+    char *text = (char *) calloc(h->l_text + 1, 1);
+    if (h->l_text) { memcpy(text, h->text, h->l_text); }
+
+    // split in lines
+    int num_lines = 0, max_lines = 64;
+    char **lines = (char **) malloc(max_lines * sizeof(char *));
+    char *saveptr = NULL;
+    for (char *line = strtok_r(text, "\n", &saveptr); line; line = strtok_r(NULL, "\n", &saveptr)) {
+      if (*line == 0 || *line == '\r') { continue; }
+      if (num_lines == max_lines) {
+	max_lines *= 2;
+	lines = (char **) realloc(lines, max_lines * sizeof(char *));
+      }
+      lines[num_lines++] = line;
+    }
+
+    // program ids of this input renamed in the merged header
+    merge_ids_t pg_renames = { 0, 0, NULL, NULL };
+    for (int j = 0; j < num_lines; j++) {
+      if (strncmp(lines[j], "@PG\t", 4) != 0 || !get_tag(lines[j], "ID", id, sizeof(id))) { continue; }
+      int k = ids_find(&pg, id);
+      if (k >= 0 && strcmp(pg.lines[k], lines[j]) != 0) {
+	unique_id(&pg, id, i, new_id, sizeof(new_id));
+	ids_add(&pg_renames, id, new_id);
+      }
+    }
+
+    for (int j = 0; j < num_lines; j++) {
+      char *line = lines[j];
+
+      if (strncmp(line, "@HD\t", 4) == 0) {
+	if (get_tag(line, "SO", value, sizeof(value)) && strcmp(value, "coordinate") != 0) {
+	  LOG_FATAL_F("%s is not sorted by coordinate (SO:%s)\n", inputs[i].filename, value);
+	}
+	if (i == 0) {
+	  char *new_line = set_tag(line, "SO", "coordinate");
+	  text_append(&hd, &hd_len, &hd_max, new_line, 1);
+	  free(new_line);
+	}
+
+      } else if (strncmp(line, "@SQ\t", 4) == 0) {
+	if (i == 0) {
+	  text_append(&sq, &sq_len, &sq_max, line, 1);
+	}
+
+      } else if (strncmp(line, "@RG\t", 4) == 0) {
+	// the set keeps the original lines, identical read groups of several
+	// inputs are merged, and different ones with the same id are renamed
+	if (!get_tag(line, "ID", id, sizeof(id))) { continue; }
+	int k;
+	for (k = 0; k < rg.num && strcmp(rg.lines[k], line) != 0; k++);
+	if (k < rg.num) {
+	  if (strcmp(rg.ids[k], id) != 0) {
+	    ids_add(&inputs[i].rg_renames, id, rg.ids[k]);
+	  }
+	} else if (ids_find(&rg, id) < 0) {
+	  ids_add(&rg, id, line);
+	} else {
+	  unique_id(&rg, id, i, new_id, sizeof(new_id));
+	  ids_add(&rg, new_id, line);
+	  ids_add(&inputs[i].rg_renames, id, new_id);
+	}
+
+      } else if (strncmp(line, "@PG\t", 4) == 0) {
+	if (!get_tag(line, "ID", id, sizeof(id))) { continue; }
+	char *new_line = strdup(line), *tmp;
+	int k = ids_find(&pg_renames, id);
+	if (k >= 0) {
+	  tmp = set_tag(new_line, "ID", pg_renames.lines[k]);
+	  free(new_line);
+	  new_line = tmp;
+	}
+	if (get_tag(line, "PP", value, sizeof(value)) && (k = ids_find(&pg_renames, value)) >= 0) {
+	  tmp = set_tag(new_line, "PP", pg_renames.lines[k]);
+	  free(new_line);
+	  new_line = tmp;
+	}
+	get_tag(new_line, "ID", id, sizeof(id));
+	if (ids_find(&pg, id) < 0) {
+	  ids_add(&pg, id, new_line);
+	}
+	free(new_line);
+
+      } else {
+	// @CO and user-defined lines, duplicates are removed
+	if (ids_find(&co, line) < 0) {
+	  ids_add(&co, line, "");
+	  text_append(&others, &others_len, &others_max, line, 1);
+	}
+      }
+    }
+
+    if (inputs[i].rg_renames.num) {
+      LOG_WARN_F("%i read groups of %s are renamed in the merged header\n",
+		 inputs[i].rg_renames.num, inputs[i].filename);
+    }
+
+    ids_free(&pg_renames);
+    free(lines);
+    free(text);
+  }
+
+  // merged text: @HD, @SQ, @RG, @PG and the others
+  char *text = NULL;
+  size_t len = 0, max = 0;
+  text_append(&text, &len, &max, hd ? hd : "@HD\tVN:1.0\tSO:coordinate\n", 0);
+  if (sq) { text_append(&text, &len, &max, sq, 0); }
+  for (int i = 0; i < rg.num; i++) {
+    if (get_tag(rg.lines[i], "ID", id, sizeof(id)) && strcmp(id, rg.ids[i]) != 0) {
+      char *new_line = set_tag(rg.lines[i], "ID", rg.ids[i]);
+      text_append(&text, &len, &max, new_line, 1);
+      free(new_line);
+    } else {
+      text_append(&text, &len, &max, rg.lines[i], 1);
+    }
+  }
+  for (int i = 0; i < pg.num; i++) { text_append(&text, &len, &max, pg.lines[i], 1); }
+  if (others) { text_append(&text, &len, &max, others, 0); }
+
+  bam_header_t *header = bam_header_init();
+  header->n_targets = first->n_targets;
+  header->target_name = (char **) calloc(first->n_targets, sizeof(char *));
+  header->target_len = (uint32_t *) calloc(first->n_targets, sizeof(uint32_t));
+  for (int i = 0; i < first->n_targets; i++) {
+    header->target_name[i] = strdup(first->target_name[i]);
+    header->target_len[i] = first->target_len[i];
+  }
+  header->text = text;
+  header->l_text = len;
+
+  if (hd) { free(hd); }
+  if (sq) { free(sq); }
+  if (others) { free(others); }
+  ids_free(&rg);
+  ids_free(&pg);
+  ids_free(&co);
+
+  return header;
+}
+
+//------------------------------------------------------------------------
+// records
+//------------------------------------------------------------------------
+
+static void rename_read_group(merge_input_t *input, bam1_t *b) {
+  uint8_t *s = bam_aux_get(b, "RG");
+  if (s == NULL) { return; }
+
+  int k = ids_find(&input->rg_renames, bam_aux2Z(s));
+  if (k >= 0) {
+    char *new_id = input->rg_renames.lines[k];
+    bam_aux_del(b, s);
+    bam_aux_append(b, "RG", 'Z', strlen(new_id) + 1, (uint8_t *) new_id);
+  }
+}
+
+//------------------------------------------------------------------------
+
+// unplaced reads (tid -1) go at the end
+static inline int record_cmp(const bam1_t *a, const bam1_t *b) {
+  uint32_t tid_a = a->core.tid, tid_b = b->core.tid;
+  if (tid_a != tid_b) { return (tid_a < tid_b ? -1 : 1); }
+  if (a->core.pos != b->core.pos) { return (a->core.pos < b->core.pos ? -1 : 1); }
+  return (int) bam1_strand(a) - (int) bam1_strand(b);
+}
+
+// reads the next record of the input in 'b', returns the previous record
+// to be recycled by the caller
+static bam1_t *merge_next(merge_input_t *input, bam1_t *b) {
+  bam1_t *prev = input->bam;
+  input->bam = b;
+
+  int ret = bgzf_mt_read_bam1(input->reader, b);
+  if (ret == -1) {
+    input->eof = 1;
+  } else if (ret < -1) {
+    LOG_FATAL_F("Truncated or corrupted BAM file %s\n", input->filename);
+  } else {
+    if (input->num_records &&
+	((uint32_t) prev->core.tid > (uint32_t) b->core.tid ||
+	 (prev->core.tid == b->core.tid && prev->core.pos > b->core.pos))) {
+      LOG_FATAL_F("%s is not sorted by coordinate (record %lu)\n",
+		  input->filename, input->num_records + 1);
+    }
+    input->num_records++;
+  }
+
+  return prev;
+}
+
+//------------------------------------------------------------------------
+// loser tree, tree[0] is the input with the next record
+//------------------------------------------------------------------------
+
+// whether the record of input a goes after the one of input b, the
+// index num_inputs is a sentinel smaller than any input
+static inline int merge_after(merge_input_t *inputs, int num_inputs, int a, int b) {
+  if (b == num_inputs) { return 1; }
+  if (a == num_inputs) { return 0; }
+
+  merge_input_t *x = &inputs[a], *y = &inputs[b];
+  if (x->eof || y->eof) {
+    return (x->eof != y->eof ? x->eof : a > b);
+  }
+  int cmp = record_cmp(x->bam, y->bam);
+  return (cmp ? cmp > 0 : a > b);
+}
+
+static void loser_tree_adjust(int *tree, merge_input_t *inputs, int num_inputs, int s) {
+  for (int t = (s + num_inputs) / 2; t > 0; t /= 2) {
+    if (merge_after(inputs, num_inputs, s, tree[t])) {
+      int tmp = s;
+      s = tree[t];
+      tree[t] = tmp;
+    }
+  }
+  tree[0] = s;
+}
+
+static int *loser_tree_new(merge_input_t *inputs, int num_inputs) {
+  int *tree = (int *) malloc(num_inputs * sizeof(int));
+  for (int i = 0; i < num_inputs; i++) {
+    tree[i] = num_inputs;
+  }
+  for (int i = num_inputs - 1; i >= 0; i--) {
+    loser_tree_adjust(tree, inputs, num_inputs, i);
+  }
+  return tree;
+}
+
+//------------------------------------------------------------------------
+// output
+//------------------------------------------------------------------------
+
+typedef struct merge_output {
+  char *filename;
+  bgzf_mt_writer_t *writer;
+  bam_index_builder_t *builder;
+} merge_output_t;
+
+static int merge_write(void *data, bam1_t *b) {
+  merge_output_t *output = (merge_output_t *) data;
+
+  uint64_t beg = bgzf_mt_writer_tell(output->writer);
+  if (bgzf_mt_write_bam1(output->writer, b) < 0) {
+    LOG_FATAL_F("Error writing file %s\n", output->filename);
+  }
+  if (output->builder && bam_index_builder_add(output->builder, b, beg, bgzf_mt_writer_tell(output->writer)) != 0) {
+    LOG_FATAL_F("Error indexing file %s, records are not sorted by coordinate\n", output->filename);
+  }
+  return 0;
+}
+
+static uint64_t writer_voffset(void *data, uint64_t offset) {
+  return bgzf_mt_writer_voffset((bgzf_mt_writer_t *) data, offset);
+}
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+
+void merge_bam(merge_options_t *opts) {
+  int num_inputs = opts->num_inputs;
+  merge_input_t *inputs = (merge_input_t *) calloc(num_inputs, sizeof(merge_input_t));
+
+  // the threads are shared out among the inputs for inflating, and all of
+  // them deflate the output
+  int reader_threads = opts->num_threads / num_inputs;
+  if (reader_threads < 1) { reader_threads = 1; }
+
+  for (int i = 0; i < num_inputs; i++) {
+    merge_input_t *input = &inputs[i];
+    input->filename = opts->in_filenames[i];
+    input->reader = bgzf_mt_reader_new(input->filename, 0, reader_threads);
+    if (input->reader == NULL) {
+      LOG_FATAL_F("Could not open file %s\n", input->filename);
+    }
+    input->header = bgzf_mt_read_bam_header(input->reader);
+    if (input->header == NULL) {
+      LOG_FATAL_F("Invalid BAM file %s\n", input->filename);
+    }
+  }
+
+  bam_header_t *header = merge_headers(inputs, num_inputs);
+
+  bgzf_mt_writer_t *writer = bgzf_mt_writer_new(opts->out_filename, opts->compression_level,
+						opts->num_threads);
+  if (writer == NULL) {
+    LOG_FATAL_F("Could not open file %s\n", opts->out_filename);
+  }
+  bgzf_mt_write_bam_header(writer, header);
+
+  bam_index_builder_t *builder = NULL;
+  if (opts->index) {
+    builder = bam_index_builder_new(header, BAM_INDEX_BAI, 0);
+  }
+
+  merge_output_t output = { opts->out_filename, writer, builder };
+  bam_markdup_t *markdup = NULL;
+  if (opts->markdup) {
+    markdup = bam_markdup_new(header, opts->remove_duplicates, merge_write, &output);
+  }
+
+  // first record of every input
+  bam1_t *free_bam = bam_init1();
+  for (int i = 0; i < num_inputs; i++) {
+    inputs[i].bam = bam_init1();
+    free_bam = merge_next(&inputs[i], free_bam);
+  }
+
+  // k-way merge
+  size_t num_records = 0;
+  int *tree = loser_tree_new(inputs, num_inputs);
+  while (1) {
+    int i = tree[0];
+    merge_input_t *input = &inputs[i];
+    if (input->eof) { break; }
+
+    if (input->rg_renames.num) {
+      rename_read_group(input, input->bam);
+    }
+
+    // the record goes out once the next one of its input is read (and
+    // checked against it)
+    bam1_t *b = merge_next(input, free_bam);
+    if (markdup) {
+      free_bam = bam_markdup_add(markdup, b);
+      if (bam_markdup_error(markdup)) {
+	LOG_FATAL_F("Error marking duplicates in %s\n", opts->out_filename);
+      }
+    } else {
+      merge_write(&output, b);
+      free_bam = b;
+    }
+    num_records++;
+
+    loser_tree_adjust(tree, inputs, num_inputs, i);
+  }
+
+  if (markdup) {
+    bam_markdup_flush(markdup);
+    if (bam_markdup_error(markdup)) {
+      LOG_FATAL_F("Error marking duplicates in %s\n", opts->out_filename);
+    }
+  }
+
+  uint64_t end = bgzf_mt_writer_tell(writer);
+  if (bgzf_mt_writer_close(writer) != 0) {
+    LOG_FATAL_F("Error writing file %s\n", opts->out_filename);
+  }
+
+  printf("Merged %lu records from %i files in %s\n", num_records, num_inputs, opts->out_filename);
+
+  if (markdup) {
+    const bam_markdup_stats_t *stats = bam_markdup_stats(markdup);
+    printf("Duplicates: %lu of %lu fragments, %lu of %lu pairs", stats->num_dup_fragments,
+	   stats->num_fragments, stats->num_dup_pairs, stats->num_pairs);
+    if (opts->remove_duplicates) {
+      printf(", %lu records removed", stats->num_removed);
+    }
+    printf("\n");
+    bam_markdup_free(markdup);
+  }
+
+  if (builder) {
+    char idx_filename[strlen(opts->out_filename) + 5];
+    bam_index_filename(opts->out_filename, builder->format, idx_filename);
+
+    bam_index_builder_finish(builder, end);
+    if (bam_index_builder_save(builder, idx_filename, writer_voffset, writer) != 0) {
+      LOG_FATAL_F("Could not write index file %s\n", idx_filename);
+    }
+    bam_index_builder_free(builder);
+
+    printf("Index created in %s\n", idx_filename);
+  }
+
+  // free memory
+  free(tree);
+  bam_destroy1(free_bam);
+  for (int i = 0; i < num_inputs; i++) {
+    bam_destroy1(inputs[i].bam);
+    bam_header_destroy(inputs[i].header);
+    bgzf_mt_reader_free(inputs[i].reader);
+    ids_free(&inputs[i].rg_renames);
+  }
+  free(inputs);
+  bam_header_destroy(header);
+  bgzf_mt_writer_free(writer);
+}
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
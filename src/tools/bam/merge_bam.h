@@ -0,0 +1,41 @@
+#ifndef MERGE_BAM_H
+#define MERGE_BAM_H
+
+/*
+ * merge_bam.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bioformats/bam/samtools/bam.h"
+
+#include "aux/aux_bgzf.h"
+#include "aux/aux_bam_index.h"
+#include "aux/aux_bam_markdup.h"
+
+#include "merge_options.h"
+
+//------------------------------------------------------------------------
+
+// k-way merge of coordinate-sorted BAM files: the inputs are inflated
+// and the output deflated on several threads (aux_bgzf), and the next
+// record comes from a loser tree over the inputs
+//
+// all the inputs must have the same reference sequences, read groups
+// and programs are merged (clashing IDs are renamed, and the RG tag of
+// the records is updated)
+//
+// duplicates can be marked (or removed) on the way to the output
+// (aux_bam_markdup)
+
+void merge_bam(merge_options_t *opts);
+
+//------------------------------------------------------------------------
+
+#endif // end of MERGE_BAM_H
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
@@ -0,0 +1,229 @@
+#include "merge_options.h"
+
+//------------------------------------------------------------------------
+
+void usage_merge_options(merge_options_t *opts);
+
+void **new_argtable_merge_options();
+merge_options_t *read_cli_merge_options(void **argtable, merge_options_t *opts);
+
+extern void free_argtable(int num_options, void **argtable);
+extern void usage_argtable(char *exec_name, char *command_name, void **argtable);
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+
+merge_options_t *merge_options_new(char *exec_name, char *command_name) {
+  merge_options_t *opts = (merge_options_t*) calloc (1, sizeof(merge_options_t));
+  
+  opts->help = 0;
+  opts->num_threads = DEFAULT_MERGE_NUM_THREADS;
+  opts->index = 0;
+  opts->compression_level = -1;
+  opts->markdup = 0;
+  opts->remove_duplicates = 0;
+
+  opts->num_inputs = 0;
+  opts->in_filenames = (char **) calloc(MAX_MERGE_INPUTS, sizeof(char *));
+  opts->in_list_filename = NULL;
+  opts->out_filename = NULL;
+
+  opts->exec_name = strdup(exec_name);
+  opts->command_name = strdup(command_name);
+
+  return opts;
+}
+
+//------------------------------------------------------------------------
+
+merge_options_t *merge_options_parse(char *exec_name, char *command_name,
+				     int argc, char **argv) {
+  void **argtable = new_argtable_merge_options();
+  
+  merge_options_t *opts = merge_options_new(exec_name, command_name);
+  if (argc < 2) {
+    usage_argtable(exec_name, command_name, argtable);
+  } else {  
+    int num_errors = arg_parse(argc, argv, argtable);
+    
+    // show help
+    if (((struct arg_int*) argtable[0])->count) {
+      usage_argtable(exec_name, command_name, argtable);
+    }
+        
+    if (num_errors > 0) {
+      arg_print_errors(stdout, argtable[NUM_MERGE_OPTIONS], exec_name);
+      usage_argtable(exec_name, command_name, argtable);
+    } else {
+      opts = read_cli_merge_options(argtable, opts);
+      if (opts->help) {
+	usage_argtable(exec_name, command_name, argtable);
+      }
+    }
+  }
+
+  free_argtable(NUM_MERGE_OPTIONS + 1, argtable);
+
+  return opts;
+}
+
+//------------------------------------------------------------------------
+
+void merge_options_free(merge_options_t *opts) {
+  if (opts == NULL) { return; }
+  
+  for (int i = 0; i < opts->num_inputs; i++) {
+    free(opts->in_filenames[i]);
+  }
+  free(opts->in_filenames);
+  if (opts->in_list_filename) { free(opts->in_list_filename); }
+  if (opts->out_filename) { free(opts->out_filename); }
+  
+  if (opts->exec_name) { free(opts->exec_name); }
+  if (opts->command_name) { free(opts->command_name); }
+  
+  free(opts);
+}
+
+//------------------------------------------------------------------------
+
+void merge_options_validate(merge_options_t *opts) {
+  // input files listed in a file, one per line
+  if (opts->in_list_filename) {
+    FILE *fd = fopen(opts->in_list_filename, "r");
+    if (fd == NULL) {
+      printf("\nError: Input list file %s not found !\n\n", opts->in_list_filename);
+      usage_merge_options(opts);
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), fd)) {
+      size_t len = strlen(line);
+      while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' ')) {
+	line[--len] = 0;
+      }
+      if (len == 0 || line[0] == '#') { continue; }
+      if (opts->num_inputs >= MAX_MERGE_INPUTS) {
+	printf("\nError: Too many input files, the maximum is %i !\n\n", MAX_MERGE_INPUTS);
+	usage_merge_options(opts);
+      }
+      opts->in_filenames[opts->num_inputs++] = strdup(line);
+    }
+    fclose(fd);
+  }
+
+  if (opts->num_inputs < 2) {
+    printf("\nError: At least two input files are required !\n\n");
+    usage_merge_options(opts);
+  }
+
+  for (int i = 0; i < opts->num_inputs; i++) {
+    if (! exists(opts->in_filenames[i])) {
+      printf("\nError: Input file name %s not found !\n\n", opts->in_filenames[i]);
+      usage_merge_options(opts);
+    }
+  }
+
+  if (!opts->out_filename) {
+    opts->out_filename = strdup(DEFAULT_MERGE_OUT_FILENAME);
+  }
+
+  for (int i = 0; i < opts->num_inputs; i++) {
+    if (strcmp(opts->in_filenames[i], opts->out_filename) == 0) {
+      printf("\nError: Output file name %s is also an input file !\n\n", opts->out_filename);
+      usage_merge_options(opts);
+    }
+  }
+
+  if (opts->num_threads < 1) {
+    printf("\nError: Invalid number of threads (%i), it must be greater than 0 !\n\n",
+	   opts->num_threads);
+    usage_merge_options(opts);
+  }
+
+  if (opts->compression_level < -1 || opts->compression_level > 9) {
+    printf("\nError: Invalid compression level (%i), valid values are from 0 to 9 !\n\n",
+	   opts->compression_level);
+    usage_merge_options(opts);
+  }
+
+  if (opts->remove_duplicates && !opts->markdup) {
+    printf("\nError: --remove-duplicates requires --markdup !\n\n");
+    usage_merge_options(opts);
+  }
+}
+
+//------------------------------------------------------------------------
+
+void merge_options_display(merge_options_t *opts) {
+  printf("PARAMETERS CONFIGURATION\n");
+  printf("=================================================\n");
+  printf("Main options\n");
+  printf("\tBAM input filenames : %i files\n", opts->num_inputs);
+  for (int i = 0; i < opts->num_inputs; i++) {
+    printf("\t\t%s\n", opts->in_filenames[i]);
+  }
+  printf("\tOutput filename     : %s\n", opts->out_filename);
+  printf("\tIndex output        : %s\n", opts->index ? "yes" : "no");
+  if (opts->compression_level >= 0) {
+    printf("\tCompression level   : %i\n", opts->compression_level);
+  } else {
+    printf("\tCompression level   : default\n");
+  }
+  printf("\tMark duplicates     : %s\n", opts->markdup ? (opts->remove_duplicates ? "yes (removed)" : "yes") : "no");
+  printf("\n");
+
+  printf("Architecture options\n");
+  printf("\tNum. threads: %d\n", opts->num_threads);
+  printf("=================================================\n");
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+merge_options_t *read_cli_merge_options(void **argtable, merge_options_t *opts) {	
+  if (((struct arg_int*)argtable[0])->count) { opts->help = ((struct arg_int*)argtable[0])->count; }
+  for (int i = 0; i < ((struct arg_file*)argtable[1])->count && opts->num_inputs < MAX_MERGE_INPUTS; i++) {
+    opts->in_filenames[opts->num_inputs++] = strdup(((struct arg_file*)argtable[1])->filename[i]);
+  }
+  if (((struct arg_file*)argtable[2])->count) { opts->in_list_filename = strdup(*(((struct arg_file*)argtable[2])->filename)); }
+  if (((struct arg_file*)argtable[3])->count) { opts->out_filename = strdup(*(((struct arg_file*)argtable[3])->filename)); }
+  if (((struct arg_int*)argtable[4])->count) { opts->num_threads = *(((struct arg_int*)argtable[4])->ival); }
+  if (((struct arg_int*)argtable[5])->count) { opts->index = ((struct arg_int*)argtable[5])->count; }
+  if (((struct arg_int*)argtable[6])->count) { opts->compression_level = *(((struct arg_int*)argtable[6])->ival); }
+  if (((struct arg_int*)argtable[7])->count) { opts->markdup = ((struct arg_int*)argtable[7])->count; }
+  if (((struct arg_int*)argtable[8])->count) { opts->remove_duplicates = ((struct arg_int*)argtable[8])->count; }
+  
+  return opts;
+}
+
+//--------------------------------------------------------------------
+
+void usage_merge_options(merge_options_t *opts) {
+  void **argtable = new_argtable_merge_options();
+  usage_argtable(opts->exec_name, opts->command_name, argtable);
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+void** new_argtable_merge_options() {
+  void **argtable = (void**)malloc((NUM_MERGE_OPTIONS + 1) * sizeof(void*));
+  
+  // NOTICE that order cannot be changed as is accessed by index in other functions
+  argtable[0] = arg_lit0("h", "help", "Help option");
+  argtable[1] = arg_filen("b", "bam-file", NULL, 0, MAX_MERGE_INPUTS, "Input file name (BAM format, sorted by coordinate), repeat it for every input file");
+  argtable[2] = arg_file0(NULL, "bam-list", NULL, "File with the input file names, one per line");
+  argtable[3] = arg_file0("o", "out-file", NULL, "Output file name (BAM format) [merged.bam]");
+  argtable[4] = arg_int0(NULL, "num-threads", NULL, "Number of threads to decompress and compress the BAM blocks [4]");
+  argtable[5] = arg_lit0(NULL, "index", "Create the index of the output file while it is written (BAI, CSI for references longer than 512 Mbp)");
+  argtable[6] = arg_int0(NULL, "compression-level", NULL, "Compression level of the output file, from 0 to 9 [zlib default]");
+  argtable[7] = arg_lit0(NULL, "markdup", "Mark the duplicate reads of the output while it is written");
+  argtable[8] = arg_lit0(NULL, "remove-duplicates", "Remove the duplicate reads instead of marking them (with --markdup)");
+  
+  argtable[NUM_MERGE_OPTIONS] = arg_end(20);
+  
+  return argtable;
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
@@ -0,0 +1,65 @@
+#ifndef MERGE_OPTIONS_H
+#define MERGE_OPTIONS_H
+
+/*
+ * merge_options.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "argtable2.h"
+#include "libconfig.h"
+#include "commons/log.h"
+#include "commons/system_utils.h"
+#include "commons/file_utils.h"
+
+//============================ DEFAULT VALUES ============================
+
+#define DEFAULT_MERGE_OUT_FILENAME  "merged.bam"
+#define DEFAULT_MERGE_NUM_THREADS   4
+
+#define MAX_MERGE_INPUTS            4096
+
+//------------------------------------------------------------------------
+
+#define NUM_MERGE_OPTIONS	9
+
+//------------------------------------------------------------------------
+
+typedef struct merge_options { 
+  int help;
+  int num_threads;
+  int index;
+  int compression_level;
+  int markdup;
+  int remove_duplicates;
+
+  int num_inputs;
+  char **in_filenames;
+  char *in_list_filename;
+  char *out_filename;
+
+  char *exec_name;
+  char *command_name;
+} merge_options_t;
+
+//------------------------------------------------------------------------
+
+merge_options_t *merge_options_new(char *exec_name, char *command_nane);
+
+merge_options_t *merge_options_parse(char *exec_name, char *command_nane,
+				     int argc, char **argv);
+
+void merge_options_free(merge_options_t *opts);
+
+void merge_options_validate(merge_options_t *opts);
+
+void merge_options_display(merge_options_t *opts);
+
+//------------------------------------------------------------------------
+//------------------------------------------------------------------------
+
+#endif
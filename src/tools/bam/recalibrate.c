@@ -46,7 +46,8 @@ int mymain(	int full,
 					const char *infofile,
 					int infocount,
 					const char *stats,
-					int statscount)
+					int statscount,
+					const recal_sample_t *sample)
 {	
 	char *refc, *inputc, *outputc, *infofilec, *datafilec, *statsc;
 	char *sched;
@@ -188,19 +189,19 @@ int mymain(	int full,
 	if(p1 && p2)
 	{
 		printf("Full recalibration\n");
-		recal_bam_file(RECALIBRATE_COLLECT | RECALIBRATE_RECALIBRATE, inputc, refc, datafilec, infofilec, outputc, cycles, statsc);
+		recal_bam_file(RECALIBRATE_COLLECT | RECALIBRATE_RECALIBRATE, inputc, refc, datafilec, infofilec, outputc, cycles, statsc, sample);
 	}
 	else
 	{
 		if(p1)
 		{
 			printf("Phase 1 recalibration\n");
-			recal_bam_file(RECALIBRATE_COLLECT, inputc, refc, datafilec, infofilec, outputc, cycles, statsc);
+			recal_bam_file(RECALIBRATE_COLLECT, inputc, refc, datafilec, infofilec, outputc, cycles, statsc, sample);
 		}
 		else
 		{
 			printf("Phase 2 recalibration\n");
-			recal_bam_file(RECALIBRATE_RECALIBRATE, inputc, refc, datafilec, infofilec, outputc, cycles, statsc);
+			recal_bam_file(RECALIBRATE_RECALIBRATE, inputc, refc, datafilec, infofilec, outputc, cycles, statsc, sample);
 		}
 	}
 	if(inputc)
@@ -225,6 +226,7 @@ int mymain(	int full,
 int recalibrate_bam(int argc, char **argv)
 {
 	int thr;
+	recal_sample_t sample;
 
     //struct arg_lit  *recurse = arg_lit0("R",NULL,                       "recurse through subdirectories");
     //struct arg_int  *repeat  = arg_int0("k","scalar",NULL,              "define scalar value k (default is 3)");
@@ -244,11 +246,14 @@ int recalibrate_bam(int argc, char **argv)
     struct arg_file *datafile = arg_file0("d",NULL,"<data>","data file containing recalibration information");
     struct arg_file *infofile = arg_file0("i",NULL,"<info>","info file (human readable) containing recalibration information");
     struct arg_file *stats = arg_file0("s",NULL,"<stats>","folder to store timing stats");
+    struct arg_dbl  *sfraction = arg_dbl0(NULL,"sample-fraction",NULL,"fraction of reads to collect in first part, default: 1.0");
+    struct arg_int  *sbases = arg_int0(NULL,"sample-bases",NULL,"stop collecting when every quality with data has this number of bases");
+    struct arg_dbl  *serror = arg_dbl0(NULL,"sample-error",NULL,"stop collecting when quality deltas are known within this error (95% confidence)");
     struct arg_lit  *help    = arg_lit0("h","help","print this help and exit");
     struct arg_lit  *version = arg_lit0(NULL,"version","print version information and exit");
     struct arg_end  *end     = arg_end(20);
     
-    void* argtable[] = {full,phase1,phase2,cycles,threads,refile,infile,outfile,datafile,infofile,stats,help,version,end};
+    void* argtable[] = {full,phase1,phase2,cycles,threads,refile,infile,outfile,datafile,infofile,stats,sfraction,sbases,serror,help,version,end};
     const char* progname = "hpg-bam recalibrate v"RECAL_VER;
     int nerrors;
     int exitcode=0;
@@ -332,6 +337,23 @@ int recalibrate_bam(int argc, char **argv)
 		thr = threads->ival[0];
 	}
 
+	//Sampled collection
+	sample.fraction = 1.0;
+	sample.qual_bases = 0;
+	sample.max_error = 0.0;
+	if(sfraction->count > 0)
+		sample.fraction = sfraction->dval[0];
+	if(sbases->count > 0)
+		sample.qual_bases = sbases->ival[0];
+	if(serror->count > 0)
+		sample.max_error = serror->dval[0];
+	if(sample.fraction <= 0.0 || sample.fraction > 1.0)
+	{
+		printf("Please, specify a sample fraction between 0 and 1.\n");
+		exitcode = 1;
+		goto exit;
+	}
+
 
     /* normal case: take the command line options at face value */
     exitcode = mymain(	full->count,
@@ -350,7 +372,8 @@ int recalibrate_bam(int argc, char **argv)
 						infofile->filename[0],
 						infofile->count,
 						stats->filename[0],
-						stats->count
+						stats->count,
+						(sfraction->count + sbases->count + serror->count) > 0 ? &sample : NULL
 						);
 
     exit:
@@ -277,6 +277,60 @@ recal_recalibrate_alignment(bam1_t* alig, const recal_info_t *bam_info, recal_re
 	return NO_ERROR;
 }
 
+/**
+ * Recalibrate alignment with lookup table.
+ */
+ERROR_CODE
+recal_recalibrate_alignment_table(bam1_t* alig, const recal_table_t *table)
+{
+	const uint8_t *bam_seq;
+	uint8_t *bam_quals;
+	const uint8_t *cycle_quals;
+	U_CYCLES bam_seq_l;
+	unsigned int cycle_size;
+	unsigned int i;
+	unsigned int qual_index;
+	int prev, cur;
+
+	//CHECK ARGUMENTS
+	{
+		//Check nulls
+		if(!alig || !table)
+			return INVALID_INPUT_PARAMS_NULL;
+	}
+
+	//Sequence length
+	bam_seq_l = alig->core.l_qseq;
+	if(bam_seq_l > table->num_cycles || bam_seq_l == 0)
+	{
+		return INVALID_SEQ_LENGTH;
+	}
+
+	//Sequence and qualities in place
+	bam_seq = bam1_seq(alig);
+	bam_quals = bam1_qual(alig);
+
+	//Iterates nucleotides in this read, one lookup per base
+	cycle_size = RECAL_TABLE_ROWS * table->num_quals;
+	cycle_quals = table->quals;
+	prev = 0;
+	for(i = 0; i < bam_seq_l; i++, cycle_quals += cycle_size)
+	{
+		cur = bam1_seqi(bam_seq, i);
+
+		//Qualities out of table are not recalibrated
+		qual_index = (uint8_t)(bam_quals[i] - table->min_qual);
+		if(qual_index < table->num_quals)
+		{
+			bam_quals[i] = cycle_quals[table->rows[prev << 4 | cur] * table->num_quals + qual_index];
+		}
+
+		prev = cur;
+	}
+
+	return NO_ERROR;
+}
+
 //Function for library internal use
 static INLINE void
 recal_recalibrate_alignment_priv(bam1_t* alig, const recal_info_t *bam_info, recal_recalibration_env_t *recalibration_env)
@@ -356,7 +410,7 @@ recal_recalibrate_alignment_priv(bam1_t* alig, const recal_info_t *bam_info, rec
 			if(i > 0)
 			{
 				recal_get_dinuc(bam_seq[i-1], bam_seq[i], &dinuc);
-				matrix_index = qual_index * bam_info->num_dinuc + i;
+				matrix_index = qual_index * bam_info->num_dinuc + dinuc;
 				delta_rd = bam_info->qual_dinuc_delta[matrix_index];
 			}
 			else
@@ -23,6 +23,7 @@
 #include <bioformats/bam/alignment.h>
 #include <aligners/bwt/genome.h>
 #include "aux/aux_common.h"
+#include "aux/aux_simd.h"
 #include "bfwork/bfwork.h"
 
 #define RECAL_REFERENCE_CORRECTION_OFFSET 1
@@ -66,6 +67,23 @@ struct recal_info {
     double* qual_dinuc_miss;		//Misses per quality-dinuc pair
     U_BASES* qual_dinuc_bases;		//Bases per quality-dinuc pair
     double* qual_dinuc_delta;		//Deltas per quality-dinuc pair
+
+    //Integer counters of data collection (bases and misses interleaved), added to previous vectors by recal_flush_counts
+    uint32_t* cycle_counts;		//Counters per cycle-quality pair
+    uint32_t* dinuc_counts;		//Counters per quality-dinuc pair
+    U_BASES counts_bases;		//Bases in counters
+};
+
+/**
+ * \brief Sampled data collection parameters.
+ *
+ * Reads are sampled by name (both mates together). Collection stops when
+ * the targets are reached by all the qualities holding some share of bases.
+ */
+struct recal_sample {
+	double fraction;	//Fraction of reads to collect, 1 for all
+	U_BASES qual_bases;	//Bases wanted per quality, 0 for no target
+	double max_error;	//Maximum half-width of quality deltas confidence intervals, 0 for no target
 };
 
 /**
@@ -84,6 +102,7 @@ struct recalibration_env;
 typedef struct recal_info recal_info_t;
 typedef struct data_collect_env recal_data_collect_env_t;
 typedef struct recalibration_env recal_recalibration_env_t;
+typedef struct recal_sample recal_sample_t;
 
 /**
  * \brief Dinucleotide enumeration.
@@ -111,6 +130,25 @@ typedef enum DINUC
 	d_X = 16	/* Not a dinucleotide. For example "NT" or "NN".*/
 } DINUCLEOTIDE;
 
+/**
+ * \brief Recalibration lookup table.
+ *
+ * New quality of every cycle-dinucleotide-quality triplet, precomputed from
+ * recalibration data to recalibrate alignments with one lookup per base.
+ */
+#define RECAL_TABLE_ROW_N	(d_X + 1)	//Row of bases not recalibrated ('N')
+#define RECAL_TABLE_ROWS	(d_X + 2)
+
+struct recal_table {
+	U_QUALS min_qual;	//Minor quality in table
+	U_QUALS num_quals;	//Range of qualities in table
+	U_CYCLES num_cycles;	//Maximum number of cycles
+
+	uint8_t rows[256];	//Row per previous and current BAM base (4 bits each)
+	uint8_t *quals;		//New qualities per cycle-row-quality
+};
+typedef struct recal_table recal_table_t;
+
 /***********************************************
  * DATA MANAGEMENT
  **********************************************/
@@ -176,6 +214,23 @@ EXTERNC ERROR_CODE recal_recalibration_init_env(const U_CYCLES cycles, recal_rec
  */
 EXTERNC ERROR_CODE recal_recalibration_destroy_env(recal_recalibration_env_t *recalibration_env);
 
+/**
+ * \brief Initialize recalibration lookup table from recalibration data.
+ *
+ * Data deltas must be computed.
+ *
+ * \param bam_info Data struct with recalibration info.
+ * \param out_table Previously allocated table struct to initialize.
+ */
+EXTERNC ERROR_CODE recal_table_init(const recal_info_t *bam_info, recal_table_t *out_table);
+
+/**
+ * \brief Free all resources of recalibration lookup table.
+ *
+ * \param table Table struct to free
+ */
+EXTERNC ERROR_CODE recal_table_destroy(recal_table_t *table);
+
 /**
  * \brief Add recalibration data from one base.
  *
@@ -191,6 +246,7 @@ EXTERNC ERROR_CODE recal_add_base(recal_info_t *data, const char qual, const U_C
  * \brief Add recalibration data from vector of bases.
  *
  * Function checks if sequence nucleotides are valid.
+ * Bases are counted in integer counters, see recal_flush_counts.
  *
  * \param data Vector of data structs to add stats.
  * \param seq Sequence vector.
@@ -202,6 +258,32 @@ EXTERNC ERROR_CODE recal_add_base(recal_info_t *data, const char qual, const U_C
  */
 EXTERNC ERROR_CODE recal_add_base_v(recal_info_t *data, const char *seq, const char *quals, const U_CYCLES init_cycle, const U_CYCLES num_cycles, const char *dinuc, const char *misses, const char *mask) __ATTR_HOT;
 
+/**
+ * Select the bases to count of a block, one bit per base (bit i for base i).
+ * Variant for each instruction set, selected at run time (see aux_simd.h).
+ *
+ * \param seq Sequence vector.
+ * \param quals Qualities vector.
+ * \param mask Mask vector, bases with mask 0 are not selected. OPTIONAL.
+ * \param seq_l Number of bases, 64 maximum.
+ * \param out_valid Valid bases: A, C, G, T (and N) with quality to stat.
+ * \param out_bad Valid bases with quality out of range.
+ */
+EXTERNC void recal_select_bases_scalar(const char *seq, const char *quals, const char *mask, size_t seq_l, uint64_t *out_valid, uint64_t *out_bad);
+#ifdef SIMD_X86
+EXTERNC void recal_select_bases_sse2(const char *seq, const char *quals, const char *mask, size_t seq_l, uint64_t *out_valid, uint64_t *out_bad);
+EXTERNC void recal_select_bases_avx2(const char *seq, const char *quals, const char *mask, size_t seq_l, uint64_t *out_valid, uint64_t *out_bad);
+EXTERNC void recal_select_bases_avx512(const char *seq, const char *quals, const char *mask, size_t seq_l, uint64_t *out_valid, uint64_t *out_bad);
+#endif
+
+/**
+ * \brief Add integer counters of data collection to bases and misses vectors.
+ * Reduction and delta computation flush counters, so only needed to read vectors after collection.
+ *
+ * \param data Data struct to flush.
+ */
+EXTERNC ERROR_CODE recal_flush_counts(recal_info_t *data);
+
 /**
  * \brief Compute deltas from bases and misses.
  *
@@ -209,6 +291,17 @@ EXTERNC ERROR_CODE recal_add_base_v(recal_info_t *data, const char *seq, const c
  */
 EXTERNC ERROR_CODE recal_calc_deltas(recal_info_t* data);
 
+/**
+ * \brief Compute half-width of quality deltas confidence intervals.
+ *
+ * Deltas must be computed.
+ *
+ * \param data Data with deltas.
+ * \param confidence Probability of intervals (e.g. 0.95).
+ * \param out_errors Vector of num_quals half-widths (0 for qualities without bases).
+ */
+EXTERNC ERROR_CODE recal_get_qual_errors(const recal_info_t* data, double confidence, double *out_errors);
+
 
 /***********************************************
  * DINUC ENUM OPERATIONS
@@ -307,6 +400,16 @@ EXTERNC ERROR_CODE recal_recalibrate_batch(const bam_batch_t* batch, const recal
  */
 EXTERNC ERROR_CODE recal_recalibrate_alignment(bam1_t* alig, const recal_info_t *bam_info, recal_recalibration_env_t *recalibration_env) __ATTR_HOT;
 
+/**
+ * \brief Recalibrate alignment with lookup table.
+ *
+ * Same qualities as recal_recalibrate_alignment, clamped to valid Sanger qualities.
+ *
+ * \param alig BAM alignment struct to recalibrate.
+ * \param table Lookup table from recalibration info.
+ */
+EXTERNC ERROR_CODE recal_recalibrate_alignment_table(bam1_t* alig, const recal_table_t *table) __ATTR_HOT;
+
 
 /***********************************************
  * FILE OPERATIONS
@@ -34,6 +34,7 @@
  * Recalibration parameters
  */
 #define MIN_QUALITY_TO_STAT 6
+#define MAX_COUNTS_BASES 0xFFFFFFFFu	//Integer counters are flushed before this number of bases
 #define NOT_COUNT_NUCLEOTIDE_N
 #define STAT_FIRST_DINUC
 #define NOT_MAPPING_QUAL_ZERO //Reads with map score of 0 wont be stated
@@ -42,6 +43,13 @@
 //#define SPLIT_BATCHS_BY_CHROM
 #define USE_SSE
 
+/**
+ * Sampled data collection
+ */
+#define SAMPLE_CHECK_BASES 20000000	//Collected bases between convergence checks
+#define SAMPLE_CONFIDENCE 0.95	//Probability of quality deltas intervals
+#define SAMPLE_MIN_QUAL_SHARE 0.001	//Qualities with less share of bases are not checked
+
 //#define D_MAX_READS_W 1000
 
 /**
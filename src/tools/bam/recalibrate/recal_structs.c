@@ -73,6 +73,11 @@ recal_init_info(const U_CYCLES cycles, recal_info_t *out_data)
 	memset(data->qual_cycle_bases, 0, vector_size * cycles * sizeof(U_BASES));
 	memset(data->qual_dinuc_bases, 0, vector_size * NUM_DINUC * sizeof(U_BASES));
 
+	//Integer counters are allocated on first collection
+	data->cycle_counts = NULL;
+	data->dinuc_counts = NULL;
+	data->counts_bases = 0;
+
 	return NO_ERROR;
 }
 
@@ -99,6 +104,13 @@ recal_destroy_info(recal_info_t *data)
 	free(d->qual_dinuc_bases);
 	free(d->qual_dinuc_delta);
 
+	//Free integer counters
+	if(d->cycle_counts)
+	{
+		_mm_free(d->cycle_counts);
+		_mm_free(d->dinuc_counts);
+	}
+
 	return NO_ERROR;
 }
 
@@ -128,6 +140,10 @@ recal_reduce_info(recal_info_t *dst_data, recal_info_t *src_data)
 			return INVALID_INPUT_PARAMS;
 	}
 
+	//Pending integer counters
+	recal_flush_counts(dst_data);
+	recal_flush_counts(src_data);
+
 	//MERGE
 	//TODO : Potential SSE implementation
 	{
@@ -238,6 +254,102 @@ recal_recalibration_destroy_env(recal_recalibration_env_t *recalibration_env)
 	return NO_ERROR;
 }
 
+/**
+ * Initialize recalibration lookup table from recalibration data.
+ */
+ERROR_CODE
+recal_table_init(const recal_info_t *bam_info, recal_table_t *out_table)
+{
+	U_CYCLES cycle;
+	U_DINUC dinuc;
+	unsigned int row;
+	unsigned int q;
+	int prev, cur;
+	uint8_t *quals;
+	double delta_r, delta_rc, delta_rd;
+	int res;
+
+	//BAM bases as in new_sequence_from_bam (no IUPAC codes)
+	static const char bases[16] = {'N', 'A', 'C', 'N', 'G', 'N', 'N', 'N', 'T', 'N', 'N', 'N', 'N', 'N', 'N', 'N'};
+
+	if(!bam_info || !out_table)
+		return INVALID_INPUT_PARAMS_NULL;
+
+	out_table->min_qual = bam_info->min_qual;
+	out_table->num_quals = bam_info->num_quals;
+	out_table->num_cycles = bam_info->num_cycles;
+
+	//Row of every pair of BAM bases
+	for(prev = 0; prev < 16; prev++)
+	{
+		for(cur = 0; cur < 16; cur++)
+		{
+			recal_get_dinuc(bases[prev], bases[cur], &dinuc);
+			out_table->rows[prev << 4 | cur] = dinuc;
+
+			//Only if the nucleotide is not "N"
+			#ifdef NOT_COUNT_NUCLEOTIDE_N
+			if(bases[cur] == 'N')
+				out_table->rows[prev << 4 | cur] = RECAL_TABLE_ROW_N;
+			#endif
+		}
+	}
+
+	//New qualities
+	out_table->quals = (uint8_t *)malloc(bam_info->num_cycles * RECAL_TABLE_ROWS * bam_info->num_quals * sizeof(uint8_t));
+
+	for(cycle = 0; cycle < bam_info->num_cycles; cycle++)
+	{
+		for(row = 0; row < RECAL_TABLE_ROWS; row++)
+		{
+			quals = out_table->quals + (cycle * RECAL_TABLE_ROWS + row) * bam_info->num_quals;
+
+			for(q = 0; q < bam_info->num_quals; q++)
+			{
+				//Keep quality by default
+				quals[q] = q + bam_info->min_qual;
+
+				if(row == RECAL_TABLE_ROW_N || q + bam_info->min_qual <= MIN_QUALITY_TO_STAT)
+					continue;
+
+				delta_r = bam_info->qual_delta[q];
+				delta_rc = bam_info->qual_cycle_delta[q * bam_info->num_cycles + cycle];
+
+				//dont take prev dinuc in first cycle (delta = 0)
+				if(cycle > 0)
+					delta_rd = bam_info->qual_dinuc_delta[q * bam_info->num_dinuc + row];
+				else
+					delta_rd = 0.0;
+
+				//Recalibration formula
+				res = (int)(bam_info->total_estimated_Q + bam_info->total_delta + delta_r + delta_rc + delta_rd);
+				if(res < P_SANGER_MIN)
+					res = P_SANGER_MIN;
+				if(res > P_SANGER_MAX)
+					res = P_SANGER_MAX;
+				quals[q] = res;
+			}
+		}
+	}
+
+	return NO_ERROR;
+}
+
+/**
+ * Free all resources of recalibration lookup table.
+ */
+ERROR_CODE
+recal_table_destroy(recal_table_t *table)
+{
+	if(!table)
+		return INVALID_INPUT_PARAMS_NULL;
+
+	free(table->quals);
+	table->quals = NULL;
+
+	return NO_ERROR;
+}
+
 /**
  * Add recalibration data from one base.
  */
@@ -299,21 +411,100 @@ recal_add_base(recal_info_t *data, const char qual, const U_CYCLES cycle, const
 	return NO_ERROR;
 }
 
+/**
+ * Count one base in integer counters.
+ */
+static inline void
+recal_count_base(recal_info_t *data, const int qual_index, const U_CYCLES cycle, const char dinuc, const char miss)
+{
+	uint32_t *cell;
+
+	//Quality-cycle counters
+	cell = data->cycle_counts + 2 * (cycle * data->num_quals + qual_index);
+	cell[0]++;
+	cell[1] += (miss != 0);
+
+	//Quality-dinuc counters
+	cell = data->dinuc_counts + 2 * (qual_index * data->num_dinuc + dinuc);
+	cell[0]++;
+	cell[1] += (miss != 0);
+}
+
 /**
  * Add recalibration data from vector of bases
  */
 ERROR_CODE
 recal_add_base_v(recal_info_t *data, const char *seq, const char *quals, const U_CYCLES init_cycle, const U_CYCLES num_cycles, const char *dinuc, const char *misses, const char *mask)
 {
-	U_CYCLES i;
+	U_CYCLES i, j;
 	U_CYCLES cycles;
+	U_CYCLES count_cycles;
+	size_t block_l;
+	uint64_t bits, bad_bits;
+	size_t counts_l;
 	ERROR_CODE err;
 
 	cycles = num_cycles;
 
+	//Allocate integer counters
+	if(data->cycle_counts == NULL)
+	{
+		counts_l = 2 * data->num_cycles * data->num_quals;
+		data->cycle_counts = (uint32_t *) _mm_malloc(counts_l * sizeof(uint32_t), MEM_ALIG_SSE_SIZE);
+		memset(data->cycle_counts, 0, counts_l * sizeof(uint32_t));
+
+		counts_l = 2 * data->num_quals * data->num_dinuc;
+		data->dinuc_counts = (uint32_t *) _mm_malloc(counts_l * sizeof(uint32_t), MEM_ALIG_SSE_SIZE);
+		memset(data->dinuc_counts, 0, counts_l * sizeof(uint32_t));
+	}
+
+	//Flush before counters overflow
+	if(data->counts_bases + cycles > MAX_COUNTS_BASES)
+	{
+		recal_flush_counts(data);
+	}
+
+	//Bases with valid cycle are counted here, others by recal_add_base (error)
+	count_cycles = 0;
+	if(init_cycle < data->num_cycles)
+	{
+		count_cycles = data->num_cycles - init_cycle;
+		if(count_cycles > cycles)
+			count_cycles = cycles;
+	}
+
+	//Select bases to count 64 at a time
+	for(i = 0; i < count_cycles; i += 64)
+	{
+		block_l = count_cycles - i;
+		if(block_l > 64)
+			block_l = 64;
+
+		simd_kernels.recal_select_bases(seq + i, quals + i, mask ? mask + i : NULL, block_l, &bits, &bad_bits);
+
+		//Count selected bases
+		while(bits)
+		{
+			j = i + __builtin_ctzll(bits);
+			if(((bad_bits >> (j - i)) & 1) || (unsigned char)dinuc[j] >= NUM_DINUC)
+			{
+				err = recal_add_base(data, quals[j], j + init_cycle, dinuc[j], misses[j]);
+				if(err)
+					printf("Error %s Base: %c\n", err == INVALID_INPUT_QUAL ? "INVALID_INPUT_QUAL" : "INVALID_INPUT_DINUC", seq[j]);
+			}
+			else
+			{
+				recal_count_base(data, quals[j] - data->min_qual, j + init_cycle, dinuc[j], misses[j]);
+				data->counts_bases++;
+			}
+			bits &= bits - 1;
+		}
+	}
+	i = count_cycles;
+
 	//Iterates cycles
 	//for(i = init_cycle; i <= end_cycle; i++)
-	for(i = 0; i < cycles; i++)
+	for(; i < cycles; i++)
 	{
 		//Check if count this nucleotide
 		if(mask == NULL || mask[i])
@@ -327,6 +518,15 @@ recal_add_base_v(recal_info_t *data, const char *seq, const char *quals, const U
 			#ifndef NOT_COUNT_NUCLEOTIDE_N
 			case 'N':
 			#endif
+				//Valid base, count it
+				if(i < count_cycles && quals[i] >= MIN_QUALITY_TO_STAT && quals[i] < MAX_QUALITY
+						&& dinuc[i] >= 0 && dinuc[i] < NUM_DINUC)
+				{
+					recal_count_base(data, quals[i] - data->min_qual, i + init_cycle, dinuc[i], misses[i]);
+					data->counts_bases++;
+					break;
+				}
+
 				err = recal_add_base(data, quals[i], i + init_cycle, dinuc[i], misses[i]);
 				if(err)
 				{
@@ -355,6 +555,272 @@ recal_add_base_v(recal_info_t *data, const char *seq, const char *quals, const U
 	return NO_ERROR;
 }
 
+/**
+ * Select bases to count, sequential variant.
+ */
+void
+recal_select_bases_scalar(const char *seq, const char *quals, const char *mask, size_t seq_l, uint64_t *out_valid, uint64_t *out_bad)
+{
+	size_t i;
+	uint64_t valid, bad;
+
+	assert(seq_l <= 64);
+
+	valid = 0;
+	bad = 0;
+	for(i = 0; i < seq_l; i++)
+	{
+		switch(seq[i])
+		{
+		case 'A':
+		case 'C':
+		case 'G':
+		case 'T':
+		#ifndef NOT_COUNT_NUCLEOTIDE_N
+		case 'N':
+		#endif
+			//Not masked and quality to stat
+			if((mask == NULL || mask[i]) && (signed char)quals[i] >= MIN_QUALITY_TO_STAT)
+			{
+				valid |= (uint64_t)1 << i;
+				if((signed char)quals[i] >= MAX_QUALITY)
+					bad |= (uint64_t)1 << i;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	*out_valid = valid;
+	*out_bad = bad;
+}
+
+#ifdef SIMD_X86
+
+/**
+ * Select bases to count, SSE2 variant. Tail selected by the sequential variant.
+ */
+__attribute__((target("sse2"))) void
+recal_select_bases_sse2(const char *seq, const char *quals, const char *mask, size_t seq_l, uint64_t *out_valid, uint64_t *out_bad)
+{
+	size_t i;
+	uint64_t valid, bad;
+	uint64_t tail_valid, tail_bad;
+	__m128i v_seq, v_qual, v_valid, v_bad;
+
+	//Constants
+	const __m128i v_zero = _mm_set1_epi8(0);
+	const __m128i v_A = _mm_set1_epi8('A');
+	const __m128i v_C = _mm_set1_epi8('C');
+	const __m128i v_G = _mm_set1_epi8('G');
+	const __m128i v_T = _mm_set1_epi8('T');
+	const __m128i v_min_qual = _mm_set1_epi8(MIN_QUALITY_TO_STAT - 1);
+	const __m128i v_max_qual = _mm_set1_epi8(MAX_QUALITY - 1);
+#ifndef NOT_COUNT_NUCLEOTIDE_N
+	const __m128i v_N = _mm_set1_epi8('N');
+#endif
+
+	assert(seq_l <= 64);
+
+	valid = 0;
+	bad = 0;
+	for(i = 0; i + 16 <= seq_l; i += 16)
+	{
+		//Valid nucleotide
+		v_seq = _mm_loadu_si128((__m128i const *)(seq + i));
+		v_valid = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(v_seq, v_A), _mm_cmpeq_epi8(v_seq, v_C)),
+				_mm_or_si128(_mm_cmpeq_epi8(v_seq, v_G), _mm_cmpeq_epi8(v_seq, v_T)));
+#ifndef NOT_COUNT_NUCLEOTIDE_N
+		v_valid = _mm_or_si128(v_valid, _mm_cmpeq_epi8(v_seq, v_N));
+#endif
+
+		//Not masked
+		if(mask != NULL)
+			v_valid = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const *)(mask + i)), v_zero), v_valid);
+
+		//Quality to stat (signed, negative qualities are never stated)
+		v_qual = _mm_loadu_si128((__m128i const *)(quals + i));
+		v_valid = _mm_and_si128(v_valid, _mm_cmpgt_epi8(v_qual, v_min_qual));
+
+		//Out of range qualities
+		v_bad = _mm_and_si128(v_valid, _mm_cmpgt_epi8(v_qual, v_max_qual));
+
+		valid |= (uint64_t)_mm_movemask_epi8(v_valid) << i;
+		bad |= (uint64_t)_mm_movemask_epi8(v_bad) << i;
+	}
+
+	//Tail
+	if(i < seq_l)
+	{
+		recal_select_bases_scalar(seq + i, quals + i, mask ? mask + i : NULL, seq_l - i, &tail_valid, &tail_bad);
+		valid |= tail_valid << i;
+		bad |= tail_bad << i;
+	}
+
+	*out_valid = valid;
+	*out_bad = bad;
+}
+
+/**
+ * Select bases to count, AVX2 variant. Tail selected by the sequential variant.
+ */
+__attribute__((target("avx2"))) void
+recal_select_bases_avx2(const char *seq, const char *quals, const char *mask, size_t seq_l, uint64_t *out_valid, uint64_t *out_bad)
+{
+	size_t i;
+	uint64_t valid, bad;
+	uint64_t tail_valid, tail_bad;
+	__m256i v_seq, v_qual, v_valid, v_bad;
+
+	//Constants
+	const __m256i v_zero = _mm256_set1_epi8(0);
+	const __m256i v_A = _mm256_set1_epi8('A');
+	const __m256i v_C = _mm256_set1_epi8('C');
+	const __m256i v_G = _mm256_set1_epi8('G');
+	const __m256i v_T = _mm256_set1_epi8('T');
+	const __m256i v_min_qual = _mm256_set1_epi8(MIN_QUALITY_TO_STAT - 1);
+	const __m256i v_max_qual = _mm256_set1_epi8(MAX_QUALITY - 1);
+#ifndef NOT_COUNT_NUCLEOTIDE_N
+	const __m256i v_N = _mm256_set1_epi8('N');
+#endif
+
+	assert(seq_l <= 64);
+
+	valid = 0;
+	bad = 0;
+	for(i = 0; i + 32 <= seq_l; i += 32)
+	{
+		//Valid nucleotide
+		v_seq = _mm256_loadu_si256((__m256i const *)(seq + i));
+		v_valid = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(v_seq, v_A), _mm256_cmpeq_epi8(v_seq, v_C)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(v_seq, v_G), _mm256_cmpeq_epi8(v_seq, v_T)));
+#ifndef NOT_COUNT_NUCLEOTIDE_N
+		v_valid = _mm256_or_si256(v_valid, _mm256_cmpeq_epi8(v_seq, v_N));
+#endif
+
+		//Not masked
+		if(mask != NULL)
+			v_valid = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *)(mask + i)), v_zero), v_valid);
+
+		//Quality to stat (signed, negative qualities are never stated)
+		v_qual = _mm256_loadu_si256((__m256i const *)(quals + i));
+		v_valid = _mm256_and_si256(v_valid, _mm256_cmpgt_epi8(v_qual, v_min_qual));
+
+		//Out of range qualities
+		v_bad = _mm256_and_si256(v_valid, _mm256_cmpgt_epi8(v_qual, v_max_qual));
+
+		valid |= (uint64_t)(uint32_t)_mm256_movemask_epi8(v_valid) << i;
+		bad |= (uint64_t)(uint32_t)_mm256_movemask_epi8(v_bad) << i;
+	}
+
+	//Tail
+	if(i < seq_l)
+	{
+		recal_select_bases_scalar(seq + i, quals + i, mask ? mask + i : NULL, seq_l - i, &tail_valid, &tail_bad);
+		valid |= tail_valid << i;
+		bad |= tail_bad << i;
+	}
+
+	*out_valid = valid;
+	*out_bad = bad;
+}
+
+/**
+ * Select bases to count, AVX-512BW variant. The tail is loaded with a mask.
+ */
+__attribute__((target("avx512f,avx512bw"))) void
+recal_select_bases_avx512(const char *seq, const char *quals, const char *mask, size_t seq_l, uint64_t *out_valid, uint64_t *out_bad)
+{
+	__mmask64 m_load, m_valid;
+	__m512i v_seq, v_qual;
+
+	assert(seq_l <= 64);
+
+	m_load = (seq_l >= 64) ? ~(__mmask64)0 : (((__mmask64)1 << seq_l) - 1);
+
+	//Valid nucleotide
+	v_seq = _mm512_maskz_loadu_epi8(m_load, seq);
+	m_valid = _mm512_cmpeq_epi8_mask(v_seq, _mm512_set1_epi8('A'))
+			| _mm512_cmpeq_epi8_mask(v_seq, _mm512_set1_epi8('C'))
+			| _mm512_cmpeq_epi8_mask(v_seq, _mm512_set1_epi8('G'))
+			| _mm512_cmpeq_epi8_mask(v_seq, _mm512_set1_epi8('T'));
+#ifndef NOT_COUNT_NUCLEOTIDE_N
+	m_valid |= _mm512_cmpeq_epi8_mask(v_seq, _mm512_set1_epi8('N'));
+#endif
+	m_valid &= m_load;
+
+	//Not masked
+	if(mask != NULL)
+		m_valid = _mm512_mask_test_epi8_mask(m_valid, _mm512_maskz_loadu_epi8(m_valid, mask), _mm512_set1_epi8(-1));
+
+	//Quality to stat (signed, negative qualities are never stated)
+	v_qual = _mm512_maskz_loadu_epi8(m_valid, quals);
+	m_valid = _mm512_mask_cmpgt_epi8_mask(m_valid, v_qual, _mm512_set1_epi8(MIN_QUALITY_TO_STAT - 1));
+
+	//Out of range qualities
+	*out_bad = _mm512_mask_cmpgt_epi8_mask(m_valid, v_qual, _mm512_set1_epi8(MAX_QUALITY - 1));
+	*out_valid = m_valid;
+}
+
+#endif	//End SIMD_X86 if
+
+/**
+ * Add integer counters of data collection to bases and misses vectors.
+ */
+ERROR_CODE
+recal_flush_counts(recal_info_t *data)
+{
+	int i, j;
+	int matrix_index;
+	uint32_t *cell;
+
+	if(!data)
+		return INVALID_INPUT_PARAMS_NULL;
+
+	//No counters
+	if(data->cycle_counts == NULL || data->counts_bases == 0)
+		return NO_ERROR;
+
+	//Qual-Cycle matrix
+	for(j = 0; j < data->num_cycles; j++)
+	{
+		for(i = 0; i < data->num_quals; i++)
+		{
+			cell = data->cycle_counts + 2 * (j * data->num_quals + i);
+			matrix_index = i * data->num_cycles + j;
+			data->qual_cycle_bases[matrix_index] += cell[0];
+			data->qual_cycle_miss[matrix_index] += cell[1];
+		}
+	}
+
+	//Qual-Dinuc matrix, quality vector and totals (every counted base has a dinuc)
+	for(i = 0; i < data->num_quals; i++)
+	{
+		for(j = 0; j < data->num_dinuc; j++)
+		{
+			cell = data->dinuc_counts + 2 * (i * data->num_dinuc + j);
+			matrix_index = i * data->num_dinuc + j;
+			data->qual_dinuc_bases[matrix_index] += cell[0];
+			data->qual_dinuc_miss[matrix_index] += cell[1];
+
+			data->qual_bases[i] += cell[0];
+			data->qual_miss[i] += cell[1];
+			data->total_bases += cell[0];
+			data->total_miss += cell[1];
+		}
+	}
+
+	//Reset counters
+	memset(data->cycle_counts, 0, 2 * data->num_cycles * data->num_quals * sizeof(uint32_t));
+	memset(data->dinuc_counts, 0, 2 * data->num_quals * data->num_dinuc * sizeof(uint32_t));
+	data->counts_bases = 0;
+
+	return NO_ERROR;
+}
+
 /**
  * Compute deltas from bases and misses.
  */
@@ -371,6 +837,9 @@ recal_calc_deltas(recal_info_t* data)
 	double emp_Q;
 	double delta;
 
+	//Pending integer counters
+	recal_flush_counts(data);
+
 	//Estimated Q
 	recal_get_estimated_Q(data->qual_bases, data->num_quals, (U_QUALS)0, &estimated_Q);
 
@@ -452,6 +921,36 @@ recal_calc_deltas(recal_info_t* data)
 	return NO_ERROR;
 }
 
+/**
+ * Compute half-width of quality deltas confidence intervals.
+ */
+ERROR_CODE
+recal_get_qual_errors(const recal_info_t* data, double confidence, double *out_errors)
+{
+	int i;
+	double low, high;
+
+	if(!data || !out_errors)
+		return INVALID_INPUT_PARAMS_NULL;
+
+	for(i = 0; i < data->num_quals; i++)
+	{
+		if(data->qual_bases[i] != 0)
+		{
+			//Interval of empirical quality, same prior than delta
+			recal_get_empirical_Q_interval(data->qual_miss[i], data->qual_bases[i], data->total_delta + data->total_estimated_Q,
+					confidence, &low, &high);
+			out_errors[i] = (high - low) / 2.0;
+		}
+		else
+		{
+			out_errors[i] = 0.0;
+		}
+	}
+
+	return NO_ERROR;
+}
+
 /**
  *
  * ENUMERATION FUNCTIONS
@@ -665,10 +1164,10 @@ recal_save_recal_info(const recal_info_t *data, const char *path)
 	fp = fopen(path, "w");
 	if(!fp) LOG_FATAL_F("Cant create \"%s\" file\n", path);
 
-	fwrite(data, sizeof(U_QUALS), 1, fp);	//min_qual
-	fwrite(data, sizeof(U_QUALS), 1, fp);	//num_quals
-	fwrite(data, sizeof(U_CYCLES), 1, fp);	//num_cycles
-	fwrite(data, sizeof(U_DINUC), 1, fp);	//num_dinuc
+	fwrite(&data->min_qual, sizeof(U_QUALS), 1, fp);
+	fwrite(&data->num_quals, sizeof(U_QUALS), 1, fp);
+	fwrite(&data->num_cycles, sizeof(U_CYCLES), 1, fp);
+	fwrite(&data->num_dinuc, sizeof(U_DINUC), 1, fp);
 
 	//Save total counters
 	fwrite(&data->total_miss, sizeof(double), 1, fp);
@@ -703,16 +1202,27 @@ ERROR_CODE
 recal_load_recal_info(const char *path, recal_info_t *data)
 {
 	FILE *fp;
+	U_QUALS min_qual, num_quals;
+	U_CYCLES num_cycles;
+	U_DINUC num_dinuc;
 
 	printf("\n----------------\nLoading recalibration data \"%s\"\n----------------\n", path);
 
 	fp = fopen(path, "r");
 	if(!fp) LOG_FATAL_F("Cant open \"%s\" file\n", path);
 
-	fread(data, sizeof(U_QUALS), 1, fp);	//min_qual
-	fread(data + sizeof(U_QUALS), sizeof(U_QUALS), 1, fp);	//num_quals
-	fread(data + (sizeof(U_QUALS) * 2), sizeof(U_CYCLES), 1, fp);	//num_cycles
-	fread(data + (sizeof(U_QUALS) * 2) + sizeof(U_CYCLES), sizeof(U_DINUC), 1, fp);	//num_dinuc
+	fread(&min_qual, sizeof(U_QUALS), 1, fp);
+	fread(&num_quals, sizeof(U_QUALS), 1, fp);
+	fread(&num_cycles, sizeof(U_CYCLES), 1, fp);
+	fread(&num_dinuc, sizeof(U_DINUC), 1, fp);
+
+	//Data saved with other number of cycles, reinitialize (files of previous versions have no valid header, they need the same cycles)
+	if(min_qual == data->min_qual && num_quals == data->num_quals && num_dinuc == data->num_dinuc
+			&& num_cycles != 0 && num_cycles != data->num_cycles)
+	{
+		recal_destroy_info(data);
+		recal_init_info(num_cycles, data);
+	}
 
 	//Read total counters
 	fread(&data->total_miss, sizeof(double), 1, fp);
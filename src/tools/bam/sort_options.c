@@ -17,6 +17,10 @@ sort_options_t *sort_options_new(char *exec_name, char *command_name) {
   sort_options_t *opts = (sort_options_t*) calloc (1, sizeof(sort_options_t));
   
   opts->help = 0;
+  opts->num_threads = 4;
+  opts->index = 0;
+  opts->markdup = 0;
+  opts->remove_duplicates = 0;
 
   opts->max_memory = 500000000;
   opts->criteria = NULL; //strdup("coord");
@@ -97,6 +101,12 @@ void sort_options_validate(sort_options_t *opts) {
     usage_sort_options(opts);
   }
 
+  if (opts->num_threads < 1) {
+    printf("\nError: Invalid number of threads (%i), it must be greater than 0 !\n\n",
+	   opts->num_threads);
+    usage_sort_options(opts);
+  }
+
   if (!opts->criteria) {
     opts->criteria = strdup("coord");
   }
@@ -106,6 +116,21 @@ void sort_options_validate(sort_options_t *opts) {
     printf("\nError: Invalid criteria by sorting (%s), valid values are 'coord' to sort by chromosomal coordinates (default value), and 'name' to sort by read names\n", opts->criteria);
     usage_sort_options(opts);
   }
+
+  if (opts->index && strcmp("coord", opts->criteria) != 0) {
+    printf("\nError: Only files sorted by chromosomal coordinates can be indexed\n");
+    usage_sort_options(opts);
+  }
+
+  if (opts->markdup && strcmp("coord", opts->criteria) != 0) {
+    printf("\nError: Duplicates can only be marked in files sorted by chromosomal coordinates\n");
+    usage_sort_options(opts);
+  }
+
+  if (opts->remove_duplicates && !opts->markdup) {
+    printf("\nError: --remove-duplicates requires --markdup !\n\n");
+    usage_sort_options(opts);
+  }
 }
 
 //------------------------------------------------------------------------
@@ -124,10 +149,13 @@ void sort_options_display(sort_options_t *opts) {
   } else {
     printf("\tby chromosomal coordinates\n");
   }
+  printf("\tIndex output: %s\n", opts->index ? "yes" : "no");
+  printf("\tMark duplicates: %s\n", opts->markdup ? (opts->remove_duplicates ? "yes (removed)" : "yes") : "no");
   printf("\n");
 
   printf("Architecture options\n");
   printf("\tMax. memory: %lu\n", opts->max_memory);
+  printf("\tNum. threads: %d\n", opts->num_threads);
   printf("=================================================\n");
 }
 
@@ -140,6 +168,10 @@ sort_options_t *read_cli_sort_options(void **argtable, sort_options_t *opts) {
   if (((struct arg_file*)argtable[2])->count) { opts->out_dirname = strdup(*(((struct arg_file*)argtable[2])->filename)); }
   if (((struct arg_int*)argtable[3])->count) { opts->max_memory = *(((struct arg_int*)argtable[3])->ival); }
   if (((struct arg_str*)argtable[4])->count) { opts->criteria = strdup(*(((struct arg_str*)argtable[4])->sval)); }
+  if (((struct arg_int*)argtable[5])->count) { opts->num_threads = *(((struct arg_int*)argtable[5])->ival); }
+  if (((struct arg_int*)argtable[6])->count) { opts->index = ((struct arg_int*)argtable[6])->count; }
+  if (((struct arg_int*)argtable[7])->count) { opts->markdup = ((struct arg_int*)argtable[7])->count; }
+  if (((struct arg_int*)argtable[8])->count) { opts->remove_duplicates = ((struct arg_int*)argtable[8])->count; }
   
   return opts;
 }
@@ -163,6 +195,10 @@ void** new_argtable_sort_options() {
   argtable[2] = arg_file0("o", "outdir", NULL, "Output file name (BAM format)");
   argtable[3] = arg_int0(NULL, "max-memory", NULL, "Approximately the maximum required memory [500000000]");
   argtable[4] = arg_str0("c", "criteria", NULL, "Sorting criteria: 'coord' to sort by chromosomal coordinates, and 'name' by read names [coord]");
+  argtable[5] = arg_int0(NULL, "num-threads", NULL, "Number of threads to decompress, sort and compress [4]");
+  argtable[6] = arg_lit0(NULL, "index", "Create the index of the sorted file while it is written (BAI, CSI for references longer than 512 Mbp)");
+  argtable[7] = arg_lit0(NULL, "markdup", "Mark the duplicate reads of the sorted file while it is written (only by coordinate)");
+  argtable[8] = arg_lit0(NULL, "remove-duplicates", "Remove the duplicate reads instead of marking them (with --markdup)");
   
   argtable[NUM_SORT_OPTIONS] = arg_end(20);
   
@@ -21,12 +21,16 @@
 
 //------------------------------------------------------------------------
 
-#define NUM_SORT_OPTIONS	5
+#define NUM_SORT_OPTIONS	9
 
 //------------------------------------------------------------------------
 
 typedef struct sort_options { 
   int help;
+  int num_threads;
+  int index;
+  int markdup;
+  int remove_duplicates;
 
   size_t max_memory;
   char *criteria;
@@ -5,6 +5,9 @@
  *      Author: jtarraga
  */
 
+#include <math.h>
+#include <pthread.h>
+
 #include "stats_bam.h"
 
 //====================================================================
@@ -15,30 +18,246 @@
 
 workflow_t *workflow;
 
+//--------------------------------------------------------------------
+// counters by worker
+//--------------------------------------------------------------------
+
+// every worker takes a private counter block while it processes a
+// batch, so the reads are added without locks, the blocks are merged
+// into the final counters at the end of the workflow
+
+typedef struct stats_counters_pool {
+  int size;
+  int *in_use;
+  stats_counters_t **counters;
+  pthread_mutex_t mutex;
+} stats_counters_pool_t;
+
+//--------------------------------------------------------------------
+
+stats_counters_pool_t *stats_counters_pool_new() {
+  stats_counters_pool_t *p = (stats_counters_pool_t *) calloc(1, sizeof(stats_counters_pool_t));
+
+  p->size = 0;
+  p->in_use = NULL;
+  p->counters = NULL;
+  pthread_mutex_init(&p->mutex, NULL);
+
+  return p;
+}
+
+//--------------------------------------------------------------------
+
+void stats_counters_pool_free(stats_counters_pool_t *p) {
+  if (p) {
+    for (int i = 0; i < p->size; i++) {
+      stats_counters_free(p->counters[i]);
+    }
+    if (p->counters) free(p->counters);
+    if (p->in_use) free(p->in_use);
+    pthread_mutex_destroy(&p->mutex);
+
+    free(p);
+  }
+}
+
+//--------------------------------------------------------------------
+
+stats_counters_t *stats_counters_pool_acquire(int *block, stats_counters_pool_t *p) {
+  int index;
+  stats_counters_t *counters;
+
+  pthread_mutex_lock(&p->mutex);
+  for (index = 0; index < p->size; index++) {
+    if (!p->in_use[index]) break;
+  }
+  if (index == p->size) {
+    // one more worker than blocks
+    p->size++;
+    p->in_use = (int *) realloc(p->in_use, p->size * sizeof(int));
+    p->counters = (stats_counters_t **) realloc(p->counters, p->size * sizeof(stats_counters_t *));
+    p->counters[index] = stats_counters_new();
+  }
+  p->in_use[index] = 1;
+  counters = p->counters[index];
+  pthread_mutex_unlock(&p->mutex);
+
+  *block = index;
+  return counters;
+}
+
+//--------------------------------------------------------------------
+
+void stats_counters_pool_release(int index, stats_counters_pool_t *p) {
+  pthread_mutex_lock(&p->mutex);
+  p->in_use[index] = 0;
+  pthread_mutex_unlock(&p->mutex);
+}
+
+//--------------------------------------------------------------------
+
+void stats_counters_pool_merge(stats_counters_t *counters, stats_counters_pool_t *p) {
+  for (int i = 0; i < p->size; i++) {
+    stats_counters_merge(counters, p->counters[i]);
+  }
+}
+
+//--------------------------------------------------------------------
+// statistics of one read
+//--------------------------------------------------------------------
+
+// computed on the stack from the BAM record, no stats object is
+// allocated by read
+
+typedef struct read_stats {
+  int mapped;
+  int strand;
+  int single_end;
+  int unique_alignment;
+  int seq_length;
+  int num_As, num_Cs, num_Gs, num_Ts, num_Ns;
+  int num_errors;
+  int num_indels;
+  int indels_length;
+  int isize;
+  int quality;
+} read_stats_t;
+
+//--------------------------------------------------------------------
+
+void read_stats_compute(bam1_t *bam1, read_stats_t *stats) {
+  uint32_t flag = (uint32_t) bam1->core.flag;
+  uint8_t *aux;
+
+  memset(stats, 0, sizeof(read_stats_t));
+
+  stats->mapped = (flag & BAM_FUNMAP) ? 0 : 1;
+  stats->strand = (flag & BAM_FREVERSE) ? 1 : 0;
+  stats->single_end = (flag & BAM_FPAIRED) ? 0 : 1;
+  stats->seq_length = bam1->core.l_qseq;
+  stats->quality = bam1->core.qual;
+  stats->isize = abs(bam1->core.isize);
+
+  if (!stats->mapped) return;
+
+  // unique: primary alignment and no other hits reported by the aligner
+  stats->unique_alignment = (flag & BAM_FSECONDARY) ? 0 : 1;
+  if (stats->unique_alignment && (aux = bam_aux_get(bam1, "NH"))) {
+    stats->unique_alignment = (bam_aux2i(aux) <= 1);
+  }
+
+  // errors from the edit distance to the reference
+  if ((aux = bam_aux_get(bam1, "NM"))) {
+    stats->num_errors = bam_aux2i(aux);
+  }
+
+  // indels from the CIGAR
+  uint32_t *cigar = bam1_cigar(bam1);
+  for (int i = 0; i < bam1->core.n_cigar; i++) {
+    switch (cigar[i] & BAM_CIGAR_MASK) {
+    case BAM_CINS:
+    case BAM_CDEL:
+      stats->num_indels++;
+      stats->indels_length += (cigar[i] >> BAM_CIGAR_SHIFT);
+      break;
+    }
+  }
+
+  // nucleotide content
+  uint8_t *seq = bam1_seq(bam1);
+  for (int i = 0; i < stats->seq_length; i++) {
+    switch (bam1_seqi(seq, i)) {
+    case 1: stats->num_As++; break;
+    case 2: stats->num_Cs++; break;
+    case 4: stats->num_Gs++; break;
+    case 8: stats->num_Ts++; break;
+    default: stats->num_Ns++; break;
+    }
+  }
+}
+
+//--------------------------------------------------------------------
+
+void stats_counters_add_read(read_stats_t *stats, uint32_t flag,
+			     stats_counters_t *counters) {
+  int gc, strand = stats->strand;
+
+  counters->num_reads++;
+
+  if (!stats->single_end) counters->single_end = 0;
+
+  if (!stats->mapped) {
+    counters->num_unmapped_reads++;
+    if (flag & BAM_FREAD1) counters->num_unmapped_reads_1++;
+    if (flag & BAM_FREAD2) counters->num_unmapped_reads_2++;
+    return;
+  }
+
+  counters->num_unique_alignments += stats->unique_alignment;
+  counters->num_mapped_reads++;
+  if (flag & BAM_FREAD1) counters->num_mapped_reads_1++;
+  if (flag & BAM_FREAD2) counters->num_mapped_reads_2++;
+
+  counters->num_As += stats->num_As;
+  counters->num_Cs += stats->num_Cs;
+  counters->num_Gs += stats->num_Gs;
+  counters->num_Ts += stats->num_Ts;
+  counters->num_Ns += stats->num_Ns;
+
+  if (stats->seq_length > 0) {
+    gc = round(100.0f * (stats->num_Gs + stats->num_Cs) / stats->seq_length);
+    counters->GC_content[gc < 100 ? gc : 99]++;
+  }
+
+  counters->num_unique_alignments_strand[strand] += stats->unique_alignment;
+  counters->num_mapped_reads_strand[strand]++;
+    
+  counters->num_indels += stats->num_indels;
+  counters->indels_acc += stats->indels_length;
+
+  if (stats->num_errors < NUM_ERRORS_STATS) {
+    counters->num_errors[stats->num_errors]++;
+  } else {
+    counters->num_errors[NUM_ERRORS_STATS]++;
+  }
+
+  if (stats->seq_length > counters->max_alignment_length) counters->max_alignment_length = stats->seq_length;
+  if (stats->seq_length < counters->min_alignment_length) counters->min_alignment_length = stats->seq_length;
+    
+  if (stats->isize > counters->max_insert_size) counters->max_insert_size = stats->isize;
+  if (stats->isize < counters->min_insert_size) counters->min_insert_size = stats->isize;
+  counters->insert_size_acc += stats->isize;
+    
+  if (stats->quality > counters->max_quality) counters->max_quality = stats->quality;
+  if (stats->quality < counters->min_quality) counters->min_quality = stats->quality;
+  counters->quality_acc += stats->quality;
+  counters->quality[stats->quality]++;
+}
+
 //--------------------------------------------------------------------
 // workflow input
 //--------------------------------------------------------------------
 
 typedef struct bam_stats_wf_input {
   stats_options_t *options;
-  bam_file_t *in_file;
-  bam_stats_options_t *bam_stats_options;
+  bam_reader_t *in_file;
   stats_counters_t *counters;
+  stats_counters_pool_t *pool;
 } bam_stats_wf_input_t;
 
 //--------------------------------------------------------------------
 
 bam_stats_wf_input_t *bam_stats_wf_input_new(stats_options_t *options,
-					     bam_file_t *in_file,
-					     bam_stats_options_t *bam_stats_options,
-					     stats_counters_t *counters) {
+					     bam_reader_t *in_file,
+					     stats_counters_t *counters,
+					     stats_counters_pool_t *pool) {
   
   bam_stats_wf_input_t *p = (bam_stats_wf_input_t *) calloc(1, sizeof(bam_stats_wf_input_t));
 
   p->in_file = in_file;
   p->options = options;
-  p->bam_stats_options = bam_stats_options;
   p->counters = counters;
+  p->pool = pool;
 
   return p;
 }
@@ -47,8 +266,6 @@ bam_stats_wf_input_t *bam_stats_wf_input_new(stats_options_t *options,
 
 void bam_stats_wf_input_free(bam_stats_wf_input_t *p) {
   if (p) {
-    if (p->bam_stats_options) bam_stats_options_free(p->bam_stats_options);
-
     free(p);
   }
 }
@@ -59,10 +276,9 @@ void bam_stats_wf_input_free(bam_stats_wf_input_t *p) {
 
 typedef struct bam_stats_wf_batch {
   stats_options_t *options;
-  bam_stats_options_t *bam_stats_options;
   array_list_t *bam1s;
-  array_list_t *bam_stats;
   stats_counters_t *counters;
+  stats_counters_pool_t *pool;
   array_list_t *passed_bam1s;
   array_list_t *failed_bam1s;
 } bam_stats_wf_batch_t;
@@ -70,17 +286,15 @@ typedef struct bam_stats_wf_batch {
 //--------------------------------------------------------------------
 
 bam_stats_wf_batch_t *bam_stats_wf_batch_new(stats_options_t *options,
-					     bam_stats_options_t *bam_stats_options,
 					     array_list_t *bam1s,
-					     array_list_t *bam_stats,
-					     stats_counters_t *counters) {
+					     stats_counters_t *counters,
+					     stats_counters_pool_t *pool) {
   bam_stats_wf_batch_t *p = (bam_stats_wf_batch_t *) calloc(1, sizeof(bam_stats_wf_batch_t));
   
   p->options = options;
-  p->bam_stats_options = bam_stats_options;
   p->bam1s = bam1s;
-  p->bam_stats = bam_stats;
   p->counters = counters;
+  p->pool = pool;
   p->passed_bam1s = NULL;
   p->failed_bam1s = NULL;
   
@@ -101,7 +315,6 @@ void bam_stats_wf_batch_free(bam_stats_wf_batch_t *p) {
       array_list_free(p->bam1s, NULL);
     }
 
-    if (p->bam_stats) array_list_free(p->bam_stats, (void *) bam_stats_free);
     if (p->passed_bam1s) array_list_free(p->passed_bam1s, NULL);
     if (p->failed_bam1s) array_list_free(p->failed_bam1s, NULL);    
 
@@ -118,26 +331,26 @@ void *bam_stats_producer(void *input) {
   bam_stats_wf_batch_t *new_batch = NULL;
   int max_num_bam1s = wf_input->options->batch_size;
 
-  bamFile bam_file = wf_input->in_file->bam_fd;
-  bam1_t *bam1;
+  bam_reader_t *reader = wf_input->in_file;
 
-  //  printf("producer: active items = %i of %i\n", workflow_get_num_items(workflow), workflow->max_num_work_items);
+  // the records are read in one go, their BGZF blocks have been inflated
+  // in the background
+  bam1_t **bam1s = (bam1_t **) calloc(max_num_bam1s, sizeof(bam1_t *));
+  size_t num_bam1s = bam_reader_read_batch(reader, bam1s, max_num_bam1s);
 
   array_list_t *bam1_list = array_list_new(max_num_bam1s, 1.25f, COLLECTION_MODE_ASYNCHRONIZED);  
-  for (int i = 0; i < max_num_bam1s; i++) {
-    bam1 = bam_init1();    
-    if (bam_read1(bam_file, bam1) > 0) {
-
-      if (++read_progress % 500000 == 0) {
-	LOG_INFO_F("%i reads extracting from disk...\n", read_progress);
-      }
+  for (size_t i = 0; i < num_bam1s; i++) {
+    array_list_insert(bam1s[i], bam1_list);
+  }
+  if (num_bam1s < max_num_bam1s && bam1s[num_bam1s]) {
+    bam_destroy1(bam1s[num_bam1s]);
+  }
+  free(bam1s);
 
-      array_list_insert(bam1, bam1_list);
-    } else {
-      bam_destroy1(bam1);
-      break;
-    }
+  if (num_bam1s && (read_progress + num_bam1s) / 500000 > read_progress / 500000) {
+    LOG_INFO_F("%lu reads extracting from disk...\n", read_progress + num_bam1s);
   }
+  read_progress += num_bam1s;
 
   size_t num_items = array_list_size(bam1_list);
 
@@ -145,10 +358,9 @@ void *bam_stats_producer(void *input) {
     array_list_free(bam1_list, NULL);
   } else {
     new_batch = bam_stats_wf_batch_new(wf_input->options,
-				       wf_input->bam_stats_options,
 				       bam1_list,  
-				       NULL,
-				       wf_input->counters);				      
+				       wf_input->counters,
+				       wf_input->pool);
   }
 
   return new_batch;
@@ -163,6 +375,12 @@ int bam_stats_worker(void *data) {
 
   //  printf("worker: active items = %i of %i\n", workflow_get_num_items(workflow), workflow->max_num_work_items);
 
+  // private counters of this worker
+  int index;
+  stats_counters_t *counters = stats_counters_pool_acquire(&index, batch->pool);
+
+  array_list_t *bam1s = batch->bam1s;
+
   // filter ?
   if (batch->options->region_table) {
     // prepare filter options
@@ -184,32 +402,51 @@ int bam_stats_worker(void *data) {
     bam_filter(batch->bam1s, batch->passed_bam1s, 
 	       batch->failed_bam1s, opts);
 
-    if ((num_items = array_list_size(batch->passed_bam1s)) > 0) {
-      // compute statistics for those reads that passed the filters
-      batch->bam_stats = array_list_new(num_items,
-					1.25f, COLLECTION_MODE_ASYNCHRONIZED);  
+    counters->num_passed += array_list_size(batch->passed_bam1s);
+    counters->num_failed += array_list_size(batch->failed_bam1s);
 
-      bam1s_stats(batch->passed_bam1s,
-		  batch->bam_stats_options,
-		  batch->bam_stats);
-    } else {
-      batch->bam_stats = array_list_new(1, 1.25f, COLLECTION_MODE_ASYNCHRONIZED);  
-    }
+    // compute statistics for those reads that passed the filters
+    bam1s = batch->passed_bam1s;
 
     // free memory
     bam_filter_options_free(opts);
+  }
 
-  } else {
-    size_t num_items = array_list_size(batch->bam1s);
-    batch->bam_stats = array_list_new(num_items,
-				      1.25f, COLLECTION_MODE_ASYNCHRONIZED);  
-    
-    bam1s_stats(batch->bam1s,
-		batch->bam_stats_options,
-		batch->bam_stats);
-    
+  // coverage is kept as a difference array (+1 at the first position
+  // of the read, -1 after the last one) shared by all the workers, it is
+  // turned into depths once the workflow is done
+  uint16_t **depths = batch->counters->sequence_depths_per_nt;
+  size_t *lengths = batch->counters->sequence_lengths;
+
+  bam1_t *bam1;
+  read_stats_t stats;
+  int seq_id, start, end;
+  size_t num_items = array_list_size(bam1s);
+
+  for (size_t i = 0; i < num_items; i++) {
+    bam1 = array_list_get(i, bam1s);
+
+    read_stats_compute(bam1, &stats);
+    stats_counters_add_read(&stats, (uint32_t) bam1->core.flag, counters);
+
+    if (!stats.mapped) continue;
+
+    // coverage addition
+    seq_id = bam1->core.tid;
+    start = bam1->core.pos;
+    end = start + bam1->core.l_qseq;
+    if (seq_id < 0 || start < 0 || start >= lengths[seq_id]) continue;
+
+    #pragma omp atomic
+    depths[seq_id][start]++;
+    if (end < lengths[seq_id]) {
+      #pragma omp atomic
+      depths[seq_id][end]--;
+    }
   }
 
+  stats_counters_pool_release(index, batch->pool);
+
   return CONSUMER_STAGE;
 }
 
@@ -222,138 +459,73 @@ int bam_stats_consumer(void *data) {
 
   //  printf("consumer: active items = %i of %i\n", workflow_get_num_items(workflow), workflow->max_num_work_items);
 
-  bam1_t *bam1;
   bam_stats_wf_batch_t *batch = (bam_stats_wf_batch_t *) data;
   
-  bam_stats_t *stats;
+  // the counters were updated by the worker, only the db records
+  // are saved here
+  if (!batch->options->db_on) {
+    bam_progress += array_list_size(batch->bam1s);
+    bam_stats_wf_batch_free(batch);
+    return 0;
+  }
+
+  bam1_t *bam1;
+  read_stats_t stats;
   stats_counters_t *counters = batch->counters;
 
-  int strand, seq_id, start, end, len, quality, gc;
-  size_t num_items = array_list_size(batch->bam_stats);
+  int seq_id, start, end;
 
   array_list_t *bam1s = batch->bam1s;
-
   if (batch->options->region_table) {
-    counters->num_passed += array_list_size(batch->passed_bam1s);
-    counters->num_failed += array_list_size(batch->failed_bam1s);
     bam1s = batch->passed_bam1s;
   }
+  size_t num_items = array_list_size(bam1s);
 
   // variables for storint stats in db
-  int db_on = batch->options->db_on;
-  sqlite3 *db = NULL;
+  sqlite3 *db = batch->options->db;
   sqlite3_stmt* stmt;
   bam_query_fields_t *fields;
   char* errorMessage;
-  khash_t(stats_chunks) *hash = NULL;
-  size_t *sequence_lengths = NULL;
-  char **sequence_labels = NULL;
-
-  if (db_on) {
-    db = batch->options->db;
-    hash = batch->options->hash;
+  khash_t(stats_chunks) *hash = batch->options->hash;
+  size_t *sequence_lengths = counters->sequence_lengths;
+  char **sequence_labels = counters->sequence_labels;
 
-    sequence_labels = counters->sequence_labels;
-    sequence_lengths = counters->sequence_lengths;
+  prepare_statement_bam_query_fields(db, &stmt);
 
-    prepare_statement_bam_query_fields(db, &stmt);
+  sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, &errorMessage);
 
-    sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, &errorMessage);
-  }
-
-  for (int i = 0; i < num_items; i++) {
-    stats = array_list_get(i, batch->bam_stats);
-    if (!stats) continue;
+  for (size_t i = 0; i < num_items; i++) {
+    bam1 = array_list_get(i, bam1s);
   
     bam_progress++;
 
-    strand = stats->strand;
-
-    // merge tmp stats into "final" stats
-    counters->num_reads++;
-
-    if (!stats->mapped) continue;
-
-    counters->num_unique_alignments += stats->unique_alignment;
-    counters->num_mapped_reads += stats->mapped;
-    counters->num_mapped_reads_1 += stats->mapped_pair_1;
-    counters->num_unmapped_reads_1 += stats->unmapped_pair_1;
-    counters->num_mapped_reads_2 += stats->mapped_pair_2;
-    counters->num_unmapped_reads_2 += stats->unmapped_pair_2;
-
-    counters->num_As += stats->num_As;
-    counters->num_Cs += stats->num_Cs;
-    counters->num_Gs += stats->num_Gs;
-    counters->num_Ts += stats->num_Ts;
-    counters->num_Ns += stats->num_Ns;
-
-    gc = round(100.0f * stats->num_GCs / stats->seq_length);
-    counters->GC_content[gc]++;
-
-    counters->single_end = stats->single_end;
-
-    counters->num_unique_alignments_strand[strand] += stats->unique_alignment;
-    counters->num_mapped_reads_strand[strand] += stats->mapped;
-    
-    counters->num_indels += stats->num_indels;
-    counters->indels_acc += stats->indels_length;
-
-    if (stats->num_errors < NUM_ERRORS_STATS) {
-      counters->num_errors[stats->num_errors]++;
-    } else {
-      counters->num_errors[NUM_ERRORS_STATS]++;
-    }
-
-    len = stats->seq_length;
-    if (len > counters->max_alignment_length) counters->max_alignment_length = len;
-    if (len < counters->min_alignment_length) counters->min_alignment_length = len;
-    
-    len = stats->isize;
-    if (len > counters->max_insert_size) counters->max_insert_size = len;
-    if (len < counters->min_insert_size) counters->min_insert_size = len;
-    counters->insert_size_acc += len;
-    
-    quality = stats->quality;
-    if (quality > counters->max_quality) counters->max_quality = quality;
-    if (quality < counters->min_quality) counters->min_quality = quality;
-    counters->quality_acc += quality;
-    counters->quality[quality]++;
-    
-    // coverage addition
-    bam1 = array_list_get(i, bam1s);
+    read_stats_compute(bam1, &stats);
+    if (!stats.mapped) continue;
 
     seq_id = bam1->core.tid;
     start = bam1->core.pos;
     end = start + bam1->core.l_qseq;
 
-    for (int p = start; p < end; p++) {
-      counters->sequence_depths_per_nt[seq_id][p]++;
-    }
-
     // save into db: bam query fields
-    if (db_on) {
-      fields = bam_query_fields_new(bam1_qname(bam1), sequence_labels[seq_id], 
-				    sequence_lengths[seq_id], strand, start + 1, end + 1, 
-				    (uint32_t) bam1->core.flag, stats->quality, 
-				    stats->num_errors, stats->num_indels, stats->indels_length,
-				    stats->isize);
-      insert_statement_bam_query_fields(fields, stmt, db);
-
-      update_chunks_hash(fields->chr, fields->chr_length, BAM_CHUNKSIZE,
-			 fields->start, fields->end, hash);
-      bam_query_fields_free(fields);
-    } 
+    fields = bam_query_fields_new(bam1_qname(bam1), sequence_labels[seq_id], 
+				  sequence_lengths[seq_id], stats.strand, start + 1, end + 1, 
+				  (uint32_t) bam1->core.flag, stats.quality, 
+				  stats.num_errors, stats.num_indels, stats.indels_length,
+				  stats.isize);
+    insert_statement_bam_query_fields(fields, stmt, db);
+
+    update_chunks_hash(fields->chr, fields->chr_length, BAM_CHUNKSIZE,
+		       fields->start, fields->end, hash);
+    bam_query_fields_free(fields);
   } // for each item
 
   //  if (bam_progress % 500000 == 0) {
   //    LOG_INFO_F("%i reads processed !\n", bam_progress);
   //  }
 
-  if (db_on) {
-    sqlite3_exec(db, "COMMIT TRANSACTION", NULL, NULL, &errorMessage);
+  sqlite3_exec(db, "COMMIT TRANSACTION", NULL, NULL, &errorMessage);
 
-    sqlite3_finalize(stmt);
-  }
+  sqlite3_finalize(stmt);
 
   // free memory
   bam_stats_wf_batch_free(batch);
@@ -368,10 +540,20 @@ int bam_stats_consumer(void *data) {
 
 void stats_bam(stats_options_t *opts) {
 
-  bam_file_t *bam_file = bam_fopen(opts->in_filename);
+  bam_reader_t *bam_file = bam_reader_new(opts->in_filename, opts->num_threads);
+  if (bam_file == NULL) {
+    LOG_FATAL_F("Could not open the BAM file %s\n", opts->in_filename);
+  }
+
+  // regions: only their chunks are read if the BAM file is indexed
+  int num_chunks = -1;
+  if (opts->region_table) {
+    num_chunks = bam_reader_set_regions(bam_file, opts->in_filename, 
+					opts->region_list, opts->gff_region_filename);
+  }
   
   size_t ref_length = 0;
-  int num_targets = bam_file->bam_header_p->n_targets;
+  int num_targets = bam_file->header->n_targets;
 
   stats_counters_t *counters = stats_counters_new();
 
@@ -383,11 +565,11 @@ void stats_bam(stats_options_t *opts) {
 
 
   for (int i = 0; i < num_targets; i++) {
-    ref_length += bam_file->bam_header_p->target_len[i];
+    ref_length += bam_file->header->target_len[i];
 
-    counters->sequence_labels[i] = strdup(bam_file->bam_header_p->target_name[i]);
-    counters->sequence_depths_per_nt[i] = (uint16_t *) calloc(bam_file->bam_header_p->target_len[i], sizeof(uint16_t));
-    counters->sequence_lengths[i] = bam_file->bam_header_p->target_len[i];
+    counters->sequence_labels[i] = strdup(bam_file->header->target_name[i]);
+    counters->sequence_depths_per_nt[i] = (uint16_t *) calloc(bam_file->header->target_len[i], sizeof(uint16_t));
+    counters->sequence_lengths[i] = bam_file->header->target_len[i];
   }
 
   counters->ref_length = ref_length;
@@ -399,16 +581,16 @@ void stats_bam(stats_options_t *opts) {
     create_stats_db(opts->out_dbname, BAM_CHUNKSIZE, create_bam_query_fields, &opts->db);                
   }
 
-  // bam_stats_options
-  bam_stats_options_t *bam_stats_options = bam_stats_options_new(NULL, NULL);
+  // counters by worker
+  stats_counters_pool_t *pool = stats_counters_pool_new();
 
   //------------------------------------------------------------------
   // workflow management
   //
   bam_stats_wf_input_t *wf_input = bam_stats_wf_input_new(opts,
 							  bam_file,
-							  bam_stats_options,
-							  counters);
+							  counters,
+							  pool);
   
   // create and initialize workflow
   workflow_t *wf = workflow_new();
@@ -432,17 +614,22 @@ void stats_bam(stats_options_t *opts) {
   // end of workflow management
   //------------------------------------------------------------------
 
-  // free bam stats 
-  //  bam_stats_options_free(bam_stats_options);
+  // merge the counters of the workers
+  stats_counters_pool_merge(counters, pool);
+  stats_counters_pool_free(pool);
 
-  // compute coverage  
+  // compute coverage, the difference arrays are turned into depths
+  uint16_t depth;
   size_t nt_depth, unmapped_nts = 0;
   size_t seq_len, acc_per_sequence = 0, acc = 0;
   for (int i = 0; i < num_targets; i++) {
     seq_len = counters->sequence_lengths[i];
     acc_per_sequence = 0;
+    depth = 0;
     for (int j = 0; j < seq_len; j++) {
-      nt_depth = ((int) counters->sequence_depths_per_nt[i][j]);
+      depth += counters->sequence_depths_per_nt[i][j];
+      counters->sequence_depths_per_nt[i][j] = depth;
+      nt_depth = ((int) depth);
       if (nt_depth) {
 	acc_per_sequence += nt_depth;
       } else {
@@ -478,6 +665,10 @@ void stats_bam(stats_options_t *opts) {
 	   (opts->region_list ? opts->region_list : opts->gff_region_filename));
     printf("\tSo, statistics were computed for %lu of %lu alignments.\n",
 	   counters->num_passed, counters->num_passed + counters->num_failed);
+    if (num_chunks >= 0) {
+      printf("\tRegions read through the BAM index (%i chunks), alignments out of them were not read.\n",
+	     num_chunks);
+    }
   } else {
     printf("\nFiltering: disabled\n");
     printf("\tSo, statistics were computed for the whole input file.\n");
@@ -486,7 +677,7 @@ void stats_bam(stats_options_t *opts) {
 
   // free memory and close file
   stats_counters_free(counters);
-  bam_fclose(bam_file);
+  bam_reader_free(bam_file);
 
   if (opts->db_on) {
     // finally, close db and free hash
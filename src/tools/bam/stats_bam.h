@@ -30,6 +30,8 @@
 #include "bioformats/bam/samtools/bam.h"
 
 
+#include "aux/aux_bam_reader.h"
+
 #include "stats_options.h"
 #include "stats_report.h"
 
@@ -112,6 +112,65 @@ void stats_counters_free(stats_counters_t *p) {
 
 //--------------------------------------------------------------------
 
+void stats_counters_merge(stats_counters_t *dst, stats_counters_t *src) {
+  // filter
+  dst->num_passed += src->num_passed;
+  dst->num_failed += src->num_failed;
+
+  // global statistics
+  dst->single_end &= src->single_end;
+
+  dst->num_reads += src->num_reads;
+  dst->num_unique_alignments += src->num_unique_alignments;
+  dst->num_mapped_reads += src->num_mapped_reads;
+  dst->num_unmapped_reads += src->num_unmapped_reads;
+  dst->num_mapped_reads_1 += src->num_mapped_reads_1;
+  dst->num_unmapped_reads_1 += src->num_unmapped_reads_1;
+  dst->num_mapped_reads_2 += src->num_mapped_reads_2;
+  dst->num_unmapped_reads_2 += src->num_unmapped_reads_2;
+
+  if (src->min_alignment_length < dst->min_alignment_length) dst->min_alignment_length = src->min_alignment_length;
+  if (src->max_alignment_length > dst->max_alignment_length) dst->max_alignment_length = src->max_alignment_length;
+
+  // stats per strand
+  for (int i = 0; i < 2; i++) {
+    dst->num_unique_alignments_strand[i] += src->num_unique_alignments_strand[i];
+    dst->num_mapped_reads_strand[i] += src->num_mapped_reads_strand[i];
+  }
+
+  // errors stats
+  dst->num_indels += src->num_indels;
+  dst->indels_acc += src->indels_acc;
+  for (int i = 0; i <= NUM_ERRORS_STATS ; i++) {
+    dst->num_errors[i] += src->num_errors[i];
+  }
+
+  // nucleotide content
+  dst->num_As += src->num_As;
+  dst->num_Cs += src->num_Cs;
+  dst->num_Gs += src->num_Gs;
+  dst->num_Ts += src->num_Ts;
+  dst->num_Ns += src->num_Ns;
+  for (int i = 0; i < 100 ; i++) {
+    dst->GC_content[i] += src->GC_content[i];
+  }
+
+  // insert
+  if (src->min_insert_size < dst->min_insert_size) dst->min_insert_size = src->min_insert_size;
+  if (src->max_insert_size > dst->max_insert_size) dst->max_insert_size = src->max_insert_size;
+  dst->insert_size_acc += src->insert_size_acc;
+
+  // quality
+  if (src->min_quality < dst->min_quality) dst->min_quality = src->min_quality;
+  if (src->max_quality > dst->max_quality) dst->max_quality = src->max_quality;
+  dst->quality_acc += src->quality_acc;
+  for (int i = 0; i < QUALITY_STATS ; i++) {
+    dst->quality[i] += src->quality[i];
+  }
+}
+
+//--------------------------------------------------------------------
+
 void init_report_graph(report_graph_t* graph) {
     graph->x_autoscale = 1;
     graph->x_start = 1;
@@ -105,6 +105,10 @@ typedef struct stats_counters {
 stats_counters_t *stats_counters_new();
 void stats_counters_free(stats_counters_t *p);
 
+// adds the counters of src to dst (coverage arrays are not merged),
+// used to gather the counters kept by every stats worker
+void stats_counters_merge(stats_counters_t *dst, stats_counters_t *src);
+
 //------------------------------------------------------------------------
 
 /**
@@ -0,0 +1,125 @@
+#include "trace.h"
+
+#define TRACE_INITIAL_EVENTS 4096
+
+//--------------------------------------------------------------------
+
+int trace_enabled = 0;
+__thread trace_buffer_t *trace_local = NULL;
+
+static int num_trace_buffers = 0;
+static int max_trace_buffers = 0;
+static trace_buffer_t **trace_buffers = NULL;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct timespec trace_start;
+
+//--------------------------------------------------------------------
+
+static trace_buffer_t *trace_buffer_register() {
+  trace_buffer_t *p = (trace_buffer_t *) calloc(1, sizeof(trace_buffer_t));
+  p->max_events = TRACE_INITIAL_EVENTS;
+  p->events = (trace_event_t *) malloc(p->max_events * sizeof(trace_event_t));
+
+  pthread_mutex_lock(&trace_mutex);
+  if (num_trace_buffers >= max_trace_buffers) {
+    max_trace_buffers = (max_trace_buffers ? 2 * max_trace_buffers : 64);
+    trace_buffers = (trace_buffer_t **) realloc(trace_buffers,
+						max_trace_buffers * sizeof(trace_buffer_t *));
+  }
+  p->tid = num_trace_buffers;
+  trace_buffers[num_trace_buffers++] = p;
+  pthread_mutex_unlock(&trace_mutex);
+
+  return p;
+}
+
+//--------------------------------------------------------------------
+
+void trace_record(char phase, const char *name, int64_t value) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  if (!trace_local) {
+    trace_local = trace_buffer_register();
+  }
+
+  trace_buffer_t *p = trace_local;
+  if (p->num_events >= p->max_events) {
+    p->max_events *= 2;
+    p->events = (trace_event_t *) realloc(p->events, p->max_events * sizeof(trace_event_t));
+  }
+
+  trace_event_t *e = &p->events[p->num_events++];
+  e->ts = (now.tv_sec - trace_start.tv_sec) * 1000000000LL + (now.tv_nsec - trace_start.tv_nsec);
+  e->value = value;
+  e->phase = phase;
+  strncpy(e->name, name, TRACE_NAME_LENGTH - 1);
+  e->name[TRACE_NAME_LENGTH - 1] = 0;
+}
+
+//--------------------------------------------------------------------
+
+void trace_init(int enabled) {
+  trace_enabled = enabled;
+  clock_gettime(CLOCK_MONOTONIC, &trace_start);
+}
+
+//--------------------------------------------------------------------
+
+void trace_free() {
+  for (int i = 0; i < num_trace_buffers; i++) {
+    free(trace_buffers[i]->events);
+    free(trace_buffers[i]);
+  }
+  if (trace_buffers) free(trace_buffers);
+
+  trace_buffers = NULL;
+  num_trace_buffers = 0;
+  max_trace_buffers = 0;
+  trace_local = NULL;
+  trace_enabled = 0;
+}
+
+//--------------------------------------------------------------------
+
+void trace_dump(char *filename) {
+  if (!trace_enabled) return;
+
+  FILE *f = fopen(filename, "w");
+  if (!f) {
+    printf("Error: could not open %s to write\n", filename);
+    return;
+  }
+
+  int first = 1;
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  pthread_mutex_lock(&trace_mutex);
+  for (int i = 0; i < num_trace_buffers; i++) {
+    trace_buffer_t *p = trace_buffers[i];
+
+    // thread name
+    fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"thread %i\"}}",
+	    (first ? "" : ",\n"), p->tid, p->tid);
+    first = 0;
+
+    for (size_t j = 0; j < p->num_events; j++) {
+      trace_event_t *e = &p->events[j];
+      if (e->phase == TRACE_COUNTER_EVENT) {
+	fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%0.3f,\"pid\":1,\"tid\":%i,\"args\":{\"value\":%li}}",
+		e->name, e->ts / 1000.0, p->tid, e->value);
+      } else {
+	fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"workflow\",\"ph\":\"%c\",\"ts\":%0.3f,\"pid\":1,\"tid\":%i}",
+		e->name, e->phase, e->ts / 1000.0, p->tid);
+      }
+    }
+  }
+  pthread_mutex_unlock(&trace_mutex);
+
+  fprintf(f, "\n]}\n");
+  fclose(f);
+}
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
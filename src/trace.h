@@ -0,0 +1,62 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+//--------------------------------------------------------------------
+// timeline tracer (--trace option), the output file follows the
+// Chrome trace event format (chrome://tracing, Perfetto)
+//--------------------------------------------------------------------
+
+#define TRACE_NAME_LENGTH  31
+
+#define TRACE_BEGIN_EVENT    'B'
+#define TRACE_END_EVENT      'E'
+#define TRACE_COUNTER_EVENT  'C'
+
+typedef struct trace_event {
+  uint64_t ts;      // nanoseconds since trace_init
+  int64_t value;    // only for counters
+  char phase;
+  char name[TRACE_NAME_LENGTH];
+} trace_event_t;
+
+//--------------------------------------------------------------------
+// per-thread event buffer, no locks when recording
+//--------------------------------------------------------------------
+
+typedef struct trace_buffer {
+  int tid;
+  size_t num_events;
+  size_t max_events;
+  trace_event_t *events;
+} trace_buffer_t;
+
+extern int trace_enabled;
+extern __thread trace_buffer_t *trace_local;
+
+void trace_record(char phase, const char *name, int64_t value);
+
+//--------------------------------------------------------------------
+
+#define TRACE_BEGIN(name)           do { if (trace_enabled) trace_record(TRACE_BEGIN_EVENT, (name), 0); } while (0)
+#define TRACE_END(name)             do { if (trace_enabled) trace_record(TRACE_END_EVENT, (name), 0); } while (0)
+#define TRACE_COUNTER(name, value)  do { if (trace_enabled) trace_record(TRACE_COUNTER_EVENT, (name), (value)); } while (0)
+
+//--------------------------------------------------------------------
+
+void trace_init(int enabled);
+void trace_free();
+
+// writes the events of all threads to the file
+void trace_dump(char *filename);
+
+//--------------------------------------------------------------------
+//--------------------------------------------------------------------
+
+#endif // TRACE_H
@@ -60,7 +60,10 @@ void *fastq_reader(void *input) {
      fastq_batch_reader_input_t *fq_reader_input = wf_input->fq_reader_input;
      array_list_t *reads = array_list_new(10000, 1.25f, COLLECTION_MODE_ASYNCHRONIZED);
 
-     if (fq_reader_input->gzip) {
+     if (wf_input->shard) {
+       // slice of the input files
+       fd_read_bytes += shard_fastq_read(reads, fq_reader_input->batch_size, wf_input->shard);
+     } else if (fq_reader_input->gzip) {
        //Gzip fastq file
        if (fq_reader_input->flags == SINGLE_END_MODE) {
 	 fastq_gzread_bytes_se(reads, fq_reader_input->batch_size, fq_reader_input->fq_gzip_file1);
@@ -585,7 +588,9 @@ int sam_writer(void *data) {
   
   if (batch) batch_free(batch);
 
-  basic_statistics_add(num_reads, num_mapped_reads, total_mappings, 0, basic_st);
+  counter_add(COUNTER_TOTAL_READS, num_reads);
+  counter_add(COUNTER_MAPPED_READS, num_mapped_reads);
+  counter_add(COUNTER_TOTAL_MAPPINGS, total_mappings);
 
   return 0;
 
@@ -651,7 +656,9 @@ int bam_writer(void *data) {
   
   if (batch) batch_free(batch);
   
-  basic_statistics_add(num_reads_b, num_mapped_reads, total_mappings, 0, basic_st);
+  counter_add(COUNTER_TOTAL_READS, num_reads_b);
+  counter_add(COUNTER_MAPPED_READS, num_mapped_reads);
+  counter_add(COUNTER_TOTAL_MAPPINGS, total_mappings);
 
   return 0;
 
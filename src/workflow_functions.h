@@ -81,6 +81,7 @@ int rna_last_hc_stage(void *data);
 typedef struct wf_input {
   fastq_batch_reader_input_t *fq_reader_input;
   batch_t *batch;
+  shard_t *shard;  // --shard, NULL to read the whole input
 } wf_input_t;
 
 typedef struct wf_input_buffer {